@@ -9,6 +9,7 @@
 
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
+#include "esp_attr.h"
 #include "esp_log.h"
 
 #include "../../include/LoRa.h"
@@ -35,6 +36,20 @@ static int SX126x_BUSY;
 static int SX126x_TXEN;
 static int SX126x_RXEN;
 
+// Warm start
+// The SX126x keeps its configuration and calibration for as long as it is
+// powered, which includes the ESP32's deep sleep. What was programmed is
+// remembered here so a wake can skip the reset and the calibration.
+#define LORA_WARM_MAGIC 0x5126A11E
+
+typedef struct {
+	uint32_t magic;
+	LoRaParams_t params;
+	int8_t calibTemperature;
+} LoRaWarmState_t;
+
+static RTC_DATA_ATTR LoRaWarmState_t warmState;
+
 // Arduino compatible macros
 #define delayMicroseconds(us) esp_rom_delay_us(us)
 #define delay(ms) esp_rom_delay_us(ms*1000)
@@ -77,7 +92,9 @@ void LoRaInit(void)
 	gpio_set_direction(SX126x_SPI_SELECT, GPIO_MODE_OUTPUT);
 	gpio_set_level(SX126x_SPI_SELECT, 1);
 
+	// Keep NRESET high while taking the pin over, a warm radio must not be reset
 	gpio_reset_pin(SX126x_RESET);
+	gpio_set_level(SX126x_RESET, 1);
 	gpio_set_direction(SX126x_RESET, GPIO_MODE_OUTPUT);
 	
 	gpio_reset_pin(SX126x_BUSY);
@@ -247,14 +264,8 @@ void FixInvertedIQ(uint8_t iqConfig)
 }
 
 
-void LoRaConfig(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate, uint16_t preambleLength, uint8_t payloadLen, bool crcOn, bool invertIrq) 
+static void BuildPacketParams(uint16_t preambleLength, uint8_t payloadLen, bool crcOn, bool invertIrq)
 {
-	SetStopRxTimerOnPreambleDetect(false);
-	SetLoRaSymbNumTimeout(0); 
-	SetPacketType(SX126X_PACKET_TYPE_LORA); // SX126x.ModulationParams.PacketType : MODEM_LORA
-	uint8_t ldro = 0; // LowDataRateOptimize OFF
-	SetModulationParams(spreadingFactor, bandwidth, codingRate, ldro);
-	
 	PacketParams[0] = (preambleLength >> 8) & 0xFF;
 	PacketParams[1] = preambleLength;
 	if ( payloadLen )
@@ -277,6 +288,18 @@ void LoRaConfig(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate,
 		PacketParams[5] = 0x01; // Inverted LoRa I and Q signals setup
 	else
 		PacketParams[5] = 0x00; // Standard LoRa I and Q signals setup
+}
+
+
+void LoRaConfig(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate, uint16_t preambleLength, uint8_t payloadLen, bool crcOn, bool invertIrq) 
+{
+	SetStopRxTimerOnPreambleDetect(false);
+	SetLoRaSymbNumTimeout(0); 
+	SetPacketType(SX126X_PACKET_TYPE_LORA); // SX126x.ModulationParams.PacketType : MODEM_LORA
+	uint8_t ldro = 0; // LowDataRateOptimize OFF
+	SetModulationParams(spreadingFactor, bandwidth, codingRate, ldro);
+	
+	BuildPacketParams(preambleLength, payloadLen, crcOn, invertIrq);
 
 	// fixes IQ configuration for inverted IQ
 	FixInvertedIQ(PacketParams[5]);
@@ -295,6 +318,78 @@ void LoRaConfig(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate,
 }
 
 
+static bool SameParams(const LoRaParams_t *a, const LoRaParams_t *b)
+{
+	return a->frequencyInHz == b->frequencyInHz
+		&& a->txPowerInDbm == b->txPowerInDbm
+		&& a->tcxoVoltage == b->tcxoVoltage
+		&& a->useRegulatorLDO == b->useRegulatorLDO
+		&& a->spreadingFactor == b->spreadingFactor
+		&& a->bandwidth == b->bandwidth
+		&& a->codingRate == b->codingRate
+		&& a->preambleLength == b->preambleLength
+		&& a->payloadLen == b->payloadLen
+		&& a->crcOn == b->crcOn
+		&& a->invertIrq == b->invertIrq;
+}
+
+
+// LoRaBegin() + LoRaConfig(), unless the radio still holds exactly these
+// parameters from before a deep sleep. Then it is only put back into RX,
+// and calibrated again if the temperature moved. LoRaInit() must run first.
+int16_t LoRaWarmBegin(const LoRaParams_t *params, int8_t temperature, bool *warm)
+{
+	uint8_t rv[2] = {0};
+	int16_t err;
+
+	*warm = false;
+	if (warmState.magic == LORA_WARM_MAGIC && SameParams(&warmState.params, params)) {
+		// A radio that lost power or was reset comes back in GFSK mode
+		ReadCommand(SX126X_CMD_GET_PACKET_TYPE, rv, 2); // 0x11
+		if (rv[1] == SX126X_PACKET_TYPE_LORA) {
+			SetStandby(SX126X_STANDBY_RC);
+			if (temperature == LORA_TEMPERATURE_UNKNOWN || warmState.calibTemperature == LORA_TEMPERATURE_UNKNOWN
+				|| abs(temperature - warmState.calibTemperature) > LORA_RECALIBRATE_DELTA_C) {
+				ESP_LOGI(TAG, "temperature %d -> %d, recalibrating", warmState.calibTemperature, temperature);
+				Calibrate(	SX126X_CALIBRATE_IMAGE_ON
+					| SX126X_CALIBRATE_ADC_BULK_P_ON
+					| SX126X_CALIBRATE_ADC_BULK_N_ON
+					| SX126X_CALIBRATE_ADC_PULSE_ON
+					| SX126X_CALIBRATE_PLL_ON
+					| SX126X_CALIBRATE_RC13M_ON
+					| SX126X_CALIBRATE_RC64K_ON
+				);
+				CalibrateImage(params->frequencyInHz);
+				warmState.calibTemperature = temperature;
+			}
+
+			// Packet params only lived in RAM. The IRQ status is left alone so
+			// a packet that woke us up can still be read.
+			BuildPacketParams(params->preambleLength, params->payloadLen, params->crcOn, params->invertIrq);
+			SetDioIrqParams(SX126X_IRQ_ALL, SX126X_IRQ_NONE, SX126X_IRQ_NONE, SX126X_IRQ_NONE);
+			SetRx(0xFFFFFF);
+
+			*warm = true;
+			return ERR_NONE;
+		}
+		ESP_LOGW(TAG, "radio lost its configuration, cold start");
+	}
+
+	warmState.magic = 0;
+	err = LoRaBegin(params->frequencyInHz, params->txPowerInDbm, params->tcxoVoltage, params->useRegulatorLDO);
+	if (err != ERR_NONE) {
+		return err;
+	}
+	LoRaConfig(params->spreadingFactor, params->bandwidth, params->codingRate, params->preambleLength, params->payloadLen, params->crcOn, params->invertIrq);
+
+	warmState.params = *params;
+	warmState.calibTemperature = temperature;
+	warmState.magic = LORA_WARM_MAGIC;
+
+	return ERR_NONE;
+}
+
+
 void LoRaDebugPrint(bool enable) 
 {
 	debugPrint = enable;
@@ -0,0 +1,494 @@
+/**
+ * @file I2CBus.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief I2C bus manager: one i2c_master bus, transaction queue and worker task
+ * 			per port.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// i2c_master REFERENCE: https://docs.espressif.com/projects/esp-idf/en/stable/esp32s3/api-reference/peripherals/i2c.html
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../../include/I2C.h"
+#include "../../include/I2CBus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "driver/i2c_master.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "I2CBus";
+
+typedef enum {
+	REQUEST_TRANSFER,
+	REQUEST_PROBE,
+	REQUEST_STOP,
+} Request_Type_t;
+
+// Queue element. Carries the whole transfer by value.
+typedef struct {
+	Request_Type_t Type;
+	uint16_t Address;
+	I2CBus_Transfer_t Transfer;
+	I2CBus_Callback_t Callback;
+	void *Arg;
+} I2CBus_Request_t;
+
+typedef struct {
+	i2c_master_bus_handle_t Bus;
+	QueueHandle_t Queue;
+	TaskHandle_t Task;
+	int Sda;
+	int Scl;
+	uint8_t Refs;		// I2CBus_Open() references
+	uint8_t Users;		// calls queueing on the port right now
+	bool Closing;		// last reference dropped, being torn down
+} I2CBus_Port_t;
+
+struct I2CBus_Device {
+	int Port;
+	uint16_t Address;
+	i2c_master_dev_handle_t Handle;
+	uint8_t Refs;
+};
+
+// Caller side of a blocking request
+typedef struct {
+	SemaphoreHandle_t Done;
+	esp_err_t Result;
+} I2CBus_Sync_t;
+
+static I2CBus_Port_t Ports[I2CBUS_MAX_PORTS];
+static struct I2CBus_Device Devices[I2CBUS_MAX_DEVICES];
+
+// Guards the port and device tables. Created on first use, so it works no
+// matter which library opens the bus first.
+static StaticSemaphore_t Table_Lock_Buffer;
+static SemaphoreHandle_t Table_Lock;
+static portMUX_TYPE Table_Lock_Init = portMUX_INITIALIZER_UNLOCKED;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+static void Lock(void)
+{
+	taskENTER_CRITICAL(&Table_Lock_Init);
+	if (Table_Lock == NULL) {
+		Table_Lock = xSemaphoreCreateMutexStatic(&Table_Lock_Buffer);
+	}
+	taskEXIT_CRITICAL(&Table_Lock_Init);
+
+	xSemaphoreTake(Table_Lock, portMAX_DELAY);
+}
+
+static void Unlock(void)
+{
+	xSemaphoreGive(Table_Lock);
+}
+
+// Table_Lock must be held
+static I2CBus_Port_t *Open_Port(int Port)
+{
+	if (Port < 0 || Port >= I2CBUS_MAX_PORTS || Ports[Port].Refs == 0) {
+		return NULL;
+	}
+	return &Ports[Port];
+}
+
+// Pin an open port for one call, so a concurrent I2CBus_Close() waits
+// before it deletes the queue the call is sending to
+static I2CBus_Port_t *Acquire_Port(int Port)
+{
+	I2CBus_Port_t *Entry;
+
+	Lock();
+	Entry = Open_Port(Port);
+	if (Entry) {
+		Entry->Users++;
+	}
+	Unlock();
+
+	return Entry;
+}
+
+static void Release_Port(I2CBus_Port_t *Entry)
+{
+	Lock();
+	Entry->Users--;
+	Unlock();
+}
+
+static esp_err_t Run_Transfer(const I2CBus_Transfer_t *Transfer)
+{
+	i2c_master_dev_handle_t Handle = Transfer->Device->Handle;
+
+	if (Transfer->Write_Length && Transfer->Read_Length) {
+		return i2c_master_transmit_receive(Handle, Transfer->Write_Data, Transfer->Write_Length,
+			Transfer->Read_Data, Transfer->Read_Length, I2C_MASTER_TIMEOUT_MS);
+	}
+	if (Transfer->Write_Length) {
+		return i2c_master_transmit(Handle, Transfer->Write_Data, Transfer->Write_Length, I2C_MASTER_TIMEOUT_MS);
+	}
+	if (Transfer->Read_Length) {
+		return i2c_master_receive(Handle, Transfer->Read_Data, Transfer->Read_Length, I2C_MASTER_TIMEOUT_MS);
+	}
+	return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t Run_Request(I2CBus_Port_t *Port, const I2CBus_Request_t *Request)
+{
+	switch (Request->Type) {
+	case REQUEST_TRANSFER:
+		return Run_Transfer(&Request->Transfer);
+	case REQUEST_PROBE:
+		return i2c_master_probe(Port->Bus, Request->Address, I2C_MASTER_TIMEOUT_MS);
+	default:
+		return ESP_OK;
+	}
+}
+
+// One worker per port. The bus driver runs synchronously here, so transfers
+// go out strictly in queue order and never interleave.
+static void I2CBus_Task(void *Arg)
+{
+	I2CBus_Port_t *Port = Arg;
+	I2CBus_Request_t Request;
+	esp_err_t err;
+
+	for (;;) {
+		xQueueReceive(Port->Queue, &Request, portMAX_DELAY);
+
+		err = Run_Request(Port, &Request);
+		if (Request.Callback) {
+			Request.Callback(err, Request.Arg);
+		}
+		if (Request.Type == REQUEST_STOP) {
+			break;
+		}
+	}
+
+	vTaskDelete(NULL);
+}
+
+static void Sync_Done(esp_err_t Result, void *Arg)
+{
+	I2CBus_Sync_t *Sync = Arg;
+
+	Sync->Result = Result;
+	xSemaphoreGive(Sync->Done);
+}
+
+// Queue a request and wait for its completion. Requests made from the worker
+// itself (completion callbacks) would deadlock in the queue, they run inline.
+static esp_err_t Wait_Request(I2CBus_Port_t *Port, I2CBus_Request_t *Request)
+{
+	StaticSemaphore_t Done_Buffer;
+	I2CBus_Sync_t Sync;
+
+	if (xTaskGetCurrentTaskHandle() == Port->Task) {
+		return Run_Request(Port, Request);
+	}
+
+	Sync.Done = xSemaphoreCreateBinaryStatic(&Done_Buffer);
+	Sync.Result = ESP_FAIL;
+	Request->Callback = Sync_Done;
+	Request->Arg = &Sync;
+
+	xQueueSend(Port->Queue, Request, portMAX_DELAY);
+	xSemaphoreTake(Sync.Done, portMAX_DELAY);
+	vSemaphoreDelete(Sync.Done);
+
+	return Sync.Result;
+}
+
+esp_err_t I2CBus_Open(int Port, int Sda, int Scl)
+{
+	i2c_master_bus_config_t Bus_Cfg = {
+		.clk_source = I2C_CLK_SRC_DEFAULT,
+		.i2c_port = Port,
+		.scl_io_num = Scl,
+		.sda_io_num = Sda,
+		.glitch_ignore_cnt = 7,
+	};
+	I2CBus_Port_t *Entry;
+	esp_err_t err = ESP_OK;
+
+	if (Port < 0 || Port >= I2CBUS_MAX_PORTS) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	Lock();
+	Entry = &Ports[Port];
+	if (Entry->Closing) {
+		Unlock();
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Entry->Refs > 0) {
+		if (Entry->Sda != Sda || Entry->Scl != Scl) {
+			ESP_LOGE(TAG, "port %d already open on SDA %d SCL %d", Port, Entry->Sda, Entry->Scl);
+			err = ESP_ERR_INVALID_STATE;
+		} else {
+			Entry->Refs++;
+		}
+		Unlock();
+		return err;
+	}
+
+	err = i2c_new_master_bus(&Bus_Cfg, &Entry->Bus);
+	if (err == ESP_OK) {
+		Entry->Queue = xQueueCreate(I2CBUS_QUEUE_DEPTH, sizeof(I2CBus_Request_t));
+		if (Entry->Queue == NULL ||
+			xTaskCreate(I2CBus_Task, "i2cbus", I2CBUS_TASK_STACK, Entry, I2CBUS_TASK_PRIORITY, &Entry->Task) != pdPASS) {
+			if (Entry->Queue) {
+				vQueueDelete(Entry->Queue);
+			}
+			i2c_del_master_bus(Entry->Bus);
+			err = ESP_ERR_NO_MEM;
+		}
+	}
+	if (err == ESP_OK) {
+		Entry->Sda = Sda;
+		Entry->Scl = Scl;
+		Entry->Refs = 1;
+	}
+	Unlock();
+
+	return err;
+}
+
+esp_err_t I2CBus_Close(int Port)
+{
+	I2CBus_Request_t Stop = {
+		.Type = REQUEST_STOP,
+	};
+	I2CBus_Port_t *Entry;
+	int i;
+
+	Lock();
+	Entry = Open_Port(Port);
+	if (Entry == NULL || xTaskGetCurrentTaskHandle() == Entry->Task) {
+		Unlock();
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (--Entry->Refs > 0) {
+		Unlock();
+		return ESP_OK;
+	}
+
+	// No references left turns new callers away, wait out the ones already in
+	Entry->Closing = true;
+	while (Entry->Users > 0) {
+		Unlock();
+		vTaskDelay(1);
+		Lock();
+	}
+	Unlock();
+
+	// Everything queued before the stop request still goes out. Unlocked, so
+	// completion callbacks of those can still look up the port.
+	Wait_Request(Entry, &Stop);
+
+	Lock();
+	vQueueDelete(Entry->Queue);
+	Entry->Queue = NULL;
+	Entry->Task = NULL;
+
+	for (i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+		if (Devices[i].Refs > 0 && Devices[i].Port == Port) {
+			ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_bus_rm_device(Devices[i].Handle));
+			memset(&Devices[i], 0, sizeof(Devices[i]));
+		}
+	}
+	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_del_master_bus(Entry->Bus));
+	Entry->Bus = NULL;
+	Entry->Closing = false;
+	Unlock();
+
+	return ESP_OK;
+}
+
+esp_err_t I2CBus_AddDevice(int Port, uint16_t Address, uint32_t Speed_Hz, I2CBus_Device_t *Device)
+{
+	i2c_device_config_t Dev_Cfg = {
+		.dev_addr_length = I2C_ADDR_BIT_LEN_7,
+		.device_address = Address,
+		.scl_speed_hz = Speed_Hz,
+	};
+	I2CBus_Port_t *Entry;
+	struct I2CBus_Device *Free = NULL;
+	esp_err_t err;
+	int i;
+
+	Lock();
+	Entry = Open_Port(Port);
+	if (Entry == NULL) {
+		Unlock();
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	// Shared device, first caller's speed wins
+	for (i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+		if (Devices[i].Refs > 0 && Devices[i].Port == Port && Devices[i].Address == Address) {
+			Devices[i].Refs++;
+			*Device = &Devices[i];
+			Unlock();
+			return ESP_OK;
+		}
+		if (Devices[i].Refs == 0 && Free == NULL) {
+			Free = &Devices[i];
+		}
+	}
+	if (Free == NULL) {
+		Unlock();
+		return ESP_ERR_NO_MEM;
+	}
+
+	err = i2c_master_bus_add_device(Entry->Bus, &Dev_Cfg, &Free->Handle);
+	if (err == ESP_OK) {
+		Free->Port = Port;
+		Free->Address = Address;
+		Free->Refs = 1;
+		*Device = Free;
+	}
+	Unlock();
+
+	return err;
+}
+
+esp_err_t I2CBus_RemoveDevice(I2CBus_Device_t Device)
+{
+	esp_err_t err = ESP_OK;
+
+	if (Device == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	Lock();
+	if (Device->Refs == 0) {
+		err = ESP_ERR_INVALID_STATE;
+	} else if (--Device->Refs == 0) {
+		err = i2c_master_bus_rm_device(Device->Handle);
+		memset(Device, 0, sizeof(*Device));
+	}
+	Unlock();
+
+	return err;
+}
+
+esp_err_t I2CBus_Prepare(I2CBus_Transfer_t *Transfer, I2CBus_Device_t Device, const void *Data, size_t Length, void *Read_Data, size_t Read_Length)
+{
+	if (Length > I2CBUS_MAX_WRITE) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	Transfer->Device = Device;
+	if (Length) {
+		memcpy(Transfer->Write_Data, Data, Length);
+	}
+	Transfer->Write_Length = Length;
+	Transfer->Read_Data = Read_Data;
+	Transfer->Read_Length = Read_Length;
+
+	return ESP_OK;
+}
+
+void I2CBus_PrepareRead(I2CBus_Transfer_t *Transfer, I2CBus_Device_t Device, uint8_t Reg, void *Data, size_t Length)
+{
+	Transfer->Device = Device;
+	Transfer->Write_Data[0] = Reg;
+	Transfer->Write_Length = 1;
+	Transfer->Read_Data = Data;
+	Transfer->Read_Length = Length;
+}
+
+esp_err_t I2CBus_Submit(const I2CBus_Transfer_t *Transfer, I2CBus_Callback_t Callback, void *Arg)
+{
+	I2CBus_Request_t Request = {
+		.Type = REQUEST_TRANSFER,
+		.Transfer = *Transfer,
+		.Callback = Callback,
+		.Arg = Arg,
+	};
+	I2CBus_Port_t *Port;
+
+	if (Transfer->Device == NULL || (Port = Acquire_Port(Transfer->Device->Port)) == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xQueueSend(Port->Queue, &Request, portMAX_DELAY);
+	Release_Port(Port);
+
+	return ESP_OK;
+}
+
+esp_err_t I2CBus_Execute(const I2CBus_Transfer_t *Transfer)
+{
+	I2CBus_Request_t Request = {
+		.Type = REQUEST_TRANSFER,
+		.Transfer = *Transfer,
+	};
+	I2CBus_Port_t *Port;
+	esp_err_t err;
+
+	if (Transfer->Device == NULL || (Port = Acquire_Port(Transfer->Device->Port)) == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	err = Wait_Request(Port, &Request);
+	Release_Port(Port);
+
+	return err;
+}
+
+esp_err_t I2CBus_Write(I2CBus_Device_t Device, const void *Data, size_t Length)
+{
+	return I2CBus_WriteRead(Device, Data, Length, NULL, 0);
+}
+
+esp_err_t I2CBus_Read(I2CBus_Device_t Device, void *Data, size_t Length)
+{
+	return I2CBus_WriteRead(Device, NULL, 0, Data, Length);
+}
+
+esp_err_t I2CBus_WriteRead(I2CBus_Device_t Device, const void *Write_Data, size_t Write_Length, void *Read_Data, size_t Read_Length)
+{
+	I2CBus_Transfer_t Transfer;
+	esp_err_t err;
+
+	err = I2CBus_Prepare(&Transfer, Device, Write_Data, Write_Length, Read_Data, Read_Length);
+	if (err != ESP_OK) {
+		return err;
+	}
+
+	return I2CBus_Execute(&Transfer);
+}
+
+esp_err_t I2CBus_Probe(int Port, uint16_t Address)
+{
+	I2CBus_Request_t Request = {
+		.Type = REQUEST_PROBE,
+		.Address = Address,
+	};
+	I2CBus_Port_t *Entry = Acquire_Port(Port);
+	esp_err_t err;
+
+	if (Entry == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	err = Wait_Request(Entry, &Request);
+	Release_Port(Entry);
+
+	return err;
+}
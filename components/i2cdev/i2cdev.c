@@ -0,0 +1,303 @@
+/**
+ * @file i2cdev.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Drop in replacement for esp-lib's i2cdev that runs every transfer
+ * 			through the I2C bus manager instead of the legacy driver. esp-lib
+ * 			drivers (ina219, sht4x, bh1750...) build against it unchanged.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// The header, and with it i2c_dev_t, is esp-lib's own. Only the legacy
+// driver's types are used from it, none of its functions, so the legacy
+// driver is never linked next to i2c_master.
+
+#include <string.h>
+
+#include "i2cdev.h"
+#include "../../include/I2C.h"
+#include "../../include/I2CBus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "i2cdev";
+
+// Bus manager device behind each (port, address) an esp-lib driver talks to
+typedef struct {
+	i2c_port_t Port;
+	uint8_t Addr;
+	I2CBus_Device_t Device;
+} Shim_Device_t;
+
+static Shim_Device_t Shim_Devices[I2CBUS_MAX_DEVICES];
+
+// Drivers in this tree never call i2cdev_init(), so the table lock is
+// created on first use
+static StaticSemaphore_t Shim_Lock_Buffer;
+static SemaphoreHandle_t Shim_Lock;
+static portMUX_TYPE Shim_Lock_Init = portMUX_INITIALIZER_UNLOCKED;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+static void Lock(void)
+{
+	taskENTER_CRITICAL(&Shim_Lock_Init);
+	if (Shim_Lock == NULL) {
+		Shim_Lock = xSemaphoreCreateMutexStatic(&Shim_Lock_Buffer);
+	}
+	taskEXIT_CRITICAL(&Shim_Lock_Init);
+
+	xSemaphoreTake(Shim_Lock, portMAX_DELAY);
+}
+
+static void Unlock(void)
+{
+	xSemaphoreGive(Shim_Lock);
+}
+
+// Find the descriptor's device, opening the port and attaching it on first use
+static I2CBus_Device_t Shim_Device(const i2c_dev_t *dev)
+{
+	Shim_Device_t *Free = NULL;
+	I2CBus_Device_t Device = NULL;
+	uint32_t Speed = I2C_MASTER_FREQ_HZ;
+	int i;
+
+	Lock();
+	for (i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+		if (Shim_Devices[i].Device && Shim_Devices[i].Port == dev->port && Shim_Devices[i].Addr == dev->addr) {
+			Device = Shim_Devices[i].Device;
+			break;
+		}
+		if (Shim_Devices[i].Device == NULL && Free == NULL) {
+			Free = &Shim_Devices[i];
+		}
+	}
+
+	if (Device == NULL && Free != NULL) {
+#if HELPER_TARGET_IS_ESP32
+		if (dev->cfg.master.clk_speed) {
+			Speed = dev->cfg.master.clk_speed;
+		}
+#endif
+		if (I2CBus_Open(dev->port, dev->cfg.sda_io_num, dev->cfg.scl_io_num) == ESP_OK) {
+			if (I2CBus_AddDevice(dev->port, dev->addr, Speed, &Device) == ESP_OK) {
+				Free->Port = dev->port;
+				Free->Addr = dev->addr;
+				Free->Device = Device;
+			} else {
+				I2CBus_Close(dev->port);
+			}
+		}
+	}
+	Unlock();
+
+	if (Device == NULL) {
+		ESP_LOGE(TAG, "[0x%02x at %d] could not attach to the bus", dev->addr, dev->port);
+	}
+	return Device;
+}
+
+static void Shim_Release(const i2c_dev_t *dev)
+{
+	int i;
+
+	Lock();
+	for (i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+		if (Shim_Devices[i].Device && Shim_Devices[i].Port == dev->port && Shim_Devices[i].Addr == dev->addr) {
+			I2CBus_RemoveDevice(Shim_Devices[i].Device);
+			I2CBus_Close(Shim_Devices[i].Port);
+			memset(&Shim_Devices[i], 0, sizeof(Shim_Devices[i]));
+			break;
+		}
+	}
+	Unlock();
+}
+
+// Nothing to install, ports open on the first transfer
+esp_err_t i2cdev_init()
+{
+	return ESP_OK;
+}
+
+esp_err_t i2cdev_done()
+{
+	int i;
+
+	Lock();
+	for (i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+		if (Shim_Devices[i].Device) {
+			I2CBus_RemoveDevice(Shim_Devices[i].Device);
+			I2CBus_Close(Shim_Devices[i].Port);
+			memset(&Shim_Devices[i], 0, sizeof(Shim_Devices[i]));
+		}
+	}
+	Unlock();
+
+	return ESP_OK;
+}
+
+// Descriptor mutexes still guard the multi transfer sequences inside esp-lib
+// drivers; single transfers are already serialized by the bus queue.
+esp_err_t i2c_dev_create_mutex(i2c_dev_t *dev)
+{
+	if (!dev) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	dev->mutex = xSemaphoreCreateMutex();
+	if (!dev->mutex) {
+		ESP_LOGE(TAG, "[0x%02x at %d] Could not create device mutex", dev->addr, dev->port);
+		return ESP_FAIL;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_dev_delete_mutex(i2c_dev_t *dev)
+{
+	if (!dev) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	// drivers call this from their free_desc(), the device is done with the bus
+	Shim_Release(dev);
+	vSemaphoreDelete(dev->mutex);
+	dev->mutex = NULL;
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_dev_take_mutex(i2c_dev_t *dev)
+{
+	if (!dev) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (!xSemaphoreTake(dev->mutex, pdMS_TO_TICKS(I2C_MASTER_TIMEOUT_MS))) {
+		ESP_LOGE(TAG, "[0x%02x at %d] Could not take device mutex", dev->addr, dev->port);
+		return ESP_ERR_TIMEOUT;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_dev_give_mutex(i2c_dev_t *dev)
+{
+	if (!dev) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (!xSemaphoreGive(dev->mutex)) {
+		ESP_LOGE(TAG, "[0x%02x at %d] Could not give device mutex", dev->addr, dev->port);
+		return ESP_FAIL;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type)
+{
+	esp_err_t err;
+
+	if (!dev) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	// i2c_master probes with an address only write whatever the type. The
+	// port is normally open already, only a probe before anything else is
+	// attached brings it up for the probe alone.
+	err = I2CBus_Probe(dev->port, dev->addr);
+	if (err != ESP_ERR_INVALID_STATE) {
+		return err;
+	}
+
+	err = I2CBus_Open(dev->port, dev->cfg.sda_io_num, dev->cfg.scl_io_num);
+	if (err != ESP_OK) {
+		return err;
+	}
+	err = I2CBus_Probe(dev->port, dev->addr);
+	I2CBus_Close(dev->port);
+
+	return err;
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size)
+{
+	I2CBus_Device_t Device;
+
+	if (!dev || !in_data || !in_size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	Device = Shim_Device(dev);
+	if (Device == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	return I2CBus_WriteRead(Device, out_data, out_data ? out_size : 0, in_data, in_size);
+}
+
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size)
+{
+	I2CBus_Transfer_t Transfer;
+	I2CBus_Device_t Device;
+	size_t Reg_Size = out_reg ? out_reg_size : 0;
+
+	if (!dev || !out_data || !out_size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (Reg_Size + out_size > I2CBUS_MAX_WRITE) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	Device = Shim_Device(dev);
+	if (Device == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	// Register address and payload go out as one write
+	Transfer.Device = Device;
+	if (Reg_Size) {
+		memcpy(Transfer.Write_Data, out_reg, Reg_Size);
+	}
+	memcpy(Transfer.Write_Data + Reg_Size, out_data, out_size);
+	Transfer.Write_Length = Reg_Size + out_size;
+	Transfer.Read_Data = NULL;
+	Transfer.Read_Length = 0;
+
+	return I2CBus_Execute(&Transfer);
+}
+
+esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg, void *in_data, size_t in_size)
+{
+	I2CBus_Transfer_t Transfer;
+	I2CBus_Device_t Device;
+
+	if (!dev || !in_data || !in_size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	Device = Shim_Device(dev);
+	if (Device == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	I2CBus_PrepareRead(&Transfer, Device, reg, in_data, in_size);
+	return I2CBus_Execute(&Transfer);
+}
+
+esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg, const void *out_data, size_t out_size)
+{
+	return i2c_dev_write(dev, &reg, 1, out_data, out_size);
+}
@@ -53,7 +53,7 @@ esp_err_t sd_card_init(const char *mount_point, sdmmc_host_t host, sdmmc_card_t
 #else
         .format_if_mount_failed = false,
 #endif // EXAMPLE_FORMAT_IF_MOUNT_FAILED
-        .max_files = 5,
+        .max_files = 7,   // 3 segments, 2 compaction, 1 backfill, 1 journal or cursor
         .allocation_unit_size = 16 * 1024
     };
 
@@ -147,7 +147,7 @@ esp_err_t sd_card_write_file(const char *path, char *data){
         ESP_LOGE(TAG, "Failed to open file for writing");
         return ESP_FAIL;
     }
-    fprintf(f, data);
+    fputs(data, f);
     fclose(f);
     ESP_LOGI(TAG, "File written");
 
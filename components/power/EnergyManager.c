@@ -0,0 +1,137 @@
+/**
+ * @file EnergyManager.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Energy budget policy.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#include "../../include/EnergyManager.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+// Full rate above the conserve knot, then longer periods, smaller reports,
+// less TX power and shorter listening as the battery runs down. Lowering the
+// spreading factor needs the cluster head on the same one, so it is left to
+// custom curves.
+static const Energy_Point_t Default_Curve[] = {
+	{0, {ENERGY_MAX_PERIOD_X100, 25, 14, 0, 10}},
+	{ENERGY_SURVIVAL_SOC, {ENERGY_SURVIVAL_PERIOD_X100, 50, 17, 0, 25}},
+	{ENERGY_CONSERVE_SOC, {ENERGY_CONSERVE_PERIOD_X100, 100, 20, 0, 50}},
+	{100, {100, 100, 22, 0, 100}},
+};
+
+static const Energy_Point_t *Curve = Default_Curve;
+static uint8_t Curve_Length = sizeof(Default_Curve) / sizeof(Default_Curve[0]);
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static int32_t Lerp(int32_t A, int32_t B, float T)
+{
+	return A + (int32_t)lroundf((B - A) * T);
+}
+
+// Interpolate the curve at a state of charge, clamped to its end points
+static void Curve_At(float SoC, Energy_Policy_t *Policy)
+{
+	const Energy_Policy_t *Low, *High;
+	float T;
+	int i;
+
+	if (SoC <= Curve[0].SoC) {
+		*Policy = Curve[0].Policy;
+		return;
+	}
+	for (i = 1; i < Curve_Length && SoC > Curve[i].SoC; i++);
+	if (i == Curve_Length) {
+		*Policy = Curve[Curve_Length - 1].Policy;
+		return;
+	}
+
+	Low = &Curve[i - 1].Policy;
+	High = &Curve[i].Policy;
+	T = (SoC - Curve[i - 1].SoC) / (Curve[i].SoC - Curve[i - 1].SoC);
+
+	Policy->Period_Scale = Lerp(Low->Period_Scale, High->Period_Scale, T);
+	Policy->Batch_Percent = Lerp(Low->Batch_Percent, High->Batch_Percent, T);
+	Policy->Tx_Power = Lerp(Low->Tx_Power, High->Tx_Power, T);
+	Policy->Spreading_Factor = T < 0.5f ? Low->Spreading_Factor : High->Spreading_Factor;
+	Policy->Rx_Duty = Lerp(Low->Rx_Duty, High->Rx_Duty, T);
+}
+
+void Energy_SetCurve(const Energy_Point_t *Points, uint8_t Count)
+{
+	if (Points == NULL || Count == 0 || Count > ENERGY_MAX_POINTS) {
+		Curve = Default_Curve;
+		Curve_Length = sizeof(Default_Curve) / sizeof(Default_Curve[0]);
+		return;
+	}
+	Curve = Points;
+	Curve_Length = Count;
+}
+
+void Energy_DefaultModel(Energy_Model_t *Model, uint32_t Sample_Interval_S, uint32_t Report_Period_S)
+{
+	Model->Sleep_uA = ENERGY_SLEEP_UA;
+	Model->Sample_mAs = ENERGY_SAMPLE_MAS;
+	Model->Report_mAs = ENERGY_REPORT_MAS;
+	Model->Listen_mA = ENERGY_LISTEN_MA;
+	Model->Listen_S = ENERGY_LISTEN_S;
+	Model->Sample_Interval_S = Sample_Interval_S;
+	Model->Report_Period_S = Report_Period_S;
+}
+
+// Everything but sleep current, in mA at Period_Scale = 100. The rest of
+// the draw scales with 1 / Period_Scale.
+static float Active_Current(const Energy_Model_t *Model, const Energy_Policy_t *Policy)
+{
+	float Tx_Factor, Air_Factor, Report;
+
+	// Half of a report is MCU and radio bring up, the PA half follows the
+	// output power. Airtime doubles per spreading factor step.
+	Tx_Factor = 0.5f + 0.5f * powf(10, (Policy->Tx_Power - 22) / 10.0f);
+	Air_Factor = Policy->Spreading_Factor ? ldexpf(1, Policy->Spreading_Factor - 12) : 1;
+
+	Report = Model->Report_mAs * Policy->Batch_Percent / 100 * Tx_Factor * Air_Factor
+		+ Model->Listen_mA * Model->Listen_S * Policy->Rx_Duty / 100;
+
+	return (Model->Sample_Interval_S ? Model->Sample_mAs / Model->Sample_Interval_S : 0)
+		+ (Model->Report_Period_S ? Report / Model->Report_Period_S : 0);
+}
+
+float Energy_AverageCurrent(const Energy_Model_t *Model, const Energy_Policy_t *Policy)
+{
+	return Model->Sleep_uA / 1000 + Active_Current(Model, Policy) * 100 / Policy->Period_Scale;
+}
+
+void Energy_Policy(const Energy_Input_t *Input, const Energy_Model_t *Model, Energy_Policy_t *Policy)
+{
+	float SoC, Budget, Active, Scale;
+
+	SoC = Input->Capacity_mAh > 0 ? 100 * Input->Remaining_mAh / Input->Capacity_mAh : 0;
+	Curve_At(SoC, Policy);
+
+	if (Input->Remaining_S == 0 || Policy->Period_Scale >= ENERGY_MAX_PERIOD_X100) {
+		return;
+	}
+
+	// Current that spreads what is left over the rest of the target lifetime
+	Budget = (Input->Remaining_mAh > 0 ? Input->Remaining_mAh : 0) * 3600 / Input->Remaining_S;
+	if (Energy_AverageCurrent(Model, Policy) <= Budget) {
+		return;
+	}
+
+	// Sleep current is fixed, only the active part shrinks with the period
+	Active = Active_Current(Model, Policy);
+	Budget -= Model->Sleep_uA / 1000;
+	Scale = Budget > 0 ? ceilf(Active * 100 / Budget) : ENERGY_MAX_PERIOD_X100;
+	Policy->Period_Scale = Scale < ENERGY_MAX_PERIOD_X100 ? (uint16_t)Scale : ENERGY_MAX_PERIOD_X100;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file EnergyProfiler.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Per operation energy profiler.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/EnergyProfiler.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <ina219.h>
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "EnergyProfiler";
+
+typedef struct {
+	char Name[PROFILER_NAME_LEN];
+	uint32_t Count;
+	double Total_uJ;
+	double Min_uJ;
+	double Max_uJ;
+	int64_t Total_US;
+} Profiler_Op_t;
+
+static ina219_t Handle;
+static TaskHandle_t Task;
+static esp_timer_handle_t Timer;
+
+// Integrated energy up to Last_US, and the power since then. Written by the
+// sampling task, read by the markers.
+static double Energy_uJ;
+static float Last_W;
+static int64_t Last_US;
+static portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+
+static Profiler_Op_t Ops[PROFILER_MAX_OPS];
+static char Open_Name[PROFILER_NAME_LEN];
+static double Open_uJ;
+static int64_t Open_US;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+// Energy so far, extrapolated from the last reading to Now
+static double Energy_At(int64_t Now)
+{
+	double Energy;
+
+	taskENTER_CRITICAL(&Lock);
+	Energy = Energy_uJ;
+	if (Now > Last_US) {
+		Energy += (double)Last_W * (Now - Last_US);
+	}
+	taskEXIT_CRITICAL(&Lock);
+
+	return Energy;
+}
+
+// esp_timer callbacks must not block, so the I2C read happens in the task
+static void Sample_Tick(void *Arg)
+{
+	xTaskNotifyGive(Task);
+}
+
+static void task_profiler(void *pvParameters)
+{
+	float Power;
+	int64_t Now;
+
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		if (ina219_get_power(&Handle, &Power) != ESP_OK) {
+			continue;
+		}
+		Now = esp_timer_get_time();
+
+		// W * us = uJ. The previous reading holds until this one.
+		taskENTER_CRITICAL(&Lock);
+		Energy_uJ += (double)Last_W * (Now - Last_US);
+		Last_W = Power;
+		Last_US = Now;
+		taskEXIT_CRITICAL(&Lock);
+	}
+}
+
+esp_err_t Profiler_Start(int Port, int Sda, int Scl, float Shunt_Ohms)
+{
+	const esp_timer_create_args_t Timer_Args = {
+		.callback = Sample_Tick,
+		.name = "Profiler",
+	};
+	esp_err_t err;
+
+	if (Task) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	err = ina219_init_desc(&Handle, INA219_ADDR_GND_GND, Port, Sda, Scl);
+	if (err == ESP_OK) {
+		err = ina219_init(&Handle);
+	}
+	if (err == ESP_OK) {
+		err = ina219_configure(&Handle, INA219_BUS_RANGE_32V, INA219_GAIN_0_125, INA219_RES_12BIT_1S, INA219_RES_12BIT_1S, INA219_MODE_CONT_SHUNT_BUS);
+	}
+	if (err == ESP_OK) {
+		err = ina219_calibrate(&Handle, Shunt_Ohms);
+	}
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "INA219 setup failed: %s", esp_err_to_name(err));
+		return err;
+	}
+
+	Last_US = esp_timer_get_time();
+	if (xTaskCreate(&task_profiler, "Profiler", PROFILER_TASK_STACK, NULL, PROFILER_TASK_PRIORITY, &Task) != pdPASS) {
+		Task = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+
+	err = esp_timer_create(&Timer_Args, &Timer);
+	if (err == ESP_OK) {
+		err = esp_timer_start_periodic(Timer, PROFILER_SAMPLE_US);
+	}
+	return err;
+}
+
+void Profiler_Stop(void)
+{
+	if (Timer) {
+		esp_timer_stop(Timer);
+		esp_timer_delete(Timer);
+		Timer = NULL;
+	}
+	if (Task) {
+		vTaskDelete(Task);
+		Task = NULL;
+	}
+}
+
+void Profiler_Reset(void)
+{
+	memset(Ops, 0, sizeof(Ops));
+	Open_Name[0] = '\0';
+}
+
+void Profiler_Begin(const char *Name)
+{
+	strlcpy(Open_Name, Name, sizeof(Open_Name));
+	Open_US = esp_timer_get_time();
+	Open_uJ = Energy_At(Open_US);
+}
+
+void Profiler_End(void)
+{
+	int64_t Now = esp_timer_get_time();
+
+	if (Open_Name[0] == '\0') {
+		return;
+	}
+	Profiler_Record(Open_Name, Energy_At(Now) - Open_uJ, Now - Open_US);
+	Open_Name[0] = '\0';
+}
+
+void Profiler_Record(const char *Name, double Energy, int64_t Duration_US)
+{
+	Profiler_Op_t *Op = NULL;
+	int i;
+
+	for (i = 0; i < PROFILER_MAX_OPS; i++) {
+		if (Ops[i].Count && strncmp(Ops[i].Name, Name, PROFILER_NAME_LEN - 1) == 0) {
+			Op = &Ops[i];
+			break;
+		}
+		if (Op == NULL && Ops[i].Count == 0) {
+			Op = &Ops[i];
+		}
+	}
+	if (Op == NULL) {
+		ESP_LOGW(TAG, "No room for %s", Name);
+		return;
+	}
+
+	if (Op->Count == 0) {
+		strlcpy(Op->Name, Name, sizeof(Op->Name));
+		Op->Min_uJ = Energy;
+		Op->Max_uJ = Energy;
+	}
+	Op->Count++;
+	Op->Total_uJ += Energy;
+	Op->Total_US += Duration_US;
+	if (Energy < Op->Min_uJ) {
+		Op->Min_uJ = Energy;
+	}
+	if (Energy > Op->Max_uJ) {
+		Op->Max_uJ = Energy;
+	}
+}
+
+float Profiler_Power(void)
+{
+	float Power;
+
+	taskENTER_CRITICAL(&Lock);
+	Power = Last_W;
+	taskEXIT_CRITICAL(&Lock);
+
+	return Power * 1000;
+}
+
+void Profiler_Print(bool Header)
+{
+	int i;
+
+	// Plain stdout, no log prefix, so the host can grep the lines out
+	if (Header) {
+		printf("EPROF,op,count,mean_uj,min_uj,max_uj,mean_us\n");
+	}
+	for (i = 0; i < PROFILER_MAX_OPS; i++) {
+		if (Ops[i].Count) {
+			printf("EPROF,%s,%lu,%.1f,%.1f,%.1f,%lld\n", Ops[i].Name, (unsigned long)Ops[i].Count,
+				Ops[i].Total_uJ / Ops[i].Count, Ops[i].Min_uJ, Ops[i].Max_uJ,
+				(long long)(Ops[i].Total_US / Ops[i].Count));
+		}
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file EnergySource.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Remaining battery charge for the energy manager.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <string.h>
+
+#include "../../include/EnergySource.h"
+#include "../../include/EnergyManager.h"
+#include "../../include/PowerMonitor.h"
+#include "esp_log.h"
+
+#if CONFIG_ENERGY_SOURCE_MAX1704X
+#include <max1704x.h>
+#elif CONFIG_ENERGY_SOURCE_LC709203F
+#include <lc709203f.h>
+#endif
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "EnergySource";
+
+#if CONFIG_ENERGY_SOURCE_MAX1704X
+static max1704x_t Gauge;
+#elif CONFIG_ENERGY_SOURCE_LC709203F
+static i2c_dev_t Gauge;
+#else
+// Charge at the power monitor's first reading, estimated from its voltage
+static float Start_mAh;
+static bool Started;
+#endif
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+esp_err_t EnergySource_Init(int Port, int Sda, int Scl)
+{
+	esp_err_t err = ESP_OK;
+
+#if CONFIG_ENERGY_SOURCE_MAX1704X
+	memset(&Gauge, 0, sizeof(Gauge));
+	Gauge.model = MAX17048_9;
+	err = max1704x_init_desc(&Gauge, Port, Sda, Scl);
+#elif CONFIG_ENERGY_SOURCE_LC709203F
+	memset(&Gauge, 0, sizeof(Gauge));
+	err = lc709203f_init_desc(&Gauge, Port, Sda, Scl);
+#else
+	Started = false;
+#endif
+
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Fuel gauge init failed: %s", esp_err_to_name(err));
+	}
+	return err;
+}
+
+esp_err_t EnergySource_Read(float *Remaining_mAh)
+{
+#if CONFIG_ENERGY_SOURCE_MAX1704X
+	float SoC;
+	esp_err_t err = max1704x_get_soc(&Gauge, &SoC);
+
+	if (err == ESP_OK) {
+		*Remaining_mAh = SoC * ENERGY_CAPACITY_MAH / 100;
+	}
+	return err;
+#elif CONFIG_ENERGY_SOURCE_LC709203F
+	uint16_t SoC;
+	esp_err_t err = lc709203f_get_rsoc(&Gauge, &SoC);
+
+	if (err == ESP_OK) {
+		*Remaining_mAh = (float)SoC * ENERGY_CAPACITY_MAH / 100;
+	}
+	return err;
+#else
+	Power_Status_t Status;
+	float SoC;
+
+	PowerMonitor_GetStatus(&Status);
+	if (Status.Samples == 0) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	// Linear between the critical and full voltages, once; coulomb counting
+	// takes over from there
+	if (!Started) {
+		SoC = (Status.Voltage * 1000 - POWER_CRITICAL_MV) / (ENERGY_FULL_MV - POWER_CRITICAL_MV);
+		SoC = SoC < 0 ? 0 : SoC > 1 ? 1 : SoC;
+		Start_mAh = SoC * ENERGY_CAPACITY_MAH + Status.Charge;
+		Started = true;
+	}
+
+	*Remaining_mAh = Start_mAh - Status.Charge;
+	return ESP_OK;
+#endif
+}
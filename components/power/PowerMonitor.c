@@ -0,0 +1,284 @@
+/**
+ * @file PowerMonitor.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background INA219 power monitor.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "../../include/PowerMonitor.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <ina219.h>
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "PowerMonitor";
+
+// One triggered shunt + bus conversion at 12 bit, 128 samples each
+#define POWER_AVERAGING INA219_RES_12BIT_128S
+#define POWER_CONVERSION_MS 140
+
+// INA219 settings kept over deep sleep. If the config register still reads
+// back what was written, the chip stayed powered and its calibration
+// register is intact too, so configure and calibrate are skipped.
+typedef struct {
+	bool Valid;
+	uint16_t Config;
+	float I_LSB, P_LSB;
+	float Shunt_Ohms;
+} Monitor_Warm_t;
+
+static ina219_t Handle;
+static TaskHandle_t Task;
+static RTC_DATA_ATTR Monitor_Warm_t Warm;
+
+// Shared with readers, guarded by Lock
+static Power_Status_t Status;
+static QueueHandle_t Subscribers[POWER_MAX_SUBSCRIBERS];
+static portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+// Big endian, saturated stores
+static void Put_Int16(uint8_t *Buffer, float Value)
+{
+	int32_t Scaled = (int32_t)lroundf(Value);
+
+	if (Scaled > INT16_MAX) {
+		Scaled = INT16_MAX;
+	} else if (Scaled < INT16_MIN) {
+		Scaled = INT16_MIN;
+	}
+	Buffer[0] = ((uint16_t)Scaled >> 8) & 0xFF;
+	Buffer[1] = (uint16_t)Scaled & 0xFF;
+}
+
+static void Put_Uint16(uint8_t *Buffer, float Value)
+{
+	int32_t Scaled = (int32_t)lroundf(Value);
+
+	if (Scaled > UINT16_MAX) {
+		Scaled = UINT16_MAX;
+	} else if (Scaled < 0) {
+		Scaled = 0;
+	}
+	Buffer[0] = (Scaled >> 8) & 0xFF;
+	Buffer[1] = Scaled & 0xFF;
+}
+
+static void Post(Power_Event_t Event)
+{
+	QueueHandle_t Queues[POWER_MAX_SUBSCRIBERS];
+	int i;
+
+	// Queue calls are not allowed inside the critical section
+	taskENTER_CRITICAL(&Lock);
+	memcpy(Queues, Subscribers, sizeof(Queues));
+	taskEXIT_CRITICAL(&Lock);
+
+	for (i = 0; i < POWER_MAX_SUBSCRIBERS; i++) {
+		if (Queues[i]) {
+			xQueueSend(Queues[i], &Event, 0);
+		}
+	}
+}
+
+// Next level for a filtered bus voltage. Falling edges use the thresholds,
+// rising edges need POWER_HYSTERESIS_MV on top so noise cannot toggle events.
+static Power_Level_t Next_Level(Power_Level_t Level, float Voltage)
+{
+	int32_t MV = (int32_t)lroundf(Voltage * 1000);
+
+	if (MV < POWER_CRITICAL_MV) {
+		return POWER_LEVEL_CRITICAL;
+	}
+	if (MV > POWER_LOW_MV + POWER_HYSTERESIS_MV) {
+		return POWER_LEVEL_NORMAL;
+	}
+	if (Level == POWER_LEVEL_CRITICAL && MV <= POWER_CRITICAL_MV + POWER_HYSTERESIS_MV) {
+		return POWER_LEVEL_CRITICAL;
+	}
+	if (MV < POWER_LOW_MV || Level != POWER_LEVEL_NORMAL) {
+		return POWER_LEVEL_LOW;
+	}
+	return POWER_LEVEL_NORMAL;
+}
+
+// One triggered conversion. Current comes back in A, stored in mA.
+static esp_err_t Measure(float *Voltage, float *Current)
+{
+	esp_err_t err;
+
+	err = ina219_trigger(&Handle);
+	if (err != ESP_OK) {
+		return err;
+	}
+	vTaskDelay(pdMS_TO_TICKS(POWER_CONVERSION_MS));
+
+	err = ina219_get_bus_voltage(&Handle, Voltage);
+	if (err == ESP_OK) {
+		err = ina219_get_current(&Handle, Current);
+		*Current *= 1000;
+	}
+	return err;
+}
+
+static void task_power(void *pvParameters)
+{
+	TickType_t Wake = xTaskGetTickCount();
+	Power_Level_t Level = POWER_LEVEL_NORMAL, Next;
+	float Voltage, Current, Last_Current = 0;
+	float Filtered_V = 0, Filtered_I = 0, Charge = 0;
+	int64_t Now, Last = 0;
+	uint32_t Samples = 0;
+
+	while (1) {
+		vTaskDelayUntil(&Wake, pdMS_TO_TICKS(POWER_MONITOR_PERIOD_MS));
+
+		if (Measure(&Voltage, &Current) != ESP_OK) {
+			ESP_LOGW(TAG, "INA219 read failed");
+			continue;
+		}
+		Now = esp_timer_get_time();
+
+		if (Samples == 0) {
+			Filtered_V = Voltage;
+			Filtered_I = Current;
+		} else {
+			Filtered_V += (Voltage - Filtered_V) / (1 << POWER_FILTER_SHIFT);
+			Filtered_I += (Current - Filtered_I) / (1 << POWER_FILTER_SHIFT);
+
+			// Trapezoid on the unfiltered readings, mA * us -> mAh
+			Charge += (Current + Last_Current) / 2 * (float)(Now - Last) / 3.6e9f;
+		}
+		Last_Current = Current;
+		Last = Now;
+		Samples++;
+
+		Next = Next_Level(Level, Filtered_V);
+
+		taskENTER_CRITICAL(&Lock);
+		Status.Voltage = Filtered_V;
+		Status.Current = Filtered_I;
+		Status.Power = Filtered_V * Filtered_I;
+		Status.Charge = Charge;
+		Status.Level = Next;
+		Status.Samples = Samples;
+		taskEXIT_CRITICAL(&Lock);
+
+		// The first reading reports a low battery found at start up too
+		if (Next != Level || (Samples == 1 && Next != POWER_LEVEL_NORMAL)) {
+			ESP_LOGI(TAG, "Bus %.2f V, level %d -> %d", Filtered_V, Level, Next);
+			Post(Next == POWER_LEVEL_CRITICAL ? POWER_EVENT_CRITICAL : Next == POWER_LEVEL_LOW ? POWER_EVENT_LOW : POWER_EVENT_RECOVERED);
+		}
+		Level = Next;
+	}
+}
+
+esp_err_t PowerMonitor_Start(int Port, int Sda, int Scl, float Shunt_Ohms)
+{
+	esp_err_t err;
+
+	if (Task) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	err = ina219_init_desc(&Handle, INA219_ADDR_GND_GND, Port, Sda, Scl);
+	if (err == ESP_OK) {
+		// Reads the config register back
+		err = ina219_init(&Handle);
+	}
+	if (err == ESP_OK && Warm.Valid && Handle.config == Warm.Config && Warm.Shunt_Ohms == Shunt_Ohms) {
+		Handle.i_lsb = Warm.I_LSB;
+		Handle.p_lsb = Warm.P_LSB;
+	} else {
+		Warm.Valid = false;
+		if (err == ESP_OK) {
+			// Triggered: the chip idles between the slow conversions
+			err = ina219_configure(&Handle, INA219_BUS_RANGE_32V, INA219_GAIN_0_125, POWER_AVERAGING, POWER_AVERAGING, INA219_MODE_TRIG_SHUNT_BUS);
+		}
+		if (err == ESP_OK) {
+			err = ina219_calibrate(&Handle, Shunt_Ohms);
+		}
+		if (err == ESP_OK) {
+			Warm.Config = Handle.config;
+			Warm.I_LSB = Handle.i_lsb;
+			Warm.P_LSB = Handle.p_lsb;
+			Warm.Shunt_Ohms = Shunt_Ohms;
+			Warm.Valid = true;
+		}
+	}
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "INA219 setup failed: %s", esp_err_to_name(err));
+		return err;
+	}
+
+	if (xTaskCreate(&task_power, "Power", POWER_TASK_STACK, NULL, POWER_TASK_PRIORITY, &Task) != pdPASS) {
+		Task = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+esp_err_t PowerMonitor_Subscribe(QueueHandle_t Queue)
+{
+	esp_err_t err = ESP_ERR_NO_MEM;
+	int i;
+
+	taskENTER_CRITICAL(&Lock);
+	for (i = 0; i < POWER_MAX_SUBSCRIBERS; i++) {
+		if (Subscribers[i] == NULL) {
+			Subscribers[i] = Queue;
+			err = ESP_OK;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL(&Lock);
+
+	return err;
+}
+
+void PowerMonitor_Unsubscribe(QueueHandle_t Queue)
+{
+	int i;
+
+	taskENTER_CRITICAL(&Lock);
+	for (i = 0; i < POWER_MAX_SUBSCRIBERS; i++) {
+		if (Subscribers[i] == Queue) {
+			Subscribers[i] = NULL;
+		}
+	}
+	taskEXIT_CRITICAL(&Lock);
+}
+
+void PowerMonitor_GetStatus(Power_Status_t *Out)
+{
+	taskENTER_CRITICAL(&Lock);
+	*Out = Status;
+	taskEXIT_CRITICAL(&Lock);
+}
+
+uint8_t PowerMonitor_Encode(uint8_t *Buffer)
+{
+	Power_Status_t Now;
+
+	PowerMonitor_GetStatus(&Now);
+	Put_Uint16(Buffer + 0, Now.Voltage * 1000);
+	Put_Int16(Buffer + 2, Now.Current);
+	Put_Uint16(Buffer + 4, Now.Power);
+	Put_Int16(Buffer + 6, Now.Charge);
+
+	return POWER_STATUS_LEN;
+}
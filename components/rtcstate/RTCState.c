@@ -0,0 +1,124 @@
+/**
+ * @file RTCState.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Versioned, CRC protected node state in RTC memory.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../../include/RTCState.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "RTCState";
+
+#define RTC_STATE_MAGIC 0x52544353
+#define US_PER_S 1000000LL
+
+typedef struct {
+	uint32_t Magic;
+	uint16_t Version;
+	uint16_t Length;
+	uint32_t Sequence;		// commit count, the higher valid copy wins
+	uint32_t CRC;			// over everything above and State, written last
+	RTC_State_t State;
+} RTCState_Copy_t;
+
+// RTC memory is reloaded (zeroed) on every boot but a deep sleep wake, so
+// cold boots never see a valid copy
+static RTC_DATA_ATTR RTCState_Copy_t Copies[2];
+
+static RTC_State_t Working;
+static uint32_t Sequence;
+static bool Restored;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static uint32_t Copy_CRC(const RTCState_Copy_t *Copy)
+{
+	uint32_t CRC;
+
+	CRC = esp_rom_crc32_le(0, (const uint8_t *)Copy, offsetof(RTCState_Copy_t, CRC));
+	return esp_rom_crc32_le(CRC, (const uint8_t *)&Copy->State, sizeof(Copy->State));
+}
+
+static bool Copy_Valid(const RTCState_Copy_t *Copy)
+{
+	return Copy->Magic == RTC_STATE_MAGIC
+		&& Copy->Version == RTC_STATE_VERSION
+		&& Copy->Length == sizeof(RTC_State_t)
+		&& Copy->CRC == Copy_CRC(Copy);
+}
+
+bool RTCState_Load(void)
+{
+	int Newest = -1;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (Copy_Valid(&Copies[i]) && (Newest < 0 || Copies[i].Sequence > Copies[Newest].Sequence)) {
+			Newest = i;
+		}
+	}
+
+	if (Newest < 0) {
+		if (Copies[0].Magic == RTC_STATE_MAGIC || Copies[1].Magic == RTC_STATE_MAGIC) {
+			ESP_LOGW(TAG, "No usable copy, starting from defaults");
+		}
+		memset(&Working, 0, sizeof(Working));
+		Sequence = 0;
+		Restored = false;
+		return false;
+	}
+
+	memcpy(&Working, &Copies[Newest].State, sizeof(Working));
+	Sequence = Copies[Newest].Sequence;
+	Restored = true;
+	return true;
+}
+
+RTC_State_t *RTCState_Get(void)
+{
+	return &Working;
+}
+
+bool RTCState_Restored(void)
+{
+	return Restored;
+}
+
+void RTCState_Commit(void)
+{
+	// Copies alternate with the sequence, so the newest valid one is never
+	// the one being written
+	RTCState_Copy_t *Copy = &Copies[(Sequence + 1) & 1];
+
+	// Invalidate first: a reset before the CRC lands leaves this copy unusable
+	// and the other one in charge
+	Copy->Magic = 0;
+	Copy->Version = RTC_STATE_VERSION;
+	Copy->Length = sizeof(RTC_State_t);
+	Copy->Sequence = ++Sequence;
+	memcpy(&Copy->State, &Working, sizeof(Working));
+	Copy->Magic = RTC_STATE_MAGIC;
+	Copy->CRC = Copy_CRC(Copy);
+}
+
+uint32_t RTCState_NetworkTime(int64_t Local_US)
+{
+	if (Working.Last_Sync_US) {
+		Local_US -= (int64_t)((Local_US - Working.Last_Sync_US) * (double)Working.Drift_PPM / 1e6);
+	}
+	return Local_US / US_PER_S + Working.Time_Offset_S;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file Deadband.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Report by exception: per channel deadband with a heartbeat, and an
+ * 			EWMA z-score anomaly detector.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// EWMA variance REFERENCE: Finch, "Incremental calculation of weighted mean and variance" (2009)
+
+#include <math.h>
+#include <string.h>
+
+#include "../../include/Deadband.h"
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+// Signed difference, wrapped to [-180, 180) for bearings
+static float Difference(const Deadband_Config_t *Config, float A, float B)
+{
+	float Delta = A - B;
+
+	if (Config->Circular) {
+		Delta = fmodf(Delta + 540.0f, 360.0f) - 180.0f;
+	}
+	return Delta;
+}
+
+void Deadband_Reset(Deadband_Channel_t *Channel)
+{
+	memset(Channel, 0, sizeof(*Channel));
+}
+
+Deadband_Result_t Deadband_Update(Deadband_Channel_t *Channel, const Deadband_Config_t *Config, float Value, uint32_t Now_S)
+{
+	Deadband_Result_t Result = DEADBAND_SUPPRESS;
+	float Change, Threshold, Delta, Z;
+
+	// 1. Deadband against the last value that actually went out
+	Change = fabsf(Difference(Config, Value, Channel->Last_Reported));
+	Threshold = fmaxf(Config->Absolute, Config->Relative * fabsf(Channel->Last_Reported));
+	if (Channel->Count == 0 || Change > Threshold || Now_S - Channel->Last_Report_S >= Config->Max_Silence_S) {
+		Result = DEADBAND_REPORT;
+	}
+
+	// 2. Anomaly: far outside the recent EWMA spread, and big enough to
+	// matter on its own. Scored before the sample joins the average.
+	Delta = Difference(Config, Value, Channel->Mean);
+	if (Config->Z_Threshold > 0 && Channel->Count >= DEADBAND_WARMUP && fabsf(Delta) > Config->Absolute) {
+		Z = fabsf(Delta) / sqrtf(Channel->Variance + 1e-6f);
+		if (Z > Config->Z_Threshold) {
+			Result = DEADBAND_ANOMALY;
+		}
+	}
+
+	// 3. Fold the sample into the EWMA
+	if (Channel->Count == 0) {
+		Channel->Mean = Value;
+		Channel->Variance = 0;
+	} else {
+		Channel->Mean += DEADBAND_EWMA_ALPHA * Delta;
+		if (Config->Circular) {
+			Channel->Mean = fmodf(Channel->Mean + 360.0f, 360.0f);
+		}
+		Channel->Variance = (1.0f - DEADBAND_EWMA_ALPHA) * (Channel->Variance + DEADBAND_EWMA_ALPHA * Delta * Delta);
+	}
+	if (Channel->Count < UINT16_MAX) {
+		Channel->Count++;
+	}
+
+	if (Result != DEADBAND_SUPPRESS) {
+		Channel->Last_Reported = Value;
+		Channel->Last_Report_S = Now_S;
+	}
+
+	return Result;
+}
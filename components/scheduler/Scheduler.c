@@ -0,0 +1,415 @@
+/**
+ * @file Scheduler.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Multi-rate sampling scheduler with deadline based wakeups.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "../../include/Scheduler.h"
+#include "../../include/Deadband.h"
+#include "../../include/RTCState.h"
+#include "../../include/WakeStub.h"
+#include "../../include/Windvane.h"
+#include "../../include/Sensors.h"
+#include "../../include/FixedPoint.h"
+#include "esp_log.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "Scheduler";
+
+#define US_PER_S 1000000LL
+
+// Lives in the RTC state block, which carries it over deep sleep
+static Schedule_State_t *State;
+
+// Report by exception thresholds, indexed by slot and value
+#define HEARTBEAT .Max_Silence_S = SCHEDULE_MAX_SILENCE_S, .Z_Threshold = SCHEDULE_ANOMALY_Z
+static const Deadband_Config_t Deadband_Configs[SENSOR_FIRST_EXTERNAL_SLOT][SENSOR_MAX_VALUES] = {
+	[SENSOR_SLOT_SOIL] = {
+		{.Absolute = 20, .Relative = 0.05f, HEARTBEAT},		// moisture, seesaw counts
+		{.Absolute = 0.5f, HEARTBEAT},						// soil temperature, C
+	},
+	[SENSOR_SLOT_SHT30] = {
+		{.Absolute = 0.5f, HEARTBEAT},						// air temperature, C
+		{.Absolute = 3.0f, HEARTBEAT},						// humidity, %
+	},
+	[SENSOR_SLOT_ANEMOMETER] = {
+		{.Absolute = 2.0f, .Relative = 0.2f, HEARTBEAT},	// wind speed, km/h
+	},
+	[SENSOR_SLOT_WINDVANE] = {
+		{.Absolute = 22.5f, .Max_Silence_S = SCHEDULE_MAX_SILENCE_S, .Circular = true},	// bearing, one vane sector
+	},
+};
+
+// Extra drivers: any 5% change
+static const Deadband_Config_t Deadband_Default = {.Relative = 0.05f, HEARTBEAT};
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static int64_t Now_US(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * US_PER_S + tv.tv_usec;
+}
+
+static uint32_t Default_Interval(int Slot)
+{
+	switch (Slot) {
+	case SENSOR_SLOT_SOIL:
+		return SCHEDULE_SOIL_INTERVAL_S;
+	case SENSOR_SLOT_SHT30:
+		return SCHEDULE_SHT30_INTERVAL_S;
+	case SENSOR_SLOT_ANEMOMETER:
+	case SENSOR_SLOT_WINDVANE:
+		return SCHEDULE_WIND_INTERVAL_S;
+	default:
+		return SCHEDULE_EXTERNAL_INTERVAL_S;
+	}
+}
+
+// Interval stretched by the energy manager's pace
+static uint32_t Paced(uint32_t Interval_S)
+{
+	return (uint32_t)(((uint64_t)Interval_S * State->Pace_X100 + 50) / 100);
+}
+
+// Step a deadline forward by whole periods until it is in the future. Missed
+// periods are skipped, not made up.
+static int64_t Advance(int64_t Deadline, uint32_t Period_S, int64_t Now)
+{
+	int64_t Period = (int64_t)Period_S * US_PER_S;
+
+	if (Period == 0) {
+		return Now;
+	}
+	if (Deadline <= Now) {
+		Deadline += ((Now - Deadline) / Period + 1) * Period;
+	}
+	return Deadline;
+}
+
+// Length of the batch record starting at Offset
+static uint16_t Record_Length(uint16_t Offset)
+{
+	return SCHEDULE_RECORD_HEADER_LEN + State->Batch[Offset + SCHEDULE_RECORD_HEADER_LEN - 1];
+}
+
+static void Drop_Records(uint16_t Length)
+{
+	if (Length >= State->Batch_Length) {
+		State->Batch_Length = 0;
+		return;
+	}
+	memmove(State->Batch, State->Batch + Length, State->Batch_Length - Length);
+	State->Batch_Length -= Length;
+}
+
+static void Batch_Append(uint32_t Timestamp, int Slot, const uint8_t *Data, uint8_t Length)
+{
+	uint16_t Needed = SCHEDULE_RECORD_HEADER_LEN + Length;
+	uint16_t Limit = State->Batch_Limit ? State->Batch_Limit : SCHEDULE_BATCH_SIZE;
+	uint8_t *Record;
+
+	if (Needed > Limit) {
+		return;
+	}
+
+	// Oldest samples go first when the batch is full
+	if (State->Batch_Length + Needed > Limit) {
+		ESP_LOGW(TAG, "Batch full, dropping oldest samples");
+	}
+	while (State->Batch_Length + Needed > Limit) {
+		Drop_Records(Record_Length(0));
+	}
+
+	Record = State->Batch + State->Batch_Length;
+	Record[0] = Timestamp >> 24;
+	Record[1] = Timestamp >> 16;
+	Record[2] = Timestamp >> 8;
+	Record[3] = Timestamp;
+	Record[4] = Slot;
+	Record[5] = Length;
+	memcpy(Record + SCHEDULE_RECORD_HEADER_LEN, Data, Length);
+	State->Batch_Length += Needed;
+}
+
+// Run one sample through its channels' deadbands
+static Deadband_Result_t Filter_Sample(int Slot, const Sensor_Values_t *Values, uint32_t Now_S)
+{
+	Deadband_Result_t Result = DEADBAND_SUPPRESS, Channel_Result;
+	const Sensor_Driver_t *Driver = Sensors_Driver(Slot);
+	const Deadband_Config_t *Config;
+	int i;
+
+	// Deadbands are configured in physical units
+	for (i = 0; i < Values->Count && i < SENSOR_MAX_VALUES; i++) {
+		Config = Slot < SENSOR_FIRST_EXTERNAL_SLOT ? &Deadband_Configs[Slot][i] : &Deadband_Default;
+		Channel_Result = Deadband_Update(&State->Channels[Slot][i], Config, Sensor_Physical(Driver, Values, i), Now_S);
+		if (Channel_Result > Result) {
+			Result = Channel_Result;
+		}
+	}
+
+#ifndef CONFIG_SCHEDULE_DEADBAND
+	// Filter disabled, every sample goes out but anomalies still jump the queue
+	if (Result == DEADBAND_SUPPRESS) {
+		Result = DEADBAND_REPORT;
+	}
+#endif
+
+	return Result;
+}
+
+void Scheduler_Init(uint32_t Report_Period_S)
+{
+	int64_t Now = Now_US();
+	int i;
+
+	// A restored state block keeps the schedule, anything else starts over
+	State = &RTCState_Get()->Schedule;
+	if (RTCState_Restored()) {
+		return;
+	}
+
+	memset(State, 0, sizeof(*State));
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		State->Interval_S[i] = Default_Interval(i);
+		State->Next_Due[i] = Now;
+	}
+	State->Report_Period_S = Report_Period_S;
+	State->Next_Report = Now + (int64_t)Report_Period_S * US_PER_S;
+	State->Pace_X100 = 100;
+}
+
+void Scheduler_SetInterval(int Slot, uint32_t Interval_S)
+{
+	if (Slot >= 0 && Slot < SENSOR_MAX_DRIVERS) {
+		State->Interval_S[Slot] = Interval_S;
+	}
+}
+
+void Scheduler_SetReportPeriod(uint32_t Report_Period_S)
+{
+	int64_t Latest = Now_US() + (int64_t)Paced(Report_Period_S) * US_PER_S;
+
+	State->Report_Period_S = Report_Period_S;
+	if (State->Next_Report > Latest) {
+		State->Next_Report = Latest;
+	}
+}
+
+void Scheduler_SetPace(uint16_t Scale_X100, uint16_t Batch_Limit)
+{
+	State->Pace_X100 = Scale_X100 ? Scale_X100 : 100;
+	State->Batch_Limit = Batch_Limit < SCHEDULE_BATCH_SIZE ? Batch_Limit : 0;
+}
+
+uint32_t Scheduler_Due(void)
+{
+	uint32_t Registered = Sensors_Registered();
+	int64_t Horizon = Now_US() + SCHEDULE_SLACK_US;
+	uint32_t Due = 0;
+	int i;
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if ((Registered & SENSOR_SLOT_BIT(i)) && State->Interval_S[i] && State->Next_Due[i] <= Horizon) {
+			Due |= SENSOR_SLOT_BIT(i);
+		}
+	}
+
+	return Due;
+}
+
+#ifdef CONFIG_SCHEDULE_WAKE_STUB
+// Feed the wind vane samples the wake stub took through the same deadband
+// and batch as live ones
+static void Merge_Stub_Samples(void)
+{
+	uint16_t Raw[WAKESTUB_MAX_SAMPLES];
+	Sensor_Values_t Values[SENSOR_MAX_DRIVERS];
+	uint8_t Encoded[SCHEDULE_MAX_RECORD_DATA];
+	Deadband_Result_t Result;
+	uint32_t Period_US, Timestamp;
+	int64_t First, When = 0;
+	uint16_t Count, k;
+	uint8_t Length;
+
+	Count = WakeStub_Take(Raw, &First, &Period_US);
+	for (k = 0; k < Count; k++) {
+		When = First + (int64_t)k * Period_US;
+		Timestamp = RTCState_NetworkTime(When);
+		Values[SENSOR_SLOT_WINDVANE].Value[0] = Fixed_Direction(Windvane_Sector(Raw[k]) * KEY_TO_DEG);
+		Values[SENSOR_SLOT_WINDVANE].Count = 1;
+
+		Result = Filter_Sample(SENSOR_SLOT_WINDVANE, &Values[SENSOR_SLOT_WINDVANE], Timestamp);
+		if (Result != DEADBAND_SUPPRESS) {
+			Length = Sensors_Encode(SENSOR_SLOT_BIT(SENSOR_SLOT_WINDVANE), Values, Encoded, sizeof(Encoded));
+			Batch_Append(Timestamp, SENSOR_SLOT_WINDVANE, Encoded, Length);
+		}
+		if (Result == DEADBAND_ANOMALY) {
+			State->Next_Report = Now_US();
+		}
+	}
+
+	if (Count) {
+		State->Next_Due[SENSOR_SLOT_WINDVANE] = When + Period_US;
+	}
+}
+#endif
+
+uint32_t Scheduler_Run(void)
+{
+	Sensor_Values_t Values[SENSOR_MAX_DRIVERS];
+	uint8_t Encoded[SCHEDULE_MAX_RECORD_DATA];
+	uint32_t Due, Read, Timestamp;
+	Deadband_Result_t Result;
+	uint8_t Length;
+	int64_t Now;
+	int i;
+
+#ifdef CONFIG_SCHEDULE_WAKE_STUB
+	Merge_Stub_Samples();
+#endif
+
+	Due = Scheduler_Due();
+	if (!Due) {
+		return 0;
+	}
+
+	// Due sensors convert in parallel, same as a full read
+	Read = Sensors_Run(Due, Values);
+	Now = Now_US();
+	Timestamp = RTCState_NetworkTime(Now);
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (!(Due & SENSOR_SLOT_BIT(i))) {
+			continue;
+		}
+		if (Read & SENSOR_SLOT_BIT(i)) {
+			Result = Filter_Sample(i, &Values[i], Timestamp);
+			if (Result != DEADBAND_SUPPRESS) {
+				Length = Sensors_Encode(SENSOR_SLOT_BIT(i), Values, Encoded, sizeof(Encoded));
+				Batch_Append(Timestamp, i, Encoded, Length);
+			}
+			if (Result == DEADBAND_ANOMALY) {
+				ESP_LOGI(TAG, "Anomaly on %s, reporting now", Sensors_Driver(i)->Name);
+				State->Next_Report = Now;
+			}
+		}
+		// Failed reads wait for their next slot rather than retrying hot
+		State->Next_Due[i] = Advance(State->Next_Due[i], Paced(State->Interval_S[i]), Now);
+	}
+
+	// Nothing changed since the last report: skip this one, the heartbeat
+	// bounds how long a channel can stay silent
+	if (State->Batch_Length == 0 && State->Next_Report <= Now + SCHEDULE_SLACK_US) {
+		State->Next_Report = Advance(State->Next_Report, Paced(State->Report_Period_S), Now);
+	}
+
+	return Read;
+}
+
+bool Scheduler_TxDue(void)
+{
+	return State->Next_Report <= Now_US() + SCHEDULE_SLACK_US;
+}
+
+uint8_t Scheduler_PeekBatch(uint8_t *Buffer, uint8_t Size)
+{
+	uint16_t Length = 0, Next;
+
+	while (Length < State->Batch_Length) {
+		Next = Record_Length(Length);
+		if (Length + Next > Size) {
+			break;
+		}
+		Length += Next;
+	}
+	memcpy(Buffer, State->Batch, Length);
+
+	return Length;
+}
+
+void Scheduler_ConsumeBatch(uint8_t Length)
+{
+	Drop_Records(Length);
+}
+
+uint16_t Scheduler_BatchLength(void)
+{
+	return State->Batch_Length;
+}
+
+void Scheduler_TxDone(void)
+{
+	State->Next_Report = Advance(State->Next_Report, Paced(State->Report_Period_S), Now_US());
+}
+
+uint64_t Scheduler_PrepareSleep(void)
+{
+#ifdef CONFIG_SCHEDULE_WAKE_STUB
+	uint32_t Registered = Sensors_Registered();
+	int64_t Now = Now_US();
+	int64_t Full = State->Next_Report;
+	int64_t Vane = State->Next_Due[SENSOR_SLOT_WINDVANE];
+	int64_t Period = (int64_t)Paced(State->Interval_S[SENSOR_SLOT_WINDVANE]) * US_PER_S;
+	int64_t Last, Samples;
+	int Channel = Windvane_Channel();
+	int i;
+
+	// The full boot is needed for the report and every other sensor
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (i != SENSOR_SLOT_WINDVANE && (Registered & SENSOR_SLOT_BIT(i)) && State->Interval_S[i] && State->Next_Due[i] < Full) {
+			Full = State->Next_Due[i];
+		}
+	}
+
+	if (Channel >= 0 && (Registered & SENSOR_SLOT_BIT(SENSOR_SLOT_WINDVANE)) && Period
+		&& Vane > Now && Vane + SCHEDULE_SLACK_US < Full) {
+		// Capped in 64 bits, a long report period would wrap a uint16_t
+		Samples = (Full - Vane - 1) / Period + 1;
+		if (Samples > WAKESTUB_MAX_SAMPLES) {
+			Samples = WAKESTUB_MAX_SAMPLES;
+		}
+		// Out of room: boot when the next sample is due, it re-plans
+		Last = Vane + (Samples - 1) * Period;
+		if (Last + Period < Full) {
+			Full = Last + Period;
+		}
+
+		WakeStub_Arm(Channel, (uint16_t)Samples, Vane, Period, Full - Last);
+		return Vane - Now;
+	}
+	WakeStub_Disarm();
+#endif
+
+	return Scheduler_NextWake_US();
+}
+
+uint64_t Scheduler_NextWake_US(void)
+{
+	uint32_t Registered = Sensors_Registered();
+	int64_t Now = Now_US();
+	int64_t Next = State->Next_Report;
+	int i;
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if ((Registered & SENSOR_SLOT_BIT(i)) && State->Interval_S[i] && State->Next_Due[i] < Next) {
+			Next = State->Next_Due[i];
+		}
+	}
+
+	return Next > Now ? Next - Now : 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file WakeStub.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Deep sleep wake stub for wind vane samples.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// Wake stub REFERENCE: https://docs.espressif.com/projects/esp-idf/en/stable/esp32s3/api-guides/deep-sleep-stub.html
+
+// The stub runs before the bootloader loads anything: only RTC memory and
+// ROM are there. Everything it touches is RTC_IRAM_ATTR / RTC_DATA_ATTR and
+// the ADC is driven through its RTC controller registers (ESP32-S3 layout).
+
+#include <string.h>
+
+#include "../../include/WakeStub.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "soc/soc.h"
+#include "soc/rtc.h"
+#include "soc/sens_reg.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define ADC_ATTEN_12DB 3			// matches the continuous driver's ADC_ATTEN_DB_12
+#define ADC_FORCE_XPD_SAR_PU 3		// SAR powered up by software
+#define ADC_FORCE_XPD_SAR_FSM 0		// SAR power back to the FSM
+
+typedef struct {
+	uint16_t Samples_Left;
+	uint16_t Count;
+	uint8_t Channel;
+	uint32_t Period_US;
+	uint32_t Tail_US;
+	int64_t First_US;				// firmware side only, the stub has no clock
+	uint16_t Raw[WAKESTUB_MAX_SAMPLES];
+} WakeStub_Plan_t;
+
+static RTC_DATA_ATTR WakeStub_Plan_t Plan;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+// One conversion on ADC1 through the RTC controller
+static RTC_IRAM_ATTR uint16_t Stub_ReadVane(void)
+{
+	uint16_t Raw;
+
+	SET_PERI_REG_MASK(SENS_SAR_PERI_CLK_GATE_CONF_REG, SENS_SARADC_CLK_EN_M);
+	SET_PERI_REG_BITS(SENS_SAR_POWER_XPD_SAR_REG, SENS_FORCE_XPD_SAR, ADC_FORCE_XPD_SAR_PU, SENS_FORCE_XPD_SAR_S);
+	CLEAR_PERI_REG_MASK(SENS_SAR_MEAS1_MUX_REG, SENS_SAR1_DIG_FORCE_M);
+	SET_PERI_REG_BITS(SENS_SAR_ATTEN1_REG, 0x3, ADC_ATTEN_12DB, Plan.Channel * 2);
+
+	SET_PERI_REG_MASK(SENS_SAR_MEAS1_CTRL2_REG, SENS_MEAS1_START_FORCE_M | SENS_SAR1_EN_PAD_FORCE_M);
+	SET_PERI_REG_BITS(SENS_SAR_MEAS1_CTRL2_REG, SENS_SAR1_EN_PAD, 1 << Plan.Channel, SENS_SAR1_EN_PAD_S);
+	CLEAR_PERI_REG_MASK(SENS_SAR_MEAS1_CTRL2_REG, SENS_MEAS1_START_SAR_M);
+	SET_PERI_REG_MASK(SENS_SAR_MEAS1_CTRL2_REG, SENS_MEAS1_START_SAR_M);
+	while (!GET_PERI_REG_MASK(SENS_SAR_MEAS1_CTRL2_REG, SENS_MEAS1_DONE_SAR_M)) {
+	}
+	Raw = GET_PERI_REG_BITS2(SENS_SAR_MEAS1_CTRL2_REG, SENS_MEAS1_DATA_SAR, SENS_MEAS1_DATA_SAR_S);
+
+	SET_PERI_REG_BITS(SENS_SAR_POWER_XPD_SAR_REG, SENS_FORCE_XPD_SAR, ADC_FORCE_XPD_SAR_FSM, SENS_FORCE_XPD_SAR_S);
+	return Raw;
+}
+
+static RTC_IRAM_ATTR void WakeStub(void)
+{
+	uint32_t Sleep_US;
+
+	// LoRa activity, or nothing left to sample: boot the firmware
+	if (Plan.Samples_Left == 0 || !(esp_wake_stub_get_wakeup_cause() & RTC_TIMER_TRIG_EN)) {
+		esp_default_wake_deep_sleep();
+		return;
+	}
+
+	Plan.Raw[Plan.Count++] = Stub_ReadVane();
+	Plan.Samples_Left--;
+
+	Sleep_US = Plan.Samples_Left ? Plan.Period_US : Plan.Tail_US;
+	if (Sleep_US < WAKESTUB_MIN_SLEEP_US) {
+		esp_default_wake_deep_sleep();
+		return;
+	}
+
+	esp_wake_stub_set_wakeup_time(Sleep_US);
+	esp_wake_stub_sleep(&WakeStub);
+}
+
+void WakeStub_Arm(int Channel, uint16_t Samples, int64_t First_US, uint32_t Period_US, uint32_t Tail_US)
+{
+	if (Samples > WAKESTUB_MAX_SAMPLES) {
+		Samples = WAKESTUB_MAX_SAMPLES;
+	}
+
+	Plan.Channel = Channel;
+	Plan.Samples_Left = Samples;
+	Plan.Count = 0;
+	Plan.First_US = First_US;
+	Plan.Period_US = Period_US;
+	Plan.Tail_US = Tail_US;
+
+	esp_set_deep_sleep_wake_stub(&WakeStub);
+}
+
+void WakeStub_Disarm(void)
+{
+	Plan.Samples_Left = 0;
+	Plan.Count = 0;
+	esp_set_deep_sleep_wake_stub(NULL);
+}
+
+uint16_t WakeStub_Take(uint16_t *Raw, int64_t *First_US, uint32_t *Period_US)
+{
+	uint16_t Count = Plan.Count;
+
+	// RTC memory is reloaded on cold boots, so a stale plan cannot leak in
+	if (Count > WAKESTUB_MAX_SAMPLES) {
+		Count = 0;
+	}
+	memcpy(Raw, Plan.Raw, Count * sizeof(Plan.Raw[0]));
+	*First_US = Plan.First_US;
+	*Period_US = Plan.Period_US;
+
+	WakeStub_Disarm();
+	return Count;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file Anemometer.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Windowed pulse counting anemometer with WMO style gust and mean.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// WMO gust/mean REFERENCE: WMO No. 8, Guide to Instruments and Methods of Observation, Vol. I ch. 5
+// Seqlock REFERENCE: https://www.kernel.org/doc/html/latest/locking/seqlock.html
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../../include/Sensors.h"
+#include "../../include/Anemometer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "driver/pulse_cnt.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "Anemometer";
+
+// PCNT handles and config
+static pcnt_unit_handle_t PCNT_Unit = NULL;
+static pcnt_channel_handle_t PCNT_Channel = NULL;
+static pcnt_unit_config_t PCNT_Unit_cfg = {
+	.high_limit = ANEMOMETER_PCNT_LIMIT,
+	.low_limit = -1,
+	.flags.accum_count = true,	// keep counting across limit crossings
+};
+static pcnt_glitch_filter_config_t PCNT_Filter_cfg = {
+	.max_glitch_ns = ANEMOMETER_GLITCH_NS,
+};
+
+static esp_timer_handle_t Window_Timer;
+
+// Writer side state, only touched by the window timer callback
+static int Last_Count;
+static uint16_t Gust_Ring[ANEMOMETER_GUST_WINDOWS];
+static uint32_t Gust_Sum, Gust_Fill;
+
+// The mean window and running totals live in RTC memory so the 10 minute mean
+// keeps filling across deep sleep wakes instead of starting over on each one.
+// RTC memory is only reloaded on a cold boot.
+static RTC_DATA_ATTR uint16_t Mean_Ring[ANEMOMETER_MEAN_WINDOWS];
+static RTC_DATA_ATTR uint32_t Mean_Sum;
+static RTC_DATA_ATTR uint32_t Ring_Index;
+static RTC_DATA_ATTR Anemometer_Snapshot_t Working;
+static RTC_DATA_ATTR bool Working_Valid;
+
+// Published state. Seq is odd while the writer is mid update.
+static atomic_uint Seq;
+static Anemometer_Snapshot_t Published;
+static atomic_bool Gust_Reset_Requested;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static inline float Pulses_To_Speed(uint32_t Pulses, uint32_t Windows)
+{
+	// ANEMOMETER_VELOCITY_CONSTANT is the speed for one pulse per second
+	return (ANEMOMETER_VELOCITY_CONSTANT * 1000.0f * Pulses) / ((float)Windows * ANEMOMETER_WINDOW_MS);
+}
+
+static void Publish(const Anemometer_Snapshot_t *Snapshot)
+{
+	unsigned int Sequence = atomic_load_explicit(&Seq, memory_order_relaxed);
+
+	atomic_store_explicit(&Seq, Sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&Published, Snapshot, sizeof(Published));
+	atomic_store_explicit(&Seq, Sequence + 2, memory_order_release);
+}
+
+// Runs once per window from the esp_timer task
+static void Anemometer_WindowTick(void *arg)
+{
+	int Count;
+	uint32_t Pulses, Slot, Filled;
+	float Gust;
+
+	if (pcnt_unit_get_count(PCNT_Unit, &Count) != ESP_OK) {
+		return;
+	}
+	Pulses = (uint32_t)(Count - Last_Count);
+	Last_Count = Count;
+	if (Pulses > UINT16_MAX) {
+		Pulses = UINT16_MAX;
+	}
+
+	// Rolling sums over the gust and mean rings
+	Slot = Ring_Index % ANEMOMETER_GUST_WINDOWS;
+	Gust_Sum += Pulses - Gust_Ring[Slot];
+	Gust_Ring[Slot] = Pulses;
+
+	Slot = Ring_Index % ANEMOMETER_MEAN_WINDOWS;
+	Mean_Sum += Pulses - Mean_Ring[Slot];
+	Mean_Ring[Slot] = Pulses;
+	Ring_Index++;
+
+	Working.Windows++;
+	Working.Wake_Windows++;
+	Working.Total_Pulses += Pulses;
+	Working.Window_Pulses = Pulses;
+	Working.Speed = Pulses_To_Speed(Pulses, 1);
+
+	// Averages only cover windows that actually happened during start up
+	Filled = Working.Windows < ANEMOMETER_MEAN_WINDOWS ? Working.Windows : ANEMOMETER_MEAN_WINDOWS;
+	Working.Mean = Pulses_To_Speed(Mean_Sum, Filled);
+	Working.Mean_Windows = Filled;
+
+	if (Gust_Fill < ANEMOMETER_GUST_WINDOWS) {
+		Gust_Fill++;
+	}
+	Gust = Pulses_To_Speed(Gust_Sum, Gust_Fill);
+	if (atomic_exchange(&Gust_Reset_Requested, false) || Gust > Working.Gust) {
+		Working.Gust = Gust;
+	}
+
+	Publish(&Working);
+}
+
+static const esp_timer_create_args_t Window_Timer_Args = {
+	.callback = Anemometer_WindowTick,
+	.dispatch_method = ESP_TIMER_TASK,
+	.name = "anemometer",
+	.skip_unhandled_events = true,
+};
+
+esp_err_t Anemometer_Init(int Gpio)
+{
+	pcnt_chan_config_t Channel_cfg = {
+		.edge_gpio_num = Gpio,
+		.level_gpio_num = -1,
+	};
+	esp_err_t err;
+
+	// A wake carries on with the mean and gust the last one left off with
+	if (!Working_Valid) {
+		memset(&Working, 0, sizeof(Working));
+		memset(Mean_Ring, 0, sizeof(Mean_Ring));
+		Mean_Sum = Ring_Index = 0;
+		Working_Valid = true;
+	}
+
+	// A 3 s gust has to be 3 consecutive windows, so never bridge a sleep
+	memset(Gust_Ring, 0, sizeof(Gust_Ring));
+	Gust_Sum = Gust_Fill = 0;
+	Last_Count = 0;
+	Working.Wake_Windows = 0;
+	Publish(&Working);
+
+	ESP_RETURN_ON_ERROR(pcnt_new_unit(&PCNT_Unit_cfg, &PCNT_Unit), TAG, "pcnt unit");
+	ESP_RETURN_ON_ERROR(pcnt_unit_set_glitch_filter(PCNT_Unit, &PCNT_Filter_cfg), TAG, "glitch filter");
+	ESP_RETURN_ON_ERROR(pcnt_new_channel(PCNT_Unit, &Channel_cfg, &PCNT_Channel), TAG, "pcnt channel");
+
+	// One count per rising edge, falling edge ignored
+	ESP_RETURN_ON_ERROR(pcnt_channel_set_edge_action(PCNT_Channel, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD), TAG, "edge action");
+	// Watch point on the limit lets the driver accumulate overflows
+	ESP_RETURN_ON_ERROR(pcnt_unit_add_watch_point(PCNT_Unit, ANEMOMETER_PCNT_LIMIT), TAG, "watch point");
+
+	ESP_RETURN_ON_ERROR(pcnt_unit_enable(PCNT_Unit), TAG, "enable");
+	ESP_RETURN_ON_ERROR(pcnt_unit_clear_count(PCNT_Unit), TAG, "clear");
+	ESP_RETURN_ON_ERROR(pcnt_unit_start(PCNT_Unit), TAG, "start");
+
+	err = esp_timer_create(&Window_Timer_Args, &Window_Timer);
+	if (err == ESP_OK) {
+		err = esp_timer_start_periodic(Window_Timer, ANEMOMETER_WINDOW_MS * 1000);
+	}
+
+	return err;
+}
+
+void Anemometer_Deinit(void)
+{
+	if (Window_Timer) {
+		esp_timer_stop(Window_Timer);
+		esp_timer_delete(Window_Timer);
+		Window_Timer = NULL;
+	}
+
+	if (PCNT_Unit) {
+		pcnt_unit_stop(PCNT_Unit);
+		pcnt_unit_disable(PCNT_Unit);
+		pcnt_del_channel(PCNT_Channel);
+		pcnt_del_unit(PCNT_Unit);
+		PCNT_Unit = NULL;
+		PCNT_Channel = NULL;
+	}
+}
+
+void Anemometer_GetSnapshot(Anemometer_Snapshot_t *Snapshot)
+{
+	unsigned int Before, After;
+
+	while (1) {
+		Before = atomic_load_explicit(&Seq, memory_order_acquire);
+		if (Before & 1) {
+			continue;	// writer mid update, it never blocks so just retry
+		}
+
+		memcpy(Snapshot, &Published, sizeof(*Snapshot));
+		atomic_thread_fence(memory_order_acquire);
+
+		After = atomic_load_explicit(&Seq, memory_order_relaxed);
+		if (Before == After) {
+			return;
+		}
+	}
+}
+
+void Anemometer_ResetGust(void)
+{
+	atomic_store(&Gust_Reset_Requested, true);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file LibDrivers.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Sensor registry adapters for esp-lib drivers. Each adapter maps the
+ * 			library's start / wait / fetch calls onto Sensor_Driver_t.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../../include/I2C.h"
+#include "../../include/LibDrivers.h"
+#include "../../include/FixedPoint.h"
+#include "freertos/FreeRTOS.h"
+
+#include <math.h>
+
+#ifdef CONFIG_SENSOR_DRIVER_SHT4X
+#include "sht4x.h"
+#endif
+#ifdef CONFIG_SENSOR_DRIVER_BH1750
+#include "bh1750.h"
+#endif
+
+// SHT4X
+/******************************************************************************/
+/******************************************************************************/
+#ifdef CONFIG_SENSOR_DRIVER_SHT4X
+static sht4x_t SHT4X_Dev;
+
+static esp_err_t SHT4X_Init(void *Ctx)
+{
+	esp_err_t err;
+
+	err = sht4x_init_desc(&SHT4X_Dev, I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
+	if (err != ESP_OK) {
+		return err;
+	}
+	return sht4x_init(&SHT4X_Dev);
+}
+
+static esp_err_t SHT4X_Start(void *Ctx)
+{
+	return sht4x_start_measurement(&SHT4X_Dev);
+}
+
+static uint32_t SHT4X_ConversionTime(void *Ctx)
+{
+	// library reports ticks
+	return sht4x_get_measurement_duration(&SHT4X_Dev) * portTICK_PERIOD_MS * 1000;
+}
+
+// The library only hands out floats, quantize them once here
+static esp_err_t SHT4X_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	float Temperature, Humidity;
+	esp_err_t err;
+
+	err = sht4x_get_results(&SHT4X_Dev, &Temperature, &Humidity);
+	if (err != ESP_OK) {
+		return err;
+	}
+
+	Values->Value[0] = lroundf(Temperature * FIXED_TEMPERATURE_SCALE);
+	Values->Value[1] = lroundf(Humidity * FIXED_HUMIDITY_SCALE);
+	Values->Count = 2;
+
+	return ESP_OK;
+}
+
+static uint8_t SHT4X_Encode(const Sensor_Values_t *Values, uint8_t *Buffer)
+{
+	uint8_t Length = 0;
+
+	Length += Sensor_PutInt16(Buffer + Length, Values->Value[0]);
+	Length += Sensor_PutUint16(Buffer + Length, Values->Value[1]);
+
+	return Length;
+}
+
+const Sensor_Driver_t SHT4X_Driver = {
+	.Name = "sht4x",
+	.Encoded_Length = 4,
+	.Scale = {FIXED_TEMPERATURE_SCALE, FIXED_HUMIDITY_SCALE},
+	.Init = SHT4X_Init,
+	.Start_Measurement = SHT4X_Start,
+	.Conversion_Time = SHT4X_ConversionTime,
+	.Read = SHT4X_Read,
+	.Encode = SHT4X_Encode,
+};
+#endif // CONFIG_SENSOR_DRIVER_SHT4X
+
+// BH1750
+/******************************************************************************/
+/******************************************************************************/
+#ifdef CONFIG_SENSOR_DRIVER_BH1750
+static i2c_dev_t BH1750_Dev;
+
+static esp_err_t BH1750_Init(void *Ctx)
+{
+	esp_err_t err;
+
+	err = bh1750_init_desc(&BH1750_Dev, CONFIG_SENSOR_DRIVER_BH1750_ADDR, I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
+	if (err != ESP_OK) {
+		return err;
+	}
+	return bh1750_power_on(&BH1750_Dev);
+}
+
+static esp_err_t BH1750_Start(void *Ctx)
+{
+	// one time mode: setup triggers the measurement, then the chip powers down
+	return bh1750_setup(&BH1750_Dev, BH1750_MODE_ONE_TIME, BH1750_RES_HIGH);
+}
+
+static uint32_t BH1750_ConversionTime(void *Ctx)
+{
+	return BH1750_CONVERSION_US;
+}
+
+static esp_err_t BH1750_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	uint16_t Level;
+	esp_err_t err;
+
+	err = bh1750_read(&BH1750_Dev, &Level);
+	Values->Value[0] = Level;
+	Values->Count = 1;
+
+	return err;
+}
+
+static uint8_t BH1750_Encode(const Sensor_Values_t *Values, uint8_t *Buffer)
+{
+	return Sensor_PutUint16(Buffer, Values->Value[0]);
+}
+
+const Sensor_Driver_t BH1750_Driver = {
+	.Name = "bh1750",
+	.Encoded_Length = 2,
+	.Init = BH1750_Init,
+	.Start_Measurement = BH1750_Start,
+	.Conversion_Time = BH1750_ConversionTime,
+	.Read = BH1750_Read,
+	.Encode = BH1750_Encode,
+};
+#endif // CONFIG_SENSOR_DRIVER_BH1750
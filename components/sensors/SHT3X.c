@@ -75,7 +75,7 @@ uint8_t clear_status_register[]         = {0x30, 0x41};
 */
 static void delay_ms(int ms)
 {
-	vTaskDelay((ms) / portTICK_PERIOD_MS);
+	vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1);
 }
 
 /*
@@ -109,10 +109,11 @@ uint8_t sht3x_generate_crc(const uint8_t* data, uint16_t count) {
 * Hence, it is required to wait the command execution time before issuing the read header.
 * Commands must not be sent while a previous command is being processed.
 */
-esp_err_t sht3x_send_command(uint8_t *command, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_send_command(uint8_t *command, I2CBus_Device_t Dev_Handle) {
     esp_err_t err = ESP_OK;
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Dev_Handle, command, sizeof(command), I2C_MASTER_TIMEOUT_MS));
+	err = I2CBus_Write(Dev_Handle, command, SHT3X_HEX_CODE_SIZE);
+	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 
     return err;
 }
@@ -123,10 +124,11 @@ esp_err_t sht3x_send_command(uint8_t *command, i2c_master_dev_handle_t Dev_Handl
 * immediately succeeded by an 8-bit CRC. In write direction it is mandatory to transmit the checksum.
 * In read direction it is up to the master to decide if it wants to process the checksum.
 */
-esp_err_t sht3x_read(uint8_t *hex_code, uint8_t *measurements, uint8_t size, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_read(uint8_t *hex_code, uint8_t *measurements, uint8_t size, I2CBus_Device_t Dev_Handle) {
     esp_err_t err = ESP_OK;
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit_receive(Dev_Handle, hex_code, SHT3X_HEX_CODE_SIZE, measurements, size, I2C_MASTER_TIMEOUT_MS));
+	err = I2CBus_WriteRead(Dev_Handle, hex_code, SHT3X_HEX_CODE_SIZE, measurements, size);
+	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 
     return err;
 }
@@ -137,11 +139,12 @@ esp_err_t sht3x_read(uint8_t *hex_code, uint8_t *measurements, uint8_t size, i2c
 * immediately succeeded by an 8-bit CRC. In write direction it is mandatory to transmit the checksum.
 * In read direction it is up to the master to decide if it wants to process the checksum.
 */
-esp_err_t sht3x_write(uint8_t *hex_code, uint8_t *measurements, uint8_t size, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_write(uint8_t *hex_code, uint8_t *measurements, uint8_t size, I2CBus_Device_t Dev_Handle) {
     esp_err_t err = ESP_OK;
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Dev_Handle, hex_code, SHT3X_HEX_CODE_SIZE, I2C_MASTER_TIMEOUT_MS));
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Dev_Handle, measurements, size, I2C_MASTER_TIMEOUT_MS));
+	ESP_ERROR_CHECK_WITHOUT_ABORT(I2CBus_Write(Dev_Handle, hex_code, SHT3X_HEX_CODE_SIZE));
+	err = I2CBus_Write(Dev_Handle, measurements, size);
+	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 
     return err;
 }
@@ -152,14 +155,19 @@ esp_err_t sht3x_write(uint8_t *hex_code, uint8_t *measurements, uint8_t size, i2
 * Hence, it is required to wait the command execution time before issuing the read header.
 * Commands must not be sent while a previous command is being processed.
 */
-esp_err_t sht3x_send_command_and_fetch_result(uint8_t *command, uint8_t *measurements, uint8_t size, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_send_command_and_fetch_result(uint8_t *command, uint8_t *measurements, uint8_t size, I2CBus_Device_t Dev_Handle) {
     esp_err_t err = ESP_OK;	
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Dev_Handle, command, sizeof(command), I2C_MASTER_TIMEOUT_MS));
+	err = I2CBus_Write(Dev_Handle, command, SHT3X_HEX_CODE_SIZE);
+	if (err != ESP_OK) {
+		return err;
+	}
 
-    delay_ms(1000);
+    // Wait out the longest (high repeatability) conversion, not a full second
+    delay_ms((SHT3X_DURATION_HIGH_US / 1000) + 1);
 
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_receive(Dev_Handle, measurements, size,I2C_MASTER_TIMEOUT_MS));
+    err = I2CBus_Read(Dev_Handle, measurements, size);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 
     return err;
 }
@@ -167,14 +175,14 @@ esp_err_t sht3x_send_command_and_fetch_result(uint8_t *command, uint8_t *measure
 /*
 * Start periodic measurement, signal update interval is 5 seconds.
 */
-esp_err_t sht3x_start_periodic_measurement(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_start_periodic_measurement(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(mps_4_repeatability_high, Dev_Handle);
 }
 
 /*
 * Start periodic measurement with the accelerated response time (ART) feature.
 */
-esp_err_t sht3x_start_periodic_measurement_with_art(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_start_periodic_measurement_with_art(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(periodic_measurement_with_art, Dev_Handle);
 }
 
@@ -182,7 +190,7 @@ esp_err_t sht3x_start_periodic_measurement_with_art(i2c_master_dev_handle_t Dev_
 * Read sensor output. The measurement data can only be read out once per signal update interval
 * as the buffer is emptied upon read-out.
 */
-esp_err_t sht3x_read_measurement(sht3x_sensors_values_t *sensors_values, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_read_measurement(sht3x_sensors_values_t *sensors_values, I2CBus_Device_t Dev_Handle) {
     measurements_t measurements = {
         .temperature = {{0x00, 0x00}, 0x00},
         .humidity = {{0x00, 0x00}, 0x00}
@@ -195,11 +203,43 @@ esp_err_t sht3x_read_measurement(sht3x_sensors_values_t *sensors_values, i2c_mas
     return err;
 }
 
+/*
+* Convert a raw 6 byte measurement (temperature word, crc, humidity word, crc) into
+* physical values. Returns ESP_ERR_INVALID_CRC if either checksum does not match.
+*/
+esp_err_t sht3x_parse_measurement(const uint8_t *raw, sht3x_sensors_values_t *sensors_values) {
+    uint16_t temperature, humidity;
+    esp_err_t err = sht3x_parse_raw(raw, &temperature, &humidity);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    sensors_values->temperature = (175.0 * (temperature / 65535.0)) - 45.0;
+    sensors_values->humidity = 100.0 * humidity / 65535.0;
+    return ESP_OK;
+}
+
+/*
+* Check both checksums of a raw 6 byte measurement and return the 16 bit temperature
+* and humidity words, for integer conversion (see FixedPoint.h).
+*/
+esp_err_t sht3x_parse_raw(const uint8_t *raw, uint16_t *temperature, uint16_t *humidity) {
+    if (sht3x_generate_crc(raw, 2) != raw[2] || sht3x_generate_crc(raw + 3, 2) != raw[5]) {
+        ESP_LOGW(SHT3X_TAG, "measurement crc mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    *temperature = (raw[0] << 8) | raw[1];
+    *humidity = (raw[3] << 8) | raw[4];
+    return ESP_OK;
+}
+
 /*
 * Stop periodic measurement to change the sensor configuration or to save power. Note that the sensor will only
 * respond to other commands after waiting 500 ms after issuing the stop_periodic_measurement command.
 */
-esp_err_t sht3x_stop_periodic_measurement(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_stop_periodic_measurement(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(stop_periodic_measurement, Dev_Handle);
 }
 
@@ -208,7 +248,7 @@ esp_err_t sht3x_stop_periodic_measurement(i2c_master_dev_handle_t Dev_Handle) {
 * the power supply. When the system is in idle state the soft reset command can be sent to the SHT3x.
 * This triggers the sensor to reset its system controller and reloads calibration data from the memory.
 */
-esp_err_t sht3x_soft_reset(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_soft_reset(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(soft_reset, Dev_Handle);
 }
 
@@ -216,21 +256,21 @@ esp_err_t sht3x_soft_reset(i2c_master_dev_handle_t Dev_Handle) {
 * Additionally, a reset of the sensor can also be generated using the "general call" mode according to
 * I2C-bus specification. This generates a reset which is functionally identical to using the nReset pin.
 */
-esp_err_t sht3x_general_call_reset(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_general_call_reset(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(general_call_reset, Dev_Handle);
 }
 
 /*
 * Switch the internal heater on.
 */
-esp_err_t sht3x_enable_heater(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_enable_heater(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(heater_enable, Dev_Handle);
 }
 
 /*
 * Switch the internal heater off.
 */
-esp_err_t sht3x_disable_heater(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_disable_heater(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(heater_disable, Dev_Handle);
 }
 
@@ -238,7 +278,7 @@ esp_err_t sht3x_disable_heater(i2c_master_dev_handle_t Dev_Handle) {
 * The status register contains information on the operational status of the heater, the alert mode
 * and on the execution status of the last command and the last write sequence.
 */
-esp_err_t sht3x_read_status_register(sht3x_sensor_value_t *sensors_value, i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_read_status_register(sht3x_sensor_value_t *sensors_value, I2CBus_Device_t Dev_Handle) {
     sht3x_sensor_value_t status_register = {
         .value = {0x00, 0x00},
         .crc = 0x00
@@ -256,6 +296,6 @@ esp_err_t sht3x_read_status_register(sht3x_sensor_value_t *sensors_value, i2c_ma
 /*
 * Clear all flags in the status register.
 */
-esp_err_t sht3x_clear_status_register(i2c_master_dev_handle_t Dev_Handle) {
+esp_err_t sht3x_clear_status_register(I2CBus_Device_t Dev_Handle) {
     return sht3x_send_command(clear_status_register, Dev_Handle);
 }
\ No newline at end of file
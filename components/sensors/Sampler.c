@@ -0,0 +1,139 @@
+/**
+ * @file Sampler.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background high rate sampling of the noisy wind sensors.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "../../include/Sensors.h"
+#include "../../include/Sampler.h"
+#include "../../include/Anemometer.h"
+#include "../../include/FixedPoint.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "Sampler";
+
+static TaskHandle_t Sampler_Task;
+static portMUX_TYPE Sampler_Lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Accumulators for the current window. They live in RTC memory so a window
+// keeps collecting across deep sleep until a report resets it, RTC memory is
+// only reloaded on a cold boot.
+static RTC_DATA_ATTR Stats_Channel_t WindSpeed_Stats;
+static RTC_DATA_ATTR Stats_Circular_t WindDirection_Stats;
+static RTC_DATA_ATTR bool Stats_Valid;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static void task_sampler(void *pvParameters)
+{
+	TickType_t Last_Wake = xTaskGetTickCount();
+	TickType_t Period = pdMS_TO_TICKS(1000 / SAMPLER_RATE_HZ);
+	float Speed, Direction;
+
+	if (Period == 0) {
+		Period = 1;
+	}
+
+	while (1) {
+		vTaskDelayUntil(&Last_Wake, Period);
+
+		// Read outside the lock, only the O(1) updates are inside it
+		Speed = Get_Wind_Speed();
+		Direction = Get_Wind_Direction();
+
+		portENTER_CRITICAL(&Sampler_Lock);
+		Stats_Update(&WindSpeed_Stats, Speed);
+		Stats_CircularUpdate(&WindDirection_Stats, Direction);
+		portEXIT_CRITICAL(&Sampler_Lock);
+	}
+}
+
+bool Sampler_Start(void)
+{
+	if (Sampler_Task) {
+		return true;
+	}
+
+	// A wake carries on with the window the last one left open
+	if (!Stats_Valid) {
+		Stats_Reset(&WindSpeed_Stats);
+		Stats_CircularReset(&WindDirection_Stats);
+		Stats_Valid = true;
+	}
+
+	if (xTaskCreate(&task_sampler, "Sampler", SAMPLER_TASK_STACK, NULL, SAMPLER_TASK_PRIORITY, &Sampler_Task) != pdPASS) {
+		ESP_LOGE(TAG, "Failed to start sampling task");
+		Sampler_Task = NULL;
+		return false;
+	}
+
+	ESP_LOGI(TAG, "Sampling wind at %d Hz", SAMPLER_RATE_HZ);
+	return true;
+}
+
+void Sampler_Stop(void)
+{
+	if (Sampler_Task) {
+		vTaskDelete(Sampler_Task);
+		Sampler_Task = NULL;
+	}
+}
+
+void Sampler_GetSummary(Sampler_Summary_t *Summary, bool Reset)
+{
+	Anemometer_Snapshot_t Wind;
+
+	// Gust is tracked by the anemometer itself on exact 1 s windows
+	Anemometer_GetSnapshot(&Wind);
+	Summary->WindGust = Wind.Gust;
+	if (Reset) {
+		Anemometer_ResetGust();
+	}
+
+	portENTER_CRITICAL(&Sampler_Lock);
+	Stats_Summarize(&WindSpeed_Stats, &Summary->WindSpeed);
+	Stats_CircularSummarize(&WindDirection_Stats, &Summary->WindDirection);
+	if (Reset) {
+		Stats_Reset(&WindSpeed_Stats);
+		Stats_CircularReset(&WindDirection_Stats);
+	}
+	portEXIT_CRITICAL(&Sampler_Lock);
+}
+
+uint8_t Sampler_EncodeSummary(const Sampler_Summary_t *Summary, uint8_t *Buffer)
+{
+	uint8_t Length = 0;
+	uint32_t Count = Summary->WindSpeed.Count;
+	uint32_t Gust = (uint32_t)lroundf(Summary->WindGust * FIXED_WIND_SPEED_SCALE);
+
+	Length += Stats_Encode(&Summary->WindSpeed, FIXED_WIND_SPEED_SCALE, Buffer + Length);
+	Length += Stats_CircularEncode(&Summary->WindDirection, Buffer + Length);
+
+	// gust, saturated
+	if (Gust > 0xFFFF) {
+		Gust = 0xFFFF;
+	}
+	Buffer[Length++] = Gust >> 8;
+	Buffer[Length++] = Gust & 0xFF;
+
+	// sample count, saturated
+	if (Count > 0xFFFF) {
+		Count = 0xFFFF;
+	}
+	Buffer[Length++] = Count >> 8;
+	Buffer[Length++] = Count & 0xFF;
+
+	return Length;
+}
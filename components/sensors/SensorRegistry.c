@@ -0,0 +1,337 @@
+/**
+ * @file SensorRegistry.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Pluggable sensor drivers and the parallel acquisition scheduler.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <string.h>
+
+#include "../../include/Sensors.h"
+#include "../../include/SensorRegistry.h"
+#include "../../include/LibDrivers.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "SensorRegistry";
+
+typedef struct {
+	const Sensor_Driver_t *Driver;
+	void *Ctx;
+} Sensor_Entry_t;
+
+static Sensor_Entry_t Registry[SENSOR_MAX_DRIVERS];
+
+// Drivers picked in menuconfig. Adding a sensor is one entry here plus its
+// Kconfig option.
+static const Sensor_Entry_t Static_Drivers[] = {
+#ifdef CONFIG_SENSOR_DRIVER_SHT4X
+	{&SHT4X_Driver, NULL},
+#endif
+#ifdef CONFIG_SENSOR_DRIVER_BH1750
+	{&BH1750_Driver, NULL},
+#endif
+	{NULL, NULL},	// keeps the array non-empty when nothing is enabled
+};
+
+// Last good reading of every slot and when it was taken (esp_timer us, 0 =
+// never). Every acquisition refreshes it, scheduled ones included.
+static Sensor_Values_t Cache[SENSOR_MAX_DRIVERS];
+static int64_t Cache_Time[SENSOR_MAX_DRIVERS];
+
+// One acquisition at a time. A caller that queued behind another one finds
+// the cache fresh and is served from it, so overlapping requests cost a
+// single bus round.
+static StaticSemaphore_t Run_Lock_Buffer;
+static SemaphoreHandle_t Run_Lock;
+static portMUX_TYPE Run_Lock_Init = portMUX_INITIALIZER_UNLOCKED;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static void Lock(void)
+{
+	taskENTER_CRITICAL(&Run_Lock_Init);
+	if (Run_Lock == NULL) {
+		Run_Lock = xSemaphoreCreateMutexStatic(&Run_Lock_Buffer);
+	}
+	taskEXIT_CRITICAL(&Run_Lock_Init);
+
+	xSemaphoreTake(Run_Lock, portMAX_DELAY);
+}
+
+static void Unlock(void)
+{
+	xSemaphoreGive(Run_Lock);
+}
+
+esp_err_t Sensors_RegisterSlot(int Slot, const Sensor_Driver_t *Driver, void *Ctx)
+{
+	esp_err_t err;
+
+	if (Slot < 0 || Slot >= SENSOR_MAX_DRIVERS || !Driver || !Driver->Read || !Driver->Encode) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (Driver->Init) {
+		err = Driver->Init(Ctx);
+		if (err != ESP_OK) {
+			ESP_LOGW(TAG, "%s failed to initialize: %s", Driver->Name, esp_err_to_name(err));
+			return err;
+		}
+	}
+
+	Registry[Slot].Driver = Driver;
+	Registry[Slot].Ctx = Ctx;
+
+	return ESP_OK;
+}
+
+int Sensors_Register(const Sensor_Driver_t *Driver, void *Ctx)
+{
+	int Slot;
+
+	for (Slot = SENSOR_FIRST_EXTERNAL_SLOT; Slot < SENSOR_MAX_DRIVERS; Slot++) {
+		if (!Registry[Slot].Driver) {
+			return Sensors_RegisterSlot(Slot, Driver, Ctx) == ESP_OK ? Slot : -1;
+		}
+	}
+
+	ESP_LOGW(TAG, "No free slot for %s", Driver->Name);
+	return -1;
+}
+
+uint32_t Sensors_RegisterStatic(void)
+{
+	uint32_t Registered = 0;
+	int i, Slot;
+
+	for (i = 0; Static_Drivers[i].Driver; i++) {
+		Slot = Sensors_Register(Static_Drivers[i].Driver, Static_Drivers[i].Ctx);
+		if (Slot >= 0) {
+			Registered |= SENSOR_SLOT_BIT(Slot);
+		}
+	}
+
+	return Registered;
+}
+
+void Sensors_Unregister(int Slot)
+{
+	if (Slot >= 0 && Slot < SENSOR_MAX_DRIVERS) {
+		Registry[Slot].Driver = NULL;
+		Registry[Slot].Ctx = NULL;
+		Cache_Time[Slot] = 0;
+	}
+}
+
+uint32_t Sensors_Registered(void)
+{
+	uint32_t Slots = 0;
+	int i;
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (Registry[i].Driver) {
+			Slots |= SENSOR_SLOT_BIT(i);
+		}
+	}
+
+	return Slots;
+}
+
+const Sensor_Driver_t *Sensors_Driver(int Slot)
+{
+	if (Slot < 0 || Slot >= SENSOR_MAX_DRIVERS) {
+		return NULL;
+	}
+	return Registry[Slot].Driver;
+}
+
+static int64_t Ready_After(const Sensor_Entry_t *Entry)
+{
+	if (!Entry->Driver->Conversion_Time) {
+		return esp_timer_get_time();
+	}
+	return esp_timer_get_time() + Entry->Driver->Conversion_Time(Entry->Ctx);
+}
+
+static uint32_t Acquire(uint32_t Slots, Sensor_Values_t *Values)
+{
+	int64_t Ready_Time[SENSOR_MAX_DRIVERS];
+	uint32_t Pending = 0, Success = 0;
+	int64_t Now, Deadline, Next_Ready;
+	const Sensor_Entry_t *Entry;
+	TickType_t Wait_Ticks;
+	esp_err_t err;
+	int i;
+
+	Slots &= Sensors_Registered();
+
+	// 1. Kick off every conversion at once
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (!(Slots & SENSOR_SLOT_BIT(i))) {
+			continue;
+		}
+		Entry = &Registry[i];
+		memset(&Values[i], 0, sizeof(Values[i]));
+
+		err = Entry->Driver->Start_Measurement ? Entry->Driver->Start_Measurement(Entry->Ctx) : ESP_OK;
+		if (err != ESP_OK) {
+			ESP_LOGW(TAG, "%s failed to start: %s", Entry->Driver->Name, esp_err_to_name(err));
+			continue;
+		}
+		Ready_Time[i] = Ready_After(Entry);
+		Pending |= SENSOR_SLOT_BIT(i);
+	}
+
+	// 2. Read each sensor once its own conversion is over, earliest first.
+	// The slowest sensor gets ACQUISITION_TIMEOUT_US of grace past its
+	// conversion time.
+	Deadline = esp_timer_get_time();
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if ((Pending & SENSOR_SLOT_BIT(i)) && Ready_Time[i] > Deadline) {
+			Deadline = Ready_Time[i];
+		}
+	}
+	Deadline += ACQUISITION_TIMEOUT_US;
+	while (Pending) {
+		Now = esp_timer_get_time();
+		Next_Ready = Deadline;
+
+		for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+			if (!(Pending & SENSOR_SLOT_BIT(i))) {
+				continue;
+			}
+			Entry = &Registry[i];
+
+			if (Ready_Time[i] <= Now) {
+				err = Entry->Driver->Read(Entry->Ctx, &Values[i]);
+				if (err == ESP_ERR_NOT_FINISHED) {
+					// Driver moved on to its next phase
+					Ready_Time[i] = Ready_After(Entry);
+				} else {
+					Pending &= ~SENSOR_SLOT_BIT(i);
+					if (err == ESP_OK) {
+						Success |= SENSOR_SLOT_BIT(i);
+					} else {
+						ESP_LOGW(TAG, "%s read failed: %s", Entry->Driver->Name, esp_err_to_name(err));
+					}
+					continue;
+				}
+			}
+
+			if (Ready_Time[i] < Next_Ready) {
+				Next_Ready = Ready_Time[i];
+			}
+		}
+
+		if (!Pending) {
+			break;
+		}
+		Now = esp_timer_get_time();
+		if (Now >= Deadline) {
+			ESP_LOGW(TAG, "Acquisition timed out, pending slots 0x%lx", (unsigned long)Pending);
+			break;
+		}
+
+		// Sleep until the next conversion is due. Waits shorter than a tick
+		// are spun out instead of rounded up to a full tick.
+		if (Next_Ready > Now) {
+			Wait_Ticks = pdMS_TO_TICKS((Next_Ready - Now) / 1000);
+			if (Wait_Ticks > 0) {
+				vTaskDelay(Wait_Ticks);
+			} else {
+				esp_rom_delay_us(Next_Ready - Now);
+			}
+		}
+	}
+
+	return Success;
+}
+
+// Copy fresh readings into the cache
+static void Cache_Store(uint32_t Slots, const Sensor_Values_t *Values)
+{
+	int64_t Now = esp_timer_get_time();
+	int i;
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (Slots & SENSOR_SLOT_BIT(i)) {
+			Cache[i] = Values[i];
+			Cache_Time[i] = Now;
+		}
+	}
+}
+
+uint32_t Sensors_Run(uint32_t Slots, Sensor_Values_t *Values)
+{
+	uint32_t Read;
+
+	Lock();
+	Read = Acquire(Slots, Values);
+	Cache_Store(Read, Values);
+	Unlock();
+
+	return Read;
+}
+
+uint32_t Sensors_Cached(uint32_t Slots, Sensor_Values_t *Values, uint32_t Max_Age_MS)
+{
+	uint32_t Fresh = 0, Read = 0;
+	int64_t Oldest;
+	int i;
+
+	Slots &= Sensors_Registered();
+
+	// Checked under the lock: whoever held it may just have refreshed us
+	Lock();
+	Oldest = esp_timer_get_time() - (int64_t)Max_Age_MS * 1000;
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if ((Slots & SENSOR_SLOT_BIT(i)) && Max_Age_MS > 0 && Cache_Time[i] != 0 && Cache_Time[i] >= Oldest) {
+			Values[i] = Cache[i];
+			Fresh |= SENSOR_SLOT_BIT(i);
+		}
+	}
+
+	if (Slots & ~Fresh) {
+		Read = Acquire(Slots & ~Fresh, Values);
+		Cache_Store(Read, Values);
+	}
+	Unlock();
+
+	return Fresh | Read;
+}
+
+uint8_t Sensors_Encode(uint32_t Slots, const Sensor_Values_t *Values, uint8_t *Buffer, uint8_t Size)
+{
+	const Sensor_Driver_t *Driver;
+	uint8_t Length = 0;
+	int i;
+
+	Slots &= Sensors_Registered();
+
+	for (i = 0; i < SENSOR_MAX_DRIVERS; i++) {
+		if (!(Slots & SENSOR_SLOT_BIT(i))) {
+			continue;
+		}
+		Driver = Registry[i].Driver;
+		if (Length + Driver->Encoded_Length > Size) {
+			ESP_LOGW(TAG, "Payload full, %s dropped", Driver->Name);
+			break;
+		}
+		Length += Driver->Encode(&Values[i], Buffer + Length);
+	}
+
+	return Length;
+}
@@ -17,17 +17,19 @@
 // respective I2C_Write() and I2C_Read() functions.
 
 #include <stddef.h>
+#include <string.h>
 
 #include "../../include/Sensors.h"
 #include "../../include/SHT3X.h"
+#include "../../include/Anemometer.h"
+#include "../../include/Windvane.h"
+#include "../../include/SensorRegistry.h"
+#include "../../include/I2CBus.h"
+#include "../../include/FixedPoint.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_attr.h"
 #include "esp_log.h"
-#include "esp_timer.h"
-
-
-#include "driver/i2c_master.h"
-#include "esp_adc/adc_oneshot.h"
 
 // VARIABLES
 /******************************************************************************/
@@ -37,322 +39,430 @@ static const char *TAG = "Sensors";
 // Whether or not init function has already been called
 static uint8_t Already_Called = 0;
 
-// Wind direction lookup tables
-static float WindDirection_LookupTable[NUMBER_OF_KEYS] = {
-	2.53,
-	1.31,
-	1.49,
-	0.27,
-	0.30,
-	0.21,
-	0.60,
-	0.41,
-	0.93,
-	0.79,
-	2.03,
-	1.93,
-	3.05,
-	2.67,
-	2.86,
-	2.26
-};
+// Sensors the last Sensors_Init() brought up, until Deinitialize_Sensors()
+static SensorsIDs_t Initialized_Sensors;
 
-// ADC max reading
-static float Max_ADC_Reading = pow(2, ADC_BITWIDTH);
+// I2C sensors that answered their probe on the last cold boot. RTC memory is
+// reloaded on every boot except a deep sleep wake, so warm wakes trust this
+// instead of probing the bus again.
+static RTC_DATA_ATTR SensorsIDs_t Present_Sensors;
+static RTC_DATA_ATTR bool Present_Valid;
 
-// Handles and configurations
+// Handles
 /******************************************************************************/
-// Master i2c bus configuration
-static i2c_master_bus_config_t i2c_bus_config = {
-	.clk_source = I2C_CLK_SRC_DEFAULT,
-	.i2c_port = I2C_MASTER_NUM,
-	.scl_io_num = I2C_MASTER_SCL_IO,
-	.sda_io_num = I2C_MASTER_SDA_IO,
-	.glitch_ignore_cnt = 7,
-};
+// Sensor devices, attached to the shared bus through the bus manager
+static I2CBus_Device_t Soil_Handle;
+static I2CBus_Device_t SHT30_Handle;
 
-// i2c bus handle
-static i2c_master_bus_handle_t Bus_Handle;
+// DATA STRUCTURES
+/******************************************************************************/
+static const uint8_t Soil_Moisture_Cmd[] = {STEMMA_MOISTURE_BASE_REG, STEMMA_MOISTURE_FUNC_REG};
+static const uint8_t Soil_Temp_Cmd[] = {STEMMA_TEMP_BASE_REG, STEMMA_TEMP_FUNC_REG};
 
-// Sensor device cfgs
-static i2c_device_config_t Soil_Cfg = {
-	.dev_addr_length = I2C_ADDR_BIT_LEN_7,
-	.device_address = STEMMA_SENSOR_ADDR,
-	.scl_speed_hz = I2C_MASTER_FREQ_HZ,
-};
-static i2c_device_config_t SHT30_Cfg = {
-	.dev_addr_length = I2C_ADDR_BIT_LEN_7,
-	.device_address = SHT3X_SENSOR_ADDR,
-	.scl_speed_hz = I2C_MASTER_FREQ_HZ,
-};
+// Moisture and temperature share one seesaw chip, so the soil driver runs
+// them back to back as two phases
+static uint8_t Soil_Phase;
 
-// Sensor device handles
-static i2c_master_dev_handle_t Soil_Handle;
-static i2c_master_dev_handle_t SHT30_Handle;
+// Measurement triggers, built once per Sensors_Init() and resubmitted as is
+static I2CBus_Transfer_t Soil_Moisture_Start;
+static I2CBus_Transfer_t Soil_Temp_Start;
+static I2CBus_Transfer_t SHT30_Trigger;
 
-// ADC Handles and configs
-static adc_oneshot_unit_handle_t ADC_Handle;
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
 
-static adc_oneshot_unit_init_cfg_t ADC_Init_cfg = {
-	.unit_id = ADC_UNIT_2,
-	.ulp_mode = ADC_ULP_MODE_DISABLE,
-};
+// Built in sensor drivers
+/******************************************************************************/
+static esp_err_t Soil_Start(void *Ctx)
+{
+	Soil_Phase = 0;
+	return I2CBus_Execute(&Soil_Moisture_Start);
+}
 
-static adc_oneshot_chan_cfg_t ADC_cfg = {
-	.bitwidth = ADC_BITWIDTH_DEFAULT,
-	.atten = ADC_ATTEN_DB_12,
-};
+static uint32_t Soil_ConversionTime(void *Ctx)
+{
+	return Soil_Phase == 0 ? STEMMA_MOISTURE_DELAY_US : STEMMA_TEMP_DELAY_US;
+}
 
-static pcnt_unit_handle_t PCNT_Unit = NULL;
-static pcnt_unit_config_t PCNT_Unit_cfg = {
-	.high_limit = PCNT_HIGH_LIMIT,
-	.low_limit = PCNT_LOW_LIMIT,
-};
+static esp_err_t Soil_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	uint8_t Data[SOIL_TEMP_DATA_LENGTH];
+	int32_t raw_temp;
+	esp_err_t err;
+
+	if (Soil_Phase == 0) {
+		err = I2CBus_Read(Soil_Handle, Data, SOIL_MOISTURE_DATA_LENGTH);
+		if (err != ESP_OK) {
+			return err;
+		}
+		Values->Value[0] = Fixed_Seesaw_Moisture(Data);
 
-// PCNT handles and config
-static pcnt_channel_handle_t PCNT_Channel = NULL;
-static pcnt_chan_config_t PCNT_Channel_cfg = {
-	.edge_gpio_num = ANEMOMETER_GPIO,
-};
+		// Moisture done, start the temperature phase
+		Soil_Phase = 1;
+		err = I2CBus_Execute(&Soil_Temp_Start);
+		return err == ESP_OK ? ESP_ERR_NOT_FINISHED : err;
+	}
 
-// DATA STRUCTURES
-/******************************************************************************/
-static PCNT_State_t PCNT_State = {
-	.Duration = 0,
-	.StartTime = 0,
-	.EndTime = 0,
-	.PCNTHandle = &PCNT_Unit,
-	.TotalIterations = 0,
+	err = I2CBus_Read(Soil_Handle, Data, SOIL_TEMP_DATA_LENGTH);
+	if (err != ESP_OK) {
+		return err;
+	}
+	raw_temp = ((uint32_t)Data[0] << 24) | ((uint32_t)Data[1] << 16) | ((uint32_t)Data[2] << 8) | Data[3];
+	Values->Value[1] = Fixed_Seesaw_Temperature(raw_temp);
+	Values->Count = 2;
+
+	return ESP_OK;
+}
+
+// Moisture (raw capacitance), temperature
+static uint8_t Soil_Encode(const Sensor_Values_t *Values, uint8_t *Buffer)
+{
+	uint8_t Length = 0;
+
+	Length += Sensor_PutUint16(Buffer + Length, Values->Value[0]);
+	Length += Sensor_PutInt16(Buffer + Length, Values->Value[1]);
+
+	return Length;
+}
+
+static const Sensor_Driver_t Soil_Driver = {
+	.Name = "soil",
+	.Encoded_Length = 4,
+	.Scale = {1, FIXED_TEMPERATURE_SCALE},
+	.Start_Measurement = Soil_Start,
+	.Conversion_Time = Soil_ConversionTime,
+	.Read = Soil_Read,
+	.Encode = Soil_Encode,
 };
 
-static bool PCNT_CallbackLogic(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx) {
-	// Pass context to internal variable
-	PCNT_State_t *state = (PCNT_State_t *)user_ctx;
+static esp_err_t SHT30_Start(void *Ctx)
+{
+	return I2CBus_Execute(&SHT30_Trigger);
+}
+
+static uint32_t SHT30_ConversionTime(void *Ctx)
+{
+	return SHT3X_DURATION_LOW_US;
+}
 
-	state->TotalIterations++;
+static esp_err_t SHT30_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	uint8_t Data[SHT3X_MEASUREMENT_SIZE];
+	uint16_t Raw_Temperature, Raw_Humidity;
+	esp_err_t err;
 
-	if(edata->watch_point_value == 1) {
-		state->StartTime = esp_timer_get_time();
-	} else {
-		state->EndTime = esp_timer_get_time();
-		state->Duration = state->EndTime - state->StartTime;
-		// ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_stop(*(state->PCNTHandle)));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_clear_count(*(state->PCNTHandle)));
+	err = I2CBus_Read(SHT30_Handle, Data, sizeof(Data));
+	if (err != ESP_OK) {
+		return err;
 	}
+	err = sht3x_parse_raw(Data, &Raw_Temperature, &Raw_Humidity);
+	if (err != ESP_OK) {
+		return err;
+	}
+
+	Values->Value[0] = Fixed_SHT3X_Temperature(Raw_Temperature);
+	Values->Value[1] = Fixed_SHT3X_Humidity(Raw_Humidity);
+	Values->Count = 2;
+
+	return ESP_OK;
+}
 
-	return pdFALSE;
+// Payload carries humidity first
+static uint8_t SHT30_Encode(const Sensor_Values_t *Values, uint8_t *Buffer)
+{
+	uint8_t Length = 0;
+
+	Length += Sensor_PutUint16(Buffer + Length, Values->Value[1]);
+	Length += Sensor_PutInt16(Buffer + Length, Values->Value[0]);
+
+	return Length;
 }
 
-static pcnt_event_callbacks_t PCNT_Callbacks = {
-	.on_reach = PCNT_CallbackLogic,
+static const Sensor_Driver_t SHT30_Driver = {
+	.Name = "sht30",
+	.Encoded_Length = 4,
+	.Scale = {FIXED_TEMPERATURE_SCALE, FIXED_HUMIDITY_SCALE},
+	.Start_Measurement = SHT30_Start,
+	.Conversion_Time = SHT30_ConversionTime,
+	.Read = SHT30_Read,
+	.Encode = SHT30_Encode,
 };
 
-// FUNCTIONS
-/******************************************************************************/
-/******************************************************************************/
+// Wind sensors sample in the background, reads return the latest window.
+// Right after init (e.g. a wake from deep sleep) they wait for the first one.
+static uint32_t Anemometer_ConversionTime(void *Ctx)
+{
+	Anemometer_Snapshot_t Snapshot;
+
+	Anemometer_GetSnapshot(&Snapshot);
+	return Snapshot.Wake_Windows ? 0 : ANEMOMETER_WINDOW_MS * 1000;
+}
 
-// standard delay :P
-static void delay_ms(int ms)
+static uint32_t Windvane_ConversionTime(void *Ctx)
 {
-    vTaskDelay((ms) / portTICK_PERIOD_MS);
+	Windvane_Snapshot_t Snapshot;
+
+	Windvane_GetSnapshot(&Snapshot);
+	return Snapshot.Samples ? 0 : WINDVANE_WINDOW_MS * 1000;
 }
 
+static esp_err_t Anemometer_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	Anemometer_Snapshot_t Snapshot;
+
+	Anemometer_GetSnapshot(&Snapshot);
+	Values->Value[0] = Fixed_WindSpeed(Snapshot.Window_Pulses, ANEMOMETER_WINDOW_MS);
+	Values->Count = 1;
+	return ESP_OK;
+}
+
+// The vector mean is computed once per window by the sampling task, only
+// the final quantization happens here
+static esp_err_t Windvane_Read(void *Ctx, Sensor_Values_t *Values)
+{
+	Values->Value[0] = Fixed_Direction(Get_Wind_Direction());
+	Values->Count = 1;
+	return ESP_OK;
+}
+
+static uint8_t Single_Encode(const Sensor_Values_t *Values, uint8_t *Buffer)
+{
+	return Sensor_PutUint16(Buffer, Values->Value[0]);
+}
+
+static const Sensor_Driver_t Anemometer_Driver = {
+	.Name = "anemometer",
+	.Encoded_Length = 2,
+	.Scale = {FIXED_WIND_SPEED_SCALE},
+	.Conversion_Time = Anemometer_ConversionTime,
+	.Read = Anemometer_Read,
+	.Encode = Single_Encode,
+};
+
+static const Sensor_Driver_t Windvane_Driver = {
+	.Name = "windvane",
+	.Encoded_Length = 2,
+	.Scale = {FIXED_DIRECTION_SCALE},
+	.Conversion_Time = Windvane_ConversionTime,
+	.Read = Windvane_Read,
+	.Encode = Single_Encode,
+};
 
 SensorsIDs_t Sensors_Init(SensorsIDs_t Sensors)
 {
 	SensorsIDs_t ReturnStatus;
 
-	// First step will be to Initialize the I2C Bus.
-	// Inititialize I2C Bus, if it hasn't been initialized already.
-	if (!Already_Called)
+	// Devices are attached and drivers registered once. Calling again without
+	// Deinitialize_Sensors() would attach them a second time and lose the
+	// first handles.
+	if (Already_Called)
 	{
-		
-		ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_new_master_bus(&i2c_bus_config, &Bus_Handle));
+		ESP_LOGW(TAG, "Already initialized, call Deinitialize_Sensors() first");
+		return Initialized_Sensors & Sensors;
 	}
-	// If I2C_Init() passes, set Already_Called to 1.
+
+	// First step will be to Initialize the I2C Bus.
+	ESP_ERROR_CHECK_WITHOUT_ABORT(I2CBus_Open(I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO));
+
+	// Drivers enabled in menuconfig join the registry after the built in ones
+	Sensors_RegisterStatic();
 	Already_Called = 1;
 
+	// Sensors that were missing at cold boot stay skipped until the next one
+	if (!Present_Valid) {
+		Present_Sensors = WINDVANE | ANEMOMETER;
+		if (I2CBus_Probe(I2C_MASTER_NUM, STEMMA_SENSOR_ADDR) == ESP_OK) {
+			Present_Sensors |= SOIL;
+		}
+		if (I2CBus_Probe(I2C_MASTER_NUM, SHT3X_SENSOR_ADDR) == ESP_OK) {
+			Present_Sensors |= SHT30;
+		}
+		Present_Valid = true;
+		ESP_LOGI(TAG, "Sensors present: 0x%x", Present_Sensors);
+	}
+	Sensors &= Present_Sensors;
+
 	// Initialize sensors:
-	// Each device must be added to master bus, and some devices may require
-	// initialization commands (doubtful, though)
+	// Each device must be attached to the bus, and gets its measurement
+	// triggers prebuilt.
 	ReturnStatus = 0;
-	if (Sensors && SOIL)
+	if (Sensors & SOIL)
 	{
-		ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_bus_add_device(Bus_Handle, &Soil_Cfg, &Soil_Handle));
-		
-		ReturnStatus |= SOIL;
+		if (I2CBus_AddDevice(I2C_MASTER_NUM, STEMMA_SENSOR_ADDR, I2C_MASTER_FREQ_HZ, &Soil_Handle) == ESP_OK &&
+			I2CBus_Prepare(&Soil_Moisture_Start, Soil_Handle, Soil_Moisture_Cmd, sizeof(Soil_Moisture_Cmd), NULL, 0) == ESP_OK &&
+			I2CBus_Prepare(&Soil_Temp_Start, Soil_Handle, Soil_Temp_Cmd, sizeof(Soil_Temp_Cmd), NULL, 0) == ESP_OK &&
+			Sensors_RegisterSlot(SENSOR_SLOT_SOIL, &Soil_Driver, NULL) == ESP_OK) {
+			ReturnStatus |= SOIL;
+		}
 	}
 
-	if (Sensors && WINDVANE)
+	if (Sensors & WINDVANE)
 	{
-		// Initialization code:
-		//	1. Initialize ADC Module
-		ESP_ERROR_CHECK_WITHOUT_ABORT(adc_oneshot_new_unit(&ADC_Init_cfg, &ADC_Handle));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(adc_oneshot_config_channel(ADC_Handle, ADC_CHANNEL_1, &ADC_cfg));
-		//  2. Verify connectivity of sensor
-		ReturnStatus |= WINDVANE;
+		// Continuous ADC sampling in the background, see Windvane.c
+		if (ESP_ERROR_CHECK_WITHOUT_ABORT(Windvane_Init(WINDVANE_GPIO)) == ESP_OK &&
+			Sensors_RegisterSlot(SENSOR_SLOT_WINDVANE, &Windvane_Driver, NULL) == ESP_OK) {
+			ReturnStatus |= WINDVANE;
+		}
 	}
 
-	if (Sensors && ANEMOMETER)
+	if (Sensors & ANEMOMETER)
 	{
-		// Initialize free running timer
-		esp_timer_init();
-
-		
-		// Initialize PCNT
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_new_unit(&PCNT_Unit_cfg, &PCNT_Unit));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_new_channel(PCNT_Unit, &PCNT_Channel_cfg, &PCNT_Channel));
-
-		// Configure channel behavior
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_channel_set_edge_action(PCNT_Channel, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_add_watch_point(PCNT_Unit, 1));	// log start
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_add_watch_point(PCNT_Unit, 0));	// log time elapsed
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_register_event_callbacks(PCNT_Unit, &PCNT_Callbacks, &PCNT_State));
-
-		// Start channel up
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_enable(PCNT_Unit));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_stop(PCNT_Unit));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_clear_count(PCNT_Unit));
-		ESP_ERROR_CHECK_WITHOUT_ABORT(pcnt_unit_start(PCNT_Unit));
-
-
-		ReturnStatus |= ANEMOMETER;
+		// Windowed pulse counting, see Anemometer.c
+		if (ESP_ERROR_CHECK_WITHOUT_ABORT(Anemometer_Init(ANEMOMETER_GPIO)) == ESP_OK &&
+			Sensors_RegisterSlot(SENSOR_SLOT_ANEMOMETER, &Anemometer_Driver, NULL) == ESP_OK) {
+			ReturnStatus |= ANEMOMETER;
+		}
 	}
 
 	// Sensor 2: SHT30
-	if (Sensors && SHT30)
+	if (Sensors & SHT30)
 	{
-		ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_bus_add_device(Bus_Handle, &SHT30_Cfg, &SHT30_Handle));
-		
-		ReturnStatus |= SHT30;
+		if (I2CBus_AddDevice(I2C_MASTER_NUM, SHT3X_SENSOR_ADDR, I2C_MASTER_FREQ_HZ, &SHT30_Handle) == ESP_OK &&
+			I2CBus_Prepare(&SHT30_Trigger, SHT30_Handle, clock_stretching_disabled_repeatability_low, SHT3X_HEX_CODE_SIZE, NULL, 0) == ESP_OK &&
+			Sensors_RegisterSlot(SENSOR_SLOT_SHT30, &SHT30_Driver, NULL) == ESP_OK) {
+			ReturnStatus |= SHT30;
+		}
 	}
 
+	Initialized_Sensors = ReturnStatus;
 	return ReturnStatus;
 }
 
-esp_err_t Read_SoilMoisture(short *Reading)
+SensorsIDs_t Sensors_Acquire(SensorsIDs_t Sensors, SensorReadings_t *Readings)
 {
-	esp_err_t I2C_Result = ESP_OK;
-	uint8_t Write_Buffer[2];
+	Sensor_Values_t Values[SENSOR_MAX_DRIVERS];
+	SensorsIDs_t ReturnStatus = 0;
+	uint32_t Slots = 0, Read;
+
+	if (Sensors & SOIL) {
+		Slots |= SENSOR_SLOT_BIT(SENSOR_SLOT_SOIL);
+	}
+	if (Sensors & SHT30) {
+		Slots |= SENSOR_SLOT_BIT(SENSOR_SLOT_SHT30);
+	}
+	if (Sensors & ANEMOMETER) {
+		Slots |= SENSOR_SLOT_BIT(SENSOR_SLOT_ANEMOMETER);
+	}
+	if (Sensors & WINDVANE) {
+		Slots |= SENSOR_SLOT_BIT(SENSOR_SLOT_WINDVANE);
+	}
 
-	size_t Read_Buffer_Size = SOIL_MOISTURE_DATA_LENGTH;
-	uint8_t Read_Buffer[SOIL_MOISTURE_DATA_LENGTH];
+	Read = Sensors_Run(Slots, Values);
 
-	Write_Buffer[0] = STEMMA_MOISTURE_BASE_REG;
-	Write_Buffer[1] = STEMMA_MOISTURE_FUNC_REG;
+	// Copy results into the fixed readings struct
+	if (Read & SENSOR_SLOT_BIT(SENSOR_SLOT_SOIL)) {
+		Readings->Soil_Moisture = Values[SENSOR_SLOT_SOIL].Value[0];
+		Readings->Soil_Temperature = Sensor_Physical(&Soil_Driver, &Values[SENSOR_SLOT_SOIL], 1);
+		ReturnStatus |= SOIL;
+	}
+	if (Read & SENSOR_SLOT_BIT(SENSOR_SLOT_SHT30)) {
+		Readings->Temperature = Sensor_Physical(&SHT30_Driver, &Values[SENSOR_SLOT_SHT30], 0);
+		Readings->Humidity = Sensor_Physical(&SHT30_Driver, &Values[SENSOR_SLOT_SHT30], 1);
+		ReturnStatus |= SHT30;
+	}
+	if (Read & SENSOR_SLOT_BIT(SENSOR_SLOT_ANEMOMETER)) {
+		Readings->WindSpeed = Sensor_Physical(&Anemometer_Driver, &Values[SENSOR_SLOT_ANEMOMETER], 0);
+		ReturnStatus |= ANEMOMETER;
+	}
+	if (Read & SENSOR_SLOT_BIT(SENSOR_SLOT_WINDVANE)) {
+		Readings->WindDirection = Sensor_Physical(&Windvane_Driver, &Values[SENSOR_SLOT_WINDVANE], 0);
+		ReturnStatus |= WINDVANE;
+	}
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Soil_Handle, Write_Buffer, sizeof(Write_Buffer), I2C_MASTER_TIMEOUT_MS));
+	return ReturnStatus;
+}
 
-	delay_ms(50);
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_receive(Soil_Handle, Read_Buffer, Read_Buffer_Size, I2C_MASTER_TIMEOUT_MS));
+esp_err_t Read_SoilMoisture(short *Reading)
+{
+	SensorReadings_t Readings;
+
+	if (!(Sensors_Acquire(SOIL, &Readings) & SOIL)) {
+		return ESP_FAIL;
+	}
 
 	// Transfer data into variable passed by reference
-	*Reading = ((uint16_t)Read_Buffer[0] << 8) | Read_Buffer[1];
+	*Reading = Readings.Soil_Moisture;
 
-	return I2C_Result;
+	return ESP_OK;
 }
 
 esp_err_t Read_SoilTemperature(float *Reading)
 {
-	esp_err_t I2C_Result = ESP_OK;
-	uint8_t Write_Buffer[2];
-
-	size_t Read_Buffer_Size = SOIL_TEMP_DATA_LENGTH;
-	uint8_t Read_Buffer[SOIL_TEMP_DATA_LENGTH];
-	
-	Write_Buffer[0] = STEMMA_TEMP_BASE_REG;
-	Write_Buffer[1] = STEMMA_TEMP_FUNC_REG;
+	SensorReadings_t Readings;
 
-	ESP_LOGI(TAG, "Made it to line 156");
-
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_transmit(Soil_Handle, Write_Buffer, sizeof(Write_Buffer), I2C_MASTER_TIMEOUT_MS));	
-
-	delay_ms(50);
-
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_receive(Soil_Handle, Read_Buffer, Read_Buffer_Size, I2C_MASTER_TIMEOUT_MS));
+	if (!(Sensors_Acquire(SOIL, &Readings) & SOIL)) {
+		return ESP_FAIL;
+	}
 
-	int32_t raw_temp = ((uint32_t)Read_Buffer[0] << 24) | ((uint32_t)Read_Buffer[1] << 16) | ((uint32_t)Read_Buffer[2] << 8) | Read_Buffer[3];
-	*Reading = (1.0 / (1UL << 16)) * raw_temp; // normalize value
+	*Reading = Readings.Soil_Temperature;
 
-	return I2C_Result;
+	return ESP_OK;
 }
 
 bool Read_SHT30_HumidityTemperature(float *Temp_Reading, float *Humid_Reading)
 {
-	sht3x_sensors_values_t Readings;
+	SensorReadings_t Readings;
 
-	if (sht3x_read_measurement(&Readings, SHT30_Handle) != ESP_OK) {
+	if (!(Sensors_Acquire(SHT30, &Readings) & SHT30)) {
 		return false;
 	}
 
-	*Temp_Reading = Readings.temperature;
-	*Humid_Reading = Readings.humidity;
+	*Temp_Reading = Readings.Temperature;
+	*Humid_Reading = Readings.Humidity;
 
 	return true;
 }
 
 float Get_Wind_Direction() {
-	int Reading, Key, i;
-	float Direction;
-	float SmallestDistance, IterationDistance, Voltage;
-	
-	// Procedure:
-	// 1. Read raw adc
-	ESP_ERROR_CHECK_WITHOUT_ABORT(adc_oneshot_read(ADC_Handle, ADC_CHANNEL_1, &Reading));
-
-	// 2. convert to voltage
-	Voltage = (Reading / Max_ADC_Reading) * MAX_ADC_VOLTAGE;
-
-	// 3. convert to degrees
-	SmallestDistance = 10; // arbitrary value
-	Key = 0;
-	// Iterate through lookup table to find which voltage matches the best with
-	// reading.
-	for (i = 0; i < NUMBER_OF_KEYS; i++) {
-		IterationDistance = fabs(Voltage - WindDirection_LookupTable[i]);
-		// if current iteration is better match than previous ones, set it as
-		// the current best match, and update key value.
-		if (IterationDistance < SmallestDistance) {
-			SmallestDistance = IterationDistance;
-			Key = i;
-		}
-	}
+	Windvane_Snapshot_t Snapshot;
 
-	// Convert key value into direction
-	Direction = Key * KEY_TO_DEG;
+	Windvane_GetSnapshot(&Snapshot);
 
-	return Direction;
+	return Snapshot.Direction;
 }
 
-
 float Get_Wind_Speed(void) {
-	float Speed;
-	ESP_LOGW(TAG, "Total Iterations: %d", PCNT_State.TotalIterations);
+	Anemometer_Snapshot_t Snapshot;
 
-	Speed = ANEMOMETER_VELOCITY_CONSTANT / PCNT_State.Duration;
+	Anemometer_GetSnapshot(&Snapshot);
 
-	return Speed;
+	return Snapshot.Speed;
 }
 
 bool Deinitialize_Sensors(void) {
+	int Slot;
+
 	// Indicate that sensors have been deinitialized
 	Already_Called = 0;
+	Initialized_Sensors = 0;
+
+	// Empty the registry
+	for (Slot = 0; Slot < SENSOR_MAX_DRIVERS; Slot++) {
+		Sensors_Unregister(Slot);
+	}
+
 	// Deinit I2C
-	// remove devices
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_bus_rm_device(Soil_Handle));
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_bus_rm_device(SHT30_Handle));
+	// detach devices
+	if (Soil_Handle) {
+		ESP_ERROR_CHECK_WITHOUT_ABORT(I2CBus_RemoveDevice(Soil_Handle));
+	}
+	if (SHT30_Handle) {
+		ESP_ERROR_CHECK_WITHOUT_ABORT(I2CBus_RemoveDevice(SHT30_Handle));
+	}
+
+	Soil_Handle = NULL;
+	SHT30_Handle = NULL;
 
-	// remove bus
-	ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_del_master_bus(Bus_Handle));
+	// release the bus, it stays up while other users (INA219...) hold it
+	ESP_ERROR_CHECK_WITHOUT_ABORT(I2CBus_Close(I2C_MASTER_NUM));
 	
 	// Deinit ADC
-	adc_oneshot_del_unit(ADC_Handle);
+	Windvane_Deinit();
 
 	// deinit pulse count
-	pcnt_unit_disable(PCNT_Unit);
-	pcnt_del_channel(PCNT_Channel);
-	pcnt_del_unit(PCNT_Unit);
+	Anemometer_Deinit();
 
 	// deinit gptimer
 	// FreeRunningTimer_Deinit();
@@ -0,0 +1,165 @@
+/**
+ * @file Statistics.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Streaming statistics for sensor channels.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// Welford REFERENCE: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Welford's_online_algorithm
+// Circular statistics REFERENCE: https://en.wikipedia.org/wiki/Directional_statistics
+
+#include <math.h>
+#include <string.h>
+
+#include "../../include/Statistics.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define DEG_TO_RAD (M_PI / 180.0f)
+#define RAD_TO_DEG (180.0f / M_PI)
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+// Median of the filled part of the window. N is tiny, insertion sort is fine.
+static float Window_Median(const Stats_Channel_t *Channel)
+{
+	float Sorted[STATS_MEDIAN_WINDOW];
+	float Key;
+	int i, j;
+
+	memcpy(Sorted, Channel->Window, Channel->Window_Fill * sizeof(float));
+	for (i = 1; i < Channel->Window_Fill; i++) {
+		Key = Sorted[i];
+		for (j = i - 1; j >= 0 && Sorted[j] > Key; j--) {
+			Sorted[j + 1] = Sorted[j];
+		}
+		Sorted[j + 1] = Key;
+	}
+
+	return Sorted[Channel->Window_Fill / 2];
+}
+
+// Big endian, saturated int16 store
+static void Put_Int16(uint8_t *Buffer, float Value)
+{
+	int32_t Scaled = (int32_t)lroundf(Value);
+
+	if (Scaled > INT16_MAX) {
+		Scaled = INT16_MAX;
+	} else if (Scaled < INT16_MIN) {
+		Scaled = INT16_MIN;
+	}
+	Buffer[0] = ((uint16_t)Scaled >> 8) & 0xFF;
+	Buffer[1] = (uint16_t)Scaled & 0xFF;
+}
+
+void Stats_Reset(Stats_Channel_t *Channel)
+{
+	memset(Channel, 0, sizeof(*Channel));
+}
+
+void Stats_Update(Stats_Channel_t *Channel, float Sample)
+{
+	float Filtered, Delta;
+
+	// 1. Median-of-N prefilter, drops single sample spikes
+	Channel->Window[Channel->Window_Index] = Sample;
+	Channel->Window_Index = (Channel->Window_Index + 1) % STATS_MEDIAN_WINDOW;
+	if (Channel->Window_Fill < STATS_MEDIAN_WINDOW) {
+		Channel->Window_Fill++;
+	}
+	Filtered = Window_Median(Channel);
+
+	// 2. Min / max
+	if (Channel->Count == 0 || Filtered < Channel->Min) {
+		Channel->Min = Filtered;
+	}
+	if (Channel->Count == 0 || Filtered > Channel->Max) {
+		Channel->Max = Filtered;
+	}
+
+	// 3. Welford mean and sum of squared differences
+	Channel->Count++;
+	Delta = Filtered - Channel->Mean;
+	Channel->Mean += Delta / Channel->Count;
+	Channel->M2 += Delta * (Filtered - Channel->Mean);
+}
+
+void Stats_Summarize(const Stats_Channel_t *Channel, Stats_Summary_t *Summary)
+{
+	Summary->Count = Channel->Count;
+	Summary->Mean = Channel->Mean;
+	Summary->Min = Channel->Min;
+	Summary->Max = Channel->Max;
+	Summary->StdDev = (Channel->Count > 1) ? sqrtf(Channel->M2 / (Channel->Count - 1)) : 0;
+}
+
+void Stats_CircularReset(Stats_Circular_t *Channel)
+{
+	memset(Channel, 0, sizeof(*Channel));
+}
+
+void Stats_CircularUpdate(Stats_Circular_t *Channel, float Degrees)
+{
+	Channel->Sum_Sin += sinf(Degrees * DEG_TO_RAD);
+	Channel->Sum_Cos += cosf(Degrees * DEG_TO_RAD);
+	Channel->Count++;
+}
+
+void Stats_CircularSummarize(const Stats_Circular_t *Channel, Stats_CircularSummary_t *Summary)
+{
+	float R;
+
+	Summary->Count = Channel->Count;
+	if (Channel->Count == 0) {
+		Summary->Mean = 0;
+		Summary->StdDev = 0;
+		return;
+	}
+
+	// Mean direction of the summed unit vectors
+	Summary->Mean = atan2f(Channel->Sum_Sin, Channel->Sum_Cos) * RAD_TO_DEG;
+	if (Summary->Mean < 0) {
+		Summary->Mean += 360.0f;
+	}
+
+	// Mean resultant length R in [0, 1], circular std dev = sqrt(-2 ln R)
+	R = sqrtf(Channel->Sum_Sin * Channel->Sum_Sin + Channel->Sum_Cos * Channel->Sum_Cos) / Channel->Count;
+	if (R >= 1.0f) {
+		Summary->StdDev = 0;
+	} else if (R <= 0.0f) {
+		Summary->StdDev = 180.0f;	// uniformly spread, no meaningful direction
+	} else {
+		Summary->StdDev = sqrtf(-2.0f * logf(R)) * RAD_TO_DEG;
+	}
+}
+
+uint8_t Stats_Encode(const Stats_Summary_t *Summary, float Scale, uint8_t *Buffer)
+{
+	Put_Int16(Buffer + 0, Summary->Mean * Scale);
+	Put_Int16(Buffer + 2, Summary->StdDev * Scale);
+	Put_Int16(Buffer + 4, Summary->Min * Scale);
+	Put_Int16(Buffer + 6, Summary->Max * Scale);
+
+	return STATS_SUMMARY_LEN;
+}
+
+uint8_t Stats_CircularEncode(const Stats_CircularSummary_t *Summary, uint8_t *Buffer)
+{
+	uint16_t Mean = (uint16_t)lroundf(Summary->Mean * 10) % 3600;
+	uint16_t StdDev = (uint16_t)lroundf(Summary->StdDev * 10);
+
+	Buffer[0] = Mean >> 8;
+	Buffer[1] = Mean & 0xFF;
+	Buffer[2] = StdDev >> 8;
+	Buffer[3] = StdDev & 0xFF;
+
+	return STATS_CIRCULAR_SUMMARY_LEN;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file Windvane.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Continuous (DMA) ADC sampling of the wind vane with vector averaged
+ * 			direction.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// ADC continuous mode REFERENCE: https://docs.espressif.com/projects/esp-idf/en/stable/esp32s3/api-reference/peripherals/adc_continuous.html
+
+#include <math.h>
+#include <string.h>
+
+#include "../../include/Windvane.h"
+
+// The sector tables and the vector average also build on the host for tests
+#ifdef ESP_PLATFORM
+#include "../../include/Sensors.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_adc/adc_continuous.h"
+
+// Output frame layout differs between targets
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define WINDVANE_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define SAMPLE_CHANNEL(p) ((p)->type1.channel)
+#define SAMPLE_DATA(p) ((p)->type1.data)
+#else
+#define WINDVANE_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define SAMPLE_CHANNEL(p) ((p)->type2.channel)
+#define SAMPLE_DATA(p) ((p)->type2.data)
+#endif
+#endif
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+
+// Divider output voltage of each sector, indexed by sector (0 = north)
+static const float Sector_Voltage[NUMBER_OF_KEYS] = {
+	2.53,
+	1.31,
+	1.49,
+	0.27,
+	0.30,
+	0.21,
+	0.60,
+	0.41,
+	0.93,
+	0.79,
+	2.03,
+	1.93,
+	3.05,
+	2.67,
+	2.86,
+	2.26
+};
+
+// Built once at init. Sorted_Sector lists sectors by ascending voltage,
+// Threshold[i] is the raw code halfway between Sorted_Sector[i] and [i + 1].
+static uint8_t Sorted_Sector[NUMBER_OF_KEYS];
+static uint16_t Threshold[NUMBER_OF_KEYS - 1];
+static float Sector_Sin[NUMBER_OF_KEYS];
+static float Sector_Cos[NUMBER_OF_KEYS];
+
+#ifdef ESP_PLATFORM
+static const char *TAG = "Windvane";
+
+static adc_continuous_handle_t ADC_Handle;
+static adc_channel_t ADC_Channel;
+static adc_unit_t ADC_Unit;
+static TaskHandle_t Windvane_Task;
+
+// Per window sector histogram, only touched by the windvane task
+static uint32_t Sector_Count[NUMBER_OF_KEYS];
+static uint32_t Window_Samples;
+
+static portMUX_TYPE Windvane_Lock = portMUX_INITIALIZER_UNLOCKED;
+static Windvane_Snapshot_t Published;
+#endif
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+void Windvane_BuildTables(void)
+{
+	float Full_Scale = pow(2, ADC_BITWIDTH);
+	float Midpoint;
+	uint8_t Key;
+	int i, j;
+
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Sorted_Sector[i] = i;
+		Sector_Sin[i] = sinf(i * KEY_TO_DEG * M_PI / 180.0f);
+		Sector_Cos[i] = cosf(i * KEY_TO_DEG * M_PI / 180.0f);
+	}
+
+	// Insertion sort, 16 entries
+	for (i = 1; i < NUMBER_OF_KEYS; i++) {
+		Key = Sorted_Sector[i];
+		for (j = i - 1; j >= 0 && Sector_Voltage[Sorted_Sector[j]] > Sector_Voltage[Key]; j--) {
+			Sorted_Sector[j + 1] = Sorted_Sector[j];
+		}
+		Sorted_Sector[j + 1] = Key;
+	}
+
+	for (i = 0; i < NUMBER_OF_KEYS - 1; i++) {
+		Midpoint = (Sector_Voltage[Sorted_Sector[i]] + Sector_Voltage[Sorted_Sector[i + 1]]) / 2;
+		Threshold[i] = (uint16_t)ceilf(Midpoint / MAX_ADC_VOLTAGE * Full_Scale);
+	}
+}
+
+uint8_t Windvane_Sector(uint16_t Raw)
+{
+	int Low = 0, High = NUMBER_OF_KEYS - 1, Mid;
+
+	// First threshold above Raw, the sector below it is the closest match
+	while (Low < High) {
+		Mid = (Low + High) / 2;
+		if (Raw < Threshold[Mid]) {
+			High = Mid;
+		} else {
+			Low = Mid + 1;
+		}
+	}
+
+	return Sorted_Sector[Low];
+}
+
+void Windvane_Average(const uint32_t Count[NUMBER_OF_KEYS], uint32_t Samples, Windvane_Snapshot_t *Snapshot)
+{
+	float Sum_Sin = 0, Sum_Cos = 0;
+	int i;
+
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Sum_Sin += Count[i] * Sector_Sin[i];
+		Sum_Cos += Count[i] * Sector_Cos[i];
+	}
+
+	Snapshot->Samples = Samples;
+	Snapshot->Resultant = Samples ? sqrtf(Sum_Sin * Sum_Sin + Sum_Cos * Sum_Cos) / Samples : 0;
+	Snapshot->Direction = atan2f(Sum_Sin, Sum_Cos) * 180.0f / M_PI;
+	if (Snapshot->Direction < 0) {
+		Snapshot->Direction += 360.0f;
+	}
+	// A bearing a hair under north can round up to 360 in float
+	if (Snapshot->Direction >= 360.0f) {
+		Snapshot->Direction -= 360.0f;
+	}
+}
+
+#ifdef ESP_PLATFORM
+// Unit vector average of the window's sector histogram
+static void Close_Window(void)
+{
+	Windvane_Snapshot_t Snapshot;
+
+	Windvane_Average(Sector_Count, Window_Samples, &Snapshot);
+
+	portENTER_CRITICAL(&Windvane_Lock);
+	Published = Snapshot;
+	portEXIT_CRITICAL(&Windvane_Lock);
+
+	memset(Sector_Count, 0, sizeof(Sector_Count));
+	Window_Samples = 0;
+}
+
+// DMA frame ready, runs in ISR context
+static bool IRAM_ATTR Windvane_FrameDone(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+	BaseType_t Woken = pdFALSE;
+
+	// Frames done before the task exists wait in the pool for it
+	if (Windvane_Task) {
+		vTaskNotifyGiveFromISR(Windvane_Task, &Woken);
+	}
+
+	return Woken == pdTRUE;
+}
+
+static void task_windvane(void *pvParameters)
+{
+	uint8_t Frame[WINDVANE_FRAME_SIZE];
+	adc_digi_output_data_t *Sample;
+	uint32_t Length, i;
+
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		// Drain everything the driver has buffered
+		while (adc_continuous_read(ADC_Handle, Frame, sizeof(Frame), &Length, 0) == ESP_OK) {
+			for (i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= Length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+				Sample = (adc_digi_output_data_t *)&Frame[i];
+				if (SAMPLE_CHANNEL(Sample) != ADC_Channel) {
+					continue;
+				}
+				Sector_Count[Windvane_Sector(SAMPLE_DATA(Sample))]++;
+				Window_Samples++;
+			}
+
+			if (Window_Samples >= WINDVANE_WINDOW_SAMPLES) {
+				Close_Window();
+			}
+		}
+	}
+}
+
+esp_err_t Windvane_Init(int Gpio)
+{
+	adc_unit_t Unit;
+	esp_err_t err;
+	adc_continuous_handle_cfg_t Handle_cfg = {
+		.max_store_buf_size = WINDVANE_POOL_SIZE,
+		.conv_frame_size = WINDVANE_FRAME_SIZE,
+	};
+	adc_digi_pattern_config_t Pattern = {
+		.atten = ADC_ATTEN_DB_12,
+		.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+	};
+	adc_continuous_config_t ADC_cfg = {
+		.pattern_num = 1,
+		.adc_pattern = &Pattern,
+		.sample_freq_hz = WINDVANE_SAMPLE_FREQ_HZ,
+		.format = WINDVANE_OUTPUT_FORMAT,
+	};
+	adc_continuous_evt_cbs_t Callbacks = {
+		.on_conv_done = Windvane_FrameDone,
+	};
+
+	Windvane_BuildTables();
+	memset(Sector_Count, 0, sizeof(Sector_Count));
+	memset(&Published, 0, sizeof(Published));
+	Window_Samples = 0;
+
+	// Unit and channel follow from the pin instead of being hard coded
+	ESP_RETURN_ON_ERROR(adc_continuous_io_to_channel(Gpio, &Unit, &ADC_Channel), TAG, "gpio %d is not an ADC pin", Gpio);
+	ADC_Unit = Unit;
+	Pattern.unit = Unit;
+	Pattern.channel = ADC_Channel;
+	ADC_cfg.conv_mode = (Unit == ADC_UNIT_1) ? ADC_CONV_SINGLE_UNIT_1 : ADC_CONV_SINGLE_UNIT_2;
+
+	// ADC first and the task last, so a failure part way leaves nothing
+	// behind once Windvane_Deinit() has run
+	err = adc_continuous_new_handle(&Handle_cfg, &ADC_Handle);
+	if (err == ESP_OK) {
+		err = adc_continuous_config(ADC_Handle, &ADC_cfg);
+	}
+	if (err == ESP_OK) {
+		err = adc_continuous_register_event_callbacks(ADC_Handle, &Callbacks, NULL);
+	}
+	if (err == ESP_OK) {
+		err = adc_continuous_start(ADC_Handle);
+	}
+	if (err == ESP_OK
+		&& xTaskCreate(&task_windvane, "Windvane", WINDVANE_TASK_STACK, NULL, WINDVANE_TASK_PRIORITY, &Windvane_Task) != pdPASS) {
+		err = ESP_ERR_NO_MEM;
+	}
+
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "ADC setup failed: %s", esp_err_to_name(err));
+		Windvane_Deinit();
+	}
+	return err;
+}
+
+int Windvane_Channel(void)
+{
+	return (ADC_Handle && ADC_Unit == ADC_UNIT_1) ? (int)ADC_Channel : -1;
+}
+
+void Windvane_Deinit(void)
+{
+	if (ADC_Handle) {
+		adc_continuous_stop(ADC_Handle);
+		adc_continuous_deinit(ADC_Handle);
+		ADC_Handle = NULL;
+	}
+
+	if (Windvane_Task) {
+		vTaskDelete(Windvane_Task);
+		Windvane_Task = NULL;
+	}
+}
+
+void Windvane_GetSnapshot(Windvane_Snapshot_t *Snapshot)
+{
+	portENTER_CRITICAL(&Windvane_Lock);
+	*Snapshot = Published;
+	portEXIT_CRITICAL(&Windvane_Lock);
+}
+#endif
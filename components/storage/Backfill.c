@@ -0,0 +1,574 @@
+/**
+ * @file Backfill.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Windowed bulk transfer of the segment store, both ends.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/Backfill.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define NO_NODE 256
+
+// Fragment states
+#define FRAGMENT_FREE 0
+#define FRAGMENT_QUEUED 1			// to be sent, again if it was before
+#define FRAGMENT_SENT 2
+#define FRAGMENT_ACKED 3			// held by the receiver, ahead of a gap
+
+// Cursor file: magic, generation, count, reserved, then per node the node,
+// 3 reserved bytes, bucket and offset, then a CRC-32 of all before it, LE
+#define CURSOR_HEADER 12
+#define CURSOR_ENTRY 12
+#define CURSOR_FILE_LEN(Count) (CURSOR_HEADER + CURSOR_ENTRY * (Count) + 4)
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static void Put_16(uint8_t *Buffer, uint16_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = Value >> 8;
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint16_t Get_16(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8);
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+// A cut path would name some other file, so truncation is an error
+static esp_err_t Cursor_Path(const Backfill_t *Backfill, char *Path, unsigned Slot)
+{
+	int Length = snprintf(Path, SEGMENT_PATH_LEN, "%s/" BACKFILL_CURSOR_FILE, Backfill->Root, Slot);
+
+	return Length < 0 || Length >= SEGMENT_PATH_LEN ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+// Load one of the two cursor files if it is whole, keeping the newer one
+static void Cursor_Read(Backfill_t *Backfill, unsigned Slot, bool *Found)
+{
+	uint8_t File[CURSOR_FILE_LEN(BACKFILL_MAX_NODES)];
+	char Path[SEGMENT_PATH_LEN];
+	uint32_t Generation;
+	uint16_t Count, i;
+	ssize_t Length;
+	int Fd;
+
+	if (Cursor_Path(Backfill, Path, Slot) != ESP_OK) {
+		return;
+	}
+	Fd = open(Path, O_RDONLY);
+	if (Fd < 0) {
+		return;
+	}
+	Length = read(Fd, File, sizeof(File));
+	close(Fd);
+
+	if (Length < CURSOR_FILE_LEN(0) || Get_32(File) != BACKFILL_CURSOR_MAGIC) {
+		return;
+	}
+	Generation = Get_32(File + 4);
+	Count = Get_16(File + 8);
+	if (Count > BACKFILL_MAX_NODES || Length != CURSOR_FILE_LEN(Count)
+		|| RecordLog_Crc32(0, File, Length - 4) != Get_32(File + Length - 4)) {
+		return;
+	}
+	if (*Found && (int32_t)(Generation - Backfill->Generation) <= 0) {
+		return;
+	}
+
+	*Found = true;
+	Backfill->Generation = Generation;
+	Backfill->Cursor_Count = Count;
+	for (i = 0; i < Count; i++) {
+		Backfill->Cursors[i].Node = File[CURSOR_HEADER + CURSOR_ENTRY * i];
+		Backfill->Cursors[i].Position.Bucket = Get_32(File + CURSOR_HEADER + CURSOR_ENTRY * i + 4);
+		Backfill->Cursors[i].Position.Offset = Get_32(File + CURSOR_HEADER + CURSOR_ENTRY * i + 8);
+	}
+}
+
+// Into the file not holding the newest copy, so a torn write leaves that one
+static esp_err_t Cursor_Write(Backfill_t *Backfill)
+{
+	uint8_t File[CURSOR_FILE_LEN(BACKFILL_MAX_NODES)] = {0};
+	uint32_t Length = CURSOR_FILE_LEN(Backfill->Cursor_Count);
+	char Path[SEGMENT_PATH_LEN];
+	uint16_t i;
+	bool Ok;
+	int Fd;
+
+	Put_32(File, BACKFILL_CURSOR_MAGIC);
+	Put_32(File + 4, Backfill->Generation + 1);
+	Put_16(File + 8, Backfill->Cursor_Count);
+	for (i = 0; i < Backfill->Cursor_Count; i++) {
+		File[CURSOR_HEADER + CURSOR_ENTRY * i] = Backfill->Cursors[i].Node;
+		Put_32(File + CURSOR_HEADER + CURSOR_ENTRY * i + 4, Backfill->Cursors[i].Position.Bucket);
+		Put_32(File + CURSOR_HEADER + CURSOR_ENTRY * i + 8, Backfill->Cursors[i].Position.Offset);
+	}
+	Put_32(File + Length - 4, RecordLog_Crc32(0, File, Length - 4));
+
+	if (Cursor_Path(Backfill, Path, (Backfill->Generation + 1) % 2) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Fd = open(Path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (Fd < 0) {
+		return ESP_FAIL;
+	}
+	Ok = write(Fd, File, Length) == (ssize_t)Length && fsync(Fd) == 0;
+	if (close(Fd) != 0 || !Ok) {
+		return ESP_FAIL;
+	}
+	Backfill->Generation++;
+	Backfill->Stats.Cursor_Writes++;
+	return ESP_OK;
+}
+
+// A node's entry in the cursor table, added from the start of its records
+// if it has none. -1 when the table is full.
+static int16_t Cursor_Find(Backfill_t *Backfill, uint8_t Node)
+{
+	uint8_t i;
+
+	for (i = 0; i < Backfill->Cursor_Count; i++) {
+		if (Backfill->Cursors[i].Node == Node) {
+			return i;
+		}
+	}
+	if (Backfill->Cursor_Count == BACKFILL_MAX_NODES) {
+		return -1;
+	}
+	Backfill->Cursors[i].Node = Node;
+	Backfill->Cursors[i].Position.Bucket = 0;
+	Backfill->Cursors[i].Position.Offset = 0;
+	Backfill->Cursor_Count++;
+	return i;
+}
+
+esp_err_t Backfill_Open(Backfill_t *Backfill, const char *Root)
+{
+	bool Found = false;
+
+	memset(Backfill, 0, sizeof(*Backfill));
+	if (strlen(Root) + sizeof("/N000/00000000.SEG") > SEGMENT_PATH_LEN) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	snprintf(Backfill->Root, sizeof(Backfill->Root), "%s", Root);
+	Backfill->Node = NO_NODE;
+
+	Cursor_Read(Backfill, 0, &Found);
+	Cursor_Read(Backfill, 1, &Found);
+	return ESP_OK;
+}
+
+esp_err_t Backfill_Begin(Backfill_t *Backfill, uint16_t Session)
+{
+	char *End;
+	struct dirent *Entry;
+	unsigned long Node;
+	DIR *Dir;
+
+	if (Backfill->Active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	// Raw records only, a compacted segment's data is left as summaries
+	memset(Backfill->Nodes, 0, sizeof(Backfill->Nodes));
+	Dir = opendir(Backfill->Root);
+	if (Dir == NULL) {
+		return ESP_FAIL;
+	}
+	while ((Entry = readdir(Dir)) != NULL) {
+		if (strlen(Entry->d_name) != 4 || (Entry->d_name[0] != 'N' && Entry->d_name[0] != 'n')) {
+			continue;
+		}
+		Node = strtoul(Entry->d_name + 1, &End, 10);
+		if (*End == '\0' && Node < NO_NODE) {
+			Backfill->Nodes[Node / 32] |= 1U << (Node % 32);
+		}
+	}
+	closedir(Dir);
+
+	memset(Backfill->Window, 0, sizeof(Backfill->Window));
+	Backfill->Active = true;
+	Backfill->Session = Session;
+	Backfill->Node = NO_NODE;
+	Backfill->Record_Pending = false;
+	Backfill->Marked = false;
+	Backfill->Stream_End = false;
+	Backfill->Base = 0;
+	Backfill->Next = 0;
+	Backfill->Waiting = false;
+	Backfill->Timeouts = 0;
+	return ESP_OK;
+}
+
+void Backfill_End(Backfill_t *Backfill)
+{
+	if (Backfill->Node != NO_NODE) {
+		Segment_QueryEnd(&Backfill->Query);
+		Backfill->Node = NO_NODE;
+	}
+	Backfill->Active = false;
+	Backfill->Waiting = false;
+}
+
+// Read the next record to pack, going on to the next node at the end of one.
+// False once every node is done.
+static bool Record_Load(Backfill_t *Backfill)
+{
+	esp_err_t err;
+	uint16_t Node;
+
+	while (true) {
+		if (Backfill->Node != NO_NODE) {
+			err = Segment_QueryNext(&Backfill->Query, &Backfill->Record);
+			if (err == ESP_OK) {
+				Backfill->Head[0] = Backfill->Node;
+				Put_32(Backfill->Head + 1, Backfill->Record.Timestamp);
+				Put_16(Backfill->Head + 5, Backfill->Record.Length);
+				Backfill->Record_Sent = 0;
+				Backfill->Record_Pending = true;
+				Backfill->Record_End.Node = Backfill->Node;
+				Segment_QueryTell(&Backfill->Query, &Backfill->Record_End.Position);
+				return true;
+			}
+			if (err != ESP_ERR_NOT_FOUND) {
+				Backfill->Stats.Errors++;
+			}
+			Segment_QueryEnd(&Backfill->Query);
+			Backfill->Node = NO_NODE;
+		}
+
+		for (Node = 0; Node < NO_NODE && !(Backfill->Nodes[Node / 32] & (1U << (Node % 32))); Node++) {
+		}
+		if (Node == NO_NODE) {
+			return false;
+		}
+		Backfill->Nodes[Node / 32] &= ~(1U << (Node % 32));
+
+		Backfill->Cursor = Cursor_Find(Backfill, Node);
+		if (Backfill->Cursor < 0) {
+			Backfill->Stats.Nodes_Skipped++;
+			continue;
+		}
+		if (Segment_QueryBegin(&Backfill->Query, Backfill->Root, 0, Node, 0, UINT32_MAX, Backfill->Buffer,
+			sizeof(Backfill->Buffer)) != ESP_OK) {
+			Backfill->Stats.Errors++;
+			continue;
+		}
+		Backfill->Node = Node;
+		if (Segment_QuerySeek(&Backfill->Query, &Backfill->Cursors[Backfill->Cursor].Position) != ESP_OK) {
+			Backfill->Stats.Errors++;
+			Segment_QueryEnd(&Backfill->Query);
+			Backfill->Node = NO_NODE;
+		}
+	}
+}
+
+// Pack stream bytes, whole records where they fit and split where they do
+// not, one node's records at most ending in it. Notes the progress of the last
+// record packed whole, and the end of the stream as soon as the last one is
+// packed.
+static uint8_t Fragment_Fill(Backfill_t *Backfill, uint8_t *Data, uint8_t Room)
+{
+	uint32_t Length, Take;
+	uint8_t Used = 0;
+
+	Backfill->Marked = false;
+	while (Used < Room) {
+		if (!Backfill->Record_Pending && !Record_Load(Backfill)) {
+			Backfill->Stream_End = true;
+			break;
+		}
+		// A fragment carries one node's progress: the next node starts a new one
+		if (Backfill->Marked && Backfill->Record_Sent == 0 && Backfill->Record_End.Node != Backfill->Mark.Node) {
+			break;
+		}
+
+		Length = BACKFILL_RECORD_HEADER + Backfill->Record.Length;
+		Take = Length - Backfill->Record_Sent;
+		if (Take > (uint32_t)(Room - Used)) {
+			Take = Room - Used;
+		}
+		while (Take--) {
+			Data[Used++] = Backfill->Record_Sent < BACKFILL_RECORD_HEADER
+				? Backfill->Head[Backfill->Record_Sent]
+				: Backfill->Record.Data[Backfill->Record_Sent - BACKFILL_RECORD_HEADER];
+			Backfill->Record_Sent++;
+		}
+
+		if (Backfill->Record_Sent == Length) {
+			Backfill->Record_Pending = false;
+			Backfill->Marked = true;
+			Backfill->Mark = Backfill->Record_End;
+			Backfill->Stats.Records++;
+		}
+	}
+
+	// A full fragment that ended a record: look ahead, so the last fragment
+	// is flagged as such
+	if (Used == Room && !Backfill->Record_Pending && !Record_Load(Backfill)) {
+		Backfill->Stream_End = true;
+	}
+	Backfill->Stats.Bytes += Used;
+	return Used;
+}
+
+uint8_t Backfill_NextFragment(Backfill_t *Backfill, int64_t Now_MS, uint8_t *Payload)
+{
+	Backfill_Fragment_t *Fragment = NULL, *Other;
+	uint16_t Seq, Pending;
+	uint8_t Length, Flags = 0;
+
+	if (!Backfill->Active) {
+		return 0;
+	}
+	if (Backfill->Waiting) {
+		if (Now_MS < Backfill->Ack_Due_MS) {
+			return 0;
+		}
+		Backfill->Stats.Timeouts++;
+		if (++Backfill->Timeouts > BACKFILL_MAX_TIMEOUTS) {
+			Backfill->Stats.Aborted++;
+			Backfill_End(Backfill);
+			return 0;
+		}
+		// The fragment asking for an acknowledgement or the acknowledgement
+		// was lost: only that fragment goes again, its reply tells the rest
+		Other = &Backfill->Window[Backfill->Asked % BACKFILL_WINDOW];
+		if (Other->State == FRAGMENT_SENT) {
+			Other->State = FRAGMENT_QUEUED;
+		}
+		Backfill->Waiting = false;
+	}
+
+	// Missed fragments first, oldest first
+	for (Seq = Backfill->Base; Seq != Backfill->Next; Seq++) {
+		if (Backfill->Window[Seq % BACKFILL_WINDOW].State == FRAGMENT_QUEUED) {
+			Fragment = &Backfill->Window[Seq % BACKFILL_WINDOW];
+			Backfill->Stats.Retransmits++;
+			break;
+		}
+	}
+	if (Fragment == NULL && (uint16_t)(Backfill->Next - Backfill->Base) < BACKFILL_WINDOW && !Backfill->Stream_End) {
+		Fragment = &Backfill->Window[Backfill->Next % BACKFILL_WINDOW];
+		Length = Fragment_Fill(Backfill, Fragment->Payload + BACKFILL_FRAGMENT_HEADER, BACKFILL_FRAGMENT_DATA);
+		if (Length == 0) {
+			Fragment = NULL;
+		} else {
+			Seq = Backfill->Next++;
+			Fragment->Length = BACKFILL_FRAGMENT_HEADER + Length;
+			Fragment->Marked = Backfill->Marked;
+			Fragment->Mark = Backfill->Mark;
+		}
+	}
+	if (Fragment == NULL) {
+		// Only an empty stream gets here with nothing in flight
+		if (Backfill->Base == Backfill->Next && Backfill->Stream_End) {
+			Backfill->Stats.Sessions++;
+			Backfill_End(Backfill);
+		}
+		return 0;
+	}
+
+	// Ask for an acknowledgement with the last fragment of a burst: nothing
+	// is left to resend and the window is full or the stream ran out
+	Fragment->State = FRAGMENT_SENT;
+	Pending = 0;
+	for (Other = Backfill->Window; Other < Backfill->Window + BACKFILL_WINDOW; Other++) {
+		Pending += Other->State == FRAGMENT_QUEUED;
+	}
+	if (Pending == 0 && ((uint16_t)(Backfill->Next - Backfill->Base) == BACKFILL_WINDOW || Backfill->Stream_End)) {
+		Flags |= BACKFILL_FLAG_ACK;
+		Backfill->Waiting = true;
+		Backfill->Asked = Seq;
+		Backfill->Ack_Due_MS = Now_MS + BACKFILL_ACK_TIMEOUT_MS;
+	}
+	if (Backfill->Stream_End && Seq == (uint16_t)(Backfill->Next - 1)) {
+		Flags |= BACKFILL_FLAG_END;
+	}
+
+	Put_16(Fragment->Payload, Backfill->Session);
+	Put_16(Fragment->Payload + 2, Seq);
+	Fragment->Payload[4] = Flags;
+	memcpy(Payload, Fragment->Payload, Fragment->Length);
+	Backfill->Stats.Fragments++;
+	return Fragment->Length;
+}
+
+void Backfill_Ack(Backfill_t *Backfill, const uint8_t *Payload, uint8_t Length)
+{
+	Backfill_Fragment_t *Fragment;
+	uint16_t Expected, Seq, Bit;
+	bool Moved = false;
+	uint32_t Bitmap;
+	int16_t Cursor;
+
+	if (!Backfill->Active || Length < BACKFILL_ACK_BYTES || Get_16(Payload) != Backfill->Session) {
+		return;
+	}
+	Expected = Get_16(Payload + 2);
+	Bitmap = Get_32(Payload + 4);
+	if ((uint16_t)(Expected - Backfill->Base) > (uint16_t)(Backfill->Next - Backfill->Base)) {
+		return;
+	}
+	Backfill->Stats.Acks++;
+
+	// Everything before Expected arrived: its progress is final
+	while (Backfill->Base != Expected) {
+		Fragment = &Backfill->Window[Backfill->Base % BACKFILL_WINDOW];
+		if (Fragment->Marked) {
+			Cursor = Cursor_Find(Backfill, Fragment->Mark.Node);
+			if (Cursor >= 0) {
+				Backfill->Cursors[Cursor].Position = Fragment->Mark.Position;
+				Moved = true;
+			}
+		}
+		Fragment->State = FRAGMENT_FREE;
+		Backfill->Base++;
+	}
+
+	// Ahead of the gap, what the bitmap does not list went missing
+	for (Seq = Backfill->Base; Seq != Backfill->Next; Seq++) {
+		Fragment = &Backfill->Window[Seq % BACKFILL_WINDOW];
+		Bit = Seq - Backfill->Base;
+		if (Bit > 0 && (Bitmap >> (Bit - 1)) & 1) {
+			Fragment->State = FRAGMENT_ACKED;
+		} else if (Fragment->State == FRAGMENT_SENT) {
+			Fragment->State = FRAGMENT_QUEUED;
+		}
+	}
+	Backfill->Waiting = false;
+	Backfill->Timeouts = 0;
+
+	if (Moved && Cursor_Write(Backfill) != ESP_OK) {
+		Backfill->Stats.Errors++;
+	}
+	if (Backfill->Base == Backfill->Next && Backfill->Stream_End) {
+		Backfill->Stats.Sessions++;
+		Backfill_End(Backfill);
+	}
+}
+
+void Backfill_ReceiverInit(Backfill_Receiver_t *Receiver, Backfill_Record_Callback_t Callback, void *Context)
+{
+	memset(Receiver, 0, sizeof(*Receiver));
+	Receiver->Callback = Callback;
+	Receiver->Context = Context;
+}
+
+// Stream bytes in order: cut them back into records
+static void Stream_Take(Backfill_Receiver_t *Receiver, const uint8_t *Data, uint8_t Length)
+{
+	uint32_t Need, Take;
+	uint16_t Record_Length;
+
+	while (Length) {
+		Need = BACKFILL_RECORD_HEADER - Receiver->Record_Used;
+		if (Receiver->Record_Used >= BACKFILL_RECORD_HEADER) {
+			Need = BACKFILL_RECORD_HEADER + Get_16(Receiver->Record + 5) - Receiver->Record_Used;
+		}
+		Take = Need < Length ? Need : Length;
+		memcpy(Receiver->Record + Receiver->Record_Used, Data, Take);
+		Receiver->Record_Used += Take;
+		Data += Take;
+		Length -= Take;
+
+		if (Receiver->Record_Used < BACKFILL_RECORD_HEADER) {
+			continue;
+		}
+		Record_Length = Get_16(Receiver->Record + 5);
+		if (Record_Length > SEGMENT_MAX_DATA) {
+			Receiver->Stats.Errors++;
+			Receiver->Record_Used = 0;
+			continue;
+		}
+		if (Receiver->Record_Used == BACKFILL_RECORD_HEADER + (uint32_t)Record_Length) {
+			if (Receiver->Callback) {
+				Receiver->Callback(Receiver->Record[0], Get_32(Receiver->Record + 1),
+					Receiver->Record + BACKFILL_RECORD_HEADER, Record_Length, Receiver->Context);
+			}
+			Receiver->Stats.Records++;
+			Receiver->Record_Used = 0;
+		}
+	}
+}
+
+uint8_t Backfill_Receive(Backfill_Receiver_t *Receiver, const uint8_t *Payload, uint8_t Length, uint8_t *Ack)
+{
+	uint16_t Session, Seq, Offset;
+	uint8_t Flags;
+
+	if (Length < BACKFILL_FRAGMENT_HEADER || Length > BACKFILL_FRAGMENT_LEN) {
+		Receiver->Stats.Errors++;
+		return 0;
+	}
+	Session = Get_16(Payload);
+	Seq = Get_16(Payload + 2);
+	Flags = Payload[4];
+	Payload += BACKFILL_FRAGMENT_HEADER;
+	Length -= BACKFILL_FRAGMENT_HEADER;
+
+	// A new session starts at a record, from the sender's progress
+	if (!Receiver->Started || Session != Receiver->Session) {
+		Receiver->Started = true;
+		Receiver->Session = Session;
+		Receiver->Next = 0;
+		Receiver->Held = 0;
+		Receiver->Record_Used = 0;
+	}
+	Receiver->Stats.Fragments++;
+
+	Offset = Seq - Receiver->Next;
+	if (Offset == 0) {
+		Stream_Take(Receiver, Payload, Length);
+		Receiver->Next++;
+		Receiver->Held >>= 1;
+		while (Receiver->Held & 1) {
+			Stream_Take(Receiver, Receiver->Fragments[Receiver->Next % BACKFILL_WINDOW],
+				Receiver->Lengths[Receiver->Next % BACKFILL_WINDOW]);
+			Receiver->Next++;
+			Receiver->Held >>= 1;
+		}
+	} else if (Offset < BACKFILL_WINDOW && !(Receiver->Held & (1U << Offset))) {
+		memcpy(Receiver->Fragments[Seq % BACKFILL_WINDOW], Payload, Length);
+		Receiver->Lengths[Seq % BACKFILL_WINDOW] = Length;
+		Receiver->Held |= 1U << Offset;
+	} else {
+		Receiver->Stats.Duplicates++;
+	}
+
+	if (!(Flags & BACKFILL_FLAG_ACK)) {
+		return 0;
+	}
+	Put_16(Ack, Receiver->Session);
+	Put_16(Ack + 2, Receiver->Next);
+	Put_32(Ack + 4, Receiver->Held >> 1);
+	return BACKFILL_ACK_BYTES;
+}
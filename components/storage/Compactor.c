@@ -0,0 +1,581 @@
+/**
+ * @file Compactor.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Segment retention: raw records to minute and hour summaries.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/Compactor.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define NO_NODE 256
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static int64_t Now_US(void)
+{
+#ifdef ESP_PLATFORM
+	return esp_timer_get_time();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void Put_16(uint8_t *Buffer, uint16_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = Value >> 8;
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+esp_err_t Compactor_LevelRoot(char *Path, const char *Root, uint8_t Level)
+{
+	static const char *const Dirs[COMPACTOR_LEVELS] = {"", "/" COMPACTOR_MINUTE_DIR, "/" COMPACTOR_HOUR_DIR};
+	int Length = snprintf(Path, SEGMENT_PATH_LEN, "%s%s", Root, Dirs[Level]);
+
+	return Length < 0 || Length >= SEGMENT_PATH_LEN ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+uint32_t Compactor_LevelBucket(uint8_t Level)
+{
+	return Level == COMPACTOR_HOUR ? COMPACTOR_HOUR_BUCKET_S : SEGMENT_BUCKET_S;
+}
+
+// Window length of the summaries a level is compacted into
+static uint32_t Window_Length(uint8_t Level)
+{
+	return Level == COMPACTOR_RAW ? COMPACTOR_MINUTE_S : COMPACTOR_HOUR_S;
+}
+
+static esp_err_t Source_Path(const Compactor_t *Compactor, char *Path)
+{
+	char Root[SEGMENT_PATH_LEN];
+
+	if (Compactor_LevelRoot(Root, Compactor->Root, Compactor->Job_Level) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return Segment_FilePath(Path, Root, Compactor->Job_Node, Compactor->Job_Bucket);
+}
+
+// A cut path would name some other file, so truncation is an error
+static esp_err_t Journal_Path(const Compactor_t *Compactor, char *Path)
+{
+	int Length = snprintf(Path, SEGMENT_PATH_LEN, "%s/%s", Compactor->Root, COMPACTOR_JOURNAL);
+
+	return Length < 0 || Length >= SEGMENT_PATH_LEN ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+// Durable before the output is touched
+static esp_err_t Journal_Write(const Compactor_t *Compactor)
+{
+	uint8_t Entry[COMPACTOR_JOURNAL_LEN] = {0};
+	char Path[SEGMENT_PATH_LEN];
+	bool Ok;
+	int Fd;
+
+	Put_32(Entry, COMPACTOR_JOURNAL_MAGIC);
+	Entry[4] = Compactor->Job_Level;
+	Entry[5] = Compactor->Job_Node;
+	Put_32(Entry + 8, Compactor->Job_Bucket);
+	Put_32(Entry + 12, Compactor->Out_Bucket);
+	Put_32(Entry + 16, Compactor->Out_End);
+	Put_32(Entry + 20, RecordLog_Crc32(0, Entry, 20));
+
+	if (Journal_Path(Compactor, Path) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Fd = open(Path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (Fd < 0) {
+		return ESP_FAIL;
+	}
+	Ok = write(Fd, Entry, sizeof(Entry)) == sizeof(Entry) && fsync(Fd) == 0;
+	return close(Fd) == 0 && Ok ? ESP_OK : ESP_FAIL;
+}
+
+// Load the job a journal entry describes. False if there is none, or it was
+// cut while being written; either way the output was not touched yet.
+static bool Journal_Read(Compactor_t *Compactor)
+{
+	uint8_t Entry[COMPACTOR_JOURNAL_LEN];
+	char Path[SEGMENT_PATH_LEN];
+	ssize_t Length;
+	int Fd;
+
+	if (Journal_Path(Compactor, Path) != ESP_OK) {
+		return false;
+	}
+	Fd = open(Path, O_RDONLY);
+	if (Fd < 0) {
+		return false;
+	}
+	Length = read(Fd, Entry, sizeof(Entry));
+	close(Fd);
+
+	if (Length != sizeof(Entry) || Get_32(Entry) != COMPACTOR_JOURNAL_MAGIC
+		|| RecordLog_Crc32(0, Entry, 20) != Get_32(Entry + 20) || Entry[4] >= COMPACTOR_HOUR) {
+		return false;
+	}
+	Compactor->Job_Level = Entry[4];
+	Compactor->Job_Node = Entry[5];
+	Compactor->Job_Bucket = Get_32(Entry + 8);
+	Compactor->Out_Bucket = Get_32(Entry + 12);
+	Compactor->Out_End = Get_32(Entry + 16);
+	return true;
+}
+
+static esp_err_t Journal_Remove(const Compactor_t *Compactor)
+{
+	char Path[SEGMENT_PATH_LEN];
+
+	if (Journal_Path(Compactor, Path) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return unlink(Path) == 0 || errno == ENOENT ? ESP_OK : ESP_FAIL;
+}
+
+// Put the output back as it was before the job: removed if the job created
+// it, else cut back to where its records ended. A cut sealed segment reads
+// as unsealed and is recovered when it is next appended to.
+static esp_err_t Job_Undo(Compactor_t *Compactor)
+{
+	char Root[SEGMENT_PATH_LEN], Path[SEGMENT_PATH_LEN];
+	int Result;
+
+	if (Compactor_LevelRoot(Root, Compactor->Root, Compactor->Job_Level + 1) != ESP_OK
+		|| Segment_FilePath(Path, Root, Compactor->Job_Node, Compactor->Out_Bucket) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (Compactor->Out_End == COMPACTOR_NO_OUTPUT) {
+		Result = unlink(Path);
+	} else {
+		Result = truncate(Path, Compactor->Out_End);
+	}
+	if (Result != 0 && errno != ENOENT) {
+		return ESP_FAIL;
+	}
+
+	Compactor->Stats.Undone++;
+	return Journal_Remove(Compactor);
+}
+
+esp_err_t Compactor_Start(Compactor_t *Compactor, const char *Root, const SegmentStore_t *Live)
+{
+	char Path[SEGMENT_PATH_LEN];
+
+	memset(Compactor, 0, sizeof(*Compactor));
+	if (strlen(Root) + sizeof("/" COMPACTOR_MINUTE_DIR "/N000/00000000.SEG") > SEGMENT_PATH_LEN) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	snprintf(Compactor->Root, sizeof(Compactor->Root), "%s", Root);
+	Compactor->Live = Live;
+	Compactor->Age_S[COMPACTOR_RAW] = COMPACTOR_RAW_AGE_S;
+	Compactor->Age_S[COMPACTOR_MINUTE] = COMPACTOR_MINUTE_AGE_S;
+	Compactor->Age_S[COMPACTOR_HOUR] = COMPACTOR_HOUR_AGE_S;
+
+	// A job cut short: if its source is gone it had finished, else its
+	// summaries may be partly written and must not stay next to the source
+	if (!Journal_Read(Compactor)) {
+		return Journal_Remove(Compactor);
+	}
+	if (Source_Path(Compactor, Path) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (access(Path, F_OK) != 0) {
+		return Journal_Remove(Compactor);
+	}
+	return Job_Undo(Compactor);
+}
+
+// Note which node directories a level has, none if nothing there can be
+// old enough yet
+static void Nodes_List(Compactor_t *Compactor, uint32_t Now)
+{
+	uint32_t Age = Compactor->Age_S[Compactor->Level];
+	char Path[SEGMENT_PATH_LEN], *End;
+	struct dirent *Entry;
+	unsigned long Node;
+	DIR *Dir;
+
+	memset(Compactor->Nodes, 0, sizeof(Compactor->Nodes));
+	Compactor->Listed = true;
+	Compactor->Node = 0;
+	if (Age == 0 || (uint64_t)Age + Compactor_LevelBucket(Compactor->Level) > Now) {
+		Compactor->Node = NO_NODE;
+		return;
+	}
+
+	if (Compactor_LevelRoot(Path, Compactor->Root, Compactor->Level) != ESP_OK) {
+		return;
+	}
+	Dir = opendir(Path);
+	if (Dir == NULL) {
+		return;
+	}
+	while ((Entry = readdir(Dir)) != NULL) {
+		if (strlen(Entry->d_name) != 4 || (Entry->d_name[0] != 'N' && Entry->d_name[0] != 'n')) {
+			continue;
+		}
+		Node = strtoul(Entry->d_name + 1, &End, 10);
+		if (*End == '\0' && Node < NO_NODE) {
+			Compactor->Nodes[Node / 32] |= 1U << (Node % 32);
+		}
+	}
+	closedir(Dir);
+}
+
+// Deleting needs no journal, the unlink is the whole job
+static esp_err_t Segment_Delete(Compactor_t *Compactor)
+{
+	char Path[SEGMENT_PATH_LEN];
+	struct stat Info;
+
+	if (Source_Path(Compactor, Path) != ESP_OK || stat(Path, &Info) != 0 || unlink(Path) != 0) {
+		return ESP_FAIL;
+	}
+	Compactor->Stats.Bytes_Freed += Info.st_size;
+	Compactor->Stats.Jobs++;
+	return ESP_OK;
+}
+
+static esp_err_t Job_Begin(Compactor_t *Compactor)
+{
+	char Root[SEGMENT_PATH_LEN], Path[SEGMENT_PATH_LEN];
+	uint8_t Level = Compactor->Job_Level;
+	uint32_t Bucket = Compactor->Job_Bucket;
+	struct stat Info;
+	int64_t End;
+
+	if (Source_Path(Compactor, Path) != ESP_OK || stat(Path, &Info) != 0) {
+		return ESP_FAIL;
+	}
+	Compactor->Job_Size = Info.st_size;
+
+	Compactor->Out_Bucket = Bucket - Bucket % Compactor_LevelBucket(Level + 1);
+	if (Compactor_LevelRoot(Root, Compactor->Root, Level + 1) != ESP_OK
+		|| Segment_FilePath(Path, Root, Compactor->Job_Node, Compactor->Out_Bucket) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	End = Segment_RecordsEnd(Path, Compactor->Buffer, &Compactor->Index);
+	Compactor->Out_End = End < 0 ? COMPACTOR_NO_OUTPUT : (uint32_t)End;
+
+	if (Journal_Write(Compactor) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (SegmentStore_Open(&Compactor->Out, Root, Compactor_LevelBucket(Level + 1)) != ESP_OK) {
+		Journal_Remove(Compactor);
+		return ESP_FAIL;
+	}
+
+	if (Compactor_LevelRoot(Root, Compactor->Root, Level) != ESP_OK
+		|| Segment_QueryBegin(&Compactor->Query, Root, Compactor_LevelBucket(Level), Compactor->Job_Node, Bucket,
+		Bucket + Compactor_LevelBucket(Level) - 1, Compactor->Buffer, sizeof(Compactor->Buffer)) != ESP_OK) {
+		Journal_Remove(Compactor);
+		return ESP_FAIL;
+	}
+
+	Compactor->Window.Count = 0;
+	Compactor->Busy = true;
+	return ESP_OK;
+}
+
+// Look at the next node of the current level for a segment old enough to
+// compact, or list the level's nodes, or move on to the next level
+static esp_err_t Work_Find(Compactor_t *Compactor, uint32_t Now)
+{
+	char Root[SEGMENT_PATH_LEN];
+	uint32_t Age = Compactor->Age_S[Compactor->Level], Bucket_S = Compactor_LevelBucket(Compactor->Level), i;
+	uint8_t Node;
+	bool Found = false;
+	esp_err_t err;
+
+	if (!Compactor->Listed) {
+		Nodes_List(Compactor, Now);
+		return ESP_OK;
+	}
+	while (Compactor->Node < NO_NODE && !(Compactor->Nodes[Compactor->Node / 32] & (1U << (Compactor->Node % 32)))) {
+		Compactor->Node++;
+	}
+	if (Compactor->Node == NO_NODE) {
+		Compactor->Listed = false;
+		if (++Compactor->Level == COMPACTOR_LEVELS) {
+			// Nothing found in a whole sweep, rest until the next one
+			Compactor->Level = COMPACTOR_RAW;
+			if (!Compactor->Found) {
+				Compactor->Swept = true;
+				Compactor->Swept_At = Now;
+			}
+			Compactor->Found = false;
+		}
+		return ESP_OK;
+	}
+	Node = Compactor->Node;
+
+	// Oldest segment that ended at least Age ago
+	err = Compactor_LevelRoot(Root, Compactor->Root, Compactor->Level);
+	if (err == ESP_OK) {
+		err = Segment_QueryBegin(&Compactor->Query, Root, Bucket_S, Node, 0, Now - Age - Bucket_S, Compactor->Buffer,
+			sizeof(Compactor->Buffer));
+	}
+	for (i = 0; err == ESP_OK && i < Compactor->Query.Bucket_Count; i++) {
+		if (Compactor->Level != COMPACTOR_RAW || Compactor->Live == NULL
+			|| !SegmentStore_IsActive(Compactor->Live, Node, Compactor->Query.Buckets[i])) {
+			Compactor->Job_Bucket = Compactor->Query.Buckets[i];
+			Found = true;
+			break;
+		}
+	}
+	Segment_QueryEnd(&Compactor->Query);
+	if (!Found) {
+		Compactor->Node++;
+		return err;
+	}
+
+	// The same node is looked at again afterwards, for its next segment
+	Compactor->Found = true;
+	Compactor->Job_Level = Compactor->Level;
+	Compactor->Job_Node = Node;
+	err = Compactor->Level == COMPACTOR_HOUR ? Segment_Delete(Compactor) : Job_Begin(Compactor);
+	if (err != ESP_OK) {
+		// Leave the node for the next sweep rather than retry at once
+		Compactor->Node++;
+	}
+	return err;
+}
+
+// Store the open window as one summary record
+static esp_err_t Window_Emit(Compactor_t *Compactor)
+{
+	Compactor_Window_t *Window = &Compactor->Window;
+	uint8_t *Record = Compactor->Record, i;
+	int64_t Mean;
+
+	Record[0] = COMPACTOR_SUMMARY_TAG;
+	Record[1] = Window->Columns;
+	Put_16(Record + 2, Window_Length(Compactor->Job_Level));
+	Put_32(Record + 4, Window->Count);
+	for (i = 0; i < Window->Columns; i++) {
+		// Rounded to nearest, halves away from zero
+		Mean = Window->Sum[i] >= 0 ? (Window->Sum[i] + Window->Count / 2) / Window->Count
+			: (Window->Sum[i] - Window->Count / 2) / Window->Count;
+		Put_32(Record + COMPACTOR_SUMMARY_HEADER + 12 * i, Window->Min[i]);
+		Put_32(Record + COMPACTOR_SUMMARY_HEADER + 12 * i + 4, (int32_t)Mean);
+		Put_32(Record + COMPACTOR_SUMMARY_HEADER + 12 * i + 8, Window->Max[i]);
+	}
+	Window->Count = 0;
+
+	Compactor->Stats.Summaries++;
+	return SegmentStore_Append(&Compactor->Out, Compactor->Job_Node, Window->Start, Record,
+		COMPACTOR_SUMMARY_LEN(Window->Columns));
+}
+
+// Fold Count samples into the window holding T. Samples mostly arrive in
+// time order; one that does not opens its window again as another record,
+// readers add up the windows that share a start.
+static esp_err_t Window_Add(Compactor_t *Compactor, uint32_t T, uint8_t Columns, uint32_t Count, const int32_t *Min,
+	const int64_t *Sum, const int32_t *Max)
+{
+	Compactor_Window_t *Window = &Compactor->Window;
+	uint32_t Start = T - T % Window_Length(Compactor->Job_Level);
+	esp_err_t err = ESP_OK;
+	uint8_t i;
+
+	if (Window->Count && (Window->Start != Start || Window->Columns != Columns)) {
+		err = Window_Emit(Compactor);
+	}
+	if (Window->Count == 0) {
+		Window->Start = Start;
+		Window->Columns = Columns;
+		for (i = 0; i < Columns; i++) {
+			Window->Min[i] = INT32_MAX;
+			Window->Max[i] = INT32_MIN;
+			Window->Sum[i] = 0;
+		}
+	}
+
+	Window->Count += Count;
+	for (i = 0; i < Columns; i++) {
+		if (Min[i] < Window->Min[i]) {
+			Window->Min[i] = Min[i];
+		}
+		if (Max[i] > Window->Max[i]) {
+			Window->Max[i] = Max[i];
+		}
+		Window->Sum[i] += Sum[i];
+	}
+	return err;
+}
+
+// Every sample of a raw series block into minute windows
+static esp_err_t Block_Add(Compactor_t *Compactor, Series_Decoder_t *Decoder)
+{
+	Series_Value_t Values[SERIES_MAX_COLUMNS];
+	int32_t Ints[SERIES_MAX_COLUMNS];
+	int64_t Sums[SERIES_MAX_COLUMNS];
+	esp_err_t err = ESP_OK;
+	uint32_t T;
+	uint8_t i;
+
+	while (err == ESP_OK && Series_Next(Decoder, &T, Values) == ESP_OK) {
+		for (i = 0; i < Decoder->Columns; i++) {
+			Ints[i] = Values[i].Int;
+			Sums[i] = Values[i].Int;
+		}
+		err = Window_Add(Compactor, T, Decoder->Columns, 1, Ints, Sums, Ints);
+		Compactor->Stats.Samples++;
+	}
+	return err;
+}
+
+// A minute summary into its hour window, its mean weighted by its count
+static esp_err_t Summary_Add(Compactor_t *Compactor, const Segment_Record_t *Record)
+{
+	int32_t Min[SERIES_MAX_COLUMNS], Max[SERIES_MAX_COLUMNS];
+	int64_t Sum[SERIES_MAX_COLUMNS];
+	const uint8_t *At;
+	uint32_t Count = Get_32(Record->Data + 4);
+	uint8_t Columns = Record->Data[1], i;
+
+	for (i = 0; i < Columns; i++) {
+		At = Record->Data + COMPACTOR_SUMMARY_HEADER + 12 * i;
+		Min[i] = (int32_t)Get_32(At);
+		Sum[i] = (int64_t)(int32_t)Get_32(At + 4) * Count;
+		Max[i] = (int32_t)Get_32(At + 8);
+	}
+	return Window_Add(Compactor, Record->Timestamp, Columns, Count, Min, Sum, Max);
+}
+
+// Seal the summaries, then delete the source; or put everything back if the
+// job failed or the writer appended to the source meanwhile
+static esp_err_t Job_Finish(Compactor_t *Compactor, esp_err_t err)
+{
+	char Path[SEGMENT_PATH_LEN];
+	struct stat Info;
+
+	Compactor->Busy = false;
+	Segment_QueryEnd(&Compactor->Query);
+	if (err == ESP_OK && Compactor->Window.Count) {
+		err = Window_Emit(Compactor);
+	}
+	if (SegmentStore_Close(&Compactor->Out) != ESP_OK) {
+		err = ESP_FAIL;
+	}
+
+	if (err == ESP_OK) {
+		err = Source_Path(Compactor, Path);
+	}
+	if (err != ESP_OK || stat(Path, &Info) != 0 || (uint64_t)Info.st_size != Compactor->Job_Size
+		|| (Compactor->Job_Level == COMPACTOR_RAW && Compactor->Live != NULL
+		&& SegmentStore_IsActive(Compactor->Live, Compactor->Job_Node, Compactor->Job_Bucket))) {
+		// A late record: the next sweep compacts the segment again
+		if (Job_Undo(Compactor) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+		return err;
+	}
+	if (unlink(Path) != 0) {
+		Job_Undo(Compactor);
+		return ESP_FAIL;
+	}
+
+	Compactor->Stats.Bytes_Freed += Compactor->Job_Size;
+	Compactor->Stats.Jobs++;
+	return Journal_Remove(Compactor);
+}
+
+// One record of the source
+static esp_err_t Job_Step(Compactor_t *Compactor)
+{
+	Segment_Record_t Record;
+	Series_Decoder_t Decoder;
+	esp_err_t err = ESP_OK;
+
+	if (Segment_QueryNext(&Compactor->Query, &Record) != ESP_OK) {
+		return Job_Finish(Compactor, ESP_OK);
+	}
+
+	if (Compactor->Job_Level == COMPACTOR_RAW) {
+		// Integer series blocks are summarized, anything else is kept
+		if (Record.Length > 1 && Record.Data[0] == SERIES_RECORD_TAG
+			&& Series_DecodeBegin(&Decoder, Record.Data + 1, Record.Length - 1) == ESP_OK && Decoder.Float_Mask == 0) {
+			err = Block_Add(Compactor, &Decoder);
+		} else {
+			err = SegmentStore_Append(&Compactor->Out, Compactor->Job_Node, Record.Timestamp, Record.Data, Record.Length);
+			Compactor->Stats.Carried++;
+		}
+	} else if (Record.Length >= COMPACTOR_SUMMARY_HEADER && Record.Data[0] == COMPACTOR_SUMMARY_TAG
+		&& Record.Data[1] && Record.Data[1] <= SERIES_MAX_COLUMNS && Record.Length == COMPACTOR_SUMMARY_LEN(Record.Data[1])) {
+		err = Summary_Add(Compactor, &Record);
+	}
+
+	if (err != ESP_OK) {
+		return Job_Finish(Compactor, err);
+	}
+	return ESP_OK;
+}
+
+esp_err_t Compactor_Step(Compactor_t *Compactor, uint32_t Now, uint32_t Budget_US)
+{
+	int64_t Start = Now_US(), Elapsed;
+	esp_err_t err = ESP_OK;
+	bool Busy;
+
+	if (!Compactor->Busy && Compactor->Swept) {
+		if (Now - Compactor->Swept_At < COMPACTOR_SWEEP_S) {
+			return ESP_OK;
+		}
+		Compactor->Swept = false;
+	}
+
+	// Starting or finishing a job syncs the card, that ends the step
+	do {
+		Busy = Compactor->Busy;
+		if ((Busy ? Job_Step(Compactor) : Work_Find(Compactor, Now)) != ESP_OK) {
+			Compactor->Stats.Errors++;
+			err = ESP_FAIL;
+		}
+		Elapsed = Now_US() - Start;
+	} while (Elapsed < Budget_US && Busy == Compactor->Busy && (Busy || !Compactor->Swept));
+
+	Compactor->Stats.Steps++;
+	if (Elapsed > Compactor->Stats.Max_Step_US) {
+		Compactor->Stats.Max_Step_US = Elapsed;
+	}
+	return err;
+}
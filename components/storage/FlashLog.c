@@ -0,0 +1,453 @@
+/**
+ * @file FlashLog.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Record log on a raw flash partition.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/FlashLog.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define ERASED 0xFF
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static int64_t Now_MS(void)
+{
+#ifdef ESP_PLATFORM
+	return esp_timer_get_time() / 1000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+#ifdef ESP_PLATFORM
+static esp_err_t Device_Read(const FlashLog_t *Log, uint32_t Address, void *Data, size_t Length)
+{
+	return esp_partition_read(Log->Partition, Address, Data, Length);
+}
+
+static esp_err_t Device_Program(FlashLog_t *Log, uint32_t Address, const void *Data, size_t Length)
+{
+	return esp_partition_write(Log->Partition, Address, Data, Length);
+}
+
+static esp_err_t Device_Erase(FlashLog_t *Log, uint32_t Page)
+{
+	return esp_partition_erase_range(Log->Partition, Page * FLASH_LOG_PAGE_SIZE, FLASH_LOG_PAGE_SIZE);
+}
+#else
+// The image behaves like NOR flash: programming only clears bits, erasing
+// sets a page back to 0xFF
+static esp_err_t Device_Read(const FlashLog_t *Log, uint32_t Address, void *Data, size_t Length)
+{
+	return pread(Log->Fd, Data, Length, Address) == (ssize_t)Length ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t Device_Program(FlashLog_t *Log, uint32_t Address, const void *Data, size_t Length)
+{
+	uint8_t Cells[FLASH_LOG_PAGE_SIZE];
+	const uint8_t *Bytes = Data;
+	size_t i;
+
+	if (Length > sizeof(Cells) || Device_Read(Log, Address, Cells, Length) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	for (i = 0; i < Length; i++) {
+		Cells[i] &= Bytes[i];
+	}
+	return pwrite(Log->Fd, Cells, Length, Address) == (ssize_t)Length ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t Device_Erase(FlashLog_t *Log, uint32_t Page)
+{
+	uint8_t Cells[FLASH_LOG_PAGE_SIZE];
+
+	memset(Cells, ERASED, sizeof(Cells));
+	return pwrite(Log->Fd, Cells, sizeof(Cells), (off_t)Page * FLASH_LOG_PAGE_SIZE) == sizeof(Cells) ? ESP_OK : ESP_FAIL;
+}
+#endif
+
+static bool Header_Valid(const uint8_t *Header, uint32_t *Sequence)
+{
+	if (Get_32(Header) != FLASH_LOG_PAGE_MAGIC || RecordLog_Crc32(0, Header, 12) != Get_32(&Header[12])) {
+		return false;
+	}
+	*Sequence = Get_32(&Header[4]);
+	return true;
+}
+
+// ESP_OK with the page's sequence number, ESP_ERR_NOT_FOUND if it holds no
+// page header
+static esp_err_t Header_Read(const FlashLog_t *Log, uint32_t Page, uint32_t *Sequence)
+{
+	uint8_t Header[FLASH_LOG_PAGE_HEADER];
+
+	if (Device_Read(Log, Page * FLASH_LOG_PAGE_SIZE, Header, sizeof(Header)) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	return Header_Valid(Header, Sequence) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t Erase_Page(FlashLog_t *Log, uint32_t Page)
+{
+	uint32_t Sequence;
+
+	if (Header_Read(Log, Page, &Sequence) == ESP_OK) {
+		Log->Stats.Pages_Dropped++;
+	}
+	if (Device_Erase(Log, Page) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Log->Stats.Erases++;
+	return ESP_OK;
+}
+
+// Program what the head page buffer holds beyond what is already on flash
+static esp_err_t Write_Out(FlashLog_t *Log)
+{
+	if (Log->Written >= Log->Used) {
+		return ESP_OK;
+	}
+	if (Device_Program(Log, Log->Head * FLASH_LOG_PAGE_SIZE + Log->Written, Log->Buffer + Log->Written,
+		Log->Used - Log->Written) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Log->Stats.Log.Device_Bytes += Log->Used - Log->Written;
+	Log->Stats.Log.Writes++;
+	Log->Written = Log->Used;
+
+	return ESP_OK;
+}
+
+// Close the head page and start the next one, erasing it first if the
+// background has not
+static esp_err_t Advance(FlashLog_t *Log)
+{
+	uint32_t Next = (Log->Head + 1) % Log->Pages;
+
+	if (Write_Out(Log) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (Log->Erased) {
+		Log->Erased--;
+	} else {
+		if (Erase_Page(Log, Next) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		Log->Stats.Foreground_Erases++;
+	}
+
+	Log->Head = Next;
+	Log->Sequence++;
+	memset(Log->Buffer, ERASED, FLASH_LOG_PAGE_SIZE);
+	Put_32(&Log->Buffer[0], FLASH_LOG_PAGE_MAGIC);
+	Put_32(&Log->Buffer[4], Log->Sequence);
+	Put_32(&Log->Buffer[12], RecordLog_Crc32(0, Log->Buffer, 12));
+	Log->Used = FLASH_LOG_PAGE_HEADER;
+	Log->Written = 0;
+	Log->Head_Open = true;
+
+	return ESP_OK;
+}
+
+static esp_err_t Page_Erased(FlashLog_t *Log, uint32_t Page, bool *Erased)
+{
+	uint32_t i;
+
+	if (Device_Read(Log, Page * FLASH_LOG_PAGE_SIZE, Log->Buffer, FLASH_LOG_PAGE_SIZE) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	for (i = 0; i < FLASH_LOG_PAGE_SIZE && Log->Buffer[i] == ERASED; i++) {
+	}
+	*Erased = i == FLASH_LOG_PAGE_SIZE;
+	return ESP_OK;
+}
+
+static esp_err_t Mount(FlashLog_t *Log)
+{
+	RecordLog_Frame_t Frame;
+	uint32_t Page, Sequence, At;
+	bool Found = false, Erased = true;
+	esp_err_t err;
+	int Length;
+
+	// Newest page from the headers
+	for (Page = 0; Page < Log->Pages; Page++) {
+		err = Header_Read(Log, Page, &Sequence);
+		if (err == ESP_FAIL) {
+			return err;
+		}
+		if (err == ESP_OK && (!Found || Sequence > Log->Sequence)) {
+			Log->Head = Page;
+			Log->Sequence = Sequence;
+			Found = true;
+		}
+	}
+	if (!Found) {
+		// The first append starts page 0
+		Log->Head = Log->Pages - 1;
+		Log->Sequence = 0;
+	}
+
+	// Pages erased ahead of it before the last power down, so the first
+	// appends do not erase again
+	while (Erased && Log->Erased < FLASH_LOG_ERASE_AHEAD) {
+		if (Page_Erased(Log, (Log->Head + 1 + Log->Erased) % Log->Pages, &Erased) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		Log->Erased += Erased;
+	}
+
+	if (!Found) {
+		Log->Used = Log->Written = FLASH_LOG_PAGE_SIZE;
+		return ESP_OK;
+	}
+
+	// Continue after the head page's last whole frame. Past it the page must
+	// still be erased; if a write was cut there, close the page instead of
+	// programming over the torn bytes.
+	if (Device_Read(Log, Log->Head * FLASH_LOG_PAGE_SIZE, Log->Buffer, FLASH_LOG_PAGE_SIZE) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	for (At = FLASH_LOG_PAGE_HEADER; (Length = RecordLog_Decode(&Log->Buffer[At], FLASH_LOG_PAGE_SIZE - At, &Frame)) > 0;
+		At += Length) {
+	}
+	Log->Used = Log->Written = At;
+	Log->Head_Open = true;
+	while (At < FLASH_LOG_PAGE_SIZE && Log->Buffer[At] == ERASED) {
+		At++;
+	}
+	if (At < FLASH_LOG_PAGE_SIZE) {
+		Log->Used = Log->Written = FLASH_LOG_PAGE_SIZE;
+		Log->Stats.Torn_Pages++;
+	}
+
+	return ESP_OK;
+}
+
+static void Release(FlashLog_t *Log)
+{
+#ifndef ESP_PLATFORM
+	if (Log->Fd >= 0) {
+		close(Log->Fd);
+	}
+	Log->Fd = -1;
+#endif
+	free(Log->Buffer);
+	Log->Buffer = NULL;
+}
+
+esp_err_t FlashLog_Open(FlashLog_t *Log, const char *Name, const RecordLog_Config_t *Config)
+{
+	RecordLog_Config_t Defaults;
+	uint64_t Size;
+
+	if (Config == NULL) {
+		RecordLog_DefaultConfig(&Defaults);
+		Config = &Defaults;
+	}
+
+	memset(Log, 0, sizeof(*Log));
+	Log->Sync_Records = Config->Sync_Records;
+	Log->Sync_MS = Config->Sync_MS;
+
+#ifdef ESP_PLATFORM
+	Log->Partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, Name);
+	if (Log->Partition == NULL) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	if (Log->Partition->erase_size != FLASH_LOG_PAGE_SIZE) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Size = Log->Partition->size;
+#else
+	Log->Fd = open(Name, O_RDWR);
+	if (Log->Fd < 0) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	Size = lseek(Log->Fd, 0, SEEK_END);
+#endif
+
+	// The head, the pages erased ahead of it, and at least one of records
+	Log->Pages = Size / FLASH_LOG_PAGE_SIZE;
+	if (Log->Pages < FLASH_LOG_ERASE_AHEAD + 2) {
+		Release(Log);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	Log->Buffer = malloc(FLASH_LOG_PAGE_SIZE);
+	if (Log->Buffer == NULL) {
+		Release(Log);
+		return ESP_ERR_NO_MEM;
+	}
+	if (Mount(Log) != ESP_OK) {
+		Release(Log);
+		return ESP_FAIL;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t FlashLog_Append(FlashLog_t *Log, const void *Data, uint16_t Length)
+{
+	return FlashLog_AppendFrame(Log, RECORD_LOG_RECORD, Data, Length);
+}
+
+esp_err_t FlashLog_AppendFrame(FlashLog_t *Log, uint8_t Type, const void *Data, uint16_t Length)
+{
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Length > FLASH_LOG_MAX_PAYLOAD) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	// Frames never cross a page, so every page decodes on its own
+	if ((!Log->Head_Open || Log->Used + RECORD_LOG_HEADER_LEN + Length > FLASH_LOG_PAGE_SIZE)
+		&& Advance(Log) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	RecordLog_EncodeHeader(&Log->Buffer[Log->Used], Type, Data, Length);
+	memcpy(&Log->Buffer[Log->Used + RECORD_LOG_HEADER_LEN], Data, Length);
+	Log->Used += RECORD_LOG_HEADER_LEN + Length;
+	Log->Stats.Log.Records++;
+	Log->Stats.Log.Payload_Bytes += Length;
+
+	if (Log->Pending++ == 0) {
+		Log->Pending_Since_MS = Now_MS();
+	}
+	if (Log->Sync_Records && Log->Pending >= Log->Sync_Records) {
+		return FlashLog_Sync(Log);
+	}
+	return FlashLog_Poll(Log);
+}
+
+esp_err_t FlashLog_Poll(FlashLog_t *Log)
+{
+	if (Log->Pending && Log->Sync_MS && Now_MS() - Log->Pending_Since_MS >= Log->Sync_MS) {
+		return FlashLog_Sync(Log);
+	}
+	return ESP_OK;
+}
+
+esp_err_t FlashLog_Sync(FlashLog_t *Log)
+{
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Write_Out(Log) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (Log->Pending) {
+		Log->Pending = 0;
+		Log->Stats.Log.Syncs++;
+	}
+	return ESP_OK;
+}
+
+esp_err_t FlashLog_EraseAhead(FlashLog_t *Log)
+{
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Log->Erased >= FLASH_LOG_ERASE_AHEAD) {
+		return ESP_OK;
+	}
+	if (Erase_Page(Log, (Log->Head + 1 + Log->Erased) % Log->Pages) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Log->Erased++;
+	return ESP_OK;
+}
+
+esp_err_t FlashLog_Close(FlashLog_t *Log)
+{
+	esp_err_t err;
+
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	err = FlashLog_Sync(Log);
+	Release(Log);
+
+	return err;
+}
+
+void FlashLog_ReadBegin(const FlashLog_t *Log, FlashLog_Cursor_t *Cursor, uint8_t *Buffer)
+{
+	memset(Cursor, 0, sizeof(*Cursor));
+	Cursor->Page = (Log->Head + 1) % Log->Pages;
+	Cursor->Left = Log->Pages;
+	Cursor->Buffer = Buffer;
+}
+
+esp_err_t FlashLog_ReadNext(const FlashLog_t *Log, FlashLog_Cursor_t *Cursor, RecordLog_Frame_t *Frame)
+{
+	uint32_t Sequence;
+	int Length;
+
+	while (1) {
+		if (Cursor->Offset < Cursor->End) {
+			Length = RecordLog_Decode(&Cursor->Buffer[Cursor->Offset], Cursor->End - Cursor->Offset, Frame);
+			if (Length > 0) {
+				Cursor->Offset += Length;
+				return ESP_OK;
+			}
+			// Erased space or a cut write, the page ends here
+			Cursor->End = 0;
+		}
+		if (Cursor->Left == 0) {
+			return ESP_ERR_NOT_FOUND;
+		}
+
+		if (Device_Read(Log, Cursor->Page * FLASH_LOG_PAGE_SIZE, Cursor->Buffer, FLASH_LOG_PAGE_SIZE) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		Cursor->Page = (Cursor->Page + 1) % Log->Pages;
+		Cursor->Left--;
+
+		// Sequence numbers grow along the ring from the oldest page. Once the
+		// writer has recycled a page ahead of the reader, the older pages
+		// after it fail this and are skipped.
+		if (Header_Valid(Cursor->Buffer, &Sequence) && Sequence > Cursor->Sequence) {
+			Cursor->Sequence = Sequence;
+			Cursor->Offset = FLASH_LOG_PAGE_HEADER;
+			Cursor->End = FLASH_LOG_PAGE_SIZE;
+		}
+	}
+}
@@ -0,0 +1,386 @@
+/**
+ * @file RecordLog.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Append-only binary record log.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/RecordLog.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+// CRC-32 nibble table, 64 bytes instead of the usual 1 KB
+static const uint32_t Crc_Table[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static int64_t Now_MS(void)
+{
+#ifdef ESP_PLATFORM
+	return esp_timer_get_time() / 1000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+// SD SPI transfers straight from DMA capable memory, anything else bounces
+static uint8_t *Buffer_Alloc(uint32_t Size)
+{
+#ifdef ESP_PLATFORM
+	return heap_caps_malloc(Size, MALLOC_CAP_DMA);
+#else
+	return aligned_alloc(RECORD_LOG_SECTOR, Size);
+#endif
+}
+
+uint32_t RecordLog_Crc32(uint32_t Crc, const void *Data, size_t Length)
+{
+	const uint8_t *Byte = Data;
+
+	Crc = ~Crc;
+	while (Length--) {
+		Crc ^= *Byte++;
+		Crc = (Crc >> 4) ^ Crc_Table[Crc & 0x0F];
+		Crc = (Crc >> 4) ^ Crc_Table[Crc & 0x0F];
+	}
+	return ~Crc;
+}
+
+void RecordLog_DefaultConfig(RecordLog_Config_t *Config)
+{
+	Config->Buffer_Size = RECORD_LOG_BUFFER_SIZE;
+	Config->Sync_Records = RECORD_LOG_SYNC_RECORDS;
+	Config->Sync_MS = RECORD_LOG_SYNC_MS;
+}
+
+static esp_err_t Write_All(int Fd, const uint8_t *Data, size_t Length)
+{
+	ssize_t Written;
+
+	while (Length) {
+		Written = write(Fd, Data, Length);
+		if (Written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return ESP_FAIL;
+		}
+		Data += Written;
+		Length -= Written;
+	}
+	return ESP_OK;
+}
+
+// Write the buffer at Base, then drop the whole sectors it held. A partial
+// last sector stays so the next write starts on a boundary again; that
+// sector is written twice, which the stats count.
+static esp_err_t Write_Out(RecordLog_t *Log)
+{
+	uint32_t Keep;
+
+	if (!Log->Dirty) {
+		return ESP_OK;
+	}
+	if (lseek(Log->Fd, (off_t)Log->Base, SEEK_SET) < 0 || Write_All(Log->Fd, Log->Buffer, Log->Used) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Log->Stats.Device_Bytes += Log->Used;
+	Log->Stats.Writes++;
+
+	Keep = Log->Used % RECORD_LOG_SECTOR;
+	memmove(Log->Buffer, Log->Buffer + Log->Used - Keep, Keep);
+	Log->Base += Log->Used - Keep;
+	Log->Used = Keep;
+	Log->Dirty = false;
+
+	return ESP_OK;
+}
+
+// Copy into the buffer, writing it out each time it fills
+static esp_err_t Put(RecordLog_t *Log, const uint8_t *Data, size_t Length)
+{
+	size_t Chunk;
+
+	while (Length) {
+		Chunk = Log->Buffer_Size - Log->Used;
+		if (Chunk > Length) {
+			Chunk = Length;
+		}
+		memcpy(Log->Buffer + Log->Used, Data, Chunk);
+		Log->Used += Chunk;
+		Log->Dirty = true;
+		Data += Chunk;
+		Length -= Chunk;
+
+		if (Log->Used == Log->Buffer_Size && Write_Out(Log) != ESP_OK) {
+			return ESP_FAIL;
+		}
+	}
+	return ESP_OK;
+}
+
+esp_err_t RecordLog_Open(RecordLog_t *Log, const char *Path, const RecordLog_Config_t *Config)
+{
+	RecordLog_Config_t Defaults;
+	off_t Size;
+
+	if (Config == NULL) {
+		RecordLog_DefaultConfig(&Defaults);
+		Config = &Defaults;
+	}
+
+	memset(Log, 0, sizeof(*Log));
+	Log->Checkpoint = RECORD_LOG_NO_CHECKPOINT;
+	Log->Buffer_Size = Config->Buffer_Size - Config->Buffer_Size % RECORD_LOG_SECTOR;
+	Log->Sync_Records = Config->Sync_Records;
+	Log->Sync_MS = Config->Sync_MS;
+	if (Log->Buffer_Size == 0) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	Log->Buffer = Buffer_Alloc(Log->Buffer_Size);
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	Log->Fd = open(Path, O_RDWR | O_CREAT, 0644);
+	if (Log->Fd < 0) {
+		free(Log->Buffer);
+		Log->Buffer = NULL;
+		return ESP_FAIL;
+	}
+
+	// Pick up the partial last sector so appends rewrite it in place
+	Size = lseek(Log->Fd, 0, SEEK_END);
+	if (Size < 0) {
+		RecordLog_Close(Log);
+		return ESP_FAIL;
+	}
+	Log->Base = Size - Size % RECORD_LOG_SECTOR;
+	Log->Used = Size % RECORD_LOG_SECTOR;
+	if (Log->Used && (lseek(Log->Fd, (off_t)Log->Base, SEEK_SET) < 0
+		|| read(Log->Fd, Log->Buffer, Log->Used) != (ssize_t)Log->Used)) {
+		RecordLog_Close(Log);
+		return ESP_FAIL;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t RecordLog_Append(RecordLog_t *Log, const void *Data, uint16_t Length)
+{
+	return RecordLog_AppendFrame(Log, RECORD_LOG_RECORD, Data, Length);
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+void RecordLog_EncodeHeader(uint8_t *Header, uint8_t Type, const void *Data, uint16_t Length)
+{
+	Header[0] = RECORD_LOG_SYNC_BYTE;
+	Header[1] = Type;
+	Header[2] = Length & 0xFF;
+	Header[3] = Length >> 8;
+	Put_32(&Header[4], RecordLog_Crc32(RecordLog_Crc32(0, &Header[1], 3), Data, Length));
+}
+
+static esp_err_t Put_Frame(RecordLog_t *Log, uint8_t Type, const void *Data, uint16_t Length)
+{
+	uint8_t Header[RECORD_LOG_HEADER_LEN];
+
+	RecordLog_EncodeHeader(Header, Type, Data, Length);
+	if (Put(Log, Header, sizeof(Header)) != ESP_OK || Put(Log, Data, Length) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+esp_err_t RecordLog_AppendFrame(RecordLog_t *Log, uint8_t Type, const void *Data, uint16_t Length)
+{
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Length > RECORD_LOG_MAX_PAYLOAD) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	if (Type == RECORD_LOG_CHECKPOINT) {
+		Log->Checkpoint = (uint32_t)RecordLog_Offset(Log);
+	}
+	if (Put_Frame(Log, Type, Data, Length) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Log->Stats.Records++;
+	Log->Stats.Payload_Bytes += Length;
+
+	if (Log->Pending++ == 0) {
+		Log->Pending_Since_MS = Now_MS();
+	}
+	if (Log->Sync_Records && Log->Pending >= Log->Sync_Records) {
+		return RecordLog_Sync(Log);
+	}
+	return RecordLog_Poll(Log);
+}
+
+uint64_t RecordLog_Offset(const RecordLog_t *Log)
+{
+	return Log->Base + Log->Used;
+}
+
+esp_err_t RecordLog_Poll(RecordLog_t *Log)
+{
+	if (Log->Pending && Log->Sync_MS && Now_MS() - Log->Pending_Since_MS >= Log->Sync_MS) {
+		return RecordLog_Sync(Log);
+	}
+	return ESP_OK;
+}
+
+esp_err_t RecordLog_Sync(RecordLog_t *Log)
+{
+	uint8_t Commit[RECORD_LOG_COMMIT_LEN];
+
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	// The marker goes down with the frames it commits
+	if (Log->Pending) {
+		Put_32(Commit, (uint32_t)RecordLog_Offset(Log));
+		Put_32(Commit + 4, Log->Checkpoint);
+		if (Put_Frame(Log, RECORD_LOG_COMMIT, Commit, sizeof(Commit)) != ESP_OK) {
+			return ESP_FAIL;
+		}
+	}
+	if (Write_Out(Log) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	if (Log->Pending == 0) {
+		return ESP_OK;
+	}
+	if (fsync(Log->Fd) != 0) {
+		return ESP_FAIL;
+	}
+	Log->Pending = 0;
+	Log->Stats.Syncs++;
+
+	return ESP_OK;
+}
+
+esp_err_t RecordLog_Close(RecordLog_t *Log)
+{
+	esp_err_t err = ESP_OK;
+
+	if (Log->Buffer == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Log->Fd >= 0) {
+		err = RecordLog_Sync(Log);
+		if (close(Log->Fd) != 0) {
+			err = ESP_FAIL;
+		}
+	}
+	free(Log->Buffer);
+	Log->Buffer = NULL;
+	Log->Fd = -1;
+
+	return err;
+}
+
+int RecordLog_Decode(const uint8_t *Buffer, size_t Length, RecordLog_Frame_t *Frame)
+{
+	uint32_t Crc;
+	uint16_t Payload;
+
+	if (Length < RECORD_LOG_HEADER_LEN) {
+		return 0;
+	}
+	Payload = Buffer[2] | (Buffer[3] << 8);
+	if (Buffer[0] != RECORD_LOG_SYNC_BYTE || Payload > RECORD_LOG_MAX_PAYLOAD) {
+		return -1;
+	}
+	if (Length < RECORD_LOG_HEADER_LEN + (size_t)Payload) {
+		return 0;
+	}
+
+	Crc = Buffer[4] | (Buffer[5] << 8) | (Buffer[6] << 16) | ((uint32_t)Buffer[7] << 24);
+	if (RecordLog_Crc32(RecordLog_Crc32(0, &Buffer[1], 3), &Buffer[RECORD_LOG_HEADER_LEN], Payload) != Crc) {
+		return -1;
+	}
+
+	Frame->Type = Buffer[1];
+	Frame->Length = Payload;
+	Frame->Payload = &Buffer[RECORD_LOG_HEADER_LEN];
+
+	return RECORD_LOG_HEADER_LEN + Payload;
+}
+
+int64_t RecordLog_FindCommit(int Fd, uint64_t Size, uint8_t *Buffer, size_t Buffer_Size, uint32_t Window, RecordLog_Commit_t *Commit)
+{
+	uint64_t Floor = Size > Window ? Size - Window : 0, Start, End = Size, At;
+	RecordLog_Frame_t Frame;
+
+	if (Buffer_Size <= RECORD_LOG_COMMIT_FRAME) {
+		return -1;
+	}
+
+	// Chunks from the end back, overlapping so a marker across a chunk
+	// boundary is seen whole
+	while (End >= Floor + RECORD_LOG_COMMIT_FRAME) {
+		Start = End - Floor > Buffer_Size ? End - Buffer_Size : Floor;
+		if (lseek(Fd, (off_t)Start, SEEK_SET) < 0 || read(Fd, Buffer, End - Start) != (ssize_t)(End - Start)) {
+			return -1;
+		}
+
+		for (At = End - RECORD_LOG_COMMIT_FRAME + 1; At-- > Start;) {
+			if (Buffer[At - Start] == RECORD_LOG_SYNC_BYTE && Buffer[At - Start + 1] == RECORD_LOG_COMMIT
+				&& RecordLog_Decode(&Buffer[At - Start], End - At, &Frame) == RECORD_LOG_COMMIT_FRAME
+				&& Frame.Length == RECORD_LOG_COMMIT_LEN && Get_32(Frame.Payload) == At) {
+				Commit->Offset = At;
+				Commit->Checkpoint = Get_32(Frame.Payload + 4);
+				return At + RECORD_LOG_COMMIT_FRAME;
+			}
+		}
+
+		if (Start == Floor) {
+			break;
+		}
+		End = Start + RECORD_LOG_COMMIT_FRAME - 1;
+	}
+	return -1;
+}
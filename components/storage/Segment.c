@@ -0,0 +1,956 @@
+/**
+ * @file Segment.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Time partitioned segment files with a sparse time index.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/Segment.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+#define SEGMENT_NAME_LEN 12				// XXXXXXXX.SEG
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static void Put_16(uint8_t *Buffer, uint16_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = Value >> 8;
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint16_t Get_16(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8);
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+// A root too long for the path is an error, never a truncated path that
+// could name some other file
+static esp_err_t Node_Path(char *Path, const char *Root, uint8_t Node)
+{
+	int Length = snprintf(Path, SEGMENT_PATH_LEN, "%s/N%03u", Root, Node);
+
+	return Length < 0 || Length >= SEGMENT_PATH_LEN ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+static esp_err_t Segment_Path(char *Path, const char *Root, uint8_t Node, uint32_t Bucket)
+{
+	int Length = snprintf(Path, SEGMENT_PATH_LEN, "%s/N%03u/%08" PRIX32 ".SEG", Root, Node, Bucket);
+
+	return Length < 0 || Length >= SEGMENT_PATH_LEN ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+static void Stats_Add(RecordLog_Stats_t *Sum, const RecordLog_Stats_t *Stats)
+{
+	Sum->Records += Stats->Records;
+	Sum->Payload_Bytes += Stats->Payload_Bytes;
+	Sum->Device_Bytes += Stats->Device_Bytes;
+	Sum->Writes += Stats->Writes;
+	Sum->Syncs += Stats->Syncs;
+}
+
+static void Index_Reset(Segment_Index_t *Index)
+{
+	memset(Index, 0, sizeof(*Index));
+	Index->Stride = SEGMENT_INDEX_STRIDE;
+}
+
+// Merge neighbouring blocks, halving the index and doubling the stride
+static void Index_Halve(Segment_Index_t *Index)
+{
+	Segment_Block_t *Out, *Second;
+	uint16_t i;
+
+	for (i = 0; i < Index->Count; i += 2) {
+		Out = &Index->Blocks[i / 2];
+		*Out = Index->Blocks[i];
+		if (i + 1 < Index->Count) {
+			Second = &Index->Blocks[i + 1];
+			Out->Count += Second->Count;
+			if (Second->Min_T < Out->Min_T) {
+				Out->Min_T = Second->Min_T;
+			}
+			if (Second->Max_T > Out->Max_T) {
+				Out->Max_T = Second->Max_T;
+			}
+		}
+	}
+	Index->Count = (Index->Count + 1) / 2;
+	Index->Stride *= 2;
+}
+
+static void Index_Add(Segment_Index_t *Index, uint32_t Offset, uint32_t Timestamp)
+{
+	Segment_Block_t *Block;
+
+	if (Index->Count == 0 || Index->Blocks[Index->Count - 1].Count >= Index->Stride) {
+		if (Index->Count == SEGMENT_MAX_INDEX) {
+			Index_Halve(Index);
+		}
+		Block = &Index->Blocks[Index->Count++];
+		Block->Offset = Offset;
+		Block->Min_T = Timestamp;
+		Block->Max_T = Timestamp;
+		Block->Count = 0;
+	}
+
+	// Records arrive late, so blocks keep a range rather than a start
+	Block = &Index->Blocks[Index->Count - 1];
+	if (Timestamp < Block->Min_T) {
+		Block->Min_T = Timestamp;
+	}
+	if (Timestamp > Block->Max_T) {
+		Block->Max_T = Timestamp;
+	}
+	Block->Count++;
+
+	if (Index->Records == 0 || Timestamp < Index->Min_T) {
+		Index->Min_T = Timestamp;
+	}
+	if (Index->Records == 0 || Timestamp > Index->Max_T) {
+		Index->Max_T = Timestamp;
+	}
+	Index->Records++;
+}
+
+static uint16_t Index_Encode(const Segment_Index_t *Index, uint8_t *Buffer)
+{
+	uint8_t *At = Buffer;
+	uint16_t i;
+
+	for (i = 0; i < Index->Count; i++, At += SEGMENT_BLOCK_LEN) {
+		Put_32(At, Index->Blocks[i].Offset);
+		Put_32(At + 4, Index->Blocks[i].Min_T);
+		Put_32(At + 8, Index->Blocks[i].Max_T);
+		Put_32(At + 12, Index->Blocks[i].Count);
+	}
+	Put_32(At, Index->Records);
+	Put_32(At + 4, Index->Min_T);
+	Put_32(At + 8, Index->Max_T);
+	Put_16(At + 12, Index->Count);
+	Put_16(At + 14, SEGMENT_VERSION);
+	Put_32(At + 16, SEGMENT_MAGIC);
+
+	return At + SEGMENT_TRAILER_LEN - Buffer;
+}
+
+static bool Index_Decode(const uint8_t *Payload, uint16_t Length, Segment_Index_t *Index)
+{
+	const uint8_t *Trailer = Payload + Length - SEGMENT_TRAILER_LEN, *At;
+	uint16_t Blocks, i;
+
+	if (Length < SEGMENT_TRAILER_LEN || Get_32(Trailer + 16) != SEGMENT_MAGIC
+		|| Get_16(Trailer + 14) != SEGMENT_VERSION) {
+		return false;
+	}
+	Blocks = Get_16(Trailer + 12);
+	if (Blocks > SEGMENT_MAX_INDEX || Length != Blocks * SEGMENT_BLOCK_LEN + SEGMENT_TRAILER_LEN) {
+		return false;
+	}
+
+	Index_Reset(Index);
+	for (i = 0, At = Payload; i < Blocks; i++, At += SEGMENT_BLOCK_LEN) {
+		Index->Blocks[i].Offset = Get_32(At);
+		Index->Blocks[i].Min_T = Get_32(At + 4);
+		Index->Blocks[i].Max_T = Get_32(At + 8);
+		Index->Blocks[i].Count = Get_32(At + 12);
+	}
+	Index->Count = Blocks;
+	Index->Records = Get_32(Trailer);
+	Index->Min_T = Get_32(Trailer + 4);
+	Index->Max_T = Get_32(Trailer + 8);
+	// Every block but the last is full
+	if (Index->Count > 1 && Index->Blocks[0].Count > Index->Stride) {
+		Index->Stride = Index->Blocks[0].Count;
+	}
+	return true;
+}
+
+// Load the footer of a sealed segment into Index. Returns the footer's file
+// offset, i.e. where the records end, or -1 if the file does not end in one.
+static int64_t Footer_Read(int Fd, uint64_t Size, uint8_t *Buffer, Segment_Index_t *Index)
+{
+	RecordLog_Frame_t Frame;
+	uint32_t Length;
+
+	// Closing the log after the footer adds a commit marker
+	if (Size >= RECORD_LOG_COMMIT_FRAME && lseek(Fd, (off_t)(Size - RECORD_LOG_COMMIT_FRAME), SEEK_SET) >= 0
+		&& read(Fd, Buffer, RECORD_LOG_COMMIT_FRAME) == RECORD_LOG_COMMIT_FRAME
+		&& RecordLog_Decode(Buffer, RECORD_LOG_COMMIT_FRAME, &Frame) == RECORD_LOG_COMMIT_FRAME
+		&& Frame.Type == RECORD_LOG_COMMIT) {
+		Size -= RECORD_LOG_COMMIT_FRAME;
+	}
+
+	if (Size < RECORD_LOG_HEADER_LEN + SEGMENT_TRAILER_LEN
+		|| lseek(Fd, (off_t)(Size - 8), SEEK_SET) < 0 || read(Fd, Buffer, 8) != 8
+		|| Get_32(Buffer + 4) != SEGMENT_MAGIC || Get_16(Buffer + 2) != SEGMENT_VERSION) {
+		return -1;
+	}
+	Length = RECORD_LOG_HEADER_LEN + Get_16(Buffer) * SEGMENT_BLOCK_LEN + SEGMENT_TRAILER_LEN;
+	if (Length > Size || Length > RECORD_LOG_HEADER_LEN + SEGMENT_MAX_INDEX * SEGMENT_BLOCK_LEN + SEGMENT_TRAILER_LEN) {
+		return -1;
+	}
+
+	if (lseek(Fd, (off_t)(Size - Length), SEEK_SET) < 0 || read(Fd, Buffer, Length) != (ssize_t)Length
+		|| RecordLog_Decode(Buffer, Length, &Frame) != (int)Length || Frame.Type != RECORD_LOG_INDEX
+		|| !Index_Decode(Frame.Payload, Frame.Length, Index)) {
+		return -1;
+	}
+	return Size - Length;
+}
+
+// Add the records from Start on to Index, noting checkpoint frames. Returns
+// where the last whole frame ends; anything after that is a torn write.
+static uint64_t Segment_Scan(int Fd, uint64_t Start, uint8_t *Buffer, Segment_Index_t *Index, uint32_t *Checkpoint, uint64_t *Scanned)
+{
+	RecordLog_Frame_t Frame;
+	uint64_t Base = Start;
+	size_t Have = 0, At = 0;
+	ssize_t Got;
+	int Length;
+
+	if (lseek(Fd, (off_t)Start, SEEK_SET) < 0) {
+		return Start;
+	}
+	while (1) {
+		Length = RecordLog_Decode(Buffer + At, Have - At, &Frame);
+		if (Length > 0) {
+			if (Frame.Type == RECORD_LOG_RECORD && Frame.Length >= SEGMENT_RECORD_HEADER_LEN) {
+				Index_Add(Index, (uint32_t)(Base + At), Get_32(Frame.Payload));
+			} else if (Frame.Type == RECORD_LOG_CHECKPOINT) {
+				*Checkpoint = (uint32_t)(Base + At);
+			}
+			At += Length;
+			continue;
+		}
+		if (Length < 0) {
+			break;
+		}
+
+		memmove(Buffer, Buffer + At, Have - At);
+		Base += At;
+		Have -= At;
+		At = 0;
+		Got = read(Fd, Buffer + Have, SEGMENT_READ_BUFFER - Have);
+		if (Got <= 0) {
+			break;
+		}
+		Have += Got;
+		*Scanned += Got;
+	}
+	return Base + At;
+}
+
+// Rebuild the index of a segment that was never sealed: the last commit
+// marker names the last checkpoint, which holds the index up to itself, and
+// only the frames after it are scanned. Returns where the valid frames end.
+static uint64_t Segment_Recover(SegmentStore_t *Store, int Fd, uint64_t Size, Segment_t *Segment)
+{
+	RecordLog_Commit_t Commit;
+	RecordLog_Frame_t Frame;
+	uint64_t Start = 0, End;
+	uint32_t Span;
+	int Length;
+
+	Index_Reset(&Segment->Index);
+	Segment->Checkpoint = RECORD_LOG_NO_CHECKPOINT;
+
+	if (RecordLog_FindCommit(Fd, Size, Store->Scratch, SEGMENT_READ_BUFFER, SEGMENT_RECOVERY_WINDOW, &Commit) < 0) {
+		Store->Recovery.Full_Scans++;
+	} else if (Commit.Checkpoint != RECORD_LOG_NO_CHECKPOINT && Commit.Checkpoint < Commit.Offset) {
+		Span = Commit.Offset - Commit.Checkpoint;
+		if (Span > SEGMENT_READ_BUFFER) {
+			Span = SEGMENT_READ_BUFFER;
+		}
+		if (lseek(Fd, Commit.Checkpoint, SEEK_SET) >= 0 && read(Fd, Store->Scratch, Span) == (ssize_t)Span) {
+			Length = RecordLog_Decode(Store->Scratch, Span, &Frame);
+			if (Length > 0 && Frame.Type == RECORD_LOG_CHECKPOINT
+				&& Index_Decode(Frame.Payload, Frame.Length, &Segment->Index)) {
+				Segment->Checkpoint = Commit.Checkpoint;
+				Start = Commit.Checkpoint + Length;
+			}
+		}
+	}
+	if (Start == 0) {
+		Index_Reset(&Segment->Index);
+	}
+
+	End = Segment_Scan(Fd, Start, Store->Scratch, &Segment->Index, &Segment->Checkpoint, &Store->Recovery.Bytes_Scanned);
+
+	Store->Recovery.Segments++;
+	Store->Recovery.Bytes_Cut += Size - End;
+
+	return End;
+}
+
+// Sync and close a segment's file. It stays active, appends reopen it.
+static esp_err_t Log_Close(SegmentStore_t *Store, Segment_t *Segment)
+{
+	RecordLog_t *Log;
+	esp_err_t err;
+
+	if (Segment->Log < 0) {
+		return ESP_OK;
+	}
+	Log = &Store->Logs[Segment->Log];
+	err = RecordLog_Close(Log);
+	Stats_Add(&Store->Closed, &Log->Stats);
+	Store->Owners[Segment->Log] = NULL;
+	Segment->Log = -1;
+
+	return err;
+}
+
+// Give a segment an open file, closing the least recently used one if every
+// log slot is taken
+static esp_err_t Log_Attach(SegmentStore_t *Store, Segment_t *Segment)
+{
+	char Path[SEGMENT_PATH_LEN];
+	esp_err_t err = ESP_OK;
+	int Slot = -1, i;
+
+	if (Segment->Log >= 0) {
+		return ESP_OK;
+	}
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] == NULL) {
+			Slot = i;
+			break;
+		}
+		if (Slot < 0 || Store->Owners[i]->Last_Use < Store->Owners[Slot]->Last_Use) {
+			Slot = i;
+		}
+	}
+	if (Store->Owners[Slot] != NULL && Log_Close(Store, Store->Owners[Slot]) != ESP_OK) {
+		err = ESP_FAIL;
+	}
+
+	if (Segment_Path(Path, Store->Root, Segment->Node, Segment->Bucket) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (RecordLog_Open(&Store->Logs[Slot], Path, &Store->Config) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Store->Logs[Slot].Checkpoint = Segment->Checkpoint;
+	Store->Owners[Slot] = Segment;
+	Segment->Log = Slot;
+
+	return err;
+}
+
+static esp_err_t Segment_Seal(SegmentStore_t *Store, Segment_t *Segment)
+{
+	esp_err_t err;
+	uint16_t Length;
+
+	err = Log_Attach(Store, Segment);
+	if (Segment->Log >= 0) {
+		Length = Index_Encode(&Segment->Index, Store->Scratch);
+		if (RecordLog_AppendFrame(&Store->Logs[Segment->Log], RECORD_LOG_INDEX, Store->Scratch, Length) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+		if (Log_Close(Store, Segment) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+		Store->Sealed++;
+	}
+	Segment->Active = false;
+
+	return err;
+}
+
+// Make a segment active for the node and bucket. The footer of a sealed
+// segment is read back and cut off so appends continue after the records;
+// an unsealed one is recovered and its torn tail cut off.
+static esp_err_t Segment_Load(SegmentStore_t *Store, Segment_t *Segment, uint8_t Node, uint32_t Bucket)
+{
+	char Path[SEGMENT_PATH_LEN];
+	int64_t End;
+	off_t Size;
+	int Fd;
+
+	if (Node_Path(Path, Store->Root, Node) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (mkdir(Path, 0755) != 0 && errno != EEXIST) {
+		return ESP_FAIL;
+	}
+
+	if (Segment_Path(Path, Store->Root, Node, Bucket) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Index_Reset(&Segment->Index);
+	Segment->Checkpoint = RECORD_LOG_NO_CHECKPOINT;
+	Fd = open(Path, O_RDONLY);
+	if (Fd >= 0) {
+		Size = lseek(Fd, 0, SEEK_END);
+		End = Footer_Read(Fd, Size, Store->Scratch, &Segment->Index);
+		if (End < 0) {
+			End = Segment_Recover(Store, Fd, Size, Segment);
+		}
+		close(Fd);
+		if (End != Size && truncate(Path, End) != 0) {
+			return ESP_FAIL;
+		}
+	}
+
+	Segment->Node = Node;
+	Segment->Bucket = Bucket;
+	Segment->Log = -1;
+	Segment->Active = true;
+
+	return ESP_OK;
+}
+
+static esp_err_t Segment_Get(SegmentStore_t *Store, uint8_t Node, uint32_t Bucket, Segment_t **Out)
+{
+	Segment_t *Segment, *Victim = NULL;
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_ACTIVE; i++) {
+		Segment = &Store->Segments[i];
+		if (Segment->Active && Segment->Node == Node && Segment->Bucket == Bucket) {
+			Segment->Last_Use = ++Store->Clock;
+			if (Log_Attach(Store, Segment) != ESP_OK) {
+				return ESP_FAIL;
+			}
+			*Out = Segment;
+			return ESP_OK;
+		}
+	}
+
+	// A node writing to a newer bucket is done with the older ones
+	for (i = 0; i < SEGMENT_MAX_ACTIVE; i++) {
+		Segment = &Store->Segments[i];
+		if (Segment->Active && Segment->Node == Node && Segment->Bucket < Bucket && Segment_Seal(Store, Segment) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+
+	// A free slot, or the least recently used
+	for (i = 0; i < SEGMENT_MAX_ACTIVE; i++) {
+		Segment = &Store->Segments[i];
+		if (!Segment->Active) {
+			Victim = Segment;
+			break;
+		}
+		if (Victim == NULL || Segment->Last_Use < Victim->Last_Use) {
+			Victim = Segment;
+		}
+	}
+	if (Victim->Active && Segment_Seal(Store, Victim) != ESP_OK) {
+		err = ESP_FAIL;
+	}
+
+	Victim->Last_Use = ++Store->Clock;
+	if (Segment_Load(Store, Victim, Node, Bucket) != ESP_OK || Log_Attach(Store, Victim) != ESP_OK) {
+		Victim->Active = false;
+		return ESP_FAIL;
+	}
+	*Out = Victim;
+
+	return err;
+}
+
+esp_err_t SegmentStore_Open(SegmentStore_t *Store, const char *Root, uint32_t Bucket_S)
+{
+	memset(Store, 0, sizeof(*Store));
+	if (strlen(Root) + sizeof("/N000/00000000.SEG") > SEGMENT_PATH_LEN) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	snprintf(Store->Root, sizeof(Store->Root), "%s", Root);
+	Store->Bucket_S = Bucket_S ? Bucket_S : SEGMENT_BUCKET_S;
+	RecordLog_DefaultConfig(&Store->Config);
+	Store->Config.Buffer_Size = SEGMENT_BUFFER_SIZE;
+	Store->Checkpoint_Bytes = SEGMENT_CHECKPOINT_BYTES;
+
+	if (mkdir(Root, 0755) != 0 && errno != EEXIST) {
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+esp_err_t SegmentStore_Append(SegmentStore_t *Store, uint8_t Node, uint32_t Timestamp, const void *Data, uint16_t Length)
+{
+	Segment_t *Segment = NULL;
+	RecordLog_t *Log;
+	uint64_t Offset;
+	esp_err_t err;
+
+	if (Length > SEGMENT_MAX_DATA) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	// A failed seal of some other segment still lets this record through
+	err = Segment_Get(Store, Node, Timestamp - Timestamp % Store->Bucket_S, &Segment);
+	if (Segment == NULL) {
+		return err;
+	}
+	Log = &Store->Logs[Segment->Log];
+
+	Put_32(Store->Scratch, Timestamp);
+	memcpy(Store->Scratch + SEGMENT_RECORD_HEADER_LEN, Data, Length);
+	Offset = RecordLog_Offset(Log);
+	if (RecordLog_Append(Log, Store->Scratch, SEGMENT_RECORD_HEADER_LEN + Length) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	Index_Add(&Segment->Index, (uint32_t)Offset, Timestamp);
+
+	// Recovery resumes from the newest checkpoint
+	Offset = RecordLog_Offset(Log);
+	if (Offset - (Segment->Checkpoint == RECORD_LOG_NO_CHECKPOINT ? 0 : Segment->Checkpoint) >= Store->Checkpoint_Bytes) {
+		if (RecordLog_AppendFrame(Log, RECORD_LOG_CHECKPOINT, Store->Scratch,
+			Index_Encode(&Segment->Index, Store->Scratch)) != ESP_OK) {
+			return ESP_FAIL;
+		}
+		Segment->Checkpoint = Log->Checkpoint;
+	}
+
+	return err;
+}
+
+esp_err_t SegmentStore_Poll(SegmentStore_t *Store)
+{
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] != NULL && RecordLog_Poll(&Store->Logs[i]) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+	return err;
+}
+
+esp_err_t SegmentStore_Sync(SegmentStore_t *Store)
+{
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] != NULL && RecordLog_Sync(&Store->Logs[i]) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+	return err;
+}
+
+esp_err_t SegmentStore_Close(SegmentStore_t *Store)
+{
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_ACTIVE; i++) {
+		if (Store->Segments[i].Active && Segment_Seal(Store, &Store->Segments[i]) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+	return err;
+}
+
+void SegmentStore_GetStats(const SegmentStore_t *Store, RecordLog_Stats_t *Stats)
+{
+	int i;
+
+	*Stats = Store->Closed;
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] != NULL) {
+			Stats_Add(Stats, &Store->Logs[i].Stats);
+		}
+	}
+}
+
+bool SegmentStore_IsActive(const SegmentStore_t *Store, uint8_t Node, uint32_t Bucket)
+{
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_ACTIVE; i++) {
+		if (Store->Segments[i].Active && Store->Segments[i].Node == Node && Store->Segments[i].Bucket == Bucket) {
+			return true;
+		}
+	}
+	return false;
+}
+
+esp_err_t Segment_FilePath(char *Path, const char *Root, uint8_t Node, uint32_t Bucket)
+{
+	return Segment_Path(Path, Root, Node, Bucket);
+}
+
+int64_t Segment_RecordsEnd(const char *Path, uint8_t *Buffer, Segment_Index_t *Index)
+{
+	int64_t End;
+	off_t Size;
+	int Fd;
+
+	Fd = open(Path, O_RDONLY);
+	if (Fd < 0) {
+		return -1;
+	}
+	Size = lseek(Fd, 0, SEEK_END);
+	End = Size < 0 ? -1 : Footer_Read(Fd, Size, Buffer, Index);
+	close(Fd);
+
+	return End < 0 ? Size : End;
+}
+
+static int Bucket_Compare(const void *A, const void *B)
+{
+	uint32_t First = *(const uint32_t *)A, Second = *(const uint32_t *)B;
+
+	return (First > Second) - (First < Second);
+}
+
+esp_err_t Segment_QueryBegin(Segment_Query_t *Query, const char *Root, uint32_t Bucket_S, uint8_t Node, uint32_t T_Start,
+	uint32_t T_End, uint8_t *Buffer, uint32_t Buffer_Size)
+{
+	char Path[SEGMENT_PATH_LEN], *End;
+	struct dirent *Entry;
+	uint32_t Bucket, Capacity = 0, *Grown;
+	DIR *Dir;
+
+	memset(Query, 0, sizeof(*Query));
+	snprintf(Query->Root, sizeof(Query->Root), "%s", Root);
+	Query->Node = Node;
+	Query->Bucket_S = Bucket_S ? Bucket_S : SEGMENT_BUCKET_S;
+	Query->T_Start = T_Start;
+	Query->T_End = T_End;
+	Query->Fd = -1;
+	Query->Block = -1;
+	Query->Buffer = Buffer;
+	Query->Buffer_Size = Buffer_Size - Buffer_Size % RECORD_LOG_SECTOR;
+	if (Query->Buffer_Size < SEGMENT_MIN_QUERY_BUFFER) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	// Every segment path must fit, Next_File() relies on it
+	if (strlen(Root) + sizeof("/N000/00000000.SEG") > SEGMENT_PATH_LEN) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	// The node's segments whose bucket overlaps the range, oldest first
+	if (Node_Path(Path, Root, Node) != ESP_OK) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Dir = opendir(Path);
+	if (Dir == NULL) {
+		return ESP_OK;
+	}
+	while ((Entry = readdir(Dir)) != NULL) {
+		if (strlen(Entry->d_name) != SEGMENT_NAME_LEN || strcasecmp(Entry->d_name + 8, ".SEG") != 0) {
+			continue;
+		}
+		Bucket = strtoul(Entry->d_name, &End, 16);
+		if (End != Entry->d_name + 8 || (uint64_t)Bucket + Query->Bucket_S <= T_Start || Bucket > T_End) {
+			continue;
+		}
+		if (Query->Bucket_Count == Capacity) {
+			Capacity = Capacity ? Capacity * 2 : 16;
+			Grown = realloc(Query->Buckets, Capacity * sizeof(uint32_t));
+			if (Grown == NULL) {
+				closedir(Dir);
+				Segment_QueryEnd(Query);
+				return ESP_ERR_NO_MEM;
+			}
+			Query->Buckets = Grown;
+		}
+		Query->Buckets[Query->Bucket_Count++] = Bucket;
+	}
+	closedir(Dir);
+
+	if (Query->Bucket_Count) {
+		qsort(Query->Buckets, Query->Bucket_Count, sizeof(uint32_t), Bucket_Compare);
+	}
+	return ESP_OK;
+}
+
+// Hand the collected records to the run's callback. Call it before the
+// buffer they point into is overwritten.
+static bool Batch_Flush(Segment_Query_t *Query)
+{
+	if (Query->Batch_Count == 0) {
+		return true;
+	}
+	Query->Stats.Batches++;
+	if (!Query->Callback(Query->Batch, Query->Batch_Count, Query->Context)) {
+		Query->Stopped = true;
+	}
+	Query->Batch_Count = 0;
+	return !Query->Stopped;
+}
+
+static void Close_File(Segment_Query_t *Query)
+{
+	if (Query->Fd >= 0) {
+		close(Query->Fd);
+		Query->Fd = -1;
+	}
+	Query->Buffer_Length = 0;
+	Query->Block = -1;
+	Query->Block_End = 0;
+	Query->Next = 0;
+}
+
+// Blocks follow each other in the file; the last one runs to the footer
+static uint64_t Block_End(const Segment_Query_t *Query, int32_t Block)
+{
+	return Block + 1 < Query->Index.Count ? Query->Index.Blocks[Block + 1].Offset : Query->Data_End;
+}
+
+// Open the next segment that can hold records in range
+static bool Next_File(Segment_Query_t *Query)
+{
+	char Path[SEGMENT_PATH_LEN];
+	Segment_Block_t *All;
+	int64_t End;
+	off_t Size;
+	int Fd;
+
+	// The footer is read into the buffer the batch points into
+	if (!Batch_Flush(Query)) {
+		return false;
+	}
+	Close_File(Query);
+
+	while (Query->Bucket < Query->Bucket_Count) {
+		Query->Current = Query->Buckets[Query->Bucket++];
+		// Segment_QueryBegin() made sure the root leaves room for the name
+		if (Segment_Path(Path, Query->Root, Query->Node, Query->Current) != ESP_OK) {
+			continue;
+		}
+		Fd = open(Path, O_RDONLY);
+		if (Fd < 0) {
+			continue;
+		}
+		Query->Stats.Files++;
+
+		Size = lseek(Fd, 0, SEEK_END);
+		End = Footer_Read(Fd, Size, Query->Buffer, &Query->Index);
+		if (End < 0) {
+			// Still being written or never sealed: read all of it
+			Index_Reset(&Query->Index);
+			All = &Query->Index.Blocks[0];
+			All->Offset = 0;
+			All->Min_T = 0;
+			All->Max_T = UINT32_MAX;
+			All->Count = UINT32_MAX;
+			Query->Index.Count = 1;
+			End = Size;
+		} else if (Query->Index.Max_T < Query->T_Start || Query->Index.Min_T > Query->T_End) {
+			close(Fd);
+			continue;
+		}
+
+		Query->Fd = Fd;
+		Query->Data_End = End;
+		return true;
+	}
+	return false;
+}
+
+// Move to the next index block that overlaps the range
+static bool Next_Block(Segment_Query_t *Query)
+{
+	const Segment_Block_t *Block;
+
+	while (++Query->Block < Query->Index.Count) {
+		Block = &Query->Index.Blocks[Query->Block];
+		if (Block->Max_T >= Query->T_Start && Block->Min_T <= Query->T_End) {
+			if (Block->Offset > Query->Next) {
+				Query->Next = Block->Offset;
+			}
+			Query->Block_End = Block_End(Query, Query->Block);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Decode the frame at Offset. When it is not buffered, refill the buffer
+// with whole sectors starting at the one that holds it. Returns -2 when the
+// run's callback stopped before the refill.
+static int Read_Frame(Segment_Query_t *Query, uint64_t Offset, RecordLog_Frame_t *Frame)
+{
+	uint64_t Start = Offset - Offset % RECORD_LOG_SECTOR;
+	ssize_t Got;
+	int Length;
+
+	if (Offset >= Query->Buffer_Offset && Offset < Query->Buffer_Offset + Query->Buffer_Length) {
+		Length = RecordLog_Decode(Query->Buffer + (Offset - Query->Buffer_Offset),
+			Query->Buffer_Offset + Query->Buffer_Length - Offset, Frame);
+		if (Length != 0) {
+			return Length;
+		}
+	}
+
+	if (!Batch_Flush(Query)) {
+		return -2;
+	}
+	if (lseek(Query->Fd, (off_t)Start, SEEK_SET) < 0) {
+		return -1;
+	}
+	Got = read(Query->Fd, Query->Buffer, Query->Buffer_Size);
+	if (Got <= (ssize_t)(Offset - Start)) {
+		Query->Buffer_Length = 0;
+		return -1;
+	}
+	Query->Buffer_Offset = Start;
+	Query->Buffer_Length = Got;
+	Query->Stats.Seeks++;
+	Query->Stats.Bytes_Read += Got;
+
+	// A frame cut short here is a torn end of file
+	Length = RecordLog_Decode(Query->Buffer + (Offset - Start), Got - (Offset - Start), Frame);
+	return Length > 0 ? Length : -1;
+}
+
+esp_err_t Segment_QueryNext(Segment_Query_t *Query, Segment_Record_t *Record)
+{
+	RecordLog_Frame_t Frame;
+	uint32_t Timestamp;
+	int Length;
+
+	while (1) {
+		if (Query->Fd < 0 || (Query->Next >= Query->Block_End && !Next_Block(Query))) {
+			if (!Next_File(Query)) {
+				return ESP_ERR_NOT_FOUND;
+			}
+			continue;
+		}
+
+		Length = Read_Frame(Query, Query->Next, &Frame);
+		if (Length == -2) {
+			return ESP_ERR_NOT_FOUND;
+		}
+		if (Length < 0) {
+			// Nothing readable past here in this file
+			Query->Block = Query->Index.Count;
+			Query->Block_End = 0;
+			continue;
+		}
+		Query->Next += Length;
+		Query->Stats.Frames++;
+
+		// Commit markers and checkpoints sit between the records
+		if (Frame.Type != RECORD_LOG_RECORD || Frame.Length < SEGMENT_RECORD_HEADER_LEN) {
+			continue;
+		}
+		Timestamp = Get_32(Frame.Payload);
+		if (Timestamp < Query->T_Start || Timestamp > Query->T_End) {
+			continue;
+		}
+
+		Record->Timestamp = Timestamp;
+		Record->Length = Frame.Length - SEGMENT_RECORD_HEADER_LEN;
+		Record->Data = Frame.Payload + SEGMENT_RECORD_HEADER_LEN;
+		return ESP_OK;
+	}
+}
+
+esp_err_t Segment_QueryRun(Segment_Query_t *Query, Segment_Batch_Callback_t Callback, void *Context)
+{
+	Segment_Record_t Record;
+
+	Query->Callback = Callback;
+	Query->Context = Context;
+	Query->Stopped = false;
+	Query->Batch_Count = 0;
+
+	// A refill inside Segment_QueryNext() flushes the batch first
+	while (Segment_QueryNext(Query, &Record) == ESP_OK) {
+		Query->Batch[Query->Batch_Count++] = Record;
+		if (Query->Batch_Count == SEGMENT_BATCH_MAX && !Batch_Flush(Query)) {
+			break;
+		}
+	}
+	if (!Query->Stopped) {
+		Batch_Flush(Query);
+	}
+	Query->Callback = NULL;
+
+	return Query->Stopped ? ESP_ERR_NOT_FINISHED : ESP_OK;
+}
+
+void Segment_QuerySeekTime(Segment_Query_t *Query, uint32_t T)
+{
+	Close_File(Query);
+	Query->T_Start = T;
+	for (Query->Bucket = 0; Query->Bucket < Query->Bucket_Count
+		&& (uint64_t)Query->Buckets[Query->Bucket] + Query->Bucket_S <= T; Query->Bucket++) {
+	}
+}
+
+void Segment_QueryTell(const Segment_Query_t *Query, Segment_Position_t *Position)
+{
+	if (Query->Fd >= 0) {
+		Position->Bucket = Query->Current;
+		Position->Offset = Query->Next;
+	} else {
+		Position->Bucket = Query->Bucket < Query->Bucket_Count ? Query->Buckets[Query->Bucket] : UINT32_MAX;
+		Position->Offset = 0;
+	}
+}
+
+esp_err_t Segment_QuerySeek(Segment_Query_t *Query, const Segment_Position_t *Position)
+{
+	int32_t Block;
+
+	Close_File(Query);
+	for (Query->Bucket = 0; Query->Bucket < Query->Bucket_Count && Query->Buckets[Query->Bucket] < Position->Bucket;
+		Query->Bucket++) {
+	}
+	if (Query->Bucket == Query->Bucket_Count || Query->Buckets[Query->Bucket] != Position->Bucket
+		|| Position->Offset == 0) {
+		return ESP_OK;
+	}
+
+	// Into the block that holds the offset. A segment with nothing in range
+	// is passed over, and the query goes on from the next one.
+	if (!Next_File(Query) || Query->Current != Position->Bucket) {
+		return ESP_OK;
+	}
+	for (Block = 0; Block + 1 < Query->Index.Count && Query->Index.Blocks[Block + 1].Offset <= Position->Offset; Block++) {
+	}
+	Query->Block = Block;
+	Query->Block_End = Block_End(Query, Block);
+	Query->Next = Position->Offset;
+
+	return ESP_OK;
+}
+
+void Segment_QueryEnd(Segment_Query_t *Query)
+{
+	Close_File(Query);
+	free(Query->Buckets);
+	Query->Buckets = NULL;
+	Query->Bucket_Count = 0;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file SeriesCodec.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Gorilla style time series block codec.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <string.h>
+
+#include "../../include/SeriesCodec.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+// Float XOR window not set yet
+#define NO_WINDOW 0xFF
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+static void Put_16(uint8_t *Buffer, uint16_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = Value >> 8;
+}
+
+static void Put_32(uint8_t *Buffer, uint32_t Value)
+{
+	Buffer[0] = Value & 0xFF;
+	Buffer[1] = (Value >> 8) & 0xFF;
+	Buffer[2] = (Value >> 16) & 0xFF;
+	Buffer[3] = Value >> 24;
+}
+
+static uint16_t Get_16(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8);
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+static uint32_t Zigzag(int32_t Value)
+{
+	return ((uint32_t)Value << 1) ^ (uint32_t)(Value >> 31);
+}
+
+static int32_t Unzigzag(uint32_t Value)
+{
+	return (int32_t)(Value >> 1) ^ -(int32_t)(Value & 1);
+}
+
+// Write the low Count bits of Value, most significant first. False if the
+// block is full.
+static bool Put_Bits(Series_Encoder_t *Encoder, uint32_t Value, uint8_t Count)
+{
+	uint8_t *Stream = Encoder->Block + SERIES_HEADER_LEN;
+	uint8_t Free, Take;
+
+	if (Encoder->Bits + Count > (uint32_t)(Encoder->Size - SERIES_HEADER_LEN) * 8) {
+		return false;
+	}
+	while (Count) {
+		Free = 8 - Encoder->Bits % 8;
+		if (Free == 8) {
+			Stream[Encoder->Bits / 8] = 0;
+		}
+		Take = Count < Free ? Count : Free;
+		Stream[Encoder->Bits / 8] |= ((Value >> (Count - Take)) & ((1U << Take) - 1)) << (Free - Take);
+		Encoder->Bits += Take;
+		Count -= Take;
+	}
+	return true;
+}
+
+static bool Get_Bits(Series_Decoder_t *Decoder, uint8_t Count, uint32_t *Value)
+{
+	const uint8_t *Stream = Decoder->Block + SERIES_HEADER_LEN;
+	uint8_t Left, Take;
+
+	if (Decoder->Bits + Count > Decoder->End) {
+		return false;
+	}
+	*Value = 0;
+	while (Count) {
+		Left = 8 - Decoder->Bits % 8;
+		Take = Count < Left ? Count : Left;
+		*Value = (*Value << Take) | ((Stream[Decoder->Bits / 8] >> (Left - Take)) & ((1U << Take) - 1));
+		Decoder->Bits += Take;
+		Count -= Take;
+	}
+	return true;
+}
+
+static int32_t Sign_Extend(uint32_t Value, uint8_t Bits)
+{
+	return (int32_t)(Value << (32 - Bits)) >> (32 - Bits);
+}
+
+// Delta of delta: '0', or a prefix of 1s picking 7, 9, 12 or 32 bits
+static bool Put_Time(Series_Encoder_t *Encoder, int32_t Dod)
+{
+	if (Dod == 0) {
+		return Put_Bits(Encoder, 0, 1);
+	}
+	if (Dod >= -64 && Dod <= 63) {
+		return Put_Bits(Encoder, 0x2, 2) && Put_Bits(Encoder, (uint32_t)Dod & 0x7F, 7);
+	}
+	if (Dod >= -256 && Dod <= 255) {
+		return Put_Bits(Encoder, 0x6, 3) && Put_Bits(Encoder, (uint32_t)Dod & 0x1FF, 9);
+	}
+	if (Dod >= -2048 && Dod <= 2047) {
+		return Put_Bits(Encoder, 0xE, 4) && Put_Bits(Encoder, (uint32_t)Dod & 0xFFF, 12);
+	}
+	return Put_Bits(Encoder, 0xF, 4) && Put_Bits(Encoder, (uint32_t)Dod, 32);
+}
+
+static bool Get_Time(Series_Decoder_t *Decoder, int32_t *Dod)
+{
+	static const uint8_t Widths[] = {7, 9, 12, 32};
+	uint32_t Bit, Value;
+	int Ones = 0;
+
+	while (Ones < 4) {
+		if (!Get_Bits(Decoder, 1, &Bit)) {
+			return false;
+		}
+		if (!Bit) {
+			break;
+		}
+		Ones++;
+	}
+	if (Ones == 0) {
+		*Dod = 0;
+		return true;
+	}
+	if (!Get_Bits(Decoder, Widths[Ones - 1], &Value)) {
+		return false;
+	}
+	*Dod = Ones == 4 ? (int32_t)Value : Sign_Extend(Value, Widths[Ones - 1]);
+	return true;
+}
+
+// Integer delta: '0' for no change, else '1' and the zigzag delta minus one
+// in 4 bit groups, low first, each behind a continue bit
+static bool Put_Int(Series_Encoder_t *Encoder, uint32_t Value, uint32_t Last)
+{
+	uint32_t Zig = Zigzag((int32_t)(Value - Last));
+
+	if (Zig == 0) {
+		return Put_Bits(Encoder, 0, 1);
+	}
+	if (!Put_Bits(Encoder, 1, 1)) {
+		return false;
+	}
+	Zig--;
+	do {
+		if (!Put_Bits(Encoder, ((Zig > 0xF) << 4) | (Zig & 0xF), 5)) {
+			return false;
+		}
+		Zig >>= 4;
+	} while (Zig);
+	return true;
+}
+
+static bool Get_Int(Series_Decoder_t *Decoder, uint32_t *Value)
+{
+	uint32_t Bit, Group, Zig = 0;
+	uint8_t Shift = 0;
+
+	if (!Get_Bits(Decoder, 1, &Bit)) {
+		return false;
+	}
+	if (Bit) {
+		do {
+			if (Shift >= 32 || !Get_Bits(Decoder, 5, &Group)) {
+				return false;
+			}
+			Zig |= (Group & 0xF) << Shift;
+			Shift += 4;
+		} while (Group & 0x10);
+		*Value += (uint32_t)Unzigzag(Zig + 1);
+	}
+	return true;
+}
+
+// Float XOR: '0' for no change, '10' and the bits inside the previous
+// window, or '11', a new window (5 bit leading zeros, 5 bit length - 1) and
+// its bits
+static bool Put_Float(Series_Encoder_t *Encoder, int Column, uint32_t Value)
+{
+	uint32_t Xor = Value ^ Encoder->Last[Column];
+	uint8_t Leading, Trailing, *Prev_Leading = &Encoder->Leading[Column], *Prev_Trailing = &Encoder->Trailing[Column];
+
+	if (Xor == 0) {
+		return Put_Bits(Encoder, 0, 1);
+	}
+	Leading = __builtin_clz(Xor);
+	Trailing = __builtin_ctz(Xor);
+	if (Leading > 31) {
+		Leading = 31;
+	}
+
+	if (*Prev_Leading != NO_WINDOW && Leading >= *Prev_Leading && Trailing >= *Prev_Trailing) {
+		return Put_Bits(Encoder, 0x2, 2)
+			&& Put_Bits(Encoder, Xor >> *Prev_Trailing, 32 - *Prev_Leading - *Prev_Trailing);
+	}
+
+	*Prev_Leading = Leading;
+	*Prev_Trailing = Trailing;
+	return Put_Bits(Encoder, 0x3, 2) && Put_Bits(Encoder, Leading, 5)
+		&& Put_Bits(Encoder, 32 - Leading - Trailing - 1, 5)
+		&& Put_Bits(Encoder, Xor >> Trailing, 32 - Leading - Trailing);
+}
+
+static bool Get_Float(Series_Decoder_t *Decoder, int Column)
+{
+	uint8_t *Leading = &Decoder->Leading[Column], *Trailing = &Decoder->Trailing[Column];
+	uint32_t Bit, Value, Length;
+
+	if (!Get_Bits(Decoder, 1, &Bit)) {
+		return false;
+	}
+	if (!Bit) {
+		return true;
+	}
+	if (!Get_Bits(Decoder, 1, &Bit)) {
+		return false;
+	}
+	if (Bit) {
+		if (!Get_Bits(Decoder, 5, &Value) || !Get_Bits(Decoder, 5, &Length) || Value + Length + 1 > 32) {
+			return false;
+		}
+		*Leading = Value;
+		*Trailing = 32 - Value - Length - 1;
+	} else if (*Leading == NO_WINDOW) {
+		return false;
+	}
+	if (!Get_Bits(Decoder, 32 - *Leading - *Trailing, &Value)) {
+		return false;
+	}
+	Decoder->Last[Column] ^= Value << *Trailing;
+	return true;
+}
+
+esp_err_t Series_EncodeBegin(Series_Encoder_t *Encoder, uint8_t *Block, uint16_t Size, uint8_t Columns, uint16_t Float_Mask)
+{
+	if (Size <= SERIES_HEADER_LEN || Size > SERIES_MAX_BLOCK || Columns == 0 || Columns > SERIES_MAX_COLUMNS) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	memset(Encoder, 0, sizeof(*Encoder));
+	memset(Encoder->Leading, NO_WINDOW, sizeof(Encoder->Leading));
+	Encoder->Block = Block;
+	Encoder->Size = Size;
+	Encoder->Columns = Columns;
+	Encoder->Float_Mask = Float_Mask;
+
+	return ESP_OK;
+}
+
+esp_err_t Series_Append(Series_Encoder_t *Encoder, uint32_t Timestamp, const Series_Value_t *Values)
+{
+	Series_Encoder_t Before;
+	uint32_t Raw;
+	int32_t Delta;
+	bool Fits;
+	int i;
+
+	if (Encoder->Count == UINT16_MAX) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	Before = *Encoder;
+
+	// The first timestamp goes in whole
+	if (Encoder->Count == 0) {
+		Fits = Put_Bits(Encoder, Timestamp, 32);
+		Delta = 0;
+	} else {
+		Delta = (int32_t)(Timestamp - Encoder->Last_T);
+		Fits = Put_Time(Encoder, (int32_t)((uint32_t)Delta - (uint32_t)Encoder->Last_Delta));
+	}
+
+	for (i = 0; i < Encoder->Columns && Fits; i++) {
+		if (Encoder->Float_Mask & (1U << i)) {
+			memcpy(&Raw, &Values[i].Float, sizeof(Raw));
+			Fits = Put_Float(Encoder, i, Raw);
+		} else {
+			Raw = (uint32_t)Values[i].Int;
+			Fits = Put_Int(Encoder, Raw, Encoder->Last[i]);
+		}
+		Encoder->Last[i] = Raw;
+	}
+
+	if (!Fits) {
+		// Clear the bits of the partial sample left in the last byte
+		*Encoder = Before;
+		if (Encoder->Bits % 8) {
+			Encoder->Block[SERIES_HEADER_LEN + Encoder->Bits / 8] &= 0xFF << (8 - Encoder->Bits % 8);
+		}
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	if (Encoder->Count == 0 || Timestamp < Encoder->Min_T) {
+		Encoder->Min_T = Timestamp;
+	}
+	if (Encoder->Count == 0 || Timestamp > Encoder->Max_T) {
+		Encoder->Max_T = Timestamp;
+	}
+	Encoder->Last_T = Timestamp;
+	Encoder->Last_Delta = Delta;
+	Encoder->Count++;
+
+	return ESP_OK;
+}
+
+uint16_t Series_EncodeEnd(Series_Encoder_t *Encoder)
+{
+	uint8_t *Header = Encoder->Block;
+
+	if (Encoder->Count == 0) {
+		return 0;
+	}
+	Header[0] = SERIES_MAGIC;
+	Header[1] = SERIES_VERSION;
+	Header[2] = Encoder->Columns;
+	Header[3] = 0;
+	Put_16(Header + 4, Encoder->Float_Mask);
+	Put_16(Header + 6, Encoder->Count);
+	Put_32(Header + 8, Encoder->Min_T);
+	Put_32(Header + 12, Encoder->Max_T);
+
+	return SERIES_HEADER_LEN + (Encoder->Bits + 7) / 8;
+}
+
+esp_err_t Series_DecodeBegin(Series_Decoder_t *Decoder, const uint8_t *Block, uint16_t Length)
+{
+	if (Length < SERIES_HEADER_LEN || Block[0] != SERIES_MAGIC || Block[1] != SERIES_VERSION
+		|| Block[2] == 0 || Block[2] > SERIES_MAX_COLUMNS) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	memset(Decoder, 0, sizeof(*Decoder));
+	memset(Decoder->Leading, NO_WINDOW, sizeof(Decoder->Leading));
+	Decoder->Block = Block;
+	Decoder->End = (uint32_t)(Length - SERIES_HEADER_LEN) * 8;
+	Decoder->Columns = Block[2];
+	Decoder->Float_Mask = Get_16(Block + 4);
+	Decoder->Count = Get_16(Block + 6);
+	Decoder->Min_T = Get_32(Block + 8);
+	Decoder->Max_T = Get_32(Block + 12);
+
+	return ESP_OK;
+}
+
+esp_err_t Series_Next(Series_Decoder_t *Decoder, uint32_t *Timestamp, Series_Value_t *Values)
+{
+	uint32_t Value;
+	int32_t Dod;
+	int i;
+
+	if (Decoder->Index >= Decoder->Count) {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	if (Decoder->Index == 0) {
+		if (!Get_Bits(Decoder, 32, &Value)) {
+			return ESP_ERR_INVALID_SIZE;
+		}
+		Decoder->Last_T = Value;
+	} else {
+		if (!Get_Time(Decoder, &Dod)) {
+			return ESP_ERR_INVALID_SIZE;
+		}
+		Decoder->Last_Delta = (int32_t)((uint32_t)Decoder->Last_Delta + (uint32_t)Dod);
+		Decoder->Last_T += (uint32_t)Decoder->Last_Delta;
+	}
+
+	for (i = 0; i < Decoder->Columns; i++) {
+		if (Decoder->Float_Mask & (1U << i)) {
+			if (!Get_Float(Decoder, i)) {
+				return ESP_ERR_INVALID_SIZE;
+			}
+			memcpy(&Values[i].Float, &Decoder->Last[i], sizeof(float));
+		} else {
+			if (!Get_Int(Decoder, &Decoder->Last[i])) {
+				return ESP_ERR_INVALID_SIZE;
+			}
+			Values[i].Int = (int32_t)Decoder->Last[i];
+		}
+	}
+
+	*Timestamp = Decoder->Last_T;
+	Decoder->Index++;
+
+	return ESP_OK;
+}
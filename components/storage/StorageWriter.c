@@ -0,0 +1,566 @@
+/**
+ * @file StorageWriter.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background storage writer with ping-pong buffers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/StorageWriter.h"
+#include "../../include/PowerMonitor.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// VARIABLES
+/******************************************************************************/
+/******************************************************************************/
+static const char *TAG = "StorageWriter";
+
+// Entries sit in a buffer as a LE length, the kind, the node, a LE
+// timestamp, then the bytes
+#define ENTRY_HEADER_LEN 8
+#define ENTRY_RECORD 0
+#define ENTRY_SAMPLE 1					// int32 readings, native order
+
+typedef struct {
+	uint8_t *Data;
+	uint32_t Used;
+	int64_t First_US;		// when the first record went in
+} Buffer_t;
+
+typedef struct {
+	Series_Encoder_t Encoder;
+	uint8_t Record[1 + STORAGE_WRITER_SERIES_BLOCK];	// tag, then the block
+	uint8_t Node;
+	uint32_t Bucket;			// segment bucket, blocks never span two
+	int64_t Opened_US;
+	uint32_t Last_Use;
+	bool Open;
+} Series_t;
+
+#ifdef CONFIG_STORAGE_BACKEND_FLASH
+static FlashLog_t Ring;
+static uint8_t Ring_Record[STORAGE_WRITER_FLASH_HEADER
+	+ (1 + STORAGE_WRITER_SERIES_BLOCK > STORAGE_WRITER_MAX_RECORD ? 1 + STORAGE_WRITER_SERIES_BLOCK : STORAGE_WRITER_MAX_RECORD)];
+#else
+static SegmentStore_t Store;
+static Compactor_t Compactor;
+static uint32_t Network_Now;			// newest timestamp written, ages segments for compaction
+static bool Compacting;
+#endif
+
+// Written by the task only
+static Series_t Series[STORAGE_WRITER_SERIES_NODES];
+static uint32_t Series_Clock;
+static TaskHandle_t Task;
+static QueueHandle_t Power_Events;
+static SemaphoreHandle_t Space;			// given each time the task hands a buffer back
+static SemaphoreHandle_t Flushed;		// given each time a requested flush completes
+
+// Guarded by Lock
+static Buffer_t Buffers[2];
+static uint8_t Fill;					// buffer the callers copy into
+static int8_t Full = -1;				// buffer the task is writing, -1 = none
+static uint32_t Flush_Requested;
+static StorageWriter_Stats_t Stats;
+static portMUX_TYPE Lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Written by the task only
+static volatile uint32_t Flush_Done;
+static volatile esp_err_t Flush_Result;
+
+// FUNCTIONS
+/******************************************************************************/
+/******************************************************************************/
+
+// Hand the filling buffer to the task. Call with Lock held, Full < 0.
+static void Swap(void)
+{
+	Full = Fill;
+	Fill ^= 1;
+}
+
+#ifdef CONFIG_STORAGE_BACKEND_FLASH
+// One ring for every node, records carry the node and timestamp
+static esp_err_t Store_Append(uint8_t Node, uint32_t Timestamp, const uint8_t *Data, uint16_t Length)
+{
+	Ring_Record[0] = Node;
+	Ring_Record[1] = Timestamp & 0xFF;
+	Ring_Record[2] = (Timestamp >> 8) & 0xFF;
+	Ring_Record[3] = (Timestamp >> 16) & 0xFF;
+	Ring_Record[4] = Timestamp >> 24;
+	memcpy(&Ring_Record[STORAGE_WRITER_FLASH_HEADER], Data, Length);
+	return FlashLog_Append(&Ring, Ring_Record, STORAGE_WRITER_FLASH_HEADER + Length);
+}
+
+// Background erase only when nothing else is waiting
+static esp_err_t Store_Idle(bool Force)
+{
+	if (Force) {
+		return FlashLog_Sync(&Ring);
+	}
+	if (FlashLog_Poll(&Ring) != ESP_OK) {
+		return ESP_FAIL;
+	}
+	return FlashLog_EraseAhead(&Ring);
+}
+
+static void Store_Stats(void)
+{
+	taskENTER_CRITICAL(&Lock);
+	Stats.Log = Ring.Stats.Log;
+	taskEXIT_CRITICAL(&Lock);
+}
+
+static esp_err_t Store_Open(const char *Root)
+{
+	return FlashLog_Open(&Ring, Root, NULL);
+}
+#else
+static esp_err_t Store_Append(uint8_t Node, uint32_t Timestamp, const uint8_t *Data, uint16_t Length)
+{
+	if (Timestamp > Network_Now) {
+		Network_Now = Timestamp;
+	}
+	return SegmentStore_Append(&Store, Node, Timestamp, Data, Length);
+}
+
+// Compaction gets a slice only when no buffer is waiting to be written. Its
+// failures are counted in its own stats, they lose no new records.
+static esp_err_t Store_Idle(bool Force)
+{
+	bool Waiting;
+
+	if (Force) {
+		return SegmentStore_Sync(&Store);
+	}
+	if (SegmentStore_Poll(&Store) != ESP_OK) {
+		return ESP_FAIL;
+	}
+
+	taskENTER_CRITICAL(&Lock);
+	Waiting = Full >= 0;
+	taskEXIT_CRITICAL(&Lock);
+	if (Compacting && !Waiting) {
+		Compactor_Step(&Compactor, Network_Now, COMPACTOR_SLICE_MS * 1000);
+	}
+	return ESP_OK;
+}
+
+static void Store_Stats(void)
+{
+	RecordLog_Stats_t Log_Stats;
+
+	SegmentStore_GetStats(&Store, &Log_Stats);
+	taskENTER_CRITICAL(&Lock);
+	Stats.Log = Log_Stats;
+	Stats.Segments_Sealed = Store.Sealed;
+	Stats.Compaction = Compactor.Stats;
+	taskEXIT_CRITICAL(&Lock);
+}
+
+static esp_err_t Store_Open(const char *Root)
+{
+	esp_err_t err = SegmentStore_Open(&Store, Root, 0);
+
+	// A job cut short that cannot be rolled back must not be overwritten by
+	// the next one; without compaction the card only fills up sooner
+	Compacting = err == ESP_OK && Compactor_Start(&Compactor, Root, &Store) == ESP_OK;
+	if (err == ESP_OK && !Compacting) {
+		ESP_LOGW(TAG, "Compaction journal not cleared, compaction off");
+	}
+	return err;
+}
+#endif
+
+// Store a node's series block
+static esp_err_t Series_Close(Series_t *Block)
+{
+	esp_err_t err = ESP_OK;
+	uint16_t Length;
+
+	Block->Open = false;
+	Length = Series_EncodeEnd(&Block->Encoder);
+	if (Length == 0) {
+		return ESP_OK;
+	}
+	err = Store_Append(Block->Node, Block->Encoder.Min_T, Block->Record, 1 + Length);
+
+	taskENTER_CRITICAL(&Lock);
+	Stats.Series_Blocks++;
+	Stats.Series_Bytes += Length;
+	taskEXIT_CRITICAL(&Lock);
+
+	return err;
+}
+
+static esp_err_t Series_Add(uint8_t Node, uint32_t Timestamp, const Series_Value_t *Values, uint8_t Count)
+{
+	Series_t *Block = NULL, *Victim = NULL;
+	Series_Encoder_t *Encoder;
+	uint32_t Bucket = Timestamp - Timestamp % SEGMENT_BUCKET_S;
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < STORAGE_WRITER_SERIES_NODES; i++) {
+		if (Series[i].Open && Series[i].Node == Node) {
+			Block = &Series[i];
+			break;
+		}
+		if (Victim == NULL || !Series[i].Open
+			|| (Victim->Open && Series[i].Last_Use < Victim->Last_Use)) {
+			Victim = &Series[i];
+		}
+	}
+
+	// Samples of a block stay within one segment bucket and one span
+	if (Block != NULL) {
+		Encoder = &Block->Encoder;
+		if (Encoder->Columns != Count || Block->Bucket != Bucket
+			|| Timestamp > Encoder->Min_T + STORAGE_WRITER_SERIES_SPAN_S
+			|| (uint64_t)Timestamp + STORAGE_WRITER_SERIES_SPAN_S < Encoder->Max_T) {
+			err = Series_Close(Block);
+		}
+	} else {
+		Block = Victim;
+		if (Block->Open) {
+			err = Series_Close(Block);
+		}
+	}
+	Block->Last_Use = ++Series_Clock;
+
+	for (i = 0; i < 2; i++) {
+		if (!Block->Open) {
+			Block->Record[0] = STORAGE_WRITER_SERIES_TAG;
+			Series_EncodeBegin(&Block->Encoder, &Block->Record[1], STORAGE_WRITER_SERIES_BLOCK, Count, 0);
+			Block->Node = Node;
+			Block->Bucket = Bucket;
+			Block->Opened_US = esp_timer_get_time();
+			Block->Open = true;
+		}
+		if (Series_Append(&Block->Encoder, Timestamp, Values) == ESP_OK) {
+			return err;
+		}
+		// Full, store it and start the next one
+		if (Series_Close(Block) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+	return ESP_FAIL;
+}
+
+// Store blocks that have been open for a whole span, or every block
+static esp_err_t Series_Expire(bool All)
+{
+	int64_t Now = esp_timer_get_time();
+	esp_err_t err = ESP_OK;
+	int i;
+
+	for (i = 0; i < STORAGE_WRITER_SERIES_NODES; i++) {
+		if (Series[i].Open && (All || Now - Series[i].Opened_US >= STORAGE_WRITER_SERIES_SPAN_S * 1000000LL)
+			&& Series_Close(&Series[i]) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+	}
+	return err;
+}
+
+static esp_err_t Write_Entry(const uint8_t *Entry, uint16_t Length)
+{
+	Series_Value_t Values[SERIES_MAX_COLUMNS];
+	uint32_t Timestamp = Entry[4] | (Entry[5] << 8) | (Entry[6] << 16) | ((uint32_t)Entry[7] << 24);
+	uint8_t i;
+
+	if (Entry[2] == ENTRY_RECORD) {
+		return Store_Append(Entry[3], Timestamp, &Entry[ENTRY_HEADER_LEN], Length);
+	}
+
+	for (i = 0; i < Length / sizeof(int32_t); i++) {
+		memcpy(&Values[i].Int, &Entry[ENTRY_HEADER_LEN + i * sizeof(int32_t)], sizeof(int32_t));
+	}
+	return Series_Add(Entry[3], Timestamp, Values, i);
+}
+
+// One pass per node in the buffer, so each node's segment is switched to once
+// per buffer instead of once per record; with more nodes than open segments,
+// interleaved appends would seal and reopen a segment on nearly every record
+static esp_err_t Write_Buffer(const Buffer_t *Buffer)
+{
+	uint32_t Done[256 / 32] = {0};
+	esp_err_t err = ESP_OK;
+	uint32_t At, Start = 0;
+	uint16_t Length;
+	uint8_t Node;
+
+	while (Start + ENTRY_HEADER_LEN <= Buffer->Used) {
+		Node = Buffer->Data[Start + 3];
+		Done[Node / 32] |= 1U << (Node % 32);
+
+		for (At = Start; At + ENTRY_HEADER_LEN <= Buffer->Used; At += ENTRY_HEADER_LEN + Length) {
+			Length = Buffer->Data[At] | (Buffer->Data[At + 1] << 8);
+			if (Buffer->Data[At + 3] == Node && Write_Entry(&Buffer->Data[At], Length) != ESP_OK) {
+				err = ESP_FAIL;
+			}
+		}
+
+		// First entry of a node not written yet
+		while (Start + ENTRY_HEADER_LEN <= Buffer->Used
+			&& (Done[Buffer->Data[Start + 3] / 32] & (1U << (Buffer->Data[Start + 3] % 32)))) {
+			Start += ENTRY_HEADER_LEN + (Buffer->Data[Start] | (Buffer->Data[Start + 1] << 8));
+		}
+	}
+	return err;
+}
+
+static void task_storage(void *pvParameters)
+{
+	Power_Event_t Event;
+	uint32_t Request, Elapsed;
+	int64_t Start;
+	int8_t Index;
+	esp_err_t err;
+	bool Force;
+
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STORAGE_WRITER_POLL_MS));
+
+		// Low battery may end in an emergency sleep, get everything down first
+		Force = false;
+		while (xQueueReceive(Power_Events, &Event, 0) == pdTRUE) {
+			if (Event != POWER_EVENT_RECOVERED) {
+				Force = true;
+				taskENTER_CRITICAL(&Lock);
+				Stats.Power_Flushes++;
+				taskEXIT_CRITICAL(&Lock);
+			}
+		}
+
+		taskENTER_CRITICAL(&Lock);
+		Request = Flush_Requested;
+		taskEXIT_CRITICAL(&Lock);
+		if (Request != Flush_Done) {
+			Force = true;
+		}
+
+		// A full buffer first, then the filling one once it is old enough
+		err = ESP_OK;
+		while (1) {
+			int64_t Now = esp_timer_get_time();
+
+			taskENTER_CRITICAL(&Lock);
+			if (Full < 0 && Buffers[Fill].Used
+				&& (Force || Now - Buffers[Fill].First_US >= STORAGE_WRITER_MAX_AGE_MS * 1000LL)) {
+				Swap();
+			}
+			Index = Full;
+			taskEXIT_CRITICAL(&Lock);
+			if (Index < 0) {
+				break;
+			}
+
+			Start = esp_timer_get_time();
+			if (Write_Buffer(&Buffers[Index]) != ESP_OK) {
+				err = ESP_FAIL;
+			}
+			Elapsed = esp_timer_get_time() - Start;
+
+			taskENTER_CRITICAL(&Lock);
+			Buffers[Index].Used = 0;
+			Full = -1;
+			Stats.Buffers++;
+			if (Elapsed > Stats.Max_Write_US) {
+				Stats.Max_Write_US = Elapsed;
+			}
+			taskEXIT_CRITICAL(&Lock);
+			xSemaphoreGive(Space);
+		}
+
+		if (Series_Expire(Force) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+		if (Store_Idle(Force) != ESP_OK) {
+			err = ESP_FAIL;
+		}
+
+		Store_Stats();
+		taskENTER_CRITICAL(&Lock);
+		if (err != ESP_OK) {
+			Stats.Errors++;
+		}
+		taskEXIT_CRITICAL(&Lock);
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "Segment write failed");
+		}
+
+		if (Request != Flush_Done) {
+			Flush_Result = err;
+			Flush_Done = Request;
+			xSemaphoreGive(Flushed);
+		}
+	}
+}
+
+esp_err_t StorageWriter_Start(const char *Root)
+{
+	esp_err_t err;
+	int i;
+
+	if (Task) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	err = Store_Open(Root);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Cannot use %s", Root);
+		return err;
+	}
+
+	for (i = 0; i < 2; i++) {
+		Buffers[i].Data = malloc(STORAGE_WRITER_BUFFER_SIZE);
+		Buffers[i].Used = 0;
+	}
+	Space = xSemaphoreCreateBinary();
+	Flushed = xSemaphoreCreateBinary();
+	Power_Events = xQueueCreate(STORAGE_WRITER_EVENT_QUEUE_LEN, sizeof(Power_Event_t));
+	if (!Buffers[0].Data || !Buffers[1].Data || !Space || !Flushed || !Power_Events) {
+		ESP_LOGE(TAG, "Out of memory");
+		return ESP_ERR_NO_MEM;
+	}
+
+	if (PowerMonitor_Subscribe(Power_Events) != ESP_OK) {
+		ESP_LOGW(TAG, "No power monitor events, flushing on age only");
+	}
+
+	if (xTaskCreatePinnedToCore(&task_storage, "Storage", STORAGE_WRITER_TASK_STACK, NULL,
+		STORAGE_WRITER_TASK_PRIORITY, &Task, STORAGE_WRITER_CORE) != pdPASS) {
+		Task = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+static esp_err_t Submit_Entry(uint8_t Kind, uint8_t Node, uint32_t Timestamp, const void *Data, uint16_t Length, TickType_t Wait)
+{
+	TickType_t Start = xTaskGetTickCount(), Elapsed;
+	uint32_t Need = ENTRY_HEADER_LEN + Length;
+	bool Stalled = false, Swapped;
+	Buffer_t *Buffer;
+	uint8_t *Entry;
+
+	if (Task == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (Length > STORAGE_WRITER_MAX_RECORD) {
+		taskENTER_CRITICAL(&Lock);
+		Stats.Dropped++;
+		taskEXIT_CRITICAL(&Lock);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	while (1) {
+		Swapped = false;
+
+		taskENTER_CRITICAL(&Lock);
+		Buffer = &Buffers[Fill];
+		if (Buffer->Used + Need > STORAGE_WRITER_BUFFER_SIZE && Full < 0) {
+			Swap();
+			Swapped = true;
+			Buffer = &Buffers[Fill];
+		}
+		if (Buffer->Used + Need <= STORAGE_WRITER_BUFFER_SIZE) {
+			if (Buffer->Used == 0) {
+				Buffer->First_US = esp_timer_get_time();
+			}
+			Entry = &Buffer->Data[Buffer->Used];
+			Entry[0] = Length & 0xFF;
+			Entry[1] = Length >> 8;
+			Entry[2] = Kind;
+			Entry[3] = Node;
+			Entry[4] = Timestamp & 0xFF;
+			Entry[5] = (Timestamp >> 8) & 0xFF;
+			Entry[6] = (Timestamp >> 16) & 0xFF;
+			Entry[7] = Timestamp >> 24;
+			memcpy(&Entry[ENTRY_HEADER_LEN], Data, Length);
+			Buffer->Used += Need;
+			if (Kind == ENTRY_SAMPLE) {
+				Stats.Samples++;
+			} else {
+				Stats.Submitted++;
+			}
+			if (Stalled) {
+				Stats.Stalls++;
+			}
+			taskEXIT_CRITICAL(&Lock);
+
+			if (Swapped) {
+				xTaskNotifyGive(Task);
+			}
+			return ESP_OK;
+		}
+		taskEXIT_CRITICAL(&Lock);
+
+		// Both buffers taken, wait for the task to hand one back
+		Elapsed = xTaskGetTickCount() - Start;
+		if (Elapsed >= Wait || xSemaphoreTake(Space, Wait - Elapsed) != pdTRUE) {
+			taskENTER_CRITICAL(&Lock);
+			Stats.Dropped++;
+			taskEXIT_CRITICAL(&Lock);
+			return ESP_ERR_TIMEOUT;
+		}
+		Stalled = true;
+	}
+}
+
+esp_err_t StorageWriter_Submit(uint8_t Node, uint32_t Timestamp, const void *Data, uint16_t Length, TickType_t Wait)
+{
+	return Submit_Entry(ENTRY_RECORD, Node, Timestamp, Data, Length, Wait);
+}
+
+esp_err_t StorageWriter_SubmitSample(uint8_t Node, uint32_t Timestamp, const int32_t *Values, uint8_t Count, TickType_t Wait)
+{
+	if (Count == 0 || Count > SERIES_MAX_COLUMNS) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	return Submit_Entry(ENTRY_SAMPLE, Node, Timestamp, Values, Count * sizeof(int32_t), Wait);
+}
+
+esp_err_t StorageWriter_Flush(TickType_t Wait)
+{
+	TickType_t Start = xTaskGetTickCount(), Elapsed;
+	uint32_t Request;
+
+	if (Task == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	taskENTER_CRITICAL(&Lock);
+	Request = ++Flush_Requested;
+	taskEXIT_CRITICAL(&Lock);
+	xTaskNotifyGive(Task);
+
+	while ((int32_t)(Flush_Done - Request) < 0) {
+		Elapsed = xTaskGetTickCount() - Start;
+		if (Elapsed >= Wait || xSemaphoreTake(Flushed, Wait - Elapsed) != pdTRUE) {
+			return ESP_ERR_TIMEOUT;
+		}
+	}
+	return Flush_Result;
+}
+
+void StorageWriter_GetStats(StorageWriter_Stats_t *Out)
+{
+	taskENTER_CRITICAL(&Lock);
+	*Out = Stats;
+	taskEXIT_CRITICAL(&Lock);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file Anemometer.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Windowed pulse counting anemometer with WMO style gust and mean.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef ANEMOMETER_H
+#define ANEMOMETER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Pulses are counted over fixed windows of this length
+#define ANEMOMETER_WINDOW_MS 1000
+
+// WMO No. 8: gust is the highest 3 s average, mean wind is a 10 min average
+#define ANEMOMETER_GUST_WINDOWS (3000 / ANEMOMETER_WINDOW_MS)
+#define ANEMOMETER_MEAN_WINDOWS (600000 / ANEMOMETER_WINDOW_MS)
+
+// Pulses shorter than this are treated as contact bounce (PCNT filter caps
+// out around 12 us at 80 MHz APB)
+#define ANEMOMETER_GLITCH_NS 10000
+
+// Counter limit before the accumulating PCNT unit folds into software
+#define ANEMOMETER_PCNT_LIMIT 10000
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// Consistent view of the anemometer, all speeds in km/h
+typedef struct {
+	float Speed;			// last window
+	uint16_t Window_Pulses;	// pulses counted in the last window
+	float Gust;				// highest 3 s average since the last gust reset
+	float Mean;				// average over the last Mean_Windows windows
+	uint16_t Mean_Windows;	// windows in the mean, ANEMOMETER_MEAN_WINDOWS once 10 minutes were sampled
+	uint32_t Total_Pulses;	// pulses since cold boot
+	uint32_t Windows;		// completed windows since cold boot
+	uint32_t Wake_Windows;	// completed windows since Anemometer_Init()
+} Anemometer_Snapshot_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Set up the PCNT unit with its glitch filter and start the window timer.
+ * The mean window, gust and totals are kept in RTC memory, so a deep sleep
+ * wake carries on with them. Windows are only counted while awake.
+ *
+ * @param Gpio anemometer input pin
+ * @return ESP error type
+ */
+esp_err_t Anemometer_Init(int Gpio);
+
+/**
+ * @brief Stop the window timer and release the PCNT unit.
+ */
+void Anemometer_Deinit(void);
+
+/**
+ * @brief Copy the latest published values. Never blocks the writer, retries
+ * only if a window closed during the copy.
+ *
+ * @param Snapshot struct to store values into
+ */
+void Anemometer_GetSnapshot(Anemometer_Snapshot_t *Snapshot);
+
+/**
+ * @brief Start a new gust period. Takes effect at the next window boundary.
+ */
+void Anemometer_ResetGust(void);
+
+#endif // ANEMOMETER_H
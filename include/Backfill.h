@@ -0,0 +1,235 @@
+/**
+ * @file Backfill.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Bulk transfer of the segment store upstream once the uplink is
+ * 			back after an outage. A session streams every node's stored
+ * 			records, series blocks as they are, packed back to back into
+ * 			large fragments; the receiver acknowledges a window of them at
+ * 			a time with a bitmap, and only the fragments it missed are
+ * 			sent again. How far each node's records have been acknowledged
+ * 			is kept on the card, so a session cut by a reboot or another
+ * 			outage resumes there. Radio agnostic: the caller sends the
+ * 			payloads built here in between its live traffic, and hands the
+ * 			acknowledgements back. Plain POSIX like Segment.h, host tools
+ * 			build it too.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef BACKFILL_H
+#define BACKFILL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Segment.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_BACKFILL_FRAGMENT_LEN
+#define BACKFILL_FRAGMENT_LEN CONFIG_BACKFILL_FRAGMENT_LEN
+#define BACKFILL_WINDOW CONFIG_BACKFILL_WINDOW
+#define BACKFILL_ACK_TIMEOUT_MS CONFIG_BACKFILL_ACK_TIMEOUT_MS
+#define BACKFILL_MAX_TIMEOUTS CONFIG_BACKFILL_MAX_TIMEOUTS
+#else
+#define BACKFILL_FRAGMENT_LEN 240		// payload, LoRa frames carry 255 bytes at most
+#define BACKFILL_WINDOW 16				// fragments in flight, at most 32
+#define BACKFILL_ACK_TIMEOUT_MS 5000
+#define BACKFILL_MAX_TIMEOUTS 4			// in a row, then the uplink is taken to be down
+#endif
+
+// Fragment payload: LE session, LE sequence number, flags, then stream bytes
+#define BACKFILL_FRAGMENT_HEADER 5
+#define BACKFILL_FRAGMENT_DATA (BACKFILL_FRAGMENT_LEN - BACKFILL_FRAGMENT_HEADER)
+#define BACKFILL_FLAG_ACK 0x01			// reply with an acknowledgement
+#define BACKFILL_FLAG_END 0x02			// last fragment of the session
+
+// Acknowledgement payload: LE session, LE next sequence number expected
+// (all before it received), LE bitmap of the 32 after it, bit 0 first
+#define BACKFILL_ACK_BYTES 8
+
+// Stream: each record is node, LE timestamp, LE length, then the stored
+// bytes (a series block record starts with SERIES_RECORD_TAG)
+#define BACKFILL_RECORD_HEADER 7
+
+// Nodes whose progress is kept; more nodes than this are left out
+#define BACKFILL_MAX_NODES 64
+
+// Progress is written to the two files in turn, a torn write leaves the
+// other one
+#define BACKFILL_CURSOR_FILE "BFCUR%u.DAT"
+#define BACKFILL_CURSOR_MAGIC 0x55434642		// "BFCU"
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	uint32_t Sessions;			// sessions that sent everything
+	uint32_t Aborted;			// sessions given up after BACKFILL_MAX_TIMEOUTS
+	uint32_t Fragments;			// fragments sent, retransmissions included
+	uint32_t Retransmits;
+	uint32_t Timeouts;
+	uint32_t Acks;
+	uint32_t Records;			// records put into fragments
+	uint64_t Bytes;				// stream bytes put into fragments
+	uint32_t Cursor_Writes;
+	uint32_t Nodes_Skipped;		// no room left in the cursor table
+	uint32_t Errors;
+} Backfill_Stats_t;
+
+// A node's progress: the next record not yet acknowledged
+typedef struct {
+	uint8_t Node;
+	Segment_Position_t Position;
+} Backfill_Cursor_t;
+
+typedef struct {
+	uint8_t State;				// free, waiting to be sent, sent, acknowledged
+	uint8_t Length;				// payload bytes
+	bool Marked;				// a record ends in it
+	Backfill_Cursor_t Mark;		// progress once it and all before it are acknowledged
+	uint8_t Payload[BACKFILL_FRAGMENT_LEN];
+} Backfill_Fragment_t;
+
+// Large (a query and the window), keep it static or on the heap
+typedef struct {
+	char Root[SEGMENT_PATH_LEN];
+	Backfill_Cursor_t Cursors[BACKFILL_MAX_NODES];
+	uint8_t Cursor_Count;
+	uint32_t Generation;		// of the last cursor file written
+
+	// Session
+	bool Active;
+	uint16_t Session;
+	uint32_t Nodes[256 / 32];	// node directories still to send
+	uint16_t Node;				// node being read, 256 = none
+	int16_t Cursor;				// its entry in Cursors
+	Segment_Query_t Query;
+	uint8_t Buffer[SEGMENT_MIN_QUERY_BUFFER];
+
+	// Record being packed: its header, then its bytes in the query's buffer
+	Segment_Record_t Record;
+	uint8_t Head[BACKFILL_RECORD_HEADER];
+	uint32_t Record_Sent;		// bytes of header and data packed
+	bool Record_Pending;
+	Backfill_Cursor_t Record_End;	// position after it
+	bool Marked;
+	Backfill_Cursor_t Mark;		// after the last record packed whole
+	bool Stream_End;
+
+	// Window
+	Backfill_Fragment_t Window[BACKFILL_WINDOW];
+	uint16_t Base;				// oldest fragment not acknowledged
+	uint16_t Next;				// next new sequence number
+	bool Waiting;				// for an acknowledgement
+	uint16_t Asked;				// the fragment that asked for it
+	int64_t Ack_Due_MS;
+	uint8_t Timeouts;
+
+	Backfill_Stats_t Stats;
+} Backfill_t;
+
+/**
+ * @brief Records for the receiver, in store order per node. After a resumed
+ * session a few may come again.
+ */
+typedef void (*Backfill_Record_Callback_t)(uint8_t Node, uint32_t Timestamp, const uint8_t *Data, uint16_t Length,
+	void *Context);
+
+typedef struct {
+	uint32_t Fragments;
+	uint32_t Duplicates;		// fragments already had
+	uint32_t Records;
+	uint32_t Errors;			// records that did not parse
+} Backfill_ReceiverStats_t;
+
+typedef struct {
+	uint16_t Session;
+	bool Started;
+	uint16_t Next;				// next sequence number in order
+	uint32_t Held;				// bit i: fragment Next + i is held
+	uint8_t Fragments[BACKFILL_WINDOW][BACKFILL_FRAGMENT_DATA];
+	uint8_t Lengths[BACKFILL_WINDOW];
+	uint8_t Record[BACKFILL_RECORD_HEADER + SEGMENT_MAX_DATA];
+	uint32_t Record_Used;
+	Backfill_Record_Callback_t Callback;
+	void *Context;
+	Backfill_ReceiverStats_t Stats;
+} Backfill_Receiver_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Set up backfill of a store and load its progress.
+ *
+ * @param Backfill backfill to set up
+ * @param Root store directory, as given to SegmentStore_Open()
+ * @return ESP error type
+ */
+esp_err_t Backfill_Open(Backfill_t *Backfill, const char *Root);
+
+/**
+ * @brief Start a session: every node's records after its progress, up to
+ * what is on the card now.
+ *
+ * @param Backfill open backfill, no session running
+ * @param Session random, tells the receiver a new session started
+ * @return ESP error type
+ */
+esp_err_t Backfill_Begin(Backfill_t *Backfill, uint16_t Session);
+
+/**
+ * @brief Next fragment to send: one the receiver missed, else a new one
+ * while the window has room. Reads the card.
+ *
+ * @param Backfill open backfill
+ * @param Now_MS ms, any monotonic clock
+ * @param Payload BACKFILL_FRAGMENT_LEN bytes
+ * @return uint8_t payload bytes, 0 when nothing is to be sent now: waiting
+ * for an acknowledgement, or no session running
+ */
+uint8_t Backfill_NextFragment(Backfill_t *Backfill, int64_t Now_MS, uint8_t *Payload);
+
+/**
+ * @brief Take an acknowledgement. Progress it confirms is written to the
+ * card; the session ends once everything is acknowledged.
+ *
+ * @param Backfill open backfill
+ * @param Payload acknowledgement
+ * @param Length its bytes
+ */
+void Backfill_Ack(Backfill_t *Backfill, const uint8_t *Payload, uint8_t Length);
+
+/**
+ * @brief Stop the session, keeping the progress acknowledged so far.
+ *
+ * @param Backfill open backfill
+ */
+void Backfill_End(Backfill_t *Backfill);
+
+/**
+ * @brief Set up the receiving end.
+ *
+ * @param Receiver receiver to set up
+ * @param Callback called per record
+ * @param Context passed to it
+ */
+void Backfill_ReceiverInit(Backfill_Receiver_t *Receiver, Backfill_Record_Callback_t Callback, void *Context);
+
+/**
+ * @brief Take a fragment, passing on the records it completes.
+ *
+ * @param Receiver receiver
+ * @param Payload fragment
+ * @param Length its bytes
+ * @param Ack BACKFILL_ACK_BYTES bytes
+ * @return uint8_t acknowledgement bytes to send back, 0 if none is asked for
+ */
+uint8_t Backfill_Receive(Backfill_Receiver_t *Receiver, const uint8_t *Payload, uint8_t Length, uint8_t *Ack);
+
+#endif // BACKFILL_H
@@ -0,0 +1,178 @@
+/**
+ * @file Compactor.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Retention for the segment store. Raw segments older than a few days
+ * 			are rewritten as 1 minute min/mean/max summaries, those as 1 hour
+ * 			summaries once they age too, and hour summaries may finally be
+ * 			deleted. A source segment is deleted only after its summaries
+ * 			are sealed and synced; a journal entry written before each job
+ * 			lets a job cut by a power loss be undone and run again, so no
+ * 			window is ever counted twice. The work is done in steps bounded
+ * 			by a time budget, called from the storage task between writes.
+ * 			Plain POSIX like Segment.h, host tools build it too.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef COMPACTOR_H
+#define COMPACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Segment.h"
+#include "SeriesCodec.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_COMPACTOR_RAW_AGE_DAYS
+#define COMPACTOR_RAW_AGE_S (CONFIG_COMPACTOR_RAW_AGE_DAYS * 86400U)
+#define COMPACTOR_MINUTE_AGE_S (CONFIG_COMPACTOR_MINUTE_AGE_DAYS * 86400U)
+#define COMPACTOR_HOUR_AGE_S (CONFIG_COMPACTOR_HOUR_AGE_DAYS * 86400U)
+#define COMPACTOR_SLICE_MS CONFIG_COMPACTOR_SLICE_MS
+#else
+#define COMPACTOR_RAW_AGE_S (7 * 86400U)		// 0 = keep raw records, no compaction
+#define COMPACTOR_MINUTE_AGE_S (90 * 86400U)	// 0 = keep minute summaries
+#define COMPACTOR_HOUR_AGE_S 0					// 0 = keep hour summaries
+#define COMPACTOR_SLICE_MS 5
+#endif
+
+// Levels: raw records in the store root, then summaries in subdirectories
+#define COMPACTOR_RAW 0
+#define COMPACTOR_MINUTE 1
+#define COMPACTOR_HOUR 2
+#define COMPACTOR_LEVELS 3
+#define COMPACTOR_MINUTE_DIR "M1"
+#define COMPACTOR_HOUR_DIR "H1"
+#define COMPACTOR_MINUTE_S 60
+#define COMPACTOR_HOUR_S 3600
+// Hour summaries are small, a month of them per file
+#define COMPACTOR_HOUR_BUCKET_S (30 * 86400U)
+
+// How often, in network time, the node directories are looked through again
+// once there was nothing to do
+#define COMPACTOR_SWEEP_S 3600
+
+// Journal: magic, level, node, reserved, source bucket, output bucket,
+// output end, CRC-32 of the first 20 bytes, all LE
+#define COMPACTOR_JOURNAL "COMPACT.JNL"
+#define COMPACTOR_JOURNAL_MAGIC 0x4C4E4A43		// "CJNL"
+#define COMPACTOR_JOURNAL_LEN 24
+#define COMPACTOR_NO_OUTPUT UINT32_MAX			// output end: the file did not exist
+
+// Summary record: tag, column count, LE u16 window length (s), LE u32 sample
+// count, then LE int32 min, mean, max for each column. Its timestamp is the
+// window start. Records that are not series blocks are carried into the
+// minute level as they are and dropped at the hour level.
+#define COMPACTOR_SUMMARY_TAG 0xFE
+#define COMPACTOR_SUMMARY_HEADER 8
+#define COMPACTOR_SUMMARY_LEN(Columns) (COMPACTOR_SUMMARY_HEADER + 12 * (Columns))
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	uint32_t Jobs;				// segments compacted or deleted
+	uint32_t Undone;			// jobs rolled back, after a power loss or a late record
+	uint32_t Samples;			// raw samples summarized
+	uint32_t Summaries;			// summary records written
+	uint32_t Carried;			// other records moved to the minute level
+	uint64_t Bytes_Freed;		// source segments deleted
+	uint32_t Steps;
+	uint32_t Max_Step_US;		// longest step, a sync included
+	uint32_t Errors;
+} Compactor_Stats_t;
+
+// One window being summarized
+typedef struct {
+	uint32_t Start;
+	uint8_t Columns;
+	uint32_t Count;				// samples
+	int32_t Min[SERIES_MAX_COLUMNS];
+	int32_t Max[SERIES_MAX_COLUMNS];
+	int64_t Sum[SERIES_MAX_COLUMNS];
+} Compactor_Window_t;
+
+// Large (a segment store and a query), keep it static or on the heap
+typedef struct {
+	char Root[SEGMENT_PATH_LEN];
+	const SegmentStore_t *Live;	// the writer's store, its active segments are left alone
+	uint32_t Age_S[COMPACTOR_LEVELS];	// COMPACTOR_*_AGE_S, host tests lower them
+
+	// Looking for work: one level's node directories at a time
+	uint8_t Level;
+	uint16_t Node;				// next node to look at, 256 = level done
+	uint32_t Nodes[256 / 32];	// node directories present at this level
+	bool Listed;				// Nodes is filled in
+	bool Found;					// this sweep started a job
+	uint32_t Swept_At;			// network time of the last sweep that found nothing
+	bool Swept;
+
+	// The job: one source segment into the next level
+	bool Busy;
+	uint8_t Job_Level;
+	uint8_t Job_Node;
+	uint32_t Job_Bucket;
+	uint64_t Job_Size;			// source size at the start, it must not change
+	uint32_t Out_Bucket;
+	uint32_t Out_End;			// where the output's records ended, COMPACTOR_NO_OUTPUT
+	Compactor_Window_t Window;
+	Segment_Query_t Query;
+	uint8_t Buffer[SEGMENT_MIN_QUERY_BUFFER];
+	Segment_Index_t Index;		// scratch for footers
+	SegmentStore_t Out;
+	uint8_t Record[COMPACTOR_SUMMARY_LEN(SERIES_MAX_COLUMNS)];
+
+	Compactor_Stats_t Stats;
+} Compactor_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Set up compaction of a store. Rolls back a job a power loss cut
+ * short, so it runs again from the start.
+ *
+ * @param Compactor compactor to set up
+ * @param Root store directory, as given to SegmentStore_Open()
+ * @param Live the store being written there, NULL if none
+ * @return ESP error type
+ */
+esp_err_t Compactor_Start(Compactor_t *Compactor, const char *Root, const SegmentStore_t *Live);
+
+/**
+ * @brief Do compaction work for about Budget_US. Each unit of work is one
+ * stored record or one directory, so a step overruns by at most one unit.
+ * Starting a job syncs its journal entry and finishing one seals and syncs
+ * the summaries; a step that does either ends there.
+ *
+ * @param Compactor started compactor
+ * @param Now network time, s; segments are compared against it by age
+ * @param Budget_US time to spend
+ * @return ESP_OK, also when there was nothing to do
+ */
+esp_err_t Compactor_Step(Compactor_t *Compactor, uint32_t Now, uint32_t Budget_US);
+
+/**
+ * @brief Store directory of a level's segments.
+ *
+ * @param Path SEGMENT_PATH_LEN bytes
+ * @param Root store directory
+ * @param Level COMPACTOR_RAW, COMPACTOR_MINUTE or COMPACTOR_HOUR
+ * @return ESP_ERR_INVALID_SIZE if the path does not fit, else ESP_OK
+ */
+esp_err_t Compactor_LevelRoot(char *Path, const char *Root, uint8_t Level);
+
+/**
+ * @brief Segment length of a level.
+ *
+ * @param Level COMPACTOR_RAW, COMPACTOR_MINUTE or COMPACTOR_HOUR
+ * @return uint32_t s
+ */
+uint32_t Compactor_LevelBucket(uint8_t Level);
+
+#endif // COMPACTOR_H
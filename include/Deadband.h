@@ -0,0 +1,75 @@
+/**
+ * @file Deadband.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Report by exception: per channel deadband with a heartbeat, and an
+ * 			EWMA z-score anomaly detector.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// EWMA smoothing factor, ~1 / (effective window length)
+#define DEADBAND_EWMA_ALPHA 0.1f
+
+// Samples before the anomaly detector trusts its mean and variance
+#define DEADBAND_WARMUP 5
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef enum {
+	DEADBAND_SUPPRESS,	// inside the deadband, nothing to report
+	DEADBAND_REPORT,	// outside the deadband, or heartbeat due
+	DEADBAND_ANOMALY,	// sudden change, report right away
+} Deadband_Result_t;
+
+typedef struct {
+	float Absolute;			// report when |change| exceeds this...
+	float Relative;			// ...or this fraction of the last reported value
+	uint32_t Max_Silence_S;	// heartbeat: report at least this often
+	float Z_Threshold;		// anomaly z-score, 0 disables the detector
+	bool Circular;			// value is a bearing in degrees
+} Deadband_Config_t;
+
+typedef struct {
+	float Last_Reported;
+	uint32_t Last_Report_S;
+	float Mean;				// EWMA mean
+	float Variance;			// EWMA variance
+	uint16_t Count;
+} Deadband_Channel_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Clear a channel. Its next sample is always reported.
+ *
+ * @param Channel channel to reset
+ */
+void Deadband_Reset(Deadband_Channel_t *Channel);
+
+/**
+ * @brief Decide whether a new sample needs reporting, and update the channel.
+ * O(1).
+ *
+ * @param Channel channel state
+ * @param Config channel thresholds
+ * @param Value new sample
+ * @param Now_S current time, in seconds
+ * @return Deadband_Result_t decision
+ */
+Deadband_Result_t Deadband_Update(Deadband_Channel_t *Channel, const Deadband_Config_t *Config, float Value, uint32_t Now_S);
+
+#endif // DEADBAND_H
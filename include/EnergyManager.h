@@ -0,0 +1,131 @@
+/**
+ * @file EnergyManager.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Energy budget policy. Maps the remaining battery charge onto a
+ * 			sensing period, batch size, TX power, spreading factor and RX
+ * 			duty cycle, slowing down further when the node would not reach
+ * 			its target lifetime. Plain C, the host simulator builds it too.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef ENERGY_MANAGER_H
+#define ENERGY_MANAGER_H
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_ENERGY_CAPACITY_MAH
+#define ENERGY_CAPACITY_MAH CONFIG_ENERGY_CAPACITY_MAH
+#define ENERGY_TARGET_DAYS CONFIG_ENERGY_TARGET_DAYS
+#define ENERGY_CONSERVE_SOC CONFIG_ENERGY_CONSERVE_SOC
+#define ENERGY_CONSERVE_PERIOD_X100 CONFIG_ENERGY_CONSERVE_PERIOD_X100
+#define ENERGY_SURVIVAL_SOC CONFIG_ENERGY_SURVIVAL_SOC
+#define ENERGY_SURVIVAL_PERIOD_X100 CONFIG_ENERGY_SURVIVAL_PERIOD_X100
+#define ENERGY_MAX_PERIOD_X100 CONFIG_ENERGY_MAX_PERIOD_X100
+#else
+#define ENERGY_CAPACITY_MAH 7000
+#define ENERGY_TARGET_DAYS 365			// 0 = follow the curve only
+#define ENERGY_CONSERVE_SOC 50
+#define ENERGY_CONSERVE_PERIOD_X100 200
+#define ENERGY_SURVIVAL_SOC 20
+#define ENERGY_SURVIVAL_PERIOD_X100 600
+#define ENERGY_MAX_PERIOD_X100 1000
+#endif
+
+// Default consumption model (see Energy_Model_t), rough figures for the
+// sensor node at 22 dBm and SF 12
+#define ENERGY_SLEEP_UA 150
+#define ENERGY_SAMPLE_MAS 30			// one sample only wake
+#define ENERGY_REPORT_MAS 400			// one report of a full batch
+#define ENERGY_LISTEN_MA 50				// awake, radio in RX
+#define ENERGY_LISTEN_S 20				// awake window after a report at 100 % RX duty
+
+#define ENERGY_MAX_POINTS 8
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// What the node should run at. Scales are against the configured settings.
+typedef struct {
+	uint16_t Period_Scale;		// sampling and report period multiplier, x100
+	uint8_t Batch_Percent;		// share of the batch buffer reported
+	int8_t Tx_Power;			// dBm
+	uint8_t Spreading_Factor;	// 0 = keep the configured one
+	uint8_t Rx_Duty;			// percent of the awake window spent listening
+} Energy_Policy_t;
+
+// One knot of the policy curve, settings are interpolated between knots
+typedef struct {
+	uint8_t SoC;				// state of charge, percent
+	Energy_Policy_t Policy;
+} Energy_Point_t;
+
+// Average charge drawn by a node at its nominal settings
+typedef struct {
+	float Sleep_uA;
+	float Sample_mAs;			// one sample only wake
+	float Report_mAs;			// one full batch report at 22 dBm, SF 12
+	float Listen_mA;			// awake, radio in RX
+	float Listen_S;				// awake window after a report at 100 % RX duty
+	uint32_t Sample_Interval_S;	// shortest sensor interval
+	uint32_t Report_Period_S;
+} Energy_Model_t;
+
+typedef struct {
+	float Remaining_mAh;		// from the fuel gauge or coulomb counting
+	float Capacity_mAh;			// full battery
+	uint32_t Remaining_S;		// left until the target lifetime, 0 = no target
+} Energy_Input_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Replace the policy curve. Points are kept by reference.
+ *
+ * @param Points knots in ascending SoC order
+ * @param Count number of knots, at most ENERGY_MAX_POINTS
+ */
+void Energy_SetCurve(const Energy_Point_t *Points, uint8_t Count);
+
+/**
+ * @brief Default consumption model.
+ *
+ * @param Model struct to fill in
+ * @param Sample_Interval_S nominal shortest sensor interval
+ * @param Report_Period_S nominal report period
+ */
+void Energy_DefaultModel(Energy_Model_t *Model, uint32_t Sample_Interval_S, uint32_t Report_Period_S);
+
+/**
+ * @brief Average current a node following Policy draws.
+ *
+ * @param Model consumption at the nominal settings
+ * @param Policy settings to evaluate
+ * @return float mA
+ */
+float Energy_AverageCurrent(const Energy_Model_t *Model, const Energy_Policy_t *Policy);
+
+/**
+ * @brief Settings for the current battery state. The curve gives the
+ * baseline; if the projected draw would empty the battery before the target
+ * lifetime, the period is stretched (up to ENERGY_MAX_PERIOD_X100) until it
+ * does not.
+ *
+ * @param Input battery state
+ * @param Model consumption at the nominal settings
+ * @param Policy struct to store settings into
+ */
+void Energy_Policy(const Energy_Input_t *Input, const Energy_Model_t *Model, Energy_Policy_t *Policy);
+
+#endif // ENERGY_MANAGER_H
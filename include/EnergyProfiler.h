@@ -0,0 +1,96 @@
+/**
+ * @file EnergyProfiler.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Per operation energy profiler. Samples the INA219 power register at
+ * 			a high rate in the background, integrates it, and charges the
+ * 			energy between a Begin/End marker pair to the named operation.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef ENERGY_PROFILER_H
+#define ENERGY_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// One power reading per period, close to the INA219's 12 bit conversion time
+#define PROFILER_SAMPLE_US 1000
+
+#define PROFILER_MAX_OPS 32
+#define PROFILER_NAME_LEN 24
+
+#define PROFILER_TASK_STACK 3072
+#define PROFILER_TASK_PRIORITY 10
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Configure the INA219 for fast continuous conversions and start
+ * integrating its power readings.
+ *
+ * @param Port I2C port number
+ * @param Sda data GPIO
+ * @param Scl clock GPIO
+ * @param Shunt_Ohms shunt resistance
+ * @return ESP error type
+ */
+esp_err_t Profiler_Start(int Port, int Sda, int Scl, float Shunt_Ohms);
+
+/**
+ * @brief Stop sampling. The results stay until Profiler_Reset().
+ */
+void Profiler_Stop(void);
+
+/**
+ * @brief Clear every operation's results.
+ */
+void Profiler_Reset(void);
+
+/**
+ * @brief Open an operation. Only one is open at a time, a second Begin
+ * replaces the first.
+ *
+ * @param Name operation name, copied
+ */
+void Profiler_Begin(const char *Name);
+
+/**
+ * @brief Close the open operation and add its energy and duration to the
+ * operation's results.
+ */
+void Profiler_End(void);
+
+/**
+ * @brief Add a measurement taken some other way, e.g. across a reset.
+ *
+ * @param Name operation name
+ * @param Energy_uJ energy
+ * @param Duration_US duration
+ */
+void Profiler_Record(const char *Name, double Energy_uJ, int64_t Duration_US);
+
+/**
+ * @brief Latest power reading.
+ *
+ * @return float mW
+ */
+float Profiler_Power(void);
+
+/**
+ * @brief Print one line per operation to stdout:
+ * EPROF,<op>,<count>,<mean uJ>,<min uJ>,<max uJ>,<mean us>
+ *
+ * @param Header print the column names first
+ */
+void Profiler_Print(bool Header);
+
+#endif // ENERGY_PROFILER_H
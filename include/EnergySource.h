@@ -0,0 +1,51 @@
+/**
+ * @file EnergySource.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Remaining battery charge for the energy manager, from the power
+ * 			monitor's coulomb counting or from a fuel gauge, picked in
+ * 			menuconfig.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef ENERGY_SOURCE_H
+#define ENERGY_SOURCE_H
+
+#include "esp_err.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Bus voltage of a full battery, the coulomb counter's starting point
+#ifdef CONFIG_ENERGY_FULL_MV
+#define ENERGY_FULL_MV CONFIG_ENERGY_FULL_MV
+#else
+#define ENERGY_FULL_MV 12600
+#endif
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Attach the configured source. With the power monitor source,
+ * PowerMonitor_Start() has to be called as well.
+ *
+ * @param Port I2C port number
+ * @param Sda data GPIO
+ * @param Scl clock GPIO
+ * @return ESP error type
+ */
+esp_err_t EnergySource_Init(int Port, int Sda, int Scl);
+
+/**
+ * @brief Charge left in the battery.
+ *
+ * @param Remaining_mAh charge out
+ * @return ESP_ERR_INVALID_STATE if the source has no reading yet
+ */
+esp_err_t EnergySource_Read(float *Remaining_mAh);
+
+#endif // ENERGY_SOURCE_H
@@ -0,0 +1,105 @@
+/**
+ * @file FixedPoint.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Integer conversions from raw sensor codes straight to the quantized
+ * 			units sent over the air. Every scale factor is a compile time
+ * 			constant, so the node and the sink get bit identical values.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <math.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Wire units per physical unit
+#define FIXED_TEMPERATURE_SCALE 100		// centi degrees C
+#define FIXED_HUMIDITY_SCALE 100		// centi percent RH
+#define FIXED_WIND_SPEED_SCALE 100		// centi km/h
+#define FIXED_DIRECTION_SCALE 10		// tenths of a degree
+
+// Anemometer: 2.4 km/h for one pulse per second (ANEMOMETER_VELOCITY_CONSTANT)
+#define FIXED_WIND_PER_HZ 240
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+// All conversions round to nearest.
+
+/**
+ * @brief SHT3x temperature, datasheet 4.13: T = -45 + 175 * S / (2^16 - 1).
+ *
+ * @param Raw 16 bit temperature word
+ * @return int32_t centi degrees C
+ */
+static inline int32_t Fixed_SHT3X_Temperature(uint16_t Raw)
+{
+	return (int32_t)((175UL * FIXED_TEMPERATURE_SCALE * Raw + 65535 / 2) / 65535) - 45 * FIXED_TEMPERATURE_SCALE;
+}
+
+/**
+ * @brief SHT3x humidity, datasheet 4.13: RH = 100 * S / (2^16 - 1).
+ *
+ * @param Raw 16 bit humidity word
+ * @return int32_t centi percent RH
+ */
+static inline int32_t Fixed_SHT3X_Humidity(uint16_t Raw)
+{
+	return (int32_t)((100UL * FIXED_HUMIDITY_SCALE * Raw + 65535 / 2) / 65535);
+}
+
+/**
+ * @brief Seesaw temperature, a signed 16.16 fixed point value in degrees C.
+ *
+ * @param Raw 32 bit register contents
+ * @return int32_t centi degrees C
+ */
+static inline int32_t Fixed_Seesaw_Temperature(int32_t Raw)
+{
+	return (int32_t)(((int64_t)Raw * FIXED_TEMPERATURE_SCALE + (1L << 15)) >> 16);
+}
+
+/**
+ * @brief Seesaw moisture, the raw capacitance reading is sent as is.
+ *
+ * @param Data big endian 16 bit register contents
+ * @return int32_t capacitance counts
+ */
+static inline int32_t Fixed_Seesaw_Moisture(const uint8_t *Data)
+{
+	return ((uint16_t)Data[0] << 8) | Data[1];
+}
+
+/**
+ * @brief Wind speed from the pulses counted in one window. 64 bit, since
+ * unsigned long is only 32 on the ESP32.
+ *
+ * @param Pulses pulses in the window
+ * @param Window_MS window length
+ * @return int32_t centi km/h
+ */
+static inline int32_t Fixed_WindSpeed(uint32_t Pulses, uint32_t Window_MS)
+{
+	return (int32_t)((Pulses * (FIXED_WIND_PER_HZ * 1000ULL) + Window_MS / 2) / Window_MS);
+}
+
+/**
+ * @brief Wind direction, a bearing that rounds up to 360 wraps to north.
+ *
+ * @param Degrees bearing in [0, 360)
+ * @return int32_t tenths of a degree, [0, 3600)
+ */
+static inline int32_t Fixed_Direction(float Degrees)
+{
+	return lroundf(Degrees * FIXED_DIRECTION_SCALE) % (360 * FIXED_DIRECTION_SCALE);
+}
+
+#endif // FIXED_POINT_H
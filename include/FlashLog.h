@@ -0,0 +1,191 @@
+/**
+ * @file FlashLog.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Record log on a raw flash partition, for cluster heads without an
+ * 			SD card. The partition is a ring of erase sized pages, each
+ * 			starting with a header holding a sequence number; records are
+ * 			the same frames as RecordLog.h and never cross a page. New pages
+ * 			are erased ahead of the writer from the background, dropping
+ * 			the oldest page, so every page is erased once per trip round the
+ * 			ring and wear is even. Mounting reads the page headers and the
+ * 			page being written, nothing else. On host builds the partition
+ * 			is an image file, for the tools in scripts/.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "RecordLog.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_FLASH_LOG_PARTITION
+#define FLASH_LOG_PARTITION CONFIG_FLASH_LOG_PARTITION
+#define FLASH_LOG_ERASE_AHEAD CONFIG_FLASH_LOG_ERASE_AHEAD
+#else
+#define FLASH_LOG_PARTITION "storage"
+#define FLASH_LOG_ERASE_AHEAD 2
+#endif
+
+// SPI flash erase sector
+#define FLASH_LOG_PAGE_SIZE 4096
+
+// Page header: magic, sequence number, reserved (erased), CRC-32 of the
+// first 12 bytes, all LE. 16 bytes keeps frames aligned for flash encryption.
+#define FLASH_LOG_PAGE_HEADER 16
+#define FLASH_LOG_PAGE_MAGIC 0x474F4C46			// "FLOG"
+
+#define FLASH_LOG_MAX_PAYLOAD (FLASH_LOG_PAGE_SIZE - FLASH_LOG_PAGE_HEADER - RECORD_LOG_HEADER_LEN)
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	RecordLog_Stats_t Log;		// Device_Bytes counts bytes programmed
+	uint32_t Erases;
+	uint32_t Foreground_Erases;	// erases an append had to wait for
+	uint32_t Pages_Dropped;		// pages of old records erased
+	uint32_t Torn_Pages;		// pages closed at mount after a cut write
+} FlashLog_Stats_t;
+
+typedef struct {
+#ifdef ESP_PLATFORM
+	const esp_partition_t *Partition;
+#else
+	int Fd;
+#endif
+	uint32_t Pages;
+	uint32_t Head;				// page being written
+	uint32_t Sequence;			// of the head page
+	bool Head_Open;				// head page header is in Buffer
+	uint32_t Erased;			// pages after Head known to be erased
+	uint8_t *Buffer;			// head page image
+	uint32_t Used;				// bytes of it filled, header included
+	uint32_t Written;			// bytes of it programmed
+	uint32_t Sync_Records;
+	uint32_t Sync_MS;
+	uint32_t Pending;
+	int64_t Pending_Since_MS;
+	FlashLog_Stats_t Stats;
+} FlashLog_t;
+
+// Position of a reader, oldest page first
+typedef struct {
+	uint32_t Page;
+	uint32_t Left;				// pages still to visit, this one included
+	uint32_t Sequence;			// of the loaded page, 0 before one is loaded
+	uint32_t Offset;			// next frame in the loaded page
+	uint32_t End;				// bytes of the loaded page that hold frames
+	uint8_t *Buffer;			// caller's, FLASH_LOG_PAGE_SIZE bytes
+} FlashLog_Cursor_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Mount the ring. Finds the newest page from the headers, picks up its
+ * records and continues after them; a page cut by a power loss mid write is
+ * closed and writing resumes on the next one. An empty or foreign partition
+ * starts an empty ring.
+ *
+ * @param Log log to set up
+ * @param Name partition label, or image file path on host builds
+ * @param Config NULL for the defaults; Buffer_Size is not used, the buffer is
+ * one page
+ * @return ESP error type
+ */
+esp_err_t FlashLog_Open(FlashLog_t *Log, const char *Name, const RecordLog_Config_t *Config);
+
+/**
+ * @brief Frame and buffer one record, as RecordLog_Append(). Full pages are
+ * programmed at once.
+ *
+ * @param Log open log
+ * @param Data payload
+ * @param Length payload bytes, at most FLASH_LOG_MAX_PAYLOAD
+ * @return ESP error type
+ */
+esp_err_t FlashLog_Append(FlashLog_t *Log, const void *Data, uint16_t Length);
+
+/**
+ * @brief FlashLog_Append() with a frame type other than RECORD_LOG_RECORD.
+ *
+ * @param Log open log
+ * @param Type RecordLog_Type_t
+ * @param Data payload
+ * @param Length payload bytes
+ * @return ESP error type
+ */
+esp_err_t FlashLog_AppendFrame(FlashLog_t *Log, uint8_t Type, const void *Data, uint16_t Length);
+
+/**
+ * @brief Sync if the oldest unsynced append has reached Sync_MS.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t FlashLog_Poll(FlashLog_t *Log);
+
+/**
+ * @brief Program everything buffered. Durable on return, flash needs no
+ * separate flush.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t FlashLog_Sync(FlashLog_t *Log);
+
+/**
+ * @brief Erase one more page ahead of the writer, if fewer than
+ * FLASH_LOG_ERASE_AHEAD are ready. Call it when idle: an erase takes tens of
+ * ms, and an append that finds no erased page has to wait for one.
+ *
+ * @param Log open log
+ * @return ESP_OK, also when nothing needed erasing
+ */
+esp_err_t FlashLog_EraseAhead(FlashLog_t *Log);
+
+/**
+ * @brief Sync and release the log.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t FlashLog_Close(FlashLog_t *Log);
+
+/**
+ * @brief Start reading at the oldest record still in the ring.
+ *
+ * @param Log open log
+ * @param Cursor reader to set up
+ * @param Buffer FLASH_LOG_PAGE_SIZE bytes, kept until the last read
+ */
+void FlashLog_ReadBegin(const FlashLog_t *Log, FlashLog_Cursor_t *Cursor, uint8_t *Buffer);
+
+/**
+ * @brief Next frame, oldest first. Only sees what has been programmed, sync
+ * first to read everything. Pages the writer recycles while reading are
+ * skipped.
+ *
+ * @param Log open log
+ * @param Cursor started reader
+ * @param Frame decoded frame, Payload points into the cursor's buffer
+ * @return ESP_OK, ESP_ERR_NOT_FOUND after the newest frame, or ESP_FAIL on a
+ * read error
+ */
+esp_err_t FlashLog_ReadNext(const FlashLog_t *Log, FlashLog_Cursor_t *Cursor, RecordLog_Frame_t *Frame);
+
+#endif // FLASH_LOG_H
@@ -9,9 +9,15 @@
  */
 // Common I2C definitions held by driver and sensor library
 
+#ifndef I2C_H
+#define I2C_H
 
 #include "driver/i2c_master.h"
 
+// Transfers go through the bus manager. It owns the bus on I2C_MASTER_NUM and
+// serializes the sensor library and esp-lib drivers.
+#include "I2CBus.h"
+
 
 /*******************************************************************************
  * PUBLIC #DEFINES                                                            *
@@ -43,4 +49,6 @@
 // #define I2C_ACK_CHECK_DIS           (0x00)
 // #define I2C_ACK_CHECK_EN            (0x01)
 #define I2C_ACK_VAL                 (I2C_MASTER_ACK)
-#define I2C_NACK_VAL                (I2C_MASTER_NACK)
\ No newline at end of file
+#define I2C_NACK_VAL                (I2C_MASTER_NACK)
+
+#endif // I2C_H
@@ -0,0 +1,187 @@
+/**
+ * @file I2CBus.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief I2C bus manager. Owns every i2c_master bus and runs all traffic on a
+ * 			port, from the sensor library and from esp-lib's i2cdev, through one
+ * 			transaction queue and worker task.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#define I2CBUS_MAX_PORTS 2
+#define I2CBUS_MAX_DEVICES 8
+
+// Pending transfers per port before I2CBus_Submit() blocks
+#define I2CBUS_QUEUE_DEPTH 16
+
+// Bytes written by one transfer (register pointer + payload). Transfers carry
+// their write bytes inline so async callers never have to keep them alive.
+#define I2CBUS_MAX_WRITE 16
+
+#define I2CBUS_TASK_STACK 3072
+#define I2CBUS_TASK_PRIORITY 6
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct I2CBus_Device *I2CBus_Device_t;
+
+// Completion callback, runs on the port's worker task. It may submit more
+// transfers but must not block on the bus.
+typedef void (*I2CBus_Callback_t)(esp_err_t Result, void *Arg);
+
+// One bus transaction. Write only, read only, or write then read with a
+// repeated start, depending on which lengths are non-zero. Build it once
+// (I2CBus_PrepareRead()...) and resubmit it for hot register reads.
+typedef struct {
+	I2CBus_Device_t Device;
+	uint8_t Write_Data[I2CBUS_MAX_WRITE];
+	uint8_t Write_Length;
+	uint8_t *Read_Data;
+	size_t Read_Length;
+} I2CBus_Transfer_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Create the bus on a port and start its worker task. Opening a port
+ * that is already open on the same pins just takes another reference.
+ *
+ * @param Port I2C port number
+ * @param Sda data GPIO
+ * @param Scl clock GPIO
+ * @return ESP_ERR_INVALID_STATE if the port is open on other pins or still
+ * closing
+ */
+esp_err_t I2CBus_Open(int Port, int Sda, int Scl);
+
+/**
+ * @brief Drop a reference to a port. The last one waits for calls already
+ * queueing on the port, drains the queue, stops the worker and deletes the
+ * bus. Not allowed from a completion callback.
+ *
+ * @param Port I2C port number
+ * @return ESP error type
+ */
+esp_err_t I2CBus_Close(int Port);
+
+/**
+ * @brief Attach a device to an open port. Devices are shared: asking twice for
+ * the same address returns the same handle with another reference.
+ *
+ * @param Port I2C port number
+ * @param Address 7 bit device address
+ * @param Speed_Hz SCL frequency for this device
+ * @param Device handle out
+ * @return ESP error type
+ */
+esp_err_t I2CBus_AddDevice(int Port, uint16_t Address, uint32_t Speed_Hz, I2CBus_Device_t *Device);
+
+/**
+ * @brief Drop a reference to a device, detaching it after the last one.
+ *
+ * @param Device handle from I2CBus_AddDevice()
+ * @return ESP error type
+ */
+esp_err_t I2CBus_RemoveDevice(I2CBus_Device_t Device);
+
+/**
+ * @brief Build a write (and optional repeated start read) transfer.
+ *
+ * @param Transfer transfer to fill in
+ * @param Device target device
+ * @param Data bytes to send, copied into the transfer
+ * @param Length number of bytes, at most I2CBUS_MAX_WRITE
+ * @param Read_Data buffer for the read phase, NULL for none
+ * @param Read_Length number of bytes to read
+ * @return ESP_ERR_INVALID_SIZE if Length does not fit
+ */
+esp_err_t I2CBus_Prepare(I2CBus_Transfer_t *Transfer, I2CBus_Device_t Device, const void *Data, size_t Length, void *Read_Data, size_t Read_Length);
+
+/**
+ * @brief Build a register read: write the register pointer, then read.
+ *
+ * @param Transfer transfer to fill in
+ * @param Device target device
+ * @param Reg register address
+ * @param Data buffer for the register contents
+ * @param Length number of bytes to read
+ */
+void I2CBus_PrepareRead(I2CBus_Transfer_t *Transfer, I2CBus_Device_t Device, uint8_t Reg, void *Data, size_t Length);
+
+/**
+ * @brief Queue a transfer and return. The transfer is copied, only its read
+ * buffer has to stay valid until Callback runs.
+ *
+ * @param Transfer transfer to run
+ * @param Callback called with the result on completion, may be NULL
+ * @param Arg passed to Callback
+ * @return ESP_ERR_INVALID_STATE if the port is not open
+ */
+esp_err_t I2CBus_Submit(const I2CBus_Transfer_t *Transfer, I2CBus_Callback_t Callback, void *Arg);
+
+/**
+ * @brief Queue a transfer and wait for it. Safe to call from a completion
+ * callback, where it runs inline.
+ *
+ * @param Transfer transfer to run
+ * @return ESP error type
+ */
+esp_err_t I2CBus_Execute(const I2CBus_Transfer_t *Transfer);
+
+/**
+ * @brief Blocking write.
+ *
+ * @param Device target device
+ * @param Data bytes to send
+ * @param Length number of bytes
+ * @return ESP error type
+ */
+esp_err_t I2CBus_Write(I2CBus_Device_t Device, const void *Data, size_t Length);
+
+/**
+ * @brief Blocking read.
+ *
+ * @param Device target device
+ * @param Data buffer to store received bytes into
+ * @param Length number of bytes
+ * @return ESP error type
+ */
+esp_err_t I2CBus_Read(I2CBus_Device_t Device, void *Data, size_t Length);
+
+/**
+ * @brief Blocking write then read (repeated start).
+ *
+ * @param Device target device
+ * @param Write_Data bytes to send
+ * @param Write_Length number of bytes to send
+ * @param Read_Data buffer to store received bytes into
+ * @param Read_Length number of bytes to receive
+ * @return ESP error type
+ */
+esp_err_t I2CBus_WriteRead(I2CBus_Device_t Device, const void *Write_Data, size_t Write_Length, void *Read_Data, size_t Read_Length);
+
+/**
+ * @brief Check for an ACK at an address, queued like any other transfer.
+ *
+ * @param Port open I2C port
+ * @param Address 7 bit device address
+ * @return ESP_OK if a device answered
+ */
+esp_err_t I2CBus_Probe(int Port, uint16_t Address);
+
+#endif // I2CBUS_H
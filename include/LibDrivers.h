@@ -0,0 +1,35 @@
+/**
+ * @file LibDrivers.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Sensor registry adapters for esp-lib drivers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef LIB_DRIVERS_H
+#define LIB_DRIVERS_H
+
+#include "SensorRegistry.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// bh1750 one time, high resolution measurement. Datasheet max is 180 ms.
+#define BH1750_CONVERSION_US 180000
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// Enabled through menuconfig, see Sensors_RegisterStatic()
+
+// Values: temperature (C), humidity (%). Encoded as a saturated int16 in
+// centi degrees C and a saturated uint16 in centi percent RH.
+extern const Sensor_Driver_t SHT4X_Driver;
+
+// Values: illuminance (lx). Encoded as one saturated uint16 in lx.
+extern const Sensor_Driver_t BH1750_Driver;
+
+#endif // LIB_DRIVERS_H
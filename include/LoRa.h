@@ -377,8 +377,28 @@
 #define SX126x_TXMODE_SYNC                            0x02
 #define SX126x_TXMODE_BACK2RX                         0x04
 
+// Warm start
+#define LORA_RECALIBRATE_DELTA_C                      10          // die temperature change that forces a recalibration
+#define LORA_TEMPERATURE_UNKNOWN                      INT8_MIN    // always recalibrates
+
+// Everything LoRaBegin() and LoRaConfig() program into the radio
+typedef struct {
+	uint32_t frequencyInHz;
+	int8_t txPowerInDbm;
+	float tcxoVoltage;
+	bool useRegulatorLDO;
+	uint8_t spreadingFactor;
+	uint8_t bandwidth;
+	uint8_t codingRate;
+	uint16_t preambleLength;
+	uint8_t payloadLen;
+	bool crcOn;
+	bool invertIrq;
+} LoRaParams_t;
+
 // Public function
 void     LoRaInit(void);
+int16_t  LoRaWarmBegin(const LoRaParams_t *params, int8_t temperature, bool *warm);
 int16_t  LoRaBegin(uint32_t frequencyInHz, int8_t txPowerInDbm, float tcxoVoltage, bool useRegulatorLDO);
 void     LoRaConfig(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate, uint16_t preambleLength, uint8_t payloadLen, bool crcOn, bool invertIrq);
 uint8_t  LoRaReceive(uint8_t *pData, int16_t len);
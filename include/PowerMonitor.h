@@ -0,0 +1,129 @@
+/**
+ * @file PowerMonitor.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background INA219 power monitor. Samples at a fixed low rate with the
+ * 			chip's hardware averaging, filters voltage, current and power,
+ * 			counts charge, and posts threshold events to subscribers.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef POWER_MONITOR_H
+#define POWER_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_POWER_MONITOR_PERIOD_MS
+#define POWER_MONITOR_PERIOD_MS CONFIG_POWER_MONITOR_PERIOD_MS
+#define POWER_LOW_MV CONFIG_POWER_LOW_MV
+#define POWER_CRITICAL_MV CONFIG_POWER_CRITICAL_MV
+#define POWER_HYSTERESIS_MV CONFIG_POWER_HYSTERESIS_MV
+#define POWER_FILTER_SHIFT CONFIG_POWER_FILTER_SHIFT
+#else
+#define POWER_MONITOR_PERIOD_MS 1000
+#define POWER_LOW_MV 11500
+#define POWER_CRITICAL_MV 11000
+#define POWER_HYSTERESIS_MV 200
+#define POWER_FILTER_SHIFT 3
+#endif
+
+// Queues that can subscribe to events
+#define POWER_MAX_SUBSCRIBERS 4
+
+// Encoded status: bus mV, current mA, power mW, charge mAh, big endian
+#define POWER_STATUS_LEN 8
+
+#define POWER_TASK_STACK 3072
+#define POWER_TASK_PRIORITY 4
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef enum {
+	POWER_LEVEL_NORMAL,
+	POWER_LEVEL_LOW,
+	POWER_LEVEL_CRITICAL,
+} Power_Level_t;
+
+// Posted when the filtered bus voltage changes level
+typedef enum {
+	POWER_EVENT_LOW,			// fell below POWER_LOW_MV
+	POWER_EVENT_CRITICAL,		// fell below POWER_CRITICAL_MV
+	POWER_EVENT_RECOVERED,		// back above POWER_LOW_MV + POWER_HYSTERESIS_MV
+} Power_Event_t;
+
+typedef struct {
+	float Voltage;			// filtered bus voltage, V
+	float Current;			// filtered current, mA, positive = discharging
+	float Power;			// filtered power, mW
+	float Charge;			// net charge drawn since start, mAh
+	Power_Level_t Level;
+	uint32_t Samples;		// 0 until the first reading
+} Power_Status_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Configure the INA219 for averaged, triggered shunt and bus
+ * conversions (it idles between readings) and start the sampling task.
+ * After deep sleep the chip usually still holds its settings; when its
+ * config register reads back what was written before, configure and
+ * calibrate are skipped.
+ *
+ * @param Port I2C port number
+ * @param Sda data GPIO
+ * @param Scl clock GPIO
+ * @param Shunt_Ohms shunt resistance
+ * @return ESP error type
+ */
+esp_err_t PowerMonitor_Start(int Port, int Sda, int Scl, float Shunt_Ohms);
+
+/**
+ * @brief Post every future Power_Event_t to a queue. Events are dropped, not
+ * waited for, when the queue is full.
+ *
+ * @param Queue queue of Power_Event_t
+ * @return ESP_ERR_NO_MEM if every subscriber slot is taken
+ */
+esp_err_t PowerMonitor_Subscribe(QueueHandle_t Queue);
+
+/**
+ * @brief Stop posting events to a queue.
+ *
+ * @param Queue queue passed to PowerMonitor_Subscribe()
+ */
+void PowerMonitor_Unsubscribe(QueueHandle_t Queue);
+
+/**
+ * @brief Snapshot the latest filtered readings.
+ *
+ * @param Status struct to store status into
+ */
+void PowerMonitor_GetStatus(Power_Status_t *Status);
+
+/**
+ * @brief Encode the latest readings as a BATTERY_DATA payload: bus voltage mV
+ * (uint16), current mA (int16), power mW (uint16), net charge mAh (int16),
+ * big endian and saturated.
+ *
+ * @param Buffer output, at least POWER_STATUS_LEN bytes
+ * @return uint8_t bytes written
+ */
+uint8_t PowerMonitor_Encode(uint8_t *Buffer);
+
+#endif // POWER_MONITOR_H
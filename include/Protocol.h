@@ -21,15 +21,19 @@
 #define BYTE_MASK 0xFF
 
 // payload lengths
-#define RAW_SENSOR_DATA_LEN 22
+#define RAW_SENSOR_DATA_LEN 12	// built in sensors only, integer wire units (FixedPoint.h); extra registry drivers append to it
 #define PERIOD_UPDATE_LEN	2
 #define REQUEST_SENSOR_DATA_LEN 0
 #define PROCESSED_SENSOR_DATA_LEN 22 // may not need this...
 #define TIME_UPDATE_LEN 4
-#define BATTERY_DATA_LEN 4
-#define BATTERY_REQ_LEN 1;
-#define DEBUG_LEN 1;
+#define BATTERY_DATA_LEN 8	// bus mV, current mA, power mW, charge mAh (PowerMonitor_Encode)
+#define BATTERY_REQ_LEN 1
+#define DEBUG_LEN 1
 #define TX_ACK_LEN 0
+#define SENSOR_SUMMARY_DATA_LEN 16	// wind speed mean/std/min/max, direction mean/std, gust, count
+#define SENSOR_BATCH_DATA_LEN 0		// variable: [timestamp(4), slot, length, data] records
+#define BACKFILL_DATA_LEN 0			// variable: fragment of stored records (Backfill.h)
+#define BACKFILL_ACK_LEN 8			// session, next fragment expected, bitmap (Backfill.h)
 
 #define RESPONSE_TIMEOUT_MS 3000	// value may need to be adjusted
 #define DATAREQ_DEBOUNCE_MS 10000
@@ -47,7 +51,11 @@ typedef enum {
 	BATTERY_DATA,	// relay
 	BATTERY_REQUEST,	// UNFINISHED: Request for battery data. payload could be node ID
 	DEBUG,			// for testing
-	TX_ACK			// NOTE: could include NOde ID in payload to increase robustness
+	TX_ACK,			// NOTE: could include NOde ID in payload to increase robustness
+	SENSOR_SUMMARY_DATA,	// windowed statistics since the last report
+	SENSOR_BATCH_DATA,		// scheduled samples batched since the last report
+	BACKFILL_DATA,			// stored records going upstream after an outage
+	BACKFILL_ACK,			// which backfill fragments arrived
 } PacketIDs_t;
 
 unsigned char PayloadLength_Lookup[] = {
@@ -58,7 +66,13 @@ unsigned char PayloadLength_Lookup[] = {
 	PROCESSED_SENSOR_DATA_LEN,	// PROCESSED SENSOR DATA
 	TIME_UPDATE_LEN,			// time update
 	BATTERY_DATA_LEN,			// battery data
-	0,							// TX ACK
+	BATTERY_REQ_LEN,			// battery request
+	DEBUG_LEN,					// debug
+	TX_ACK_LEN,					// TX ACK
+	SENSOR_SUMMARY_DATA_LEN,	// sensor summary data
+	SENSOR_BATCH_DATA_LEN,		// sensor batch data
+	BACKFILL_DATA_LEN,			// backfill data
+	BACKFILL_ACK_LEN,			// backfill ack
 };
 
 typedef struct {
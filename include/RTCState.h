@@ -0,0 +1,94 @@
+/**
+ * @file RTCState.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Node state that survives deep sleep. One versioned block kept as two
+ * 			CRC protected copies in RTC memory; a commit always overwrites the
+ * 			older copy, so a reset in the middle of one leaves the previous
+ * 			state intact.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef RTC_STATE_H
+#define RTC_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Scheduler.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Bump whenever RTC_State_t changes layout. A block written by another
+// version is discarded instead of being misread.
+#define RTC_STATE_VERSION 2
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	// Protocol
+	uint8_t Node_ID;
+	uint16_t Period;				// report period, seconds
+
+	// Time sync: network time = local time + offset, corrected for drift
+	int32_t Time_Offset_S;
+	int64_t Last_Sync_US;			// local time of the last sync, 0 = never
+	float Drift_PPM;				// local clock error, positive runs fast
+
+	// Radio settings, the starting point for the next wake's radio bring up
+	int8_t Tx_Power;
+	uint8_t Spreading_Factor;
+	uint8_t Rx_Duty;				// percent of the awake window spent listening
+
+	// Sampling deadlines and the samples waiting for the next report
+	Schedule_State_t Schedule;
+} RTC_State_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Restore the newest valid copy into the working state. Call once,
+ * first thing in app_main(). After a cold boot, or when both copies are
+ * corrupt or from another version, the working state is zeroed instead.
+ *
+ * @return true state restored, false caller has to fill in defaults
+ */
+bool RTCState_Load(void);
+
+/**
+ * @brief Working state. Changes only survive deep sleep once committed.
+ *
+ * @return RTC_State_t* working state
+ */
+RTC_State_t *RTCState_Get(void);
+
+/**
+ * @brief Whether RTCState_Load() found a valid block this boot.
+ *
+ * @return true state restored
+ */
+bool RTCState_Restored(void);
+
+/**
+ * @brief Write the working state over the older RTC copy. Call before deep
+ * sleep and after any change that must not be lost to a crash.
+ */
+void RTCState_Commit(void);
+
+/**
+ * @brief Network time of a local timestamp: the local time plus the offset
+ * from the last time sync, corrected for the drift measured between syncs.
+ * Packet headers and batch records both take their timestamps from here.
+ *
+ * @param Local_US local (system) time in microseconds
+ * @return uint32_t network time in seconds
+ */
+uint32_t RTCState_NetworkTime(int64_t Local_US);
+
+#endif // RTC_STATE_H
@@ -0,0 +1,245 @@
+/**
+ * @file RecordLog.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Append-only binary record log. Keeps the file open, packs framed
+ * 			records into a large sector aligned buffer, writes whole
+ * 			sectors, and groups fsyncs by record count or age. Every fsync
+ * 			is preceded by a commit marker frame, so recovery after a power
+ * 			loss only looks at the end of the file. Plain POSIX file calls,
+ * 			the host tools in scripts/ build it too.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef RECORD_LOG_H
+#define RECORD_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#include "sdkconfig.h"
+#else
+// The few error codes the storage modules return, for host builds
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_INVALID_CRC 0x109
+#define ESP_ERR_NOT_FINISHED 0x10C
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_RECORD_LOG_BUFFER_SIZE
+#define RECORD_LOG_BUFFER_SIZE CONFIG_RECORD_LOG_BUFFER_SIZE
+#define RECORD_LOG_SYNC_RECORDS CONFIG_RECORD_LOG_SYNC_RECORDS
+#define RECORD_LOG_SYNC_MS CONFIG_RECORD_LOG_SYNC_MS
+#else
+#define RECORD_LOG_BUFFER_SIZE 8192
+#define RECORD_LOG_SYNC_RECORDS 64
+#define RECORD_LOG_SYNC_MS 2000
+#endif
+
+// FAT sector. Writes start on a sector boundary and the buffer is a whole
+// number of sectors, so full buffers go to the card without read-modify-write.
+#define RECORD_LOG_SECTOR 512
+
+// Frame: sync byte, type, payload length (LE), CRC-32 (LE) over type, length
+// and payload, then the payload
+#define RECORD_LOG_SYNC_BYTE 0xE5
+#define RECORD_LOG_HEADER_LEN 8
+#define RECORD_LOG_MAX_PAYLOAD 4096
+
+// Commit marker payload: its own file offset, then the offset of the last
+// checkpoint frame (LE). The self offset keeps stale markers left in reused
+// FAT clusters from being taken for this file's.
+#define RECORD_LOG_COMMIT_LEN 8
+#define RECORD_LOG_COMMIT_FRAME (RECORD_LOG_HEADER_LEN + RECORD_LOG_COMMIT_LEN)
+#define RECORD_LOG_NO_CHECKPOINT UINT32_MAX
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef enum {
+	RECORD_LOG_RECORD = 1,			// caller data
+	RECORD_LOG_INDEX,				// segment footer (see Segment.h)
+	RECORD_LOG_COMMIT,				// written by every sync
+	RECORD_LOG_CHECKPOINT,			// caller state to resume recovery from
+} RecordLog_Type_t;
+
+typedef struct {
+	uint32_t Buffer_Size;		// bytes, rounded down to whole sectors
+	uint32_t Sync_Records;		// fsync after this many appends, 0 = off
+	uint32_t Sync_MS;			// or once the oldest unsynced append is this old, 0 = off
+} RecordLog_Config_t;
+
+typedef struct {
+	uint64_t Records;
+	uint64_t Payload_Bytes;		// caller bytes appended
+	uint64_t Device_Bytes;		// bytes handed to write(), sector rewrites included
+	uint32_t Writes;
+	uint32_t Syncs;
+} RecordLog_Stats_t;
+
+typedef struct {
+	int Fd;
+	uint8_t *Buffer;
+	uint32_t Buffer_Size;
+	uint32_t Used;				// bytes in Buffer
+	uint64_t Base;				// file offset of Buffer[0], sector aligned
+	bool Dirty;					// Buffer holds bytes the file does not
+	uint32_t Sync_Records;
+	uint32_t Sync_MS;
+	uint32_t Pending;			// appends since the last fsync
+	int64_t Pending_Since_MS;
+	uint32_t Checkpoint;		// last RECORD_LOG_CHECKPOINT frame, set it after reopening a log that has one
+	RecordLog_Stats_t Stats;
+} RecordLog_t;
+
+// One decoded frame, Payload points into the caller's buffer
+typedef struct {
+	uint8_t Type;
+	uint16_t Length;
+	const uint8_t *Payload;
+} RecordLog_Frame_t;
+
+typedef struct {
+	uint32_t Offset;			// of the marker
+	uint32_t Checkpoint;		// RECORD_LOG_NO_CHECKPOINT if none came before it
+} RecordLog_Commit_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Fill a config with the Kconfig defaults.
+ *
+ * @param Config config to fill
+ */
+void RecordLog_DefaultConfig(RecordLog_Config_t *Config);
+
+/**
+ * @brief Open or create a log. New records go after whatever the file
+ * already holds.
+ *
+ * @param Log log to set up
+ * @param Path file path, e.g. "/sdcard/ch.log"
+ * @param Config NULL for the defaults
+ * @return ESP error type
+ */
+esp_err_t RecordLog_Open(RecordLog_t *Log, const char *Path, const RecordLog_Config_t *Config);
+
+/**
+ * @brief Frame and buffer one record. Writes full buffers, and syncs when
+ * the group commit count or age is reached.
+ *
+ * @param Log open log
+ * @param Data payload
+ * @param Length payload bytes, at most RECORD_LOG_MAX_PAYLOAD
+ * @return ESP error type
+ */
+esp_err_t RecordLog_Append(RecordLog_t *Log, const void *Data, uint16_t Length);
+
+/**
+ * @brief RecordLog_Append() with a frame type other than RECORD_LOG_RECORD.
+ *
+ * @param Log open log
+ * @param Type RecordLog_Type_t
+ * @param Data payload
+ * @param Length payload bytes
+ * @return ESP error type
+ */
+esp_err_t RecordLog_AppendFrame(RecordLog_t *Log, uint8_t Type, const void *Data, uint16_t Length);
+
+/**
+ * @brief File offset the next frame will start at.
+ *
+ * @param Log open log
+ * @return uint64_t offset
+ */
+uint64_t RecordLog_Offset(const RecordLog_t *Log);
+
+/**
+ * @brief Sync if the oldest unsynced append has reached Sync_MS. Call this
+ * when appends stop for a while.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t RecordLog_Poll(RecordLog_t *Log);
+
+/**
+ * @brief Add a commit marker, write the buffer and fsync. Everything
+ * appended so far is durable on return.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t RecordLog_Sync(RecordLog_t *Log);
+
+/**
+ * @brief Sync and close.
+ *
+ * @param Log open log
+ * @return ESP error type
+ */
+esp_err_t RecordLog_Close(RecordLog_t *Log);
+
+/**
+ * @brief Decode the frame at the start of a buffer.
+ *
+ * @param Buffer bytes read back from a log
+ * @param Length bytes available
+ * @param Frame decoded frame
+ * @return frame length, 0 if Buffer holds only part of it, -1 if it is not a
+ * valid frame
+ */
+int RecordLog_Decode(const uint8_t *Buffer, size_t Length, RecordLog_Frame_t *Frame);
+
+/**
+ * @brief Build the header of a frame, for backends that place frames
+ * themselves (FlashLog.h).
+ *
+ * @param Header RECORD_LOG_HEADER_LEN bytes
+ * @param Type RecordLog_Type_t
+ * @param Data payload
+ * @param Length payload bytes
+ */
+void RecordLog_EncodeHeader(uint8_t *Header, uint8_t Type, const void *Data, uint16_t Length);
+
+/**
+ * @brief Find the last commit marker, searching back from the end of a log
+ * file. Reads only the searched window.
+ *
+ * @param Fd log file, read only is enough
+ * @param Size file size
+ * @param Buffer scratch
+ * @param Buffer_Size scratch bytes, more than RECORD_LOG_COMMIT_FRAME
+ * @param Window how far back from the end to look
+ * @param Commit the marker found
+ * @return offset just past the marker, or -1 if there is none in the window
+ */
+int64_t RecordLog_FindCommit(int Fd, uint64_t Size, uint8_t *Buffer, size_t Buffer_Size, uint32_t Window, RecordLog_Commit_t *Commit);
+
+/**
+ * @brief CRC-32 (IEEE, reflected), chainable: pass 0 to start.
+ *
+ * @param Crc running value
+ * @param Data bytes
+ * @param Length byte count
+ * @return uint32_t updated value
+ */
+uint32_t RecordLog_Crc32(uint32_t Crc, const void *Data, size_t Length);
+
+#endif // RECORD_LOG_H
@@ -41,6 +41,12 @@
 #define SHT3X_READ_ERROR            (0xFFFF)
 #define SHT3X_HEX_CODE_SIZE         (0x02)
 
+// Worst case single shot measurement durations (datasheet table 4), in us
+#define SHT3X_DURATION_LOW_US       (4500)
+#define SHT3X_DURATION_MEDIUM_US    (6500)
+#define SHT3X_DURATION_HIGH_US      (15500)
+#define SHT3X_MEASUREMENT_SIZE      (6)
+
 #define CRC8_POLYNOMIAL             (0x31)
 #define CRC8_INIT                   (0xFF)
 
@@ -62,32 +68,39 @@ typedef struct sht3x_sensors_values {
 } sht3x_sensors_values_t;
 #endif
 
+// Single shot command without clock stretching, low repeatability
+extern uint8_t clock_stretching_disabled_repeatability_low[];
+
 uint8_t sht3x_generate_crc(const uint8_t* data, uint16_t count);
 
-esp_err_t sht3x_send_command(uint8_t *command, i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_parse_measurement(const uint8_t *raw, sht3x_sensors_values_t *sensors_values);
+
+esp_err_t sht3x_parse_raw(const uint8_t *raw, uint16_t *temperature, uint16_t *humidity);
+
+esp_err_t sht3x_send_command(uint8_t *command, I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_read(uint8_t *hex_code, uint8_t *measurements, uint8_t , i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_read(uint8_t *hex_code, uint8_t *measurements, uint8_t , I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_write(uint8_t *hex_code, uint8_t *measurements, uint8_t size, i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_write(uint8_t *hex_code, uint8_t *measurements, uint8_t size, I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_send_command_and_fetch_result(uint8_t *command, uint8_t *measurements, uint8_t size, i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_send_command_and_fetch_result(uint8_t *command, uint8_t *measurements, uint8_t size, I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_start_periodic_measurement(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_start_periodic_measurement(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_start_periodic_measurement_with_art(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_start_periodic_measurement_with_art(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_read_measurement(sht3x_sensors_values_t *sensors_values, i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_read_measurement(sht3x_sensors_values_t *sensors_values, I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_stop_periodic_measurement(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_stop_periodic_measurement(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_soft_reset(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_soft_reset(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_general_call_reset(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_general_call_reset(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_enable_heater(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_enable_heater(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_disable_heater(i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_disable_heater(I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_read_status_register(sht3x_sensor_value_t *sensors_value, i2c_master_dev_handle_t Dev_Handle);
+esp_err_t sht3x_read_status_register(sht3x_sensor_value_t *sensors_value, I2CBus_Device_t Dev_Handle);
 
-esp_err_t sht3x_clear_status_register(i2c_master_dev_handle_t Dev_Handle);
\ No newline at end of file
+esp_err_t sht3x_clear_status_register(I2CBus_Device_t Dev_Handle);
\ No newline at end of file
@@ -0,0 +1,72 @@
+/**
+ * @file Sampler.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background high rate sampling of the noisy wind sensors into
+ * 			streaming statistics, summarized at report time.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "Statistics.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#define SAMPLER_RATE_HZ CONFIG_SENSOR_SAMPLE_RATE_HZ
+#define SAMPLER_TASK_STACK 1024 * 3
+#define SAMPLER_TASK_PRIORITY 4
+
+// Encoded summary: wind speed summary, wind direction summary, 3 s gust, sample count
+#define SAMPLER_SUMMARY_LEN (STATS_SUMMARY_LEN + STATS_CIRCULAR_SUMMARY_LEN + 2 + 2)
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	Stats_Summary_t WindSpeed;
+	Stats_CircularSummary_t WindDirection;
+	float WindGust;		// highest 3 s average over the window, km/h
+} Sampler_Summary_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Start the sampling task. Sensors_Init() must have initialized the
+ * windvane and anemometer first. The window is kept in RTC memory, so after a
+ * deep sleep wake it carries on with the samples taken on earlier wakes.
+ *
+ * @return true on success
+ */
+bool Sampler_Start(void);
+
+/**
+ * @brief Stop the sampling task.
+ */
+void Sampler_Stop(void);
+
+/**
+ * @brief Summarize the current window, every sample taken while awake since
+ * the last reset or cold boot.
+ *
+ * @param Summary struct to store summary into
+ * @param Reset start a new window afterwards
+ */
+void Sampler_GetSummary(Sampler_Summary_t *Summary, bool Reset);
+
+/**
+ * @brief Encode a summary for the SENSOR_SUMMARY_DATA payload.
+ *
+ * @param Summary summary to encode
+ * @param Buffer output, at least SAMPLER_SUMMARY_LEN bytes
+ * @return uint8_t bytes written
+ */
+uint8_t Sampler_EncodeSummary(const Sampler_Summary_t *Summary, uint8_t *Buffer);
+
+#endif // SAMPLER_H
@@ -0,0 +1,179 @@
+/**
+ * @file Scheduler.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Multi-rate sampling scheduler. Every sensor slot has its own interval,
+ * 			the node wakes for whichever deadline comes first and only brings
+ * 			the radio up when a report is due.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "SensorRegistry.h"
+#include "Deadband.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Per sensor sampling intervals, in seconds
+#define SCHEDULE_SOIL_INTERVAL_S CONFIG_SCHEDULE_SOIL_INTERVAL
+#define SCHEDULE_SHT30_INTERVAL_S CONFIG_SCHEDULE_SHT30_INTERVAL
+#define SCHEDULE_WIND_INTERVAL_S CONFIG_SCHEDULE_WIND_INTERVAL
+#define SCHEDULE_EXTERNAL_INTERVAL_S CONFIG_SCHEDULE_EXTERNAL_INTERVAL
+
+// Samples waiting for the next report live in the RTC state block
+#define SCHEDULE_BATCH_SIZE CONFIG_SCHEDULE_BATCH_SIZE
+
+// Batch record: timestamp (4, big endian network seconds), slot (1), length (1), data
+#define SCHEDULE_RECORD_HEADER_LEN 6
+#define SCHEDULE_MAX_RECORD_DATA 32
+
+// Report by exception: longest a channel may go unreported, and the EWMA
+// z-score that counts as an anomaly and forces a report
+#define SCHEDULE_MAX_SILENCE_S CONFIG_SCHEDULE_MAX_SILENCE
+#define SCHEDULE_ANOMALY_Z (CONFIG_SCHEDULE_ANOMALY_Z_X10 / 10.0f)
+
+// Deadlines closer than this are handled in the current wake
+#define SCHEDULE_SLACK_US 50000
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// Everything the scheduler carries over deep sleep (see RTCState.h).
+// Deadlines are in system time, which the RTC keeps running while the chip
+// sleeps.
+typedef struct {
+	uint32_t Interval_S[SENSOR_MAX_DRIVERS];
+	int64_t Next_Due[SENSOR_MAX_DRIVERS];
+	uint32_t Report_Period_S;
+	int64_t Next_Report;
+	uint16_t Pace_X100;			// energy manager's period multiplier, x100
+	uint16_t Batch_Limit;		// energy manager's batch cap, 0 = SCHEDULE_BATCH_SIZE
+	Deadband_Channel_t Channels[SENSOR_MAX_DRIVERS][SENSOR_MAX_VALUES];
+	uint16_t Batch_Length;
+	uint8_t Batch[SCHEDULE_BATCH_SIZE];
+} Schedule_State_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Restore the schedule from the RTC state block, or start a fresh one
+ * (everything due now) when none was restored. Call after RTCState_Load().
+ *
+ * @param Report_Period_S report (transmit) period, in seconds
+ */
+void Scheduler_Init(uint32_t Report_Period_S);
+
+/**
+ * @brief Change a slot's sampling interval. Takes effect from its next sample.
+ *
+ * @param Slot registry slot
+ * @param Interval_S new interval, in seconds. 0 stops sampling the slot.
+ */
+void Scheduler_SetInterval(int Slot, uint32_t Interval_S);
+
+/**
+ * @brief Change the report period. The next report is moved forward if the
+ * new period is shorter.
+ *
+ * @param Report_Period_S new period, in seconds
+ */
+void Scheduler_SetReportPeriod(uint32_t Report_Period_S);
+
+/**
+ * @brief Slow the whole schedule down to save energy. Every sampling interval
+ * and the report period are multiplied by Scale_X100 / 100 from their next
+ * deadline on, and the batch keeps at most Batch_Limit bytes, oldest samples
+ * dropped first.
+ *
+ * @param Scale_X100 period multiplier x100, 100 = as configured
+ * @param Batch_Limit batch cap in bytes, 0 or SCHEDULE_BATCH_SIZE = no cap
+ */
+void Scheduler_SetPace(uint16_t Scale_X100, uint16_t Batch_Limit);
+
+/**
+ * @brief Slots whose sampling deadline has passed.
+ *
+ * @return uint32_t slot bits
+ */
+uint32_t Scheduler_Due(void);
+
+/**
+ * @brief Read every due sensor concurrently and move their deadlines on by one
+ * interval. Samples that moved past their deadband (or whose heartbeat is due)
+ * are appended to the batch. An anomaly makes the report due immediately, and
+ * a report with nothing to send is skipped.
+ *
+ * @return uint32_t slot bits that were sampled
+ */
+uint32_t Scheduler_Run(void);
+
+/**
+ * @brief Whether a report is due, i.e. whether the radio is needed this wake.
+ *
+ * @return true report due
+ */
+bool Scheduler_TxDue(void);
+
+/**
+ * @brief Copy as many whole batch records as fit into Buffer, oldest first.
+ * The batch is left as is, the caller hands the returned length to
+ * Scheduler_ConsumeBatch() once the records went out, so a failed send
+ * peeks the same records again.
+ *
+ * @param Buffer output buffer
+ * @param Size size of Buffer
+ * @return uint8_t bytes written, 0 when the batch is empty
+ */
+uint8_t Scheduler_PeekBatch(uint8_t *Buffer, uint8_t Size);
+
+/**
+ * @brief Drop the records returned by the last Scheduler_PeekBatch() call
+ * from the front of the batch. Scheduler_TxDone() does not touch the batch.
+ *
+ * @param Length value Scheduler_PeekBatch() returned
+ */
+void Scheduler_ConsumeBatch(uint8_t Length);
+
+/**
+ * @brief Bytes of samples waiting in the batch.
+ *
+ * @return uint16_t batch length
+ */
+uint16_t Scheduler_BatchLength(void);
+
+/**
+ * @brief Mark the report as sent and schedule the next one.
+ */
+void Scheduler_TxDone(void);
+
+/**
+ * @brief Plan the coming deep sleep. With SCHEDULE_WAKE_STUB, wind vane
+ * samples due before the next report or other sensor are left to the wake
+ * stub, and the full boot only happens for the rest.
+ *
+ * @return uint64_t microseconds to program into the sleep timer
+ */
+uint64_t Scheduler_PrepareSleep(void);
+
+/**
+ * @brief Time until the earliest sampling or report deadline.
+ *
+ * @return uint64_t microseconds, 0 if something is already due
+ */
+uint64_t Scheduler_NextWake_US(void);
+
+#endif // SCHEDULER_H
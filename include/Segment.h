@@ -0,0 +1,362 @@
+/**
+ * @file Segment.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Time partitioned segment files. Records go to one record log per
+ * 			node and time bucket, <root>/N<node>/<bucket start, hex>.SEG
+ * 			(8.3 names for FAT without LFN). Sealing a segment appends a
+ * 			footer frame holding a sparse index: the file offset and
+ * 			min/max timestamp of every block of records. Active segments
+ * 			keep their index in memory and share a few open files, so a
+ * 			cluster with more nodes than FAT file handles does not seal
+ * 			on every switch. While a segment is written, the index is also
+ * 			checkpointed every SEGMENT_CHECKPOINT_BYTES, so recovering one
+ * 			after a power loss reads the file's end, not all of it. Queries
+ * 			over (node, t_start, t_end) open only the buckets in range, seek
+ * 			only to the blocks that overlap it, and stream records in place
+ * 			out of sector aligned reads into the caller's buffer.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "RecordLog.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_SEGMENT_BUCKET_S
+#define SEGMENT_BUCKET_S CONFIG_SEGMENT_BUCKET_S
+#define SEGMENT_MAX_ACTIVE CONFIG_SEGMENT_MAX_ACTIVE
+#define SEGMENT_MAX_OPEN CONFIG_SEGMENT_MAX_OPEN
+#define SEGMENT_BUFFER_SIZE CONFIG_SEGMENT_BUFFER_SIZE
+#define SEGMENT_CHECKPOINT_BYTES CONFIG_SEGMENT_CHECKPOINT_BYTES
+#else
+#define SEGMENT_BUCKET_S 86400
+#define SEGMENT_MAX_ACTIVE 16			// one per node in the cluster
+#define SEGMENT_MAX_OPEN 3				// of the 7 files FAT is mounted with
+#define SEGMENT_BUFFER_SIZE 2048		// record log buffer per open segment
+#define SEGMENT_CHECKPOINT_BYTES 32768	// index checkpoint after this much log
+#endif
+
+// Recovery of an unsealed segment looks this far back from the end for the
+// last commit marker, then scans forward from the checkpoint it names. With
+// no marker in reach it scans the whole segment.
+#define SEGMENT_RECOVERY_WINDOW 32768
+
+// Index blocks start at this many records and double whenever the index is
+// full, so any segment size fits in one footer frame and an active segment's
+// index stays about 1 KB
+#define SEGMENT_INDEX_STRIDE 32
+#define SEGMENT_MAX_INDEX 64
+
+// Footer frame payload: the blocks, then the trailer. The trailer is at the
+// very end of the file, so readers find the footer from its last 8 bytes.
+#define SEGMENT_BLOCK_LEN 16			// offset, min t, max t, count, LE
+#define SEGMENT_TRAILER_LEN 20			// records, min t, max t, blocks, version, magic
+#define SEGMENT_MAGIC 0x46474553		// "SEGF"
+#define SEGMENT_VERSION 1
+
+// Record payload: LE timestamp, then the caller's bytes
+#define SEGMENT_RECORD_HEADER_LEN 4
+#define SEGMENT_MAX_DATA (RECORD_LOG_MAX_PAYLOAD - SEGMENT_RECORD_HEADER_LEN)
+
+#define SEGMENT_PATH_LEN 64
+#define SEGMENT_READ_BUFFER (2 * (RECORD_LOG_HEADER_LEN + RECORD_LOG_MAX_PAYLOAD))
+
+// Smallest query buffer: reads start on the sector holding the next frame,
+// and the largest frame has to fit after that
+#define SEGMENT_MIN_QUERY_BUFFER \
+	(((RECORD_LOG_HEADER_LEN + RECORD_LOG_MAX_PAYLOAD) / RECORD_LOG_SECTOR + 2) * RECORD_LOG_SECTOR)
+
+// Records per Segment_QueryRun() callback, at most
+#define SEGMENT_BATCH_MAX 32
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	uint32_t Offset;			// first frame
+	uint32_t Min_T;
+	uint32_t Max_T;
+	uint32_t Count;				// records
+} Segment_Block_t;
+
+typedef struct {
+	Segment_Block_t Blocks[SEGMENT_MAX_INDEX];
+	uint16_t Count;				// blocks used
+	uint32_t Stride;			// records per block
+	uint32_t Records;
+	uint32_t Min_T;
+	uint32_t Max_T;
+} Segment_Index_t;
+
+typedef struct {
+	Segment_Index_t Index;
+	uint8_t Node;
+	uint32_t Bucket;			// bucket start, s
+	uint32_t Last_Use;
+	int8_t Log;					// slot in SegmentStore_t Logs, -1 = file closed
+	uint32_t Checkpoint;		// last checkpoint frame, RECORD_LOG_NO_CHECKPOINT if none
+	bool Active;
+} Segment_t;
+
+typedef struct {
+	uint32_t Segments;			// unsealed segments recovered
+	uint64_t Bytes_Scanned;		// read forward from a checkpoint or the start
+	uint64_t Bytes_Cut;			// torn tails truncated
+	uint32_t Full_Scans;		// recoveries with no commit marker in reach
+} Segment_RecoveryStats_t;
+
+typedef struct {
+	char Root[SEGMENT_PATH_LEN];
+	uint32_t Bucket_S;
+	RecordLog_Config_t Config;
+	uint32_t Checkpoint_Bytes;	// SEGMENT_CHECKPOINT_BYTES, host tests lower it
+	Segment_t Segments[SEGMENT_MAX_ACTIVE];
+	RecordLog_t Logs[SEGMENT_MAX_OPEN];
+	Segment_t *Owners[SEGMENT_MAX_OPEN];	// segment each log belongs to, NULL = free
+	uint32_t Clock;
+	RecordLog_Stats_t Closed;	// stats of segments no longer open
+	uint32_t Sealed;
+	Segment_RecoveryStats_t Recovery;
+	uint8_t Scratch[SEGMENT_READ_BUFFER];	// record and footer assembly, recovery scans
+} SegmentStore_t;
+
+typedef struct {
+	uint32_t Timestamp;
+	uint16_t Length;
+	const uint8_t *Data;		// valid until the next Segment_QueryNext()
+} Segment_Record_t;
+
+// Where a query is, to resume it later or in another query
+typedef struct {
+	uint32_t Bucket;			// segment, UINT32_MAX past the last one
+	uint32_t Offset;			// next frame in it
+} Segment_Position_t;
+
+/**
+ * @brief Records for Segment_QueryRun(). They point into the query's buffer
+ * and are valid until the callback returns.
+ *
+ * @return true to go on, false to stop the run
+ */
+typedef bool (*Segment_Batch_Callback_t)(const Segment_Record_t *Records, uint32_t Count, void *Context);
+
+typedef struct {
+	uint32_t Files;				// segments opened
+	uint32_t Seeks;				// buffer refills
+	uint64_t Bytes_Read;
+	uint32_t Frames;			// frames decoded, matching or not
+	uint32_t Batches;			// callbacks made
+} Segment_QueryStats_t;
+
+// Keep it static or on the heap, the index is 1 KB
+typedef struct {
+	char Root[SEGMENT_PATH_LEN];
+	uint8_t Node;
+	uint32_t Bucket_S;
+	uint32_t T_Start;
+	uint32_t T_End;
+	uint32_t *Buckets;			// segments in range, ascending
+	uint32_t Bucket_Count;
+	uint32_t Bucket;			// next one to open
+	int Fd;
+	uint32_t Current;			// bucket of the open segment
+	uint64_t Data_End;			// where its records end
+	Segment_Index_t Index;
+	int32_t Block;				// block being read, -1 before the first
+	uint64_t Block_End;			// offset it ends at
+	uint64_t Next;				// offset of the next frame
+	uint8_t *Buffer;			// caller's
+	uint32_t Buffer_Size;		// whole sectors
+	uint64_t Buffer_Offset;		// sector aligned
+	uint32_t Buffer_Length;
+	Segment_Record_t Batch[SEGMENT_BATCH_MAX];
+	uint32_t Batch_Count;
+	Segment_Batch_Callback_t Callback;
+	void *Context;
+	bool Stopped;				// the callback asked to stop
+	Segment_QueryStats_t Stats;
+} Segment_Query_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Set up a store under a directory, creating it if needed.
+ *
+ * @param Store store to set up
+ * @param Root directory, e.g. "/sdcard/DATA"
+ * @param Bucket_S segment length in seconds, 0 for SEGMENT_BUCKET_S
+ * @return ESP error type
+ */
+esp_err_t SegmentStore_Open(SegmentStore_t *Store, const char *Root, uint32_t Bucket_S);
+
+/**
+ * @brief Append one record to its node's segment for the timestamp's bucket.
+ * Segments are opened on demand, the least recently used one is sealed when
+ * all SEGMENT_MAX_ACTIVE slots are taken, and a node's older segment is
+ * sealed once it writes to a newer bucket. Late records reopen sealed
+ * segments.
+ *
+ * @param Store open store
+ * @param Node node ID
+ * @param Timestamp network time, s
+ * @param Data record
+ * @param Length record bytes, at most SEGMENT_MAX_DATA
+ * @return ESP error type
+ */
+esp_err_t SegmentStore_Append(SegmentStore_t *Store, uint8_t Node, uint32_t Timestamp, const void *Data, uint16_t Length);
+
+/**
+ * @brief Group commit age check on every open segment file.
+ *
+ * @param Store open store
+ * @return ESP error type
+ */
+esp_err_t SegmentStore_Poll(SegmentStore_t *Store);
+
+/**
+ * @brief Write and fsync every open segment file.
+ *
+ * @param Store open store
+ * @return ESP error type
+ */
+esp_err_t SegmentStore_Sync(SegmentStore_t *Store);
+
+/**
+ * @brief Seal every active segment.
+ *
+ * @param Store open store
+ * @return ESP error type
+ */
+esp_err_t SegmentStore_Close(SegmentStore_t *Store);
+
+/**
+ * @brief Record log counters summed over every segment written so far.
+ *
+ * @param Store open store
+ * @param Stats filled in
+ */
+void SegmentStore_GetStats(const SegmentStore_t *Store, RecordLog_Stats_t *Stats);
+
+/**
+ * @brief Whether a node's segment for a bucket is being written, so others
+ * leave its file alone.
+ *
+ * @param Store open store
+ * @param Node node ID
+ * @param Bucket bucket start, s
+ * @return true if it is active
+ */
+bool SegmentStore_IsActive(const SegmentStore_t *Store, uint8_t Node, uint32_t Bucket);
+
+/**
+ * @brief Path of a node's segment file for a bucket.
+ *
+ * @param Path SEGMENT_PATH_LEN bytes
+ * @param Root store directory
+ * @param Node node ID
+ * @param Bucket bucket start, s
+ * @return ESP_ERR_INVALID_SIZE if the path does not fit, else ESP_OK
+ */
+esp_err_t Segment_FilePath(char *Path, const char *Root, uint8_t Node, uint32_t Bucket);
+
+/**
+ * @brief Where a segment file's records end: the footer's offset if it is
+ * sealed, its size if not. Appending after reopening starts there.
+ *
+ * @param Path segment file
+ * @param Buffer scratch, SEGMENT_MIN_QUERY_BUFFER bytes
+ * @param Index scratch
+ * @return offset, -1 if the file does not exist
+ */
+int64_t Segment_RecordsEnd(const char *Path, uint8_t *Buffer, Segment_Index_t *Index);
+
+/**
+ * @brief Start a query. Sees what is on the card; sync the store first to
+ * include records still in its buffers.
+ *
+ * @param Query query to set up
+ * @param Root store directory
+ * @param Bucket_S the store's segment length, 0 for SEGMENT_BUCKET_S
+ * @param Node node ID
+ * @param T_Start first timestamp, inclusive
+ * @param T_End last timestamp, inclusive
+ * @param Buffer read buffer, kept until Segment_QueryEnd(). The card reads
+ * whole sectors into it, so make it large (tens of KB) for replays and DMA
+ * capable to skip the bounce buffer.
+ * @param Buffer_Size bytes, at least SEGMENT_MIN_QUERY_BUFFER
+ * @return ESP error type
+ */
+esp_err_t Segment_QueryBegin(Segment_Query_t *Query, const char *Root, uint32_t Bucket_S, uint8_t Node, uint32_t T_Start,
+	uint32_t T_End, uint8_t *Buffer, uint32_t Buffer_Size);
+
+/**
+ * @brief Next record in range. Ascending by segment, in write order within
+ * one.
+ *
+ * @param Query running query
+ * @param Record filled in, Data points into the query's buffer
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND when there are no more
+ */
+esp_err_t Segment_QueryNext(Segment_Query_t *Query, Segment_Record_t *Record);
+
+/**
+ * @brief Hand the rest of the range to a callback, up to SEGMENT_BATCH_MAX
+ * records at a time, without copying them: a batch ends when it is full or
+ * when the buffer it points into is about to be refilled.
+ *
+ * @param Query running query
+ * @param Callback called per batch
+ * @param Context passed to it
+ * @return ESP_OK at the end of the range, ESP_ERR_NOT_FINISHED if the
+ * callback stopped the run; Segment_QueryTell() then points just past the
+ * last record it was given
+ */
+esp_err_t Segment_QueryRun(Segment_Query_t *Query, Segment_Batch_Callback_t Callback, void *Context);
+
+/**
+ * @brief Continue from a later time. Blocks and segments before it are
+ * skipped with the index, without reading them.
+ *
+ * @param Query running query
+ * @param T first timestamp from now on, within the range the query began
+ * with
+ */
+void Segment_QuerySeekTime(Segment_Query_t *Query, uint32_t T);
+
+/**
+ * @brief Where the query is.
+ *
+ * @param Query running query
+ * @param Position filled in
+ */
+void Segment_QueryTell(const Segment_Query_t *Query, Segment_Position_t *Position);
+
+/**
+ * @brief Continue from a position Segment_QueryTell() gave, for instance one
+ * saved before a reboot. The query must cover the same node.
+ *
+ * @param Query running query
+ * @param Position where to go on from
+ * @return ESP error type
+ */
+esp_err_t Segment_QuerySeek(Segment_Query_t *Query, const Segment_Position_t *Position);
+
+/**
+ * @brief Release the query's file and bucket list.
+ *
+ * @param Query query
+ */
+void Segment_QueryEnd(Segment_Query_t *Query);
+
+#endif // SEGMENT_H
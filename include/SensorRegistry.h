@@ -0,0 +1,224 @@
+/**
+ * @file SensorRegistry.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Pluggable sensor drivers. Each sensor is described by a small table
+ * 			of functions, and the registry runs every registered sensor's
+ * 			conversion in parallel.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#define SENSOR_MAX_DRIVERS 12
+#define SENSOR_MAX_VALUES 4
+
+// Built in sensors sit in fixed slots, in payload order. Everything
+// registered through Sensors_Register() is appended after them.
+#define SENSOR_SLOT_SOIL 0
+#define SENSOR_SLOT_SHT30 1
+#define SENSOR_SLOT_ANEMOMETER 2
+#define SENSOR_SLOT_WINDVANE 3
+#define SENSOR_FIRST_EXTERNAL_SLOT 4
+
+#define SENSOR_SLOT_BIT(Slot) (1UL << (Slot))
+
+// Readings younger than this answer a data request without touching the bus
+#ifdef CONFIG_SENSOR_CACHE_TTL_MS
+#define SENSOR_CACHE_TTL_MS CONFIG_SENSOR_CACHE_TTL_MS
+#else
+#define SENSOR_CACHE_TTL_MS 30000
+#endif
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// One sensor's reading, in the driver's order. Values are already in wire
+// units (see FixedPoint.h); Value[i] / Scale[i] is the physical value.
+typedef struct {
+	int32_t Value[SENSOR_MAX_VALUES];
+	uint8_t Count;
+} Sensor_Values_t;
+
+// Driver interface. Only Read and Encode are required. Sensors without a
+// conversion step (ADC, counters) leave Start_Measurement NULL, and are read
+// right away if Conversion_Time is NULL or returns 0.
+typedef struct {
+	const char *Name;
+	uint8_t Encoded_Length;		// bytes Encode() always writes
+	uint16_t Scale[SENSOR_MAX_VALUES];	// wire units per physical unit, 0 = 1
+
+	// Probe and configure the device
+	esp_err_t (*Init)(void *Ctx);
+	// Trigger a conversion without waiting for it
+	esp_err_t (*Start_Measurement)(void *Ctx);
+	// Time from Start_Measurement (or a multi phase Read) to data ready, us
+	uint32_t (*Conversion_Time)(void *Ctx);
+	// Collect the result. Returning ESP_ERR_NOT_FINISHED means the driver
+	// started another phase and wants to be read again after Conversion_Time.
+	esp_err_t (*Read)(void *Ctx, Sensor_Values_t *Values);
+	// Serialize Values into the payload
+	uint8_t (*Encode)(const Sensor_Values_t *Values, uint8_t *Buffer);
+} Sensor_Driver_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Encode helper: big endian int16, saturated.
+ *
+ * @param Buffer output, at least 2 bytes
+ * @param Value value in wire units
+ * @return uint8_t bytes written
+ */
+static inline uint8_t Sensor_PutInt16(uint8_t *Buffer, int32_t Value)
+{
+	if (Value > INT16_MAX) {
+		Value = INT16_MAX;
+	} else if (Value < INT16_MIN) {
+		Value = INT16_MIN;
+	}
+	Buffer[0] = ((uint16_t)Value >> 8) & 0xFF;
+	Buffer[1] = (uint16_t)Value & 0xFF;
+	return 2;
+}
+
+/**
+ * @brief Encode helper: big endian uint16, saturated.
+ *
+ * @param Buffer output, at least 2 bytes
+ * @param Value value in wire units
+ * @return uint8_t bytes written
+ */
+static inline uint8_t Sensor_PutUint16(uint8_t *Buffer, int32_t Value)
+{
+	if (Value > UINT16_MAX) {
+		Value = UINT16_MAX;
+	} else if (Value < 0) {
+		Value = 0;
+	}
+	Buffer[0] = (Value >> 8) & 0xFF;
+	Buffer[1] = Value & 0xFF;
+	return 2;
+}
+
+/**
+ * @brief Physical value of one channel, for consumers that need real units
+ * (deadbands, logs...).
+ *
+ * @param Driver driver that produced Values
+ * @param Values reading
+ * @param Index channel
+ * @return float value in the driver's physical unit
+ */
+static inline float Sensor_Physical(const Sensor_Driver_t *Driver, const Sensor_Values_t *Values, int Index)
+{
+	uint16_t Scale = Driver->Scale[Index];
+
+	return Scale ? (float)Values->Value[Index] / Scale : (float)Values->Value[Index];
+}
+
+/**
+ * @brief Place a driver in a specific slot and initialize it. Used for the
+ * built in sensors, which have fixed slots.
+ *
+ * @param Slot slot to use
+ * @param Driver driver table, must outlive the registry
+ * @param Ctx driver instance data, passed back to every driver call
+ * @return ESP error type
+ */
+esp_err_t Sensors_RegisterSlot(int Slot, const Sensor_Driver_t *Driver, void *Ctx);
+
+/**
+ * @brief Register and initialize a driver in the next free external slot.
+ *
+ * @param Driver driver table, must outlive the registry
+ * @param Ctx driver instance data, passed back to every driver call
+ * @return int slot, or -1 if the registry is full or Init() failed
+ */
+int Sensors_Register(const Sensor_Driver_t *Driver, void *Ctx);
+
+/**
+ * @brief Register every driver enabled in menuconfig (Sensor Configurations ->
+ * Extra Sensor Drivers).
+ *
+ * @return uint32_t slot bits of the drivers that initialized
+ */
+uint32_t Sensors_RegisterStatic(void);
+
+/**
+ * @brief Clear a slot. The driver has no deinit hook, the caller releases
+ * the hardware.
+ *
+ * @param Slot slot to clear
+ */
+void Sensors_Unregister(int Slot);
+
+/**
+ * @brief Slots that currently hold a driver.
+ *
+ * @return uint32_t slot bits
+ */
+uint32_t Sensors_Registered(void);
+
+/**
+ * @brief Driver in a slot.
+ *
+ * @param Slot slot to look up
+ * @return const Sensor_Driver_t* driver, NULL if the slot is empty
+ */
+const Sensor_Driver_t *Sensors_Driver(int Slot);
+
+/**
+ * @brief Read the requested sensors concurrently. Every conversion is started
+ * up front, then each sensor is read as soon as its own conversion time has
+ * passed, so the total time is the slowest sensor rather than the sum.
+ *
+ * @param Slots slot bits to read
+ * @param Values array of SENSOR_MAX_DRIVERS entries, indexed by slot
+ * @return uint32_t slot bits that were read successfully
+ */
+uint32_t Sensors_Run(uint32_t Slots, Sensor_Values_t *Values);
+
+/**
+ * @brief Like Sensors_Run(), but slots read within the last Max_Age_MS come
+ * from the cache. Only stale slots are acquired. Callers that overlap are
+ * serialized, and the later ones reuse what the first one read.
+ *
+ * @param Slots slot bits to read
+ * @param Values array of SENSOR_MAX_DRIVERS entries, indexed by slot
+ * @param Max_Age_MS oldest acceptable cached reading
+ * @return uint32_t slot bits that hold a valid reading
+ */
+uint32_t Sensors_Cached(uint32_t Slots, Sensor_Values_t *Values, uint32_t Max_Age_MS);
+
+/**
+ * @brief Encode the requested slots back to back, in slot order. Every slot
+ * writes its full Encoded_Length even if its read failed, so the payload
+ * layout only depends on which drivers are registered.
+ *
+ * @param Slots slot bits to encode
+ * @param Values array of SENSOR_MAX_DRIVERS entries, indexed by slot
+ * @param Buffer output buffer
+ * @param Size size of Buffer
+ * @return uint8_t bytes written
+ */
+uint8_t Sensors_Encode(uint32_t Slots, const Sensor_Values_t *Values, uint8_t *Buffer, uint8_t Size);
+
+#endif // SENSOR_REGISTRY_H
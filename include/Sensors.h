@@ -9,10 +9,9 @@
  * 
  */
 #include "I2C.h"
+#include "Windvane.h"
 #include <math.h>
 
-#include "driver/pulse_cnt.h"
-
 /*******************************************************************************
  * PUBLIC #DEFINES                                                            *
  ******************************************************************************/
@@ -28,26 +27,23 @@
 #define SOIL_MOISTURE_DATA_LENGTH 2
 #define SOIL_TEMP_DATA_LENGTH 4
 
+// Seesaw conversion times, taken from the adafruit driver, in us
+#define STEMMA_MOISTURE_DELAY_US 3000
+#define STEMMA_TEMP_DELAY_US 1000
+
 // sht3x defines
 #define SHT3X_REPEATABILITY sht3x_low // both are defined in SH3X.h
 #define SHT3X_PERIOD sht3x_single_shot
 
 
-// Weathervane defines
-#define NUMBER_OF_KEYS 16
-#define KEY_TO_DEG 22.5
+// Weathervane defines, the vane geometry is in Windvane.h
 #define ANEMOMETER_GPIO	CONFIG_ANEMOMETER_GPIO
 #define WINDVANE_GPIO	CONFIG_WINDVANE_GPIO
 // #define ANEMOMETER_VELOCITY_CONSTANT 0.6666 // m/s
 #define ANEMOMETER_VELOCITY_CONSTANT 2.4 // km/h
 
-//	 ADC defines
-#define ADC_BITWIDTH 12.0
-#define MAX_ADC_VOLTAGE 3.3
-
-// PCNT defines
-#define PCNT_HIGH_LIMIT 10
-#define PCNT_LOW_LIMIT -10
+// Acquisition defines
+#define ACQUISITION_TIMEOUT_US 100000	// give up 100 ms past the slowest conversion
 
 /*******************************************************************************
  * PUBLIC DATATYPES
@@ -70,13 +66,15 @@ typedef enum {
     BUS_COLISION = 0x4,
 } SesnorErrors_t;
 
+// One reading of every sensor, filled in by Sensors_Acquire()
 typedef struct {
-	uint64_t Duration;
-	uint64_t StartTime;
-	uint64_t EndTime;
-	pcnt_unit_handle_t *PCNTHandle;
-	int TotalIterations;
-} PCNT_State_t;
+	short Soil_Moisture;
+	float Soil_Temperature;
+	float Temperature;
+	float Humidity;
+	float WindSpeed;
+	float WindDirection;
+} SensorReadings_t;
 
 /*******************************************************************************
  * PUBLIC FUNCTIONS                                                           *
@@ -86,6 +84,8 @@ typedef struct {
  * Return value is a bitewise description of sensors that have been initialized.
  * Most sensors don't require specific intitialization code past proper
  * configuration of the I2C Bus. I2C_Init() should be called beforehand.
+ * Calling it again before Deinitialize_Sensors() changes nothing and returns
+ * those of Sensors that are already initialized.
  * 
  * @param Sensors sensors to initialize
  * @return SensorsIDs_t Initialized sensors. 1 = initialized.
@@ -93,6 +93,20 @@ typedef struct {
 SensorsIDs_t Sensors_Init(SensorsIDs_t Sensors);
 
 
+/**
+ * @brief Read every requested built in sensor concurrently.
+ * 
+ * Thin wrapper over Sensors_Run() for the four built in sensors. Every
+ * measurement is started at once and each sensor is only collected once its
+ * own conversion time has elapsed. Total time is therefore the slowest
+ * sensor's conversion instead of the sum of all of them.
+ * 
+ * @param Sensors sensors to read
+ * @param Readings struct to store readings into
+ * @return SensorsIDs_t sensors that were read successfully. 1 = success.
+ */
+SensorsIDs_t Sensors_Acquire(SensorsIDs_t Sensors, SensorReadings_t *Readings);
+
 /**
  * @brief Read from the soil moisture sensor
  * 
@@ -119,16 +133,18 @@ esp_err_t Read_SoilTemperature(float *Reading);
 bool Read_SHT30_HumidityTemperature(float *Temp_Reading, float *Humid_Reading);
 
 /**
- * @brief Get wind direction from ADC reading
+ * @brief Get the vector averaged wind direction of the last completed vane
+ * window.
  * 
- * @return short bearing, in degrees 
+ * @return float bearing, in degrees 
  */
 float Get_Wind_Direction(void);
 
 /**
- * @brief Get wind speed from anemometer pulse width
+ * @brief Get wind speed over the last completed anemometer window. Gust and
+ * 10 minute mean are available through Anemometer_GetSnapshot().
  * 
- * @return float wind speed, in meters per second
+ * @return float wind speed, in km/h
  */
 float Get_Wind_Speed(void);
 
@@ -0,0 +1,141 @@
+/**
+ * @file SeriesCodec.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Gorilla style compression of sensor time series. A block holds
+ * 			samples of a fixed set of columns: timestamps as delta of delta,
+ * 			integer columns (wire units, see FixedPoint.h) as zigzag deltas
+ * 			in nibble varints, float columns as XOR with the previous value.
+ * 			Every block starts with a header (count, time range) and decodes
+ * 			on its own, so readers can skip or fetch blocks independently.
+ * 			No allocation and no ESP calls, host tools build it too.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef SERIES_CODEC_H
+#define SERIES_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "RecordLog.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#define SERIES_MAX_COLUMNS 16
+
+// Header: magic, version, columns, reserved, float column mask, sample
+// count, min t, max t, all LE. The bit stream follows.
+#define SERIES_HEADER_LEN 16
+#define SERIES_MAGIC 0x47				// 'G'
+#define SERIES_VERSION 1
+
+// Fits a record log frame with room for a tag byte
+#define SERIES_MAX_BLOCK 4000
+
+// First byte of a stored record that holds a block, never a packet type
+#define SERIES_RECORD_TAG 0xFF
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef union {
+	int32_t Int;
+	float Float;
+} Series_Value_t;
+
+typedef struct {
+	uint8_t *Block;
+	uint16_t Size;
+	uint32_t Bits;				// bits of stream written
+	uint8_t Columns;
+	uint16_t Float_Mask;		// bit i set = column i is a float
+	uint16_t Count;
+	uint32_t Min_T;
+	uint32_t Max_T;
+	uint32_t Last_T;
+	int32_t Last_Delta;
+	uint32_t Last[SERIES_MAX_COLUMNS];		// previous value, raw bits
+	uint8_t Leading[SERIES_MAX_COLUMNS];	// float XOR window of the previous value
+	uint8_t Trailing[SERIES_MAX_COLUMNS];
+} Series_Encoder_t;
+
+typedef struct {
+	const uint8_t *Block;
+	uint32_t Bits;				// bits of stream read
+	uint32_t End;				// bits of stream available
+	uint8_t Columns;
+	uint16_t Float_Mask;
+	uint16_t Count;
+	uint16_t Index;				// samples decoded
+	uint32_t Min_T;
+	uint32_t Max_T;
+	uint32_t Last_T;
+	int32_t Last_Delta;
+	uint32_t Last[SERIES_MAX_COLUMNS];
+	uint8_t Leading[SERIES_MAX_COLUMNS];
+	uint8_t Trailing[SERIES_MAX_COLUMNS];
+} Series_Decoder_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Start an empty block.
+ *
+ * @param Encoder encoder to set up
+ * @param Block output, kept until Series_EncodeEnd()
+ * @param Size bytes, at most SERIES_MAX_BLOCK
+ * @param Columns values per sample, at most SERIES_MAX_COLUMNS
+ * @param Float_Mask columns holding floats, the rest are integers
+ * @return ESP error type
+ */
+esp_err_t Series_EncodeBegin(Series_Encoder_t *Encoder, uint8_t *Block, uint16_t Size, uint8_t Columns, uint16_t Float_Mask);
+
+/**
+ * @brief Add one sample. Timestamps may go backwards (late samples), they
+ * just cost more bits.
+ *
+ * @param Encoder started encoder
+ * @param Timestamp s
+ * @param Values one per column
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE when the block is full; the block
+ * is left as it was and can be ended
+ */
+esp_err_t Series_Append(Series_Encoder_t *Encoder, uint32_t Timestamp, const Series_Value_t *Values);
+
+/**
+ * @brief Write the header. The encoder can be started again afterwards.
+ *
+ * @param Encoder encoder
+ * @return uint16_t block length, 0 if it holds no samples
+ */
+uint16_t Series_EncodeEnd(Series_Encoder_t *Encoder);
+
+/**
+ * @brief Check a block's header and start reading it. Count, Min_T and
+ * Max_T are valid on return.
+ *
+ * @param Decoder decoder to set up
+ * @param Block block
+ * @param Length block bytes
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if it is not a block
+ */
+esp_err_t Series_DecodeBegin(Series_Decoder_t *Decoder, const uint8_t *Block, uint16_t Length);
+
+/**
+ * @brief Next sample, in the order it was appended.
+ *
+ * @param Decoder started decoder
+ * @param Timestamp s
+ * @param Values one per column
+ * @return ESP_OK, ESP_ERR_NOT_FOUND after the last sample, or
+ * ESP_ERR_INVALID_SIZE if the block is cut short
+ */
+esp_err_t Series_Next(Series_Decoder_t *Decoder, uint32_t *Timestamp, Series_Value_t *Values);
+
+#endif // SERIES_CODEC_H
@@ -0,0 +1,148 @@
+/**
+ * @file Statistics.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Streaming statistics for sensor channels. Every accumulator is a fixed
+ * 			size struct, so memory per channel does not grow with the window.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Median-of-N outlier filter length. Must be odd, 1 disables the filter.
+#ifdef CONFIG_STATS_MEDIAN_WINDOW
+#define STATS_MEDIAN_WINDOW CONFIG_STATS_MEDIAN_WINDOW
+#else
+#define STATS_MEDIAN_WINDOW 5
+#endif
+#if STATS_MEDIAN_WINDOW < 1 || (STATS_MEDIAN_WINDOW % 2) == 0
+#error "STATS_MEDIAN_WINDOW must be odd"
+#endif
+
+// Size of one encoded summary: mean, std dev, min, max as int16
+#define STATS_SUMMARY_LEN 8
+// Size of one encoded circular summary: mean, std dev as uint16 tenths of a degree
+#define STATS_CIRCULAR_SUMMARY_LEN 4
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+// Linear channel: median prefilter feeding Welford mean/variance and min/max
+typedef struct {
+	float Window[STATS_MEDIAN_WINDOW];
+	uint8_t Window_Index;
+	uint8_t Window_Fill;
+	uint32_t Count;
+	float Mean;
+	float M2;
+	float Min;
+	float Max;
+} Stats_Channel_t;
+
+// Circular channel (bearings): accumulates the unit vector of every sample
+typedef struct {
+	float Sum_Sin;
+	float Sum_Cos;
+	uint32_t Count;
+} Stats_Circular_t;
+
+typedef struct {
+	float Mean;
+	float StdDev;
+	float Min;
+	float Max;
+	uint32_t Count;
+} Stats_Summary_t;
+
+typedef struct {
+	float Mean;			// degrees, [0, 360)
+	float StdDev;		// degrees
+	uint32_t Count;
+} Stats_CircularSummary_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Clear a linear channel, including its median window.
+ *
+ * @param Channel channel to reset
+ */
+void Stats_Reset(Stats_Channel_t *Channel);
+
+/**
+ * @brief Push one sample. The sample goes through the median-of-N filter first,
+ * then the filtered value updates mean, variance, min and max. O(1).
+ *
+ * @param Channel channel to update
+ * @param Sample new raw sample
+ */
+void Stats_Update(Stats_Channel_t *Channel, float Sample);
+
+/**
+ * @brief Snapshot the channel's statistics.
+ *
+ * @param Channel channel to summarize
+ * @param Summary struct to store summary into
+ */
+void Stats_Summarize(const Stats_Channel_t *Channel, Stats_Summary_t *Summary);
+
+/**
+ * @brief Clear a circular channel.
+ *
+ * @param Channel channel to reset
+ */
+void Stats_CircularReset(Stats_Circular_t *Channel);
+
+/**
+ * @brief Push one bearing, in degrees. O(1).
+ *
+ * @param Channel channel to update
+ * @param Degrees new bearing
+ */
+void Stats_CircularUpdate(Stats_Circular_t *Channel, float Degrees);
+
+/**
+ * @brief Vector mean bearing and circular standard deviation of the channel.
+ *
+ * @param Channel channel to summarize
+ * @param Summary struct to store summary into
+ */
+void Stats_CircularSummarize(const Stats_Circular_t *Channel, Stats_CircularSummary_t *Summary);
+
+/**
+ * @brief Encode a summary as four big endian int16 values: mean, std dev, min,
+ * max, each multiplied by Scale and saturated.
+ *
+ * @param Summary summary to encode
+ * @param Scale wire units per physical unit (e.g. 100 for hundredths)
+ * @param Buffer output, at least STATS_SUMMARY_LEN bytes
+ * @return uint8_t bytes written
+ */
+uint8_t Stats_Encode(const Stats_Summary_t *Summary, float Scale, uint8_t *Buffer);
+
+/**
+ * @brief Encode a circular summary as two big endian uint16 values, tenths of
+ * a degree: mean bearing, std dev.
+ *
+ * @param Summary summary to encode
+ * @param Buffer output, at least STATS_CIRCULAR_SUMMARY_LEN bytes
+ * @return uint8_t bytes written
+ */
+uint8_t Stats_CircularEncode(const Stats_CircularSummary_t *Summary, uint8_t *Buffer);
+
+#endif // STATISTICS_H
@@ -0,0 +1,150 @@
+/**
+ * @file StorageWriter.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Background storage writer. Callers copy records into one of two
+ * 			ping-pong buffers and return; a task on the other core writes the
+ * 			full buffer to the segment store while the second one fills, so
+ * 			slow SD writes never stall the radio loop. Sensor samples are
+ * 			compressed per node into series blocks (SeriesCodec.h) before
+ * 			they reach the store. With STORAGE_BACKEND_FLASH the store is a
+ * 			flash ring (FlashLog.h) instead of segments on the SD card.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef STORAGE_WRITER_H
+#define STORAGE_WRITER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#include "Compactor.h"
+#include "FlashLog.h"
+#include "Segment.h"
+#include "SeriesCodec.h"
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+#ifdef CONFIG_STORAGE_WRITER_BUFFER_SIZE
+#define STORAGE_WRITER_BUFFER_SIZE CONFIG_STORAGE_WRITER_BUFFER_SIZE
+#define STORAGE_WRITER_MAX_AGE_MS CONFIG_STORAGE_WRITER_MAX_AGE_MS
+#else
+#define STORAGE_WRITER_BUFFER_SIZE 4096
+#define STORAGE_WRITER_MAX_AGE_MS 5000
+#endif
+
+#ifdef CONFIG_STORAGE_WRITER_SERIES_BLOCK
+#define STORAGE_WRITER_SERIES_BLOCK CONFIG_STORAGE_WRITER_SERIES_BLOCK
+#define STORAGE_WRITER_SERIES_SPAN_S CONFIG_STORAGE_WRITER_SERIES_SPAN_S
+#else
+#define STORAGE_WRITER_SERIES_BLOCK 512
+#define STORAGE_WRITER_SERIES_SPAN_S 600
+#endif
+
+// Open sample blocks, one per node being written
+#define STORAGE_WRITER_SERIES_NODES SEGMENT_MAX_ACTIVE
+
+// First data byte of a stored series block record, never a packet type. The
+// record's timestamp is the block's earliest sample and the rest are at most
+// STORAGE_WRITER_SERIES_SPAN_S later, so a query that must see every sample
+// from T starts at T - STORAGE_WRITER_SERIES_SPAN_S.
+#define STORAGE_WRITER_SERIES_TAG SERIES_RECORD_TAG
+
+// Flash ring records start with the node and the LE timestamp, the segment
+// store keeps those in the file name and frame index instead
+#define STORAGE_WRITER_FLASH_HEADER 5
+
+// Records are copied in under a spinlock, keep them short
+#define STORAGE_WRITER_MAX_RECORD 512
+
+// How often the task checks buffer age, group commit age and power events
+#define STORAGE_WRITER_POLL_MS 100
+
+#define STORAGE_WRITER_TASK_STACK 4096
+#define STORAGE_WRITER_TASK_PRIORITY 3
+// The core the radio loop does not run on
+#define STORAGE_WRITER_CORE (portNUM_PROCESSORS - 1)
+
+#define STORAGE_WRITER_EVENT_QUEUE_LEN 4
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	uint32_t Submitted;			// records accepted
+	uint32_t Dropped;			// records refused: both buffers busy past the wait, or too long
+	uint32_t Stalls;			// submits that had to wait for a buffer
+	uint32_t Buffers;			// buffers written to the store
+	uint32_t Power_Flushes;		// flushes forced by low battery events
+	uint32_t Errors;			// segment store failures
+	uint32_t Max_Write_US;		// longest buffer write, fsync included
+	uint32_t Segments_Sealed;	// SD backend only
+	uint32_t Samples;			// samples accepted into series blocks
+	uint32_t Series_Blocks;		// series blocks stored
+	uint64_t Series_Bytes;		// their encoded size
+	RecordLog_Stats_t Log;		// summed over all segments
+	Compactor_Stats_t Compaction;	// SD backend only
+} StorageWriter_Stats_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Open the segment store or flash ring, allocate both buffers,
+ * subscribe to power monitor events and start the writer task.
+ *
+ * @param Root store directory on a mounted card, or the flash ring's
+ * partition label
+ * @return ESP error type
+ */
+esp_err_t StorageWriter_Start(const char *Root);
+
+/**
+ * @brief Queue one record. Only copies; the write happens in the task.
+ *
+ * @param Node node the record is from
+ * @param Timestamp network time, s, picks the segment
+ * @param Data record
+ * @param Length record bytes, at most STORAGE_WRITER_MAX_RECORD
+ * @param Wait how long to wait when both buffers are busy, 0 drops at once
+ * @return ESP_OK, or ESP_ERR_TIMEOUT when the record was dropped
+ */
+esp_err_t StorageWriter_Submit(uint8_t Node, uint32_t Timestamp, const void *Data, uint16_t Length, TickType_t Wait);
+
+/**
+ * @brief Queue one sample of integer readings (wire units). The task adds it
+ * to the node's series block, which is stored once it is full, spans
+ * STORAGE_WRITER_SERIES_SPAN_S, changes bucket or column count, or on a
+ * flush.
+ *
+ * @param Node node the sample is from
+ * @param Timestamp network time, s
+ * @param Values readings
+ * @param Count readings, at most SERIES_MAX_COLUMNS
+ * @param Wait how long to wait when both buffers are busy, 0 drops at once
+ * @return ESP_OK, or ESP_ERR_TIMEOUT when the sample was dropped
+ */
+esp_err_t StorageWriter_SubmitSample(uint8_t Node, uint32_t Timestamp, const int32_t *Values, uint8_t Count, TickType_t Wait);
+
+/**
+ * @brief Store the open series blocks, then write and fsync everything
+ * submitted so far.
+ *
+ * @param Wait how long to wait for the task
+ * @return ESP_OK once durable, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t StorageWriter_Flush(TickType_t Wait);
+
+/**
+ * @brief Copy of the counters.
+ *
+ * @param Stats filled in
+ */
+void StorageWriter_GetStats(StorageWriter_Stats_t *Stats);
+
+#endif // STORAGE_WRITER_H
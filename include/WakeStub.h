@@ -0,0 +1,64 @@
+/**
+ * @file WakeStub.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Deep sleep wake stub. Takes wind vane samples straight from RTC
+ * 			memory without booting the firmware, and only lets the boot go on
+ * 			once the scheduler needs the full node.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef WAKESTUB_H
+#define WAKESTUB_H
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Samples the stub can hold until the next full boot
+#define WAKESTUB_MAX_SAMPLES 64
+
+// Shorter sleeps than this are not worth it, the stub lets the boot go on
+#define WAKESTUB_MIN_SLEEP_US 20000
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Install the stub for the coming deep sleep. The first wake (after
+ * the timer the caller sets) takes a sample, and so do the next Samples - 1,
+ * Period_US apart. After the last one the stub sleeps Tail_US more, then the
+ * full firmware boots.
+ *
+ * @param Channel ADC1 channel of the wind vane
+ * @param Samples samples to take, at most WAKESTUB_MAX_SAMPLES
+ * @param First_US system time of the first sample, handed back by WakeStub_Take()
+ * @param Period_US time between samples
+ * @param Tail_US time from the last sample to the full boot
+ */
+void WakeStub_Arm(int Channel, uint16_t Samples, int64_t First_US, uint32_t Period_US, uint32_t Tail_US);
+
+/**
+ * @brief Remove the stub, the next wake boots straight away.
+ */
+void WakeStub_Disarm(void);
+
+/**
+ * @brief Collect what the stub sampled since it was armed, and disarm it.
+ *
+ * @param Raw output, at least WAKESTUB_MAX_SAMPLES raw 12 bit ADC codes
+ * @param First_US system time of Raw[0]
+ * @param Period_US time between samples
+ * @return uint16_t number of samples
+ */
+uint16_t WakeStub_Take(uint16_t *Raw, int64_t *First_US, uint32_t *Period_US);
+
+#endif // WAKESTUB_H
@@ -0,0 +1,114 @@
+/**
+ * @file Windvane.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Continuous (DMA) ADC sampling of the wind vane with vector averaged
+ * 			direction.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef WINDVANE_H
+#define WINDVANE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#else
+typedef int esp_err_t;
+#endif
+
+/*******************************************************************************
+ * PUBLIC #DEFINES                                                            *
+ ******************************************************************************/
+// Vane geometry, 16 sectors clockwise from north
+#define NUMBER_OF_KEYS 16
+#define KEY_TO_DEG 22.5
+
+//	 ADC defines
+#define ADC_BITWIDTH 12.0
+#define MAX_ADC_VOLTAGE 3.3
+
+// ADC runs in the background at this rate. Lower bound on the S3 is 611 Hz.
+#define WINDVANE_SAMPLE_FREQ_HZ 1000
+
+// Direction is averaged over windows of this length
+#define WINDVANE_WINDOW_MS 1000
+#define WINDVANE_WINDOW_SAMPLES (WINDVANE_SAMPLE_FREQ_HZ * WINDVANE_WINDOW_MS / 1000)
+
+// DMA frame and driver pool sizes, in bytes
+#define WINDVANE_FRAME_SIZE 256
+#define WINDVANE_POOL_SIZE (WINDVANE_FRAME_SIZE * 4)
+
+#define WINDVANE_TASK_STACK 1024 * 3
+#define WINDVANE_TASK_PRIORITY 5
+
+/*******************************************************************************
+ * PUBLIC DATATYPES
+ ******************************************************************************/
+typedef struct {
+	float Direction;	// vector mean bearing of the last window, degrees [0, 360)
+	float Resultant;	// mean resultant length, 1 = steady, 0 = no direction
+	uint32_t Samples;	// samples in the last window
+} Windvane_Snapshot_t;
+
+/*******************************************************************************
+ * PUBLIC FUNCTIONS                                                           *
+ ******************************************************************************/
+/**
+ * @brief Build the sector threshold table and start continuous conversions
+ * on the ADC channel behind Gpio.
+ *
+ * @param Gpio wind vane input pin, must be ADC capable
+ * @return ESP error type
+ */
+esp_err_t Windvane_Init(int Gpio);
+
+/**
+ * @brief Stop conversions and release the ADC.
+ */
+void Windvane_Deinit(void);
+
+/**
+ * @brief Copy the last completed window.
+ *
+ * @param Snapshot struct to store values into
+ */
+void Windvane_GetSnapshot(Windvane_Snapshot_t *Snapshot);
+
+/**
+ * @brief Build the sector threshold and unit vector tables. Windvane_Init()
+ * calls this, it is only public for host tests.
+ */
+void Windvane_BuildTables(void);
+
+/**
+ * @brief Map a raw ADC code to its vane sector with a binary search over the
+ * precomputed thresholds. Windvane_Init() must have built the table.
+ *
+ * @param Raw 12 bit ADC code
+ * @return uint8_t sector, 0 = north, clockwise in KEY_TO_DEG steps
+ */
+uint8_t Windvane_Sector(uint16_t Raw);
+
+/**
+ * @brief Unit vector average of a sector histogram.
+ *
+ * @param Count samples per sector
+ * @param Samples sum of Count
+ * @param Snapshot struct to store the direction and resultant into
+ */
+void Windvane_Average(const uint32_t Count[NUMBER_OF_KEYS], uint32_t Samples, Windvane_Snapshot_t *Snapshot);
+
+/**
+ * @brief ADC1 channel the vane is sampled on, for the deep sleep wake stub.
+ *
+ * @return int channel, -1 if not initialized or the pin is on ADC2
+ */
+int Windvane_Channel(void);
+
+#endif // WINDVANE_H
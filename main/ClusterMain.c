@@ -20,11 +20,17 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_sleep.h"
+#include "esp_random.h"
 
-// #include "../include/Memory.h"
+#include "../include/memory.h"
 #include "../include/Protocol.h"
 #include "../include/LoRa.h"
-#include <ina219.h>
+#include "../include/PowerMonitor.h"
+#include "../include/EnergyManager.h"
+#include "../include/EnergySource.h"
+#include "../include/StorageWriter.h"
+#include "../include/Backfill.h"
+#include "freertos/queue.h"
 
 // Defines
 /******************************************************************************/
@@ -36,12 +42,33 @@
 
 // Voltage monitor defines
 #define SHUNT_RESISTANCE 0.24
-#define CRITICAL_VOLTAGE 11.0 // ACCURATE VALUE NEEDED ... minimum voltage is 10V for battery
+#define POWER_EVENT_QUEUE_LEN 4
 
 // i2c defines NOTE: probably should be replaced with CONFIG_I2C values
 #define I2C_SCL 42
 #define I2C_SDA 41
 #define I2C_PORT 0
+
+// Last value cache
+#ifdef CONFIG_CLUSTER_CACHE_TTL_MS
+#define NODE_CACHE_TTL_MS CONFIG_CLUSTER_CACHE_TTL_MS
+#else
+#define NODE_CACHE_TTL_MS 60000
+#endif
+#define NODE_CACHE_SIZE 16				// sensor nodes remembered
+
+// Storage
+#define MOUNT_POINT "/sdcard"
+#define STORAGE_ROOT MOUNT_POINT"/DATA"
+#define STORAGE_RECORD_HEADER_LEN 1		// packet type
+#define STORAGE_SLEEP_FLUSH_MS 2000		// longest the emergency sleep waits for the card
+
+// Backfill
+#ifdef CONFIG_CLUSTER_BACKFILL_INTERVAL_S
+#define BACKFILL_INTERVAL_MS (CONFIG_CLUSTER_BACKFILL_INTERVAL_S * 1000)
+#else
+#define BACKFILL_INTERVAL_MS 60000		// between sessions, while the sink answers
+#endif
 // Datatypes
 /******************************************************************************/
 typedef struct {
@@ -51,6 +78,12 @@ typedef struct {
 	bool *Sending;
 } LoRaTaskParams;
 
+// Latest raw sensor packet heard from one node
+typedef struct {
+	LORA_Packet_t Packet;
+	int64_t Received;	// esp_timer us, 0 = empty
+} NodeCache_Entry_t;
+
 
 // Variables
 /******************************************************************************/
@@ -58,8 +91,9 @@ static const char *TAG = "ClusterMain.c";
 static LORA_Packet_t MainPacket, StoragePacket; // store packet is needed in case original packet
 												// needs to be stored if no ack received
 static bool AwaitingResponse;					// to check in main loop
-static int Send_StartTime, Last_DataRequest;
-static ina219_t MonitorHandle;
+static int Send_StartTime;
+static int64_t Last_DataRequest;				// esp_timer us of the last over the air poll
+static QueueHandle_t Power_Events;				// Power_Event_t from the power monitor
 static uint16_t Period;
 static uint32_t TempTimestamp;
 uint8_t Unique_NodeID;
@@ -70,6 +104,18 @@ uint8_t rx_len, tx_len;
 static uint8_t Raw_Buf[MAX_BUFF];
 static bool RX_Flag, Buf_Flag, TX_Flag;
 
+#ifndef CONFIG_STORAGE_BACKEND_FLASH
+// What the card holds goes upstream in bulk once the sink answers again
+static Backfill_t Backfill;
+static bool Backfill_Ready;
+static int64_t Last_UplinkAck;					// esp_timer us, 0 = none yet
+static int64_t Last_Backfill;					// esp_timer us of the last session start
+#endif
+
+// Sink requests are answered from here while every node's reading is younger
+// than NODE_CACHE_TTL_MS
+static NodeCache_Entry_t NodeCache[NODE_CACHE_SIZE];
+
 // bool TX_Buf_Empty, RX_Buf_Empty;
 
 static LoRaTaskParams TaskFlags = {
@@ -140,6 +186,14 @@ bool GetPacket()
 	Buf_Flag = false;
 
 
+	// Larger frames (another head's backfill) do not fit a packet, and a
+	// relayed payload has to leave room for the header and CRC
+	if (Raw_Buf[6] > MAX_PACKET_LENGTH - BASE_PACKET_LEGNTH)
+	{
+		TX_Flag = false;
+		return false;
+	}
+
 	// Transfer bytes from lora buffer into main packet structure
 	MainPacket.NodeID = Raw_Buf[0];
 	MainPacket.Pkt_Type = Raw_Buf[1];
@@ -194,17 +248,14 @@ void Calculate_CRC(LORA_Packet_t *Packet)
 	TempChar = (uint8_t)(Packet->Timestamp)[3];
 	Iterative_CRC(false, TempChar);
 
-	// Length
-	Iterative_CRC(false, Packet->Length);
+	// Length, CRC of empty packets (requests) ends here
+	Packet->CRC = Iterative_CRC(false, Packet->Length);
 
 	// Payload
-	for (i = 0; i < (Packet->Length - 1); i++)
+	for (i = 0; i < Packet->Length; i++)
 	{
-		Iterative_CRC(false, *(Packet->Payload + i));
+		Packet->CRC = Iterative_CRC(false, *(Packet->Payload + i));
 	}
-
-	// final payload and store CRC
-	Packet->CRC = Iterative_CRC(false, *(Packet->Payload + Packet->Length - 1));
 }
 
 bool SendAck()
@@ -347,6 +398,82 @@ bool SendPacket()
 	return true;
 }
 
+#ifndef CONFIG_STORAGE_BACKEND_FLASH
+// Send one backfill fragment. Frames are longer than packets, so it is built
+// here instead of in a LORA_Packet_t. Fragments ask for their own
+// acknowledgements, no response is awaited.
+bool SendBackfill(const uint8_t *Payload, uint8_t Length)
+{
+	uint8_t buffer[MAX_BUFF];
+	uint8_t i;
+
+	buffer[0] = Unique_NodeID;
+	buffer[1] = BACKFILL_DATA;
+	TempTimestamp = esp_timer_get_time() / MICROSECOND_CONVERSION;
+	memcpy(buffer + 2, &TempTimestamp, 4);
+	buffer[6] = Length;
+	memcpy(buffer + 7, Payload, Length);
+
+	// CRC over everything before it
+	Iterative_CRC(true, buffer[0]);
+	for (i = 1; i < 7 + Length; i++)
+	{
+		buffer[7 + Length] = Iterative_CRC(false, buffer[i]);
+	}
+	tx_len = 8 + Length;
+
+	// wait for lora module to be available
+	while(RX_Flag);
+
+	// Set TX flag and send
+	TX_Flag = true;
+	if (LoRaSend(buffer, tx_len, SX126x_TXMODE_SYNC) == false)
+	{
+		ESP_LOGE(TAG, "LoRaSend fail");
+	}
+
+	// reset flag
+	TX_Flag = false;
+
+	return true;
+}
+
+// Called on loop turns with nothing else to do. A session starts while the
+// sink has been answering, and sends one fragment per turn so a live packet
+// waits for one fragment at most
+void BackfillPoll(void)
+{
+	uint8_t Payload[BACKFILL_FRAGMENT_LEN];
+	int64_t Now = esp_timer_get_time();
+	uint8_t Length;
+
+	if (!Backfill_Ready)
+	{
+		return;
+	}
+	if (!Backfill.Active)
+	{
+		if (Last_UplinkAck == 0 || Now - Last_UplinkAck > BACKFILL_INTERVAL_MS * 1000LL
+			|| (Last_Backfill != 0 && Now - Last_Backfill < BACKFILL_INTERVAL_MS * 1000LL))
+		{
+			return;
+		}
+		Last_Backfill = Now;
+		if (Backfill_Begin(&Backfill, esp_random()) != ESP_OK)
+		{
+			ESP_LOGW(TAG, "Backfill session not started");
+			return;
+		}
+	}
+
+	Length = Backfill_NextFragment(&Backfill, Now / 1000, Payload);
+	if (Length)
+	{
+		SendBackfill(Payload, Length);
+	}
+}
+#endif
+
 // send new period
 bool SendNewPeriod()
 {
@@ -373,17 +500,155 @@ bool SendNewPeriod()
 }
 
 // send data request
+// No payload, every sensor node in range answers with raw sensor data
 bool SendSensorDataRequest()
 {
+	// build packet
+	MainPacket.NodeID = Unique_NodeID;
+	MainPacket.Pkt_Type = REQUEST_SENSOR_DATA;
+
+	TempTimestamp = esp_timer_get_time() / MICROSECOND_CONVERSION;
+	memcpy(MainPacket.Timestamp, &TempTimestamp, 4);
+
+	MainPacket.Length = REQUEST_SENSOR_DATA_LEN;
+
+	Calculate_CRC(&MainPacket);
+
+	StoragePacket = MainPacket;
+	SendPacket();
+
+	// Requests arriving while this poll is out are answered by its replies
+	Last_DataRequest = esp_timer_get_time();
 
 	return true;
 }
 
+// send this cluster head's battery status
+bool SendBatteryData()
+{
+	// build packet
+	MainPacket.NodeID = Unique_NodeID;
+	MainPacket.Pkt_Type = BATTERY_DATA;
+
+	TempTimestamp = esp_timer_get_time() / MICROSECOND_CONVERSION;
+	memcpy(MainPacket.Timestamp, &TempTimestamp, 4);
+
+	MainPacket.Length = PowerMonitor_Encode(MainPacket.Payload);
+
+	Calculate_CRC(&MainPacket);
+
+	StoragePacket = MainPacket;
+	SendPacket();
+
+	return true;
+}
+
+// Remember the latest raw sensor packet of the node that sent it
+void NodeCache_Store(const LORA_Packet_t *Packet)
+{
+	NodeCache_Entry_t *Slot = NULL;
+	int i;
+
+	for (i = 0; i < NODE_CACHE_SIZE; i++)
+	{
+		if (NodeCache[i].Received && NodeCache[i].Packet.NodeID == Packet->NodeID)
+		{
+			Slot = &NodeCache[i];
+			break;
+		}
+		// otherwise take the first empty entry, or else the oldest one
+		if (!Slot || (Slot->Received && NodeCache[i].Received < Slot->Received))
+		{
+			Slot = &NodeCache[i];
+		}
+	}
+
+	Slot->Packet = *Packet;
+	Slot->Received = esp_timer_get_time();
+}
+
+// Forward every cached reading younger than the TTL.
+// Return: true if the cache answered the request on its own (at least one
+// 		   node known, none of them stale)
+bool NodeCache_Replay(void)
+{
+	int64_t Oldest = esp_timer_get_time() - (int64_t)NODE_CACHE_TTL_MS * 1000;
+	bool Known = false, Stale = false;
+	int i;
+
+	for (i = 0; i < NODE_CACHE_SIZE; i++)
+	{
+		if (!NodeCache[i].Received)
+		{
+			continue;
+		}
+		Known = true;
+
+		if (NodeCache[i].Received < Oldest)
+		{
+			Stale = true;
+			continue;
+		}
+
+		// Stored or relayed once already when it came in, so a replay that
+		// goes unanswered is not stored again. Leaves StoragePacket to the
+		// packet it belongs to.
+		MainPacket = NodeCache[i].Packet;
+		SendPacket();
+		AwaitingResponse = false;
+	}
+
+	return Known && !Stale;
+}
+
 bool StorePacket()
 {
+	uint8_t Record[STORAGE_RECORD_HEADER_LEN + MAX_PAYLOAD_LENGTH];
+	int32_t Values[SERIES_MAX_COLUMNS];
+	uint8_t Length = StoragePacket.Length;
+	uint32_t Timestamp;
+	esp_err_t err;
+	int i;
+
 	AwaitingResponse = false;
 
-	// write storage packet into sd card
+	// A request carries nothing worth keeping
+	if (StoragePacket.Pkt_Type == REQUEST_SENSOR_DATA)
+	{
+		return true;
+	}
+
+	// Node and timestamp pick the segment, the record keeps the rest
+	if (Length > MAX_PAYLOAD_LENGTH)
+	{
+		Length = MAX_PAYLOAD_LENGTH;
+	}
+	memcpy(&Timestamp, StoragePacket.Timestamp, TIMESTAMP_LENGTH);
+
+	// Only a copy, the card is written by the storage task. Never wait here,
+	// a full writer drops the record and counts it.
+	if (StoragePacket.Pkt_Type == RAW_SENSOR_DATA && Length && Length % 2 == 0 && Length / 2 <= SERIES_MAX_COLUMNS)
+	{
+		// Readings are 16 bit big endian words, kept as unsigned so signed
+		// and unsigned channels both come back bit exact; the series codec
+		// stores their deltas
+		for (i = 0; i < Length / 2; i++)
+		{
+			Values[i] = (StoragePacket.Payload[2 * i] << BYTE_SHIFT) | StoragePacket.Payload[2 * i + 1];
+		}
+		err = StorageWriter_SubmitSample(StoragePacket.NodeID, Timestamp, Values, Length / 2, 0);
+	}
+	else
+	{
+		Record[0] = StoragePacket.Pkt_Type;
+		memcpy(&Record[STORAGE_RECORD_HEADER_LEN], StoragePacket.Payload, Length);
+		err = StorageWriter_Submit(StoragePacket.NodeID, Timestamp, Record, STORAGE_RECORD_HEADER_LEN + Length, 0);
+	}
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Storage busy, packet dropped");
+		return false;
+	}
 
 	return true;
 }
@@ -411,6 +676,9 @@ bool ParsePacket(void)
 		// Send ACK
 		SendAck();
 
+		// Latest reading of this node, for later sink requests
+		NodeCache_Store(&MainPacket);
+
 		SendPacket();
 		break;
 
@@ -448,9 +716,16 @@ bool ParsePacket(void)
 		// Send ACK
 		SendAck();
 
-		// Check that data wasn't just requested
+		// Answer from the cache if every known node reported recently
+		if (NodeCache_Replay())
+		{
+			break;
+		}
+
+		// Check that data wasn't just requested: the poll already in flight
+		// answers this request as well
 		int Last_Request_Time = (esp_timer_get_time() - Last_DataRequest) / 1000;
-		if (Last_Request_Time < DATAREQ_DEBOUNCE_MS)
+		if (Last_DataRequest && Last_Request_Time < DATAREQ_DEBOUNCE_MS)
 		{
 			break;
 		}
@@ -462,6 +737,8 @@ bool ParsePacket(void)
 	// Packet contains processed sensor data
 	// here, the cluster head should act as a relay.
 	case PROCESSED_SENSOR_DATA:
+	case SENSOR_SUMMARY_DATA:
+	case SENSOR_BATCH_DATA:
 		// Check if awaiting response
 		if (AwaitingResponse)
 		{
@@ -515,6 +792,13 @@ bool ParsePacket(void)
 		// Send ACK
 		SendAck();
 
+		// Payload is the node asked for: answer for this one, forward the rest
+		if (MainPacket.Length >= BATTERY_REQ_LEN && MainPacket.Payload[0] == Unique_NodeID)
+		{
+			SendBatteryData();
+			break;
+		}
+
 		// Foward data
 		SendPacket();
 
@@ -542,6 +826,19 @@ bool ParsePacket(void)
 	// simple set flag low
 	case TX_ACK:
 		AwaitingResponse = false;
+#ifndef CONFIG_STORAGE_BACKEND_FLASH
+		Last_UplinkAck = esp_timer_get_time();
+#endif
+		break;
+
+	// backfill runs between a head and the sink, neither is relayed
+	case BACKFILL_ACK:
+#ifndef CONFIG_STORAGE_BACKEND_FLASH
+		Backfill_Ack(&Backfill, MainPacket.Payload, MainPacket.Length);
+#endif
+		break;
+
+	case BACKFILL_DATA:
 		break;
 
 	default:
@@ -563,6 +860,70 @@ bool ParsePacket(void)
 	return true;
 }
 
+// The cluster head has to keep listening and relaying, so of the energy
+// policy only the TX power applies to it
+void ApplyEnergyPolicy()
+{
+	Energy_Input_t Input;
+	Energy_Model_t Model;
+	Energy_Policy_t Policy;
+
+	if (EnergySource_Read(&Input.Remaining_mAh) != ESP_OK)
+	{
+		return;
+	}
+	Input.Capacity_mAh = ENERGY_CAPACITY_MAH;
+	Input.Remaining_S = 0; // curve only
+
+	Energy_DefaultModel(&Model, 0, Period);
+	Energy_Policy(&Input, &Model, &Policy);
+
+	// wait for lora module to be available
+	while(RX_Flag);
+	TX_Flag = true;
+	SetTxPower(Policy.Tx_Power);
+	TX_Flag = false;
+
+	ESP_LOGI(TAG, "%.0f mAh left, TX power %d dBm", Input.Remaining_mAh, Policy.Tx_Power);
+}
+
+// React to a battery level change from the power monitor
+void HandlePowerEvent(Power_Event_t Event)
+{
+	ApplyEnergyPolicy();
+
+	switch (Event)
+	{
+	case POWER_EVENT_LOW:
+		ESP_LOGW(TAG, "Battery low");
+		break;
+
+	case POWER_EVENT_RECOVERED:
+		ESP_LOGI(TAG, "Battery recovered");
+		break;
+
+	case POWER_EVENT_CRITICAL:
+		// ESP_LOGE(TAG, "Below critical voltage!");
+		// update network that cluster head is shutting off
+		SendBatteryData();
+
+		// Stored packets have to be on the card before the power goes
+		if (StorageWriter_Flush(pdMS_TO_TICKS(STORAGE_SLEEP_FLUSH_MS)) != ESP_OK)
+		{
+			ESP_LOGW(TAG, "Storage not flushed");
+		}
+
+		// shut off
+		uint64_t wakeup_time = EMERGENCY_SLEEP_TIME_SEC * MICROSECOND_CONVERSION;
+		esp_sleep_enable_timer_wakeup(wakeup_time);
+		ESP_LOGI(TAG, "Entering deep sleep for %d seconds...", EMERGENCY_SLEEP_TIME_SEC);
+
+		// The power monitor checks again after the wake
+		esp_deep_sleep_start();
+		break;
+	}
+}
+
 // Could add lora send functions here if needed.
 
 // main()
@@ -573,11 +934,35 @@ void app_main(void)
 	Period = DEFAULT_PERIOD;
 	Unique_NodeID = PLACEHOLDER_UNIQUEID; // place holder value
 
-	// Power_init();
-	ina219_init_desc(&MonitorHandle, INA219_ADDR_GND_GND, I2C_PORT, I2C_SDA, I2C_SCL);
-	ina219_init(&MonitorHandle);
-	ina219_configure(&MonitorHandle, INA219_BUS_RANGE_32V, INA219_GAIN_0_125, INA219_RES_12BIT_1S, INA219_RES_12BIT_1S, INA219_MODE_CONT_SHUNT_BUS);
-	ina219_calibrate(&MonitorHandle, SHUNT_RESISTANCE);
+	// Power monitor samples in the background, the main loop only sees its events
+	Power_Events = xQueueCreate(POWER_EVENT_QUEUE_LEN, sizeof(Power_Event_t));
+	PowerMonitor_Subscribe(Power_Events);
+	if (PowerMonitor_Start(I2C_PORT, I2C_SDA, I2C_SCL, SHUNT_RESISTANCE) != ESP_OK)
+	{
+		ESP_LOGE(TAG, "Power monitor not running");
+	}
+	EnergySource_Init(I2C_PORT, I2C_SDA, I2C_SCL);
+
+	// Packets that could not be delivered go to the SD card, or to the flash
+	// ring on heads without one
+#ifdef CONFIG_STORAGE_BACKEND_FLASH
+	if (StorageWriter_Start(FLASH_LOG_PARTITION) != ESP_OK)
+	{
+		ESP_LOGE(TAG, "No storage, undelivered packets will be lost");
+	}
+#else
+	sdmmc_card_t *card;
+	sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+	if (sd_card_init(MOUNT_POINT, host, &card) != ESP_OK
+		|| StorageWriter_Start(STORAGE_ROOT) != ESP_OK)
+	{
+		ESP_LOGE(TAG, "No storage, undelivered packets will be lost");
+	}
+	else if (Backfill_Open(&Backfill, STORAGE_ROOT) == ESP_OK)
+	{
+		Backfill_Ready = true;
+	}
+#endif
 
 	// Lora init
 	LoRaInit();
@@ -651,7 +1036,7 @@ void app_main(void)
 #endif
 		IterationCount ++;
 		int IterationTime;
-		float BusVoltage;
+		Power_Event_t PowerEvent;
 
 		// Check for packets
 		if (GetPacket()) {
@@ -667,20 +1052,18 @@ void app_main(void)
 			StorePacket();
 		}
 
-		// check power
-		ina219_get_bus_voltage(&MonitorHandle, &BusVoltage);
-		if (BusVoltage < CRITICAL_VOLTAGE)
+#ifndef CONFIG_STORAGE_BACKEND_FLASH
+		// Stored packets go upstream when the channel is free of live ones
+		if (!AwaitingResponse && !Buf_Flag)
 		{
-			// ESP_LOGE(TAG, "Below critical voltage!");
-			// update network that cluster head is shutting off?
-
-			// shut off
-			uint64_t wakeup_time = EMERGENCY_SLEEP_TIME_SEC * MICROSECOND_CONVERSION;
-			esp_sleep_enable_timer_wakeup(wakeup_time);
-			// ESP_LOGI(TAG, "Entering deep sleep for %d seconds...", EMERGENCY_SLEEP_TIME_SEC);
+			BackfillPoll();
+		}
+#endif
 
-			// Light sleep start
-			// esp_deep_sleep_start(); // deep sleep mode but LoRa wakeup is enabled
+		// check power
+		if (xQueueReceive(Power_Events, &PowerEvent, 0) == pdTRUE)
+		{
+			HandlePowerEvent(PowerEvent);
 		}
 
 #ifdef CONFIG_DEBUG_STUFF
@@ -0,0 +1,258 @@
+/**
+ * @file EnergyBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Energy benchmark. Brackets every operation the nodes repeat in the
+ * 			field with profiler markers and prints microjoules per operation
+ * 			as EPROF lines, so firmware changes can be compared on energy.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+// #includes
+/******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "../include/EnergyProfiler.h"
+#include "../include/Sensors.h"
+#include "../include/SensorRegistry.h"
+#include "../include/LoRa.h"
+#include "../include/memory.h"
+
+// #defines
+/******************************************************************************/
+#define I2C_SCL 42
+#define I2C_SDA 41
+#define I2C_PORT 0
+
+#define SHUNT_RESISTANCE 0.24
+
+#define US_PER_S 1000000LL
+
+#ifdef CONFIG_ENERGY_BENCH_REPEAT
+#define BENCH_REPEAT CONFIG_ENERGY_BENCH_REPEAT
+#define BENCH_SLEEP_S CONFIG_ENERGY_BENCH_SLEEP_S
+#else
+#define BENCH_REPEAT 10
+#define BENCH_SLEEP_S 5
+#endif
+
+#define BENCH_IDLE_MS 1000
+#define BENCH_RX_WINDOW_MS 1000
+#define BENCH_PAYLOAD_LEN 20			// a typical raw sensor data frame
+#define BENCH_SD_RECORD_LEN 512
+#define BENCH_CAD_TIMEOUT_MS 1000
+
+#define MOUNT_POINT "/sdcard"
+
+// CAD detection peaks per spreading factor, from LoRaCADTest.c
+#define CAD_DET_MIN 10
+static const uint8_t Cad_Det_Peak[] = {22, 22, 23, 24, 25, 28};	// SF 7..12
+
+// Variables
+/******************************************************************************/
+static const char *TAG = "EnergyBench.c";
+
+// System time the wake test went to sleep at, 0 when it is not running
+static RTC_DATA_ATTR int64_t Sleep_Start_US;
+
+// Functions
+/******************************************************************************/
+// System time, which keeps running through deep sleep
+static int64_t Local_US(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * US_PER_S + tv.tv_usec;
+}
+
+// Baseline: everything running, nothing to do. Includes the profiler's own
+// I2C polling, which every other operation pays for as well.
+static void Bench_Idle(void) {
+	int i;
+
+	for (i = 0; i < BENCH_REPEAT; i++) {
+		Profiler_Begin("idle_1s");
+		vTaskDelay(pdMS_TO_TICKS(BENCH_IDLE_MS));
+		Profiler_End();
+	}
+}
+
+// One read of each registered sensor, conversion time included
+static void Bench_Sensors(void) {
+	Sensor_Values_t Values[SENSOR_MAX_DRIVERS];
+	char Name[PROFILER_NAME_LEN];
+	uint32_t Registered;
+	int Slot, i;
+
+	Sensors_Init(ALL_SENSORS);
+	Registered = Sensors_Registered();
+
+	for (Slot = 0; Slot < SENSOR_MAX_DRIVERS; Slot++) {
+		if (!(Registered & SENSOR_SLOT_BIT(Slot))) {
+			continue;
+		}
+		snprintf(Name, sizeof(Name), "read_%s", Sensors_Driver(Slot)->Name);
+		for (i = 0; i < BENCH_REPEAT; i++) {
+			Profiler_Begin(Name);
+			Sensors_Run(SENSOR_SLOT_BIT(Slot), Values);
+			Profiler_End();
+		}
+	}
+}
+
+// Channel activity detection at the current spreading factor
+static void Cad_Once(uint8_t Spreading_Factor) {
+	int64_t Start = esp_timer_get_time();
+
+	SetCadParams(Spreading_Factor < 9 ? SX126X_CAD_ON_2_SYMB : SX126X_CAD_ON_4_SYMB,
+		Cad_Det_Peak[Spreading_Factor - 7], CAD_DET_MIN, SX126X_CAD_GOTO_STDBY, 0);
+	SetCad();
+	while (!(GetIrqStatus() & SX126X_IRQ_CAD_DONE)) {
+		if (esp_timer_get_time() - Start > BENCH_CAD_TIMEOUT_MS * 1000LL) {
+			ESP_LOGW(TAG, "CAD timed out");
+			break;
+		}
+	}
+	ClearIrqStatus(SX126X_IRQ_ALL);
+}
+
+// TX and CAD at every spreading factor, then an RX window
+static void Bench_Radio(void) {
+	uint8_t Payload[BENCH_PAYLOAD_LEN];
+	char Name[PROFILER_NAME_LEN];
+	uint8_t Spreading_Factor;
+	int i;
+
+	LoRaInit();
+
+	// set frequency
+	uint32_t frequencyInHz = 0;
+#if CONFIG_433MHZ
+	frequencyInHz = 433000000;
+#elif CONFIG_866MHZ
+	frequencyInHz = 866000000;
+#elif CONFIG_915MHZ
+	frequencyInHz = 915000000;
+#elif CONFIG_OTHER
+	frequencyInHz = CONFIG_OTHER_FREQUENCY * 1000000;
+#endif
+
+	// txco power configurations for LORA
+#if CONFIG_USE_TCXO
+	float tcxoVoltage = 3.3;	 // use TCXO
+	bool useRegulatorLDO = true; // use DCDC + LDO
+#else
+	float tcxoVoltage = 0.0;	  // don't use TCXO
+	bool useRegulatorLDO = false; // use only LDO in all modes
+#endif
+
+	if (LoRaBegin(frequencyInHz, 22, tcxoVoltage, useRegulatorLDO) != 0) {
+		ESP_LOGE(TAG, "Does not recognize the module, skipping radio");
+		return;
+	}
+
+	memset(Payload, 0xA5, sizeof(Payload));
+	for (Spreading_Factor = 7; Spreading_Factor <= 12; Spreading_Factor++) {
+		LoRaConfig(Spreading_Factor, 4, 1, 8, 0, true, false);
+
+		snprintf(Name, sizeof(Name), "tx_sf%d_%db", Spreading_Factor, BENCH_PAYLOAD_LEN);
+		for (i = 0; i < BENCH_REPEAT; i++) {
+			Profiler_Begin(Name);
+			if (LoRaSend(Payload, sizeof(Payload), SX126x_TXMODE_SYNC) == false) {
+				ESP_LOGW(TAG, "LoRaSend fail");
+			}
+			Profiler_End();
+		}
+
+		snprintf(Name, sizeof(Name), "cad_sf%d", Spreading_Factor);
+		for (i = 0; i < BENCH_REPEAT; i++) {
+			Profiler_Begin(Name);
+			Cad_Once(Spreading_Factor);
+			Profiler_End();
+		}
+	}
+
+	// Listening, still at SF 12
+	for (i = 0; i < BENCH_REPEAT; i++) {
+		Profiler_Begin("rx_window_1s");
+		SetRx(0xFFFFFF);
+		vTaskDelay(pdMS_TO_TICKS(BENCH_RX_WINDOW_MS));
+		SetStandby(SX126X_STANDBY_RC);
+		Profiler_End();
+	}
+}
+
+// One record appended to a file on the SD card
+static void Bench_SD(void) {
+	static char Record[BENCH_SD_RECORD_LEN + 1];
+	sdmmc_card_t *card;
+	sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+	int i;
+
+	if (sd_card_init(MOUNT_POINT, host, &card) != ESP_OK) {
+		ESP_LOGE(TAG, "SD Card failed to be initialized, skipping SD");
+		return;
+	}
+
+	memset(Record, 'x', BENCH_SD_RECORD_LEN - 1);
+	Record[BENCH_SD_RECORD_LEN - 1] = '\n';
+	for (i = 0; i < BENCH_REPEAT; i++) {
+		Profiler_Begin("sd_append_512b");
+		sd_card_append_file(MOUNT_POINT"/bench.txt", Record);
+		Profiler_End();
+	}
+	sd_card_delete_file(MOUNT_POINT"/bench.txt");
+}
+
+// Second half of the wake test. The MCU is off from the timer firing to
+// app_main(), so that stretch is charged at the first power reading after
+// the boot; the sleep itself is not measured.
+static void Bench_Wake(void) {
+	int64_t Boot_US = Local_US() - Sleep_Start_US - BENCH_SLEEP_S * US_PER_S;
+
+	Sleep_Start_US = 0;
+	vTaskDelay(pdMS_TO_TICKS(10));
+	Profiler_Record("deep_sleep_wake", (double)Profiler_Power() / 1000 * Boot_US, Boot_US);
+	Profiler_Print(false);
+	ESP_LOGI(TAG, "Benchmark done");
+}
+
+// main()
+/******************************************************************************/
+void app_main(void)
+{
+	if (Profiler_Start(I2C_PORT, I2C_SDA, I2C_SCL, SHUNT_RESISTANCE) != ESP_OK) {
+		ESP_LOGE(TAG, "No INA219, nothing to measure");
+		return;
+	}
+
+	if (Sleep_Start_US && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+		Bench_Wake();
+		return;
+	}
+
+	ESP_LOGI(TAG, "Energy benchmark, %d runs per operation", BENCH_REPEAT);
+	Bench_Idle();
+	Bench_Sensors();
+	Bench_Radio();
+	Bench_SD();
+	Profiler_Print(true);
+
+	// The wake row follows after the reset
+	Profiler_Stop();
+	esp_sleep_enable_timer_wakeup(BENCH_SLEEP_S * US_PER_S);
+	Sleep_Start_US = Local_US();
+	esp_deep_sleep_start();
+}
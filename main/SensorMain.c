@@ -13,19 +13,28 @@
 /******************************************************************************/
 #include <stddef.h>
 #include <string.h>
+#include <sys/time.h>
 
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_sleep.h"
+#include "freertos/semphr.h"
+#include "driver/temperature_sensor.h"
 
 #include "../include/Sensors.h"
+#include "../include/Sampler.h"
+#include "../include/SensorRegistry.h"
+#include "../include/Scheduler.h"
+#include "../include/RTCState.h"
+#include "../include/PowerMonitor.h"
+#include "../include/EnergyManager.h"
+#include "../include/EnergySource.h"
 #include "../include/LoRa.h"
 #include "../include/Protocol.h"
-#include <ina219.h>
 
 // #defines
 /******************************************************************************/
-#define MICROSECOND_TO_SECOND 1000000
 #define TIMEOUT_PERIOD 30					// timeout period in seconds
 #define BYTE_SHIFT 8						
 #define BYTE_MASK 0xFF
@@ -37,22 +46,15 @@
 
 #define SHUNT_RESISTANCE 0.24
 
+#define US_PER_S 1000000LL
+// Offsets are whole seconds, so drift is only estimated over long intervals
+#define DRIFT_MIN_INTERVAL_US (3600 * US_PER_S)
+
+// Main loop passes spent listening after a report, at 100 % RX duty
+#define AWAKE_ITERATIONS 20000
+
 // Data types
 /******************************************************************************/
-typedef struct {
-	float WindDirection;
-	float Temperature;
-	float Humidity;
-	float WindSpeed;
-	short Soil_Moisture;
-	float Soil_Temperature;
-} SensorData_t;
-
-union {
-	float f;
-	uint8_t b[4];
-} float_converter;
-
 typedef struct {
 	uint8_t *Buffer;
 	bool *Receiving;
@@ -63,15 +65,24 @@ typedef struct {
 // Variables
 /******************************************************************************/
 static bool AwaitingResponse;
-static uint16_t Period;
 static LORA_Packet_t MainPacket;
-static bool Sending, Response, MainPacket_Ready;
-static ina219_t MonitorHandle;
+static bool Sending, Response;
 static int Send_StartTime;
-SensorData_t SensorData;
-static uint8_t Unique_NodeID;
+static Sensor_Values_t SensorData[SENSOR_MAX_DRIVERS];
 static uint32_t TempTimestamp;
 
+// Protocol and network state, carried over deep sleep by the RTC state block
+static RTC_State_t *Retained;
+
+// Radio bring up runs on its own task, in parallel with the I2C side
+static StaticSemaphore_t Radio_Ready_Buffer;
+static SemaphoreHandle_t Radio_Ready;
+static int16_t Radio_Status;
+static bool Radio_Warm;
+
+// Time from wake to the first transmission, 0 until it happened
+static int64_t First_TX_US;
+
 
 static uint8_t Raw_Buf[MAX_BUFF];
 static bool RX_Flag, Buf_Flag, TX_Flag;
@@ -130,37 +141,184 @@ void task_rx(void *pvParameters) {
 }
 
 
-// Return: true for sucess
-// 		   false for fail
-bool SenseData() {
-	float TempFloat1, TempFloat2;
-	short TempShort;
-	// Initialize return value to true... will be set false on first fail
-	bool ret = true;
-
-	// Try reading soil moisture
-	if(Read_SoilMoisture(&TempShort) != ESP_OK) {
-		ret = false;
+// Die temperature, whole degrees. Only used to decide whether the radio
+// needs calibrating again, so it does not have to be accurate.
+static int8_t Die_Temperature(void) {
+	temperature_sensor_handle_t Handle;
+	temperature_sensor_config_t Config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+	float Celsius;
+	esp_err_t err;
+
+	if (temperature_sensor_install(&Config, &Handle) != ESP_OK) {
+		return LORA_TEMPERATURE_UNKNOWN;
+	}
+	err = temperature_sensor_enable(Handle);
+	if (err == ESP_OK) {
+		err = temperature_sensor_get_celsius(Handle, &Celsius);
+		temperature_sensor_disable(Handle);
 	}
-	// store reading
-	SensorData.Soil_Moisture = TempShort;
+	temperature_sensor_uninstall(Handle);
+
+	return err == ESP_OK ? (int8_t)lroundf(Celsius) : LORA_TEMPERATURE_UNKNOWN;
+}
+
+// Radio settings for this node
+static void Radio_Params(LoRaParams_t *Params) {
+	memset(Params, 0, sizeof(*Params));
+	Params->txPowerInDbm = Retained->Tx_Power;
+
+	// set frequency
+#if CONFIG_433MHZ
+	Params->frequencyInHz = 433000000;
+	ESP_LOGI(TAG, "Frequency is 433MHz");
+#elif CONFIG_866MHZ
+	Params->frequencyInHz = 866000000;
+	ESP_LOGI(TAG, "Frequency is 866MHz");
+#elif CONFIG_915MHZ
+	Params->frequencyInHz = 915000000;
+	ESP_LOGI(TAG, "Frequency is 915MHz");
+#elif CONFIG_OTHER
+	ESP_LOGI(TAG, "Frequency is %dMHz", CONFIG_OTHER_FREQUENCY);
+	Params->frequencyInHz = CONFIG_OTHER_FREQUENCY * 1000000;
+#endif
 
-	// Read wind speed and direction. No fail condition for these functions
-	SensorData.Soil_Moisture = Get_Wind_Speed();
-	SensorData.WindDirection = Get_Wind_Direction();
+	// txco power configurations for LORA
+#if CONFIG_USE_TCXO
+	Params->tcxoVoltage = 3.3;		// use TCXO
+	Params->useRegulatorLDO = true;	// use DCDC + LDO
+#else
+	Params->tcxoVoltage = 0.0;		// don't use TCXO
+	Params->useRegulatorLDO = false;	// use only LDO in all modes
+#endif
 
-	// Read humidity and temperature
-	if(!Read_SHT30_HumidityTemperature(&TempFloat1, &TempFloat2)) {
-		ret = false;
+	// NOTE: These variables could and maybe should be configured in the menuconfig
+	Params->spreadingFactor = Retained->Spreading_Factor;
+	Params->bandwidth = 4;
+	Params->codingRate = 1;
+	Params->preambleLength = 8;
+	Params->payloadLen = 0;
+	Params->crcOn = true;
+	Params->invertIrq = false;
+#if CONFIG_ADVANCED
+	Params->bandwidth = CONFIG_BANDWIDTH;
+	Params->codingRate = CONFIG_CODING_RATE;
+#endif
+}
+
+// Fresh network state after a cold boot, or when the RTC block was lost
+static void Retained_Defaults(void) {
+	Retained->Node_ID = 101; // place holder value
+	Retained->Period = DEFAULT_PERIOD;
+	Retained->Tx_Power = 22;
+	Retained->Rx_Duty = 100;
+	Retained->Spreading_Factor = 12;
+#if CONFIG_ADVANCED
+	Retained->Spreading_Factor = CONFIG_SF_RATE;
+#endif
+}
+
+// System time, which keeps running through deep sleep
+static int64_t Local_US(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * US_PER_S + tv.tv_usec;
+}
+
+// Network time in seconds, the same clock the scheduler stamps records with
+static uint32_t Network_Time(void) {
+	return RTCState_NetworkTime(Local_US());
+}
+
+// Take the network time from a TIME_UPDATE. The drift estimate comes from
+// how far the offset moved since the previous update.
+static void Time_Sync(uint32_t Network) {
+	int64_t Now = Local_US();
+	int32_t Offset = (int64_t)Network - Now / US_PER_S;
+	int64_t Elapsed = Now - Retained->Last_Sync_US;
+
+	if (Retained->Last_Sync_US && Elapsed >= DRIFT_MIN_INTERVAL_US) {
+		Retained->Drift_PPM = (float)(Retained->Time_Offset_S - Offset) * 1e6f / ((float)Elapsed / US_PER_S);
+	}
+	Retained->Time_Offset_S = Offset;
+	Retained->Last_Sync_US = Now;
+	RTCState_Commit();
+}
+
+// Fit the schedule and radio to what is left in the battery. Runs once per
+// radio wake; the settings carry over deep sleep in the RTC state block.
+static void Energy_Update(void) {
+	Energy_Input_t Input;
+	Energy_Model_t Model;
+	Energy_Policy_t Policy;
+	// The local clock starts at 0 with a cold boot, i.e. at deployment
+	int64_t Uptime_S = Local_US() / US_PER_S;
+	int64_t Target_S = (int64_t)ENERGY_TARGET_DAYS * 86400;
+
+	if (EnergySource_Read(&Input.Remaining_mAh) != ESP_OK) {
+		return;
+	}
+	Input.Capacity_mAh = ENERGY_CAPACITY_MAH;
+	Input.Remaining_S = Uptime_S < Target_S ? Target_S - Uptime_S : 0;
+
+	Energy_DefaultModel(&Model, SCHEDULE_WIND_INTERVAL_S, Retained->Period);
+	Energy_Policy(&Input, &Model, &Policy);
+
+	Scheduler_SetPace(Policy.Period_Scale, (uint32_t)SCHEDULE_BATCH_SIZE * Policy.Batch_Percent / 100);
+	Retained->Tx_Power = Policy.Tx_Power;
+	if (Policy.Spreading_Factor) {
+		Retained->Spreading_Factor = Policy.Spreading_Factor;
+	}
+	Retained->Rx_Duty = Policy.Rx_Duty;
+
+	ESP_LOGI(TAG, "%.0f mAh left: period x%.2f, batch %d%%, %d dBm, RX %d%%", Input.Remaining_mAh,
+		Policy.Period_Scale / 100.0f, Policy.Batch_Percent, Policy.Tx_Power, Policy.Rx_Duty);
+}
+
+// Radio bring up task. After a deep sleep the radio usually still holds its
+// configuration, and only has to be put back into RX.
+void task_radio(void *pvParameters) {
+	LoRaParams_t Params;
+
+	Radio_Params(&Params);
+	LoRaInit();
+	Radio_Status = LoRaWarmBegin(&Params, Die_Temperature(), &Radio_Warm);
+	if (Radio_Status == ERR_NONE && !Radio_Warm) {
+		ClearIrqStatus(SX126X_IRQ_ALL);
 	}
-	// Store readings
-	SensorData.Temperature = TempFloat1;
-	SensorData.Humidity = TempFloat2;
+
+	xSemaphoreGive(Radio_Ready);
+	vTaskDelete(NULL);
+}
+
+static void Radio_Start(void) {
+	Radio_Ready = xSemaphoreCreateBinaryStatic(&Radio_Ready_Buffer);
+	xTaskCreate(&task_radio, "Radio", 1024*4, NULL, 5, NULL);
+}
+
+// Log how long the first transmission took after the wake. Cold boots give
+// the baseline, warm ones what RTC caching saves.
+static void Mark_FirstTX(void) {
+	if (First_TX_US == 0) {
+		First_TX_US = esp_timer_get_time();
+		ESP_LOGI(TAG, "Wake to first TX: %lld us (%s radio start)", First_TX_US, Radio_Warm ? "warm" : "cold");
+	}
+}
+
+// Return: true for sucess
+// 		   false for fail
+bool SenseData() {
+	uint32_t Read;
+
+	// Readings the scheduler (or an earlier request) took within
+	// SENSOR_CACHE_TTL_MS are reused. The rest are started together, so this
+	// only takes as long as the slowest stale sensor.
+	Read = Sensors_Cached(Sensors_Registered(), SensorData, SENSOR_CACHE_TTL_MS);
 
 	// read particle data
 	// ReadParticle()
 
-	return ret;
+	return Read == Sensors_Registered();
 }
 
 
@@ -249,6 +407,7 @@ bool SendAck()
 	
 	// Set TX flag and send
 	TX_Flag = true;
+	Mark_FirstTX();
 	if (LoRaSend(buffer, tx_len, SX126x_TXMODE_SYNC) == false)
 	{
 		ESP_LOGE(TAG, "LoRaSend fail");
@@ -288,6 +447,7 @@ bool SendMainPacket() {
 	
 	// Set TX flag and send
 	TX_Flag = true;
+	Mark_FirstTX();
 	if (LoRaSend(buffer, tx_len, SX126x_TXMODE_SYNC) == false)
 	{
 		ESP_LOGE(TAG, "LoRaSend fail");
@@ -303,6 +463,69 @@ bool SendMainPacket() {
 	return true;
 }
 
+// Send statistics of the wind samples taken since the last report
+bool SendSummaryPacket() {
+	Sampler_Summary_t Summary;
+
+	Sampler_GetSummary(&Summary, true);
+
+	MainPacket.NodeID = Retained->Node_ID;
+	MainPacket.Pkt_Type = SENSOR_SUMMARY_DATA;
+
+	TempTimestamp = Network_Time();
+	memcpy(&MainPacket.Timestamp, &TempTimestamp, 4);
+	MainPacket.Length = Sampler_EncodeSummary(&Summary, MainPacket.Payload);
+
+	Calculate_CRC(&MainPacket);
+
+	return SendMainPacket();
+}
+
+// Send every sample the scheduler batched since the last report. Records
+// only leave the batch once their packet went out.
+bool SendBatchPackets() {
+	uint8_t Length;
+
+	while (Scheduler_BatchLength() > 0) {
+		MainPacket.NodeID = Retained->Node_ID;
+		MainPacket.Pkt_Type = SENSOR_BATCH_DATA;
+
+		TempTimestamp = Network_Time();
+		memcpy(&MainPacket.Timestamp, &TempTimestamp, 4);
+		Length = Scheduler_PeekBatch(MainPacket.Payload, MAX_PACKET_LENGTH - BASE_PACKET_LEGNTH);
+		if (Length == 0) {
+			break;
+		}
+		MainPacket.Length = Length;
+
+		Calculate_CRC(&MainPacket);
+
+		if (!SendMainPacket()) {
+			return false;
+		}
+		Scheduler_ConsumeBatch(Length);
+	}
+
+	return true;
+}
+
+// Sleep until the scheduler's next deadline, or until LoRa activity
+void EnterSleep(bool Radio_Up) {
+	if (Radio_Up) {
+		// Enable wakeup from LoRa activity
+		// Enable channel activity interrupt on DIO1
+		SetDioIrqParams(SX126X_IRQ_CAD_DETECTED, SX126X_IRQ_CAD_DETECTED, SX126X_IRQ_NONE, SX126X_IRQ_NONE);
+	}
+
+	// NOTE: Pin 18 has to be wired to pin 33
+	esp_sleep_enable_ext1_wakeup(GPIO_NUM_18, ESP_EXT1_WAKEUP_ANY_HIGH);
+
+	// Go to sleep until the earliest sample or report deadline
+	esp_sleep_enable_timer_wakeup(Scheduler_PrepareSleep());
+	RTCState_Commit();
+	esp_deep_sleep_start();
+}
+
 // Get packet from RX buffer and store into main packet
 bool GetPacket() {
 	// Return false if there's no packet
@@ -315,6 +538,12 @@ bool GetPacket() {
 	TX_Flag = true;
 	Buf_Flag = false;
 
+	// A length past what a packet can carry would read beyond the frame
+	if (Raw_Buf[6] > MAX_PACKET_LENGTH - BASE_PACKET_LEGNTH) {
+		TX_Flag = false;
+		return false;
+	}
+
 	// Transfer bytes from lora buffer into main packet structure
 	MainPacket.NodeID = Raw_Buf[0];
 	MainPacket.Pkt_Type = Raw_Buf[1];
@@ -330,13 +559,17 @@ bool GetPacket() {
 }
 
 bool ParsePacket() {
+	int64_t Request_Start;
+
 	// The sensor node only has to respond to a few packet types
 	switch (MainPacket.Pkt_Type) {
 		case PERIOD_UPDATE:
 			// Access new period from payload
 			//update period
-			Period = MainPacket.Payload[0] << BYTE_SHIFT;
-			Period += MainPacket.Payload[1];
+			Retained->Period = MainPacket.Payload[0] << BYTE_SHIFT;
+			Retained->Period += MainPacket.Payload[1];
+			Scheduler_SetReportPeriod(Retained->Period);
+			RTCState_Commit();
 
 			// Acknowledge Packet
 			SendAck();
@@ -344,41 +577,22 @@ bool ParsePacket() {
 			break;
 
 		case REQUEST_SENSOR_DATA:
-			// sense data
+			// sense data, mostly from the cache the scheduler filled
+			Request_Start = esp_timer_get_time();
 			SenseData();
+			ESP_LOGI(TAG, "Data request sensed in %lld us", (long long)(esp_timer_get_time() - Request_Start));
 
 			// build packet
-			MainPacket.NodeID = Unique_NodeID;
+			MainPacket.NodeID = Retained->Node_ID;
 			MainPacket.Pkt_Type = RAW_SENSOR_DATA;
 
-			TempTimestamp = 100;		// replace with actual stamp later
+			TempTimestamp = Network_Time();
 			memcpy(&MainPacket.Timestamp, &TempTimestamp, 4);
-			MainPacket.Length = RAW_SENSOR_DATA_LEN;
 
 			// Store payload
-			// structure is in pag 104 of jacob's eng notebook
-			MainPacket.Payload[0] = SensorData.Soil_Moisture >> BYTE_SHIFT;
-			MainPacket.Payload[1] = SensorData.Soil_Moisture & BYTE_MASK;
-			
-			// float conversion for soil temperature
-			float_converter.f = SensorData.Soil_Temperature;
-			memcpy(MainPacket.Payload + 2, &float_converter.b, 4);
-
-			// float conversion for humidity
-			float_converter.f = SensorData.Humidity;
-			memcpy(MainPacket.Payload + 6, &float_converter.b, 4);
-
-			// float conversion for temperature
-			float_converter.f = SensorData.Temperature;
-			memcpy(MainPacket.Payload + 10, &float_converter.b, 4);
-
-			// float conversion of wind speed
-			float_converter.f = SensorData.WindSpeed;
-			memcpy(MainPacket.Payload + 14, &float_converter.b, 4);
-
-			// float conversion of wind direction
-			float_converter.f = SensorData.WindSpeed;
-			memcpy(MainPacket.Payload + 18, &float_converter.b, 4);
+			// Built in sensors keep the layout on pag 104 of jacob's eng
+			// notebook (RAW_SENSOR_DATA_LEN bytes), extra drivers follow.
+			MainPacket.Length = Sensors_Encode(Sensors_Registered(), SensorData, MainPacket.Payload, MAX_PACKET_LENGTH - BASE_PACKET_LEGNTH);
 
 			// Calculate and store CRC
 			Calculate_CRC(&MainPacket);
@@ -386,16 +600,28 @@ bool ParsePacket() {
 			// Acknowledge Packet
 			SendAck();
 
-			return SendMainPacket();
+			if (!SendMainPacket()) {
+				return false;
+			}
+
+			// Follow up with the windowed wind statistics
+			return SendSummaryPacket();
+
+		case TIME_UPDATE:
+			// Network time, big endian seconds
+			Time_Sync(((uint32_t)MainPacket.Payload[0] << 24) | ((uint32_t)MainPacket.Payload[1] << 16)
+				| ((uint32_t)MainPacket.Payload[2] << 8) | MainPacket.Payload[3]);
+
+			// Acknowledge Packet
+			SendAck();
+
+			break;
 
 		// for all other cases, break
 		default:
 			break;
 	}
 
-	// Reset ready flag
-	MainPacket_Ready = false;
-
 	return true;
 }
 
@@ -404,59 +630,54 @@ bool ParsePacket() {
 
 void app_main(void)
 {
+	bool Radio_Needed;
+
+	// Period, node ID, time sync and the schedule all come back from RTC
+	// memory, so a wake carries on where the last one left off
+	Retained = RTCState_Get();
+	if (!RTCState_Load()) {
+		Retained_Defaults();
+	}
+
+	// Each sensor has its own interval. Sample whichever are due into the
+	// batch, then go straight back to sleep unless a report is due or LoRa
+	// activity woke us up. The radio stays untouched on sample only wakes.
+	Scheduler_Init(Retained->Period);
+	Radio_Needed = Scheduler_TxDue() || esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT1;
+
+	// The radio is on SPI, everything else on I2C, so it comes up meanwhile
+	if (Radio_Needed) {
+		Radio_Start();
+	}
+
 	// Initialization and configuration
 	Sensors_Init(ALL_SENSORS);
+	Scheduler_Run();
+	if (!Radio_Needed) {
+		// The report may have come due while sampling
+		if (!Scheduler_TxDue()) {
+			EnterSleep(false);
+		}
+		Radio_Start();
+	}
+
+	// Sample wind in the background so reports carry window statistics
+	Sampler_Start();
 	
-	// Power_init();
-	ina219_init_desc(&MonitorHandle, INA219_ADDR_GND_GND, I2C_PORT, I2C_SDA, I2C_SCL);
-	ina219_init(&MonitorHandle);
-	ina219_configure(&MonitorHandle, INA219_BUS_RANGE_32V, INA219_GAIN_0_125, INA219_RES_12BIT_1S, INA219_RES_12BIT_1S, INA219_MODE_CONT_SHUNT_BUS);
-	ina219_calibrate(&MonitorHandle, SHUNT_RESISTANCE);
+	// Power monitor for the energy manager
+	PowerMonitor_Start(I2C_PORT, I2C_SDA, I2C_SCL, SHUNT_RESISTANCE);
+	EnergySource_Init(I2C_PORT, I2C_SDA, I2C_SCL);
 
 	//init timer
 	esp_timer_init();
 
-	// assign unique node id
-	Unique_NodeID = 101; // place holder value
-
 	// init variables
 	Sending = false;
 	Response = false;
-	Period = DEFAULT_PERIOD;
 
-	// Lora init
-	LoRaInit();
-	int8_t txPowerInDbm = 22;
-
-	// set frequency
-	uint32_t frequencyInHz = 0;
-#if CONFIG_433MHZ
-	frequencyInHz = 433000000;
-	ESP_LOGI(TAG, "Frequency is 433MHz");
-#elif CONFIG_866MHZ
-	frequencyInHz = 866000000;
-	ESP_LOGI(TAG, "Frequency is 866MHz");
-#elif CONFIG_915MHZ
-	frequencyInHz = 915000000;
-	ESP_LOGI(TAG, "Frequency is 915MHz");
-#elif CONFIG_OTHER
-	ESP_LOGI(TAG, "Frequency is %dMHz", CONFIG_OTHER_FREQUENCY);
-	frequencyInHz = CONFIG_OTHER_FREQUENCY * 1000000;
-#endif
-
-	// txco power configurations for LORA
-#if CONFIG_USE_TCXO
-	ESP_LOGW(TAG, "Enable TCXO");
-	float tcxoVoltage = 3.3;	 // use TCXO
-	bool useRegulatorLDO = true; // use DCDC + LDO
-#else
-	ESP_LOGW(TAG, "Disable TCXO");
-	float tcxoVoltage = 0.0;	  // don't use TCXO
-	bool useRegulatorLDO = false; // use only LDO in all modes
-#endif
-
-	// begin the lora module
-	if (LoRaBegin(frequencyInHz, txPowerInDbm, tcxoVoltage, useRegulatorLDO) != 0)
+	// Wait for the radio
+	xSemaphoreTake(Radio_Ready, portMAX_DELAY);
+	if (Radio_Status != ERR_NONE)
 	{
 		ESP_LOGE(TAG, "Does not recognize the module");
 		while (1)
@@ -465,27 +686,15 @@ void app_main(void)
 		}
 	}
 
-	// NOTE: These variables could and maybe should be configured in the menuconfig
-	uint8_t spreadingFactor = 12;
-	uint8_t bandwidth = 4;
-	uint8_t codingRate = 1;
-	uint16_t preambleLength = 8;
-	uint8_t payloadLen = 0;
-	bool crcOn = true;
-	bool invertIrq = false;
-#if CONFIG_ADVANCED
-	spreadingFactor = CONFIG_SF_RATE;
-	bandwidth = CONFIG_BANDWIDTH;
-	codingRate = CONFIG_CODING_RATE;
-#endif
-	LoRaConfig(spreadingFactor, bandwidth, codingRate, preambleLength, payloadLen, crcOn, invertIrq);
-
-	ClearIrqStatus(SX126X_IRQ_ALL);
-
 	// esp_timer_init() // apparently this is already initialized
 
 	// Start RX
 	xTaskCreate(&task_rx, "RX", 1024*4, &TaskFlags, 5, NULL);
+
+	// Report everything sampled since the last one
+	if (Scheduler_TxDue() && SendBatchPackets()) {
+		Scheduler_TxDone();
+	}
 	
 	int IterationCount = 0;
 	while(1) {
@@ -493,27 +702,16 @@ void app_main(void)
 		vTaskDelay(1);
 
 		// check incoming packets
-		if (MainPacket_Ready) {
-			GetPacket();
+		if (GetPacket()) {
 			ParsePacket();
 		}
 
-		// Stay awake for some time before sleep
-		if (IterationCount++ < 20000) {
+		// Stay awake for some time before sleep, shorter on a low battery
+		if (IterationCount++ < AWAKE_ITERATIONS * Retained->Rx_Duty / 100) {
 			continue;
 		}
 		// if some time has passed: 
-
-		// Enable wakeup from LoRa activity
-		// Enable channel activity interrupt on DIO1
-		SetDioIrqParams(SX126X_IRQ_CAD_DETECTED, SX126X_IRQ_CAD_DETECTED, SX126X_IRQ_NONE, SX126X_IRQ_NONE);
-
-		// NOTE: Pin 18 has to be wired to pin 33
-		esp_sleep_enable_ext1_wakeup(GPIO_NUM_18, ESP_EXT1_WAKEUP_ANY_HIGH);
-
-
-		// Go to sleep for period
-		esp_sleep_enable_timer_wakeup(Period * MICROSECOND_TO_SECOND);
-		esp_deep_sleep_start();
+		Energy_Update();
+		EnterSleep(true);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,413 @@
+/**
+ * @file BackfillTest.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host backfill test over a simulated LoRa link. Stores days of series
+ * 			blocks (as the storage writer stores them) and numbered event
+ * 			records for a few nodes, as an outage would leave them, then
+ * 			drains the store through a backfill session: fragments and
+ * 			acknowledgements are lost at random, live frames take their
+ * 			airtime in between, and the sender reboots at random points,
+ * 			resuming from its cursor file. Every record must arrive, in
+ * 			store order per node; only records already sent before a reboot
+ * 			may come again. A session right after must send nothing, and
+ * 			records stored afterwards go with the next one. Reports the
+ * 			goodput against the channel's capacity and against sending one
+ * 			sample per frame.
+ *
+ * 			gcc -O2 -Iinclude scripts/BackfillTest.c components/storage/Backfill.c components/storage/Segment.c components/storage/SeriesCodec.c components/storage/RecordLog.c -o backfilltest -lm
+ * 			./backfilltest -d 3 -l 10
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/Backfill.h"
+#include "../include/SeriesCodec.h"
+
+// #defines
+/******************************************************************************/
+#define T_ORIGIN 1790035200U			// start of a day bucket
+#define DAY_S 86400
+#define COLUMNS 2
+#define BLOCK_SIZE 512
+#define SPAN_S 600						// STORAGE_WRITER_SERIES_SPAN_S
+#define EVENT_TYPE 0x05
+#define FRAME_OVERHEAD 8				// node, type, timestamp, length, CRC
+#define SAMPLE_PAYLOAD 12				// RAW_SENSOR_DATA_LEN
+#define LIVE_PAYLOAD 12
+#define IDLE_MS 10						// main loop turn with nothing to send
+#define RETRY_MS 60000					// CLUSTER_BACKFILL_INTERVAL_S
+
+// Variables
+/******************************************************************************/
+typedef struct {
+	uint32_t Timestamp;
+	uint16_t Length;
+	uint32_t Crc;
+} Expected_t;
+
+typedef struct {
+	Expected_t *Records;
+	uint32_t Count;
+	uint32_t Size;
+	uint32_t Got;				// next record due
+	Series_Encoder_t Encoder;
+	uint8_t Block[1 + BLOCK_SIZE];
+	uint32_t Bucket;
+	bool Open;
+	uint32_t Events;
+} Node_t;
+
+typedef struct {
+	uint32_t Delivered;
+	uint32_t Duplicates;
+	uint32_t Bad;
+	uint64_t Bytes;
+	uint64_t Samples;
+} Check_t;
+
+static SegmentStore_t Live;
+static Backfill_t Backfill;
+static Backfill_Receiver_t Receiver;
+static Node_t *Nodes;
+static uint32_t Node_Count;
+static Check_t Check;
+static uint8_t Spreading = 9;
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -r dir   scratch directory, emptied first (/tmp/backfilltest)\n"
+		"  -d days  outage stored (3)\n"
+		"  -n n     nodes (4)\n"
+		"  -p s     sample period (10)\n"
+		"  -l %%     frames lost, either way (10)\n"
+		"  -s sf    spreading factor, 125 kHz, 4/5 (9)\n"
+		"  -L ms    live frames every ms on average, 0 for none (5000)\n"
+		"  -c n     a sender reboot every n fragments on average, 0 for none (400)\n",
+		Name);
+}
+
+// Semtech AN1200.13, explicit header, CRC on, 8 symbol preamble
+static double Airtime_MS(uint32_t Length)
+{
+	double Symbol = (double)(1 << Spreading) / 125.0;
+	int Low_Rate = Spreading >= 11;
+	double Symbols = ceil((8.0 * Length - 4 * Spreading + 28 + 16) / (4.0 * (Spreading - 2 * Low_Rate)));
+
+	return (8 + 4.25 + 8 + (Symbols > 0 ? Symbols * 5 : 0)) * Symbol;
+}
+
+static uint32_t Crc(const uint8_t *Data, uint16_t Length)
+{
+	return RecordLog_Crc32(0, Data, Length);
+}
+
+static void Expect(uint8_t Node, uint32_t Timestamp, const uint8_t *Data, uint16_t Length)
+{
+	Node_t *N = &Nodes[Node];
+
+	if (SegmentStore_Append(&Live, Node, Timestamp, Data, Length) != ESP_OK) {
+		fprintf(stderr, "append failed\n");
+		exit(1);
+	}
+	if (N->Count == N->Size) {
+		N->Size = N->Size ? 2 * N->Size : 1024;
+		N->Records = realloc(N->Records, N->Size * sizeof(Expected_t));
+	}
+	N->Records[N->Count].Timestamp = Timestamp;
+	N->Records[N->Count].Length = Length;
+	N->Records[N->Count].Crc = Crc(Data, Length);
+	N->Count++;
+}
+
+static void Block_Store(uint8_t Node)
+{
+	Node_t *N = &Nodes[Node];
+	uint16_t Length = Series_EncodeEnd(&N->Encoder);
+
+	N->Open = false;
+	if (Length) {
+		Expect(Node, N->Encoder.Min_T, N->Block, 1 + Length);
+	}
+}
+
+static void Sample_Add(uint8_t Node, uint32_t T)
+{
+	Node_t *N = &Nodes[Node];
+	uint32_t Bucket = T - T % SEGMENT_BUCKET_S;
+	Series_Value_t Values[COLUMNS];
+	int c;
+
+	for (c = 0; c < COLUMNS; c++) {
+		Values[c].Int = (int32_t)((T % DAY_S) / 60) * (c ? -3 : 5) + (int32_t)((T * 2654435761U ^ Node) % 201) - 100;
+	}
+	if (N->Open && (N->Bucket != Bucket || T > N->Encoder.Min_T + SPAN_S)) {
+		Block_Store(Node);
+	}
+	if (!N->Open) {
+		N->Block[0] = SERIES_RECORD_TAG;
+		Series_EncodeBegin(&N->Encoder, &N->Block[1], BLOCK_SIZE, COLUMNS, 0);
+		N->Bucket = Bucket;
+		N->Open = true;
+	}
+	if (Series_Append(&N->Encoder, T, Values) != ESP_OK) {
+		Block_Store(Node);
+		Sample_Add(Node, T);
+	}
+}
+
+// An outage's worth of storage: samples of every node, an event an hour
+static void Store(uint32_t T_Start, uint32_t T_End, uint32_t Period)
+{
+	uint8_t Event[8];
+	uint32_t T;
+	uint8_t Node;
+
+	for (T = T_Start; T < T_End; T += Period) {
+		for (Node = 0; Node < Node_Count; Node++) {
+			Sample_Add(Node, T);
+			if (T % 3600 == 0) {
+				Event[0] = EVENT_TYPE;
+				Event[1] = Node;
+				memcpy(&Event[4], &Nodes[Node].Events, 4);
+				Nodes[Node].Events++;
+				Expect(Node, T, Event, sizeof(Event));
+			}
+		}
+	}
+	for (Node = 0; Node < Node_Count; Node++) {
+		if (Nodes[Node].Open) {
+			Block_Store(Node);
+		}
+	}
+	SegmentStore_Sync(&Live);
+}
+
+// Records must come in store order per node. After a reboot the sender goes
+// back to its last acknowledged record, so earlier ones may come again.
+static void Received(uint8_t Node, uint32_t Timestamp, const uint8_t *Data, uint16_t Length, void *Context)
+{
+	Series_Decoder_t Decoder;
+	Series_Value_t Values[SERIES_MAX_COLUMNS];
+	uint32_t Sum, T, i;
+	Node_t *N;
+
+	(void)Context;
+	if (Node >= Node_Count) {
+		Check.Bad++;
+		return;
+	}
+	N = &Nodes[Node];
+	Sum = Crc(Data, Length);
+	if (N->Got < N->Count && N->Records[N->Got].Timestamp == Timestamp && N->Records[N->Got].Length == Length
+		&& N->Records[N->Got].Crc == Sum) {
+		N->Got++;
+		Check.Delivered++;
+		Check.Bytes += Length;
+		if (Length > 1 && Data[0] == SERIES_RECORD_TAG && Series_DecodeBegin(&Decoder, Data + 1, Length - 1) == ESP_OK) {
+			while (Series_Next(&Decoder, &T, Values) == ESP_OK) {
+				Check.Samples++;
+			}
+		}
+		return;
+	}
+	for (i = N->Got; i-- > 0;) {
+		if (N->Records[i].Timestamp == Timestamp && N->Records[i].Length == Length && N->Records[i].Crc == Sum) {
+			Check.Duplicates++;
+			return;
+		}
+	}
+	if (Check.Bad++ < 10) {
+		printf("node %u: record at %u out of order, %u of %u due\n", Node, Timestamp, N->Got, N->Count);
+	}
+}
+
+static bool Lost(uint32_t Loss)
+{
+	return (uint32_t)(rand() % 100) < Loss;
+}
+
+static void Reboot(const char *Root)
+{
+	Backfill_Stats_t Stats = Backfill.Stats;
+
+	Backfill_End(&Backfill);
+	if (Backfill_Open(&Backfill, Root) != ESP_OK) {
+		fprintf(stderr, "backfill open failed\n");
+		exit(1);
+	}
+	Backfill.Stats = Stats;
+}
+
+// Run sessions as the cluster head's main loop would until one sends
+// everything. Returns the simulated time taken, ms.
+static double Drain(const char *Root, uint32_t Loss, uint32_t Live_MS, uint32_t Reboot_Every, uint32_t *Reboots)
+{
+	uint8_t Payload[BACKFILL_FRAGMENT_LEN], Ack[BACKFILL_ACK_BYTES];
+	uint32_t Sessions = Backfill.Stats.Sessions;
+	double Now = 0, Next_Live = 0, Retry = 0;
+	uint8_t Length, Ack_Length;
+
+	while (Backfill.Stats.Sessions == Sessions) {
+		if (!Backfill.Active) {
+			if (Now < Retry) {
+				Now = Retry;
+			}
+			Retry = Now + RETRY_MS;
+			if (Backfill_Begin(&Backfill, rand()) != ESP_OK) {
+				fprintf(stderr, "backfill begin failed\n");
+				exit(1);
+			}
+		}
+
+		// Live traffic goes first, with its acknowledgement
+		if (Live_MS && Now >= Next_Live) {
+			Now += Airtime_MS(FRAME_OVERHEAD + LIVE_PAYLOAD) + Airtime_MS(FRAME_OVERHEAD);
+			Next_Live += -log((rand() + 1.0) / (RAND_MAX + 2.0)) * Live_MS;
+			continue;
+		}
+
+		Length = Backfill_NextFragment(&Backfill, (int64_t)Now, Payload);
+		if (Length == 0) {
+			Now += IDLE_MS;
+			continue;
+		}
+		Now += Airtime_MS(FRAME_OVERHEAD + Length);
+		if (!Lost(Loss)) {
+			Ack_Length = Backfill_Receive(&Receiver, Payload, Length, Ack);
+			if (Ack_Length) {
+				Now += Airtime_MS(FRAME_OVERHEAD + Ack_Length);
+				if (!Lost(Loss)) {
+					Backfill_Ack(&Backfill, Ack, Ack_Length);
+				}
+			}
+		}
+
+		if (Reboot_Every && rand() % Reboot_Every == 0) {
+			Reboot(Root);
+			(*Reboots)++;
+			Retry = Now;
+		}
+	}
+	return Now;
+}
+
+static uint32_t Missing(void)
+{
+	uint32_t Count = 0, Node;
+
+	for (Node = 0; Node < Node_Count; Node++) {
+		if (Nodes[Node].Got != Nodes[Node].Count) {
+			if (Count < 10) {
+				printf("node %u: %u of %u records\n", Node, Nodes[Node].Got, Nodes[Node].Count);
+			}
+			Count++;
+		}
+	}
+	return Count;
+}
+
+int main(int argc, char **argv)
+{
+	const char *Root = "/tmp/backfilltest";
+	uint32_t Days = 3, Period = 10, Loss = 10, Live_MS = 5000, Reboot_Every = 400, Reboots = 0, Fragments, Records;
+	uint32_t Bad = 0, Node;
+	char Command[SEGMENT_PATH_LEN + 16];
+	double Elapsed, Capacity, Per_Sample, Bytes, Samples;
+	int Opt;
+
+	Node_Count = 4;
+	while ((Opt = getopt(argc, argv, "r:d:n:p:l:s:L:c:h")) != -1) {
+		switch (Opt) {
+		case 'r': Root = optarg; break;
+		case 'd': Days = atoi(optarg); break;
+		case 'n': Node_Count = atoi(optarg); break;
+		case 'p': Period = atoi(optarg); break;
+		case 'l': Loss = atoi(optarg); break;
+		case 's': Spreading = atoi(optarg); break;
+		case 'L': Live_MS = atoi(optarg); break;
+		case 'c': Reboot_Every = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Days == 0 || Node_Count == 0 || Node_Count > BACKFILL_MAX_NODES || Period == 0 || Loss >= 100
+		|| Spreading < 7 || Spreading > 12) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	Nodes = calloc(Node_Count, sizeof(Node_t));
+	snprintf(Command, sizeof(Command), "rm -rf %s", Root);
+	if (system(Command) != 0 || SegmentStore_Open(&Live, Root, 0) != ESP_OK || Backfill_Open(&Backfill, Root) != ESP_OK) {
+		perror(Root);
+		return 1;
+	}
+	Backfill_ReceiverInit(&Receiver, Received, NULL);
+	srand(1);
+
+	// The outage's backlog, drained
+	Store(T_ORIGIN, T_ORIGIN + Days * DAY_S, Period);
+	Elapsed = Drain(Root, Loss, Live_MS, Reboot_Every, &Reboots);
+	Bad += Missing();
+	Bytes = Check.Bytes;
+	Samples = Check.Samples;
+
+	// Nothing new: nothing to send
+	Fragments = Backfill.Stats.Fragments;
+	Drain(Root, Loss, 0, 0, &Reboots);
+	if (Backfill.Stats.Fragments != Fragments) {
+		printf("%u fragments sent with nothing stored since\n", Backfill.Stats.Fragments - Fragments);
+		Bad++;
+	}
+
+	// Another outage, the same store: only the new records go
+	Records = Check.Delivered;
+	Store(T_ORIGIN + Days * DAY_S, T_ORIGIN + Days * DAY_S + DAY_S / 4, Period);
+	Drain(Root, Loss, Live_MS, Reboot_Every, &Reboots);
+	Bad += Missing();
+	SegmentStore_Close(&Live);
+	Backfill_End(&Backfill);
+
+	// Capacity: full fragments back to back, each window's acknowledgement
+	// included; the baseline sends each sample in its own acknowledged frame
+	Capacity = BACKFILL_FRAGMENT_DATA * 1000.0
+		/ (Airtime_MS(FRAME_OVERHEAD + BACKFILL_FRAGMENT_LEN)
+			+ Airtime_MS(FRAME_OVERHEAD + BACKFILL_ACK_BYTES) / BACKFILL_WINDOW);
+	Per_Sample = 1000.0 / (Airtime_MS(FRAME_OVERHEAD + SAMPLE_PAYLOAD) + Airtime_MS(FRAME_OVERHEAD));
+
+	printf("%u days, %u nodes, SF%u, %u%% lost each way, %u reboots: %u records (%u new after), %llu samples, "
+		"%.1f kB\n", Days, Node_Count, Spreading, Loss, Reboots, Check.Delivered, Check.Delivered - Records,
+		(unsigned long long)Check.Samples, Check.Bytes / 1e3);
+	printf("fragments: %u, %u resent, %u timeouts, %u acks, %u sessions (%u aborted), %u cursor writes\n",
+		Backfill.Stats.Fragments, Backfill.Stats.Retransmits, Backfill.Stats.Timeouts, Backfill.Stats.Acks,
+		Backfill.Stats.Sessions, Backfill.Stats.Aborted, Backfill.Stats.Cursor_Writes);
+	printf("receiver: %u fragments, %u duplicate fragments, %u duplicate records, %u errors; %u wrong\n",
+		Receiver.Stats.Fragments, Receiver.Stats.Duplicates, Check.Duplicates, Receiver.Stats.Errors,
+		Check.Bad + Bad);
+	printf("backlog drained in %.0f s simulated: %.0f B/s of %.0f B/s capacity (%.0f%%), %.1f samples/s against "
+		"%.1f sending one per frame (x%.0f)\n", Elapsed / 1e3, Bytes * 1000 / Elapsed, Capacity,
+		Bytes * 1000 / Elapsed * 100 / Capacity, Samples * 1000 / Elapsed, Per_Sample, Samples * 1000 / Elapsed / Per_Sample);
+
+	system(Command);
+	for (Node = 0; Node < Node_Count; Node++) {
+		free(Nodes[Node].Records);
+	}
+	free(Nodes);
+	return Bad || Check.Bad || Backfill.Stats.Errors || Receiver.Stats.Errors ? 1 : 0;
+}
@@ -0,0 +1,463 @@
+/**
+ * @file CompactTest.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host compaction test in accelerated time. Writes months of series
+ * 			blocks (as the storage writer stores them) and a daily event
+ * 			record per node through a segment store, steps the compactor
+ * 			every simulated hour as an idle storage task would, and cuts
+ * 			the power at random points of its jobs. Afterwards every
+ * 			sample must be counted exactly once, in raw records, minute
+ * 			or hour summaries; summaries must hold the generator's
+ * 			min/max/mean; events may not repeat; and nothing older than
+ * 			its level's age may be left. Reports the step times and the
+ * 			space the levels take.
+ *
+ * 			gcc -O2 -Iinclude scripts/CompactTest.c components/storage/Compactor.c components/storage/Segment.c components/storage/SeriesCodec.c components/storage/RecordLog.c -o compacttest
+ * 			./compacttest -d 120 -c 24
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/Compactor.h"
+
+// #defines
+/******************************************************************************/
+#define T_ORIGIN 1790035200U			// start of a day bucket
+#define DAY_S 86400
+#define COLUMNS 2
+#define BLOCK_SIZE 512
+#define SPAN_S 600						// STORAGE_WRITER_SERIES_SPAN_S
+#define EVENT_TYPE 0x05
+#define STEPS_PER_HOUR 100				// the storage task polls far more often
+
+// Variables
+/******************************************************************************/
+typedef struct {
+	uint32_t Count;
+	int32_t Min[COLUMNS];
+	int32_t Max[COLUMNS];
+	int64_t Sum[COLUMNS];
+} Window_t;
+
+typedef struct {
+	Series_Encoder_t Encoder;
+	uint8_t Record[1 + BLOCK_SIZE];
+	uint32_t Bucket;
+	bool Open;
+} Block_t;
+
+static SegmentStore_t Live;
+static Compactor_t Compactor;
+static Segment_Query_t Query;
+static uint8_t Query_Buffer[SEGMENT_MIN_QUERY_BUFFER];
+static uint32_t Ages[COMPACTOR_LEVELS];
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -r dir   scratch directory, emptied first (/tmp/compacttest)\n"
+		"  -d days  simulated time (120)\n"
+		"  -n n     nodes (3)\n"
+		"  -p s     sample period (10)\n"
+		"  -c h     a power cut every h simulated hours on average, 0 for none (24)\n"
+		"  -R days  raw age (7)\n"
+		"  -M days  minute summary age (30)\n"
+		"  -H days  hour summary age, 0 keeps them (0)\n"
+		"  -b us    step budget (5000)\n",
+		Name);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Reading of a node's column at T: a daily ramp plus scatter, negative too
+static int32_t Value(uint8_t Node, uint32_t T, uint8_t Column)
+{
+	uint32_t Hash = (T * 2654435761U) ^ (Node * 40503U) ^ (Column * 97U);
+
+	Hash ^= Hash >> 15;
+	Hash *= 2246822519U;
+	Hash ^= Hash >> 13;
+	return (int32_t)((T % DAY_S) / 60) * (Column ? -3 : 5) + (int32_t)(Hash % 2001) - 1000;
+}
+
+static void Window_Add(Window_t *Window, const int32_t *Min, const int64_t *Sum, const int32_t *Max, uint32_t Count)
+{
+	int c;
+
+	for (c = 0; c < COLUMNS; c++) {
+		if (Window->Count == 0 || Min[c] < Window->Min[c]) {
+			Window->Min[c] = Min[c];
+		}
+		if (Window->Count == 0 || Max[c] > Window->Max[c]) {
+			Window->Max[c] = Max[c];
+		}
+		Window->Sum[c] += Sum[c];
+	}
+	Window->Count += Count;
+}
+
+static int64_t Mean(const Window_t *Window, int c)
+{
+	int64_t Half = Window->Count / 2;
+
+	return (Window->Sum[c] >= 0 ? Window->Sum[c] + Half : Window->Sum[c] - Half) / (int64_t)Window->Count;
+}
+
+static void Block_Store(uint8_t Node, Block_t *Block)
+{
+	uint16_t Length = Series_EncodeEnd(&Block->Encoder);
+
+	Block->Open = false;
+	if (Length && SegmentStore_Append(&Live, Node, Block->Encoder.Min_T, Block->Record, 1 + Length) != ESP_OK) {
+		fprintf(stderr, "block append failed\n");
+		exit(1);
+	}
+}
+
+static void Block_Add(uint8_t Node, Block_t *Block, uint32_t T, const Series_Value_t *Values)
+{
+	uint32_t Bucket = T - T % SEGMENT_BUCKET_S;
+
+	if (Block->Open && (Block->Bucket != Bucket || T > Block->Encoder.Min_T + SPAN_S)) {
+		Block_Store(Node, Block);
+	}
+	if (!Block->Open) {
+		Block->Record[0] = SERIES_RECORD_TAG;
+		Series_EncodeBegin(&Block->Encoder, &Block->Record[1], BLOCK_SIZE, COLUMNS, 0);
+		Block->Bucket = Bucket;
+		Block->Open = true;
+	}
+	if (Series_Append(&Block->Encoder, T, Values) != ESP_OK) {
+		Block_Store(Node, Block);
+		Block_Add(Node, Block, T, Values);
+	}
+}
+
+// Cut the logs here without sealing, as a power loss would
+static void Abandon(SegmentStore_t *Store)
+{
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] != NULL) {
+			RecordLog_Close(&Store->Logs[i]);
+			Store->Owners[i] = NULL;
+		}
+	}
+}
+
+static void Start(const char *Root)
+{
+	Compactor_Stats_t Stats = Compactor.Stats;
+
+	if (Compactor_Start(&Compactor, Root, &Live) != ESP_OK) {
+		fprintf(stderr, "compactor start failed\n");
+		exit(1);
+	}
+	Stats.Undone += Compactor.Stats.Undone;
+	Compactor.Stats = Stats;
+	memcpy(Compactor.Age_S, Ages, sizeof(Ages));
+}
+
+static uint64_t Directory_Bytes(const char *Path, uint32_t *Files)
+{
+	char Child[PATH_MAX];
+	struct dirent *Entry;
+	struct stat Info;
+	uint64_t Bytes = 0;
+	DIR *Dir = opendir(Path);
+
+	while (Dir != NULL && (Entry = readdir(Dir)) != NULL) {
+		if (Entry->d_name[0] == '.' || strcmp(Entry->d_name, COMPACTOR_MINUTE_DIR) == 0
+			|| strcmp(Entry->d_name, COMPACTOR_HOUR_DIR) == 0) {
+			continue;
+		}
+		// A cut name would stat some other file and throw the sizes off
+		if (snprintf(Child, sizeof(Child), "%s/%s", Path, Entry->d_name) >= (int)sizeof(Child)) {
+			fprintf(stderr, "path too long under %s\n", Path);
+			exit(1);
+		}
+		if (stat(Child, &Info) != 0) {
+			continue;
+		}
+		if (S_ISDIR(Info.st_mode)) {
+			Bytes += Directory_Bytes(Child, Files);
+		} else {
+			Bytes += Info.st_size;
+			(*Files)++;
+		}
+	}
+	if (Dir != NULL) {
+		closedir(Dir);
+	}
+	return Bytes;
+}
+
+int main(int argc, char **argv)
+{
+	const char *Root = "/tmp/compacttest";
+	uint32_t Days = 120, Nodes = 3, Period = 10, Cut_Hours = 24, Budget = 5000, Hours, Minutes;
+	uint32_t T, T_End, Hour_T, i, Cuts = 0, Units, Level, Files, Events, *Event_Seen, Bad = 0, Left = 0;
+	uint64_t Samples = 0, Seen, Bytes;
+	char Path[SEGMENT_PATH_LEN], Command[SEGMENT_PATH_LEN + 16];
+	Series_Value_t Values[COLUMNS];
+	int32_t Ints[COLUMNS], Min[COLUMNS], Max[COLUMNS];
+	int64_t Sums[COLUMNS];
+	Window_t *Minute, *Hour, *Got, *Got_Hour, *W;
+	Block_t *Blocks;
+	Segment_Record_t Record;
+	Series_Decoder_t Decoder;
+	uint8_t Node, Event[8];
+	double Elapsed;
+	int Opt, c;
+
+	Ages[COMPACTOR_RAW] = 7 * DAY_S;
+	Ages[COMPACTOR_MINUTE] = 30 * DAY_S;
+	Ages[COMPACTOR_HOUR] = 0;
+	while ((Opt = getopt(argc, argv, "r:d:n:p:c:R:M:H:b:h")) != -1) {
+		switch (Opt) {
+		case 'r': Root = optarg; break;
+		case 'd': Days = atoi(optarg); break;
+		case 'n': Nodes = atoi(optarg); break;
+		case 'p': Period = atoi(optarg); break;
+		case 'c': Cut_Hours = atoi(optarg); break;
+		case 'R': Ages[COMPACTOR_RAW] = atoi(optarg) * DAY_S; break;
+		case 'M': Ages[COMPACTOR_MINUTE] = atoi(optarg) * DAY_S; break;
+		case 'H': Ages[COMPACTOR_HOUR] = atoi(optarg) * DAY_S; break;
+		case 'b': Budget = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Days == 0 || Nodes == 0 || Nodes > 255 || Period == 0 || Period > 60 || 60 % Period) {
+		Usage(argv[0]);
+		return 1;
+	}
+	Hours = Days * 24;
+	Minutes = Hours * 60;
+	T_End = T_ORIGIN + Days * DAY_S;
+
+	// What the generator wrote, per node and window
+	Minute = calloc((size_t)Nodes * Minutes, sizeof(Window_t));
+	Hour = calloc((size_t)Nodes * Hours, sizeof(Window_t));
+	Got = calloc((size_t)Nodes * Minutes, sizeof(Window_t));
+	Got_Hour = calloc((size_t)Nodes * Hours, sizeof(Window_t));
+	Blocks = calloc(Nodes, sizeof(Block_t));
+	Event_Seen = calloc((size_t)Nodes * Days, sizeof(uint32_t));
+	snprintf(Command, sizeof(Command), "rm -rf %s", Root);
+	if (system(Command) != 0 || SegmentStore_Open(&Live, Root, 0) != ESP_OK) {
+		perror(Root);
+		return 1;
+	}
+	Start(Root);
+
+	srand(1);
+	Elapsed = Seconds();
+	for (T = T_ORIGIN; T < T_End; T += Period) {
+		for (Node = 0; Node < Nodes; Node++) {
+			for (c = 0; c < COLUMNS; c++) {
+				Values[c].Int = Ints[c] = Value(Node, T, c);
+				Sums[c] = Ints[c];
+			}
+			Block_Add(Node, &Blocks[Node], T, Values);
+			Window_Add(&Minute[Node * Minutes + (T - T_ORIGIN) / 60], Ints, Sums, Ints, 1);
+			Window_Add(&Hour[Node * Hours + (T - T_ORIGIN) / 3600], Ints, Sums, Ints, 1);
+			Samples++;
+
+			// A daily record that is not a sample, numbered
+			if (T % DAY_S == 3600) {
+				i = Node * Days + (T - T_ORIGIN) / DAY_S;
+				Event[0] = EVENT_TYPE;
+				memcpy(&Event[4], &i, sizeof(i));
+				SegmentStore_Append(&Live, Node, T, Event, sizeof(Event));
+			}
+		}
+		if ((T + Period) % 3600 != 0) {
+			continue;
+		}
+
+		// An idle storage task, once a simulated hour
+		for (i = 0; i < STEPS_PER_HOUR && !(Compactor.Swept && !Compactor.Busy); i++) {
+			Compactor_Step(&Compactor, T, Budget);
+		}
+
+		// Power cut: in the middle of a job, a random number of records in
+		if (Cut_Hours && rand() % Cut_Hours == 0) {
+			for (Units = rand() % 2000; Units; Units--) {
+				Compactor_Step(&Compactor, T, 0);
+			}
+			for (Node = 0; Node < Nodes; Node++) {
+				if (Blocks[Node].Open) {
+					Block_Store(Node, &Blocks[Node]);
+				}
+			}
+			SegmentStore_Sync(&Live);
+			Abandon(&Live);
+			Abandon(&Compactor.Out);
+			Segment_QueryEnd(&Compactor.Query);
+			SegmentStore_Open(&Live, Root, 0);
+			Start(Root);
+			Cuts++;
+		}
+	}
+	for (Node = 0; Node < Nodes; Node++) {
+		if (Blocks[Node].Open) {
+			Block_Store(Node, &Blocks[Node]);
+		}
+	}
+	SegmentStore_Sync(&Live);
+
+	// Whatever is due at the end, done
+	T = T_End - 1;
+	Compactor.Swept = false;
+	for (i = 0; i < 1000000 && !(Compactor.Swept && !Compactor.Busy); i++) {
+		Compactor_Step(&Compactor, T, Budget);
+	}
+	Elapsed = Seconds() - Elapsed;
+	SegmentStore_Close(&Live);
+
+	// Read every level back
+	for (Level = COMPACTOR_RAW; Level < COMPACTOR_LEVELS; Level++) {
+		if (Compactor_LevelRoot(Path, Root, Level) != ESP_OK) {
+			fprintf(stderr, "root %s too long\n", Root);
+			return 1;
+		}
+		for (Node = 0; Node < Nodes; Node++) {
+			Segment_QueryBegin(&Query, Path, Compactor_LevelBucket(Level), Node, 0, UINT32_MAX, Query_Buffer,
+				sizeof(Query_Buffer));
+
+			// Nothing past its age may be left, but segments still being written
+			for (i = 0; i < Query.Bucket_Count; i++) {
+				if (Ages[Level] && (uint64_t)Query.Buckets[i] + Compactor_LevelBucket(Level) + Ages[Level] <= T) {
+					printf("level %u node %u: segment %08X is past its age\n", Level, Node, Query.Buckets[i]);
+					Left++;
+				}
+			}
+
+			while (Segment_QueryNext(&Query, &Record) == ESP_OK) {
+				if (Record.Length > 1 && Record.Data[0] == SERIES_RECORD_TAG && Level == COMPACTOR_RAW
+					&& Series_DecodeBegin(&Decoder, Record.Data + 1, Record.Length - 1) == ESP_OK) {
+					while (Series_Next(&Decoder, &Record.Timestamp, Values) == ESP_OK) {
+						for (c = 0; c < COLUMNS; c++) {
+							Ints[c] = Values[c].Int;
+							Sums[c] = Ints[c];
+						}
+						Window_Add(&Got[Node * Minutes + (Record.Timestamp - T_ORIGIN) / 60], Ints, Sums, Ints, 1);
+					}
+				} else if (Record.Length == COMPACTOR_SUMMARY_LEN(COLUMNS) && Record.Data[0] == COMPACTOR_SUMMARY_TAG
+					&& Level != COMPACTOR_RAW) {
+					memcpy(&i, Record.Data + 4, sizeof(i));
+					for (c = 0; c < COLUMNS; c++) {
+						memcpy(&Min[c], Record.Data + COMPACTOR_SUMMARY_HEADER + 12 * c, 4);
+						memcpy(&Ints[c], Record.Data + COMPACTOR_SUMMARY_HEADER + 12 * c + 4, 4);
+						memcpy(&Max[c], Record.Data + COMPACTOR_SUMMARY_HEADER + 12 * c + 8, 4);
+						Sums[c] = (int64_t)Ints[c] * i;
+					}
+					if (Level == COMPACTOR_MINUTE) {
+						W = &Minute[Node * Minutes + (Record.Timestamp - T_ORIGIN) / 60];
+						Window_Add(&Got[Node * Minutes + (Record.Timestamp - T_ORIGIN) / 60], Min, Sums, Max, i);
+					} else {
+						W = &Hour[Node * Hours + (Record.Timestamp - T_ORIGIN) / 3600];
+						Window_Add(&Got_Hour[Node * Hours + (Record.Timestamp - T_ORIGIN) / 3600], Min, Sums, Max, i);
+					}
+					// Minute means are exact; hour means come from rounded
+					// minute means, within one unit
+					for (c = 0; c < COLUMNS; c++) {
+						if (i != W->Count || Min[c] != W->Min[c] || Max[c] != W->Max[c]
+							|| llabs(Ints[c] - Mean(W, c)) > (Level == COMPACTOR_HOUR)) {
+							if (Bad++ < 10) {
+								printf("level %u node %u window %u: count %u min %d mean %d max %d, want %u %d %lld %d\n",
+									Level, Node, Record.Timestamp, i, Min[c], Ints[c], Max[c], W->Count, W->Min[c],
+									(long long)Mean(W, c), W->Max[c]);
+							}
+						}
+					}
+				} else if (Record.Length == sizeof(Event) && Record.Data[0] == EVENT_TYPE) {
+					memcpy(&i, Record.Data + 4, sizeof(i));
+					if (i >= Nodes * Days || Event_Seen[i]++) {
+						printf("event %u repeated\n", i);
+						Bad++;
+					}
+				} else {
+					printf("level %u node %u: unexpected record at %u\n", Level, Node, Record.Timestamp);
+					Bad++;
+				}
+			}
+			Segment_QueryEnd(&Query);
+		}
+	}
+
+	// Every sample exactly once: raw and minute counts per minute, hour
+	// counts per hour
+	Seen = 0;
+	for (Node = 0; Node < Nodes; Node++) {
+		for (i = 0; i < Hours; i++) {
+			W = &Got_Hour[Node * Hours + i];
+			for (c = 0; c < 60; c++) {
+				W->Count += Got[(Node * Hours + i) * 60 + c].Count;
+			}
+			Seen += W->Count;
+			Hour_T = T_ORIGIN + i * 3600;
+			if (W->Count != Hour[Node * Hours + i].Count && !(W->Count == 0 && Ages[COMPACTOR_HOUR]
+				&& (uint64_t)Hour_T - Hour_T % COMPACTOR_HOUR_BUCKET_S + COMPACTOR_HOUR_BUCKET_S + Ages[COMPACTOR_HOUR] <= T)) {
+				if (Bad++ < 10) {
+					printf("node %u hour %u: %u samples, %u written\n", Node, i, W->Count, Hour[Node * Hours + i].Count);
+				}
+			}
+		}
+	}
+	for (Events = 0, i = 0; i < Nodes * Days; i++) {
+		Events += Event_Seen[i];
+	}
+
+	printf("%u days, %u nodes, %llu samples every %u s, %u power cuts: %u jobs, %u undone, %u errors, %.1f s\n", Days,
+		Nodes, (unsigned long long)Samples, Period, Cuts, Compactor.Stats.Jobs, Compactor.Stats.Undone,
+		Compactor.Stats.Errors, Elapsed);
+	printf("samples back: %llu; events kept: %u of %u; %u wrong, %u past their age\n", (unsigned long long)Seen, Events,
+		Nodes * Days, Bad, Left);
+	printf("steps: %u, longest %.2f ms (budget %.2f ms)\n", Compactor.Stats.Steps, Compactor.Stats.Max_Step_US / 1e3,
+		Budget / 1e3);
+	for (Level = COMPACTOR_RAW; Level < COMPACTOR_LEVELS; Level++) {
+		if (Compactor_LevelRoot(Path, Root, Level) != ESP_OK) {
+			fprintf(stderr, "root %s too long\n", Root);
+			return 1;
+		}
+		Files = 0;
+		Bytes = Directory_Bytes(Path, &Files);
+		printf("level %u: %.2f MB in %u files\n", Level, Bytes / 1e6, Files);
+	}
+	printf("freed %.2f MB\n", Compactor.Stats.Bytes_Freed / 1e6);
+
+	system(Command);
+	free(Minute);
+	free(Hour);
+	free(Got);
+	free(Got_Hour);
+	free(Blocks);
+	free(Event_Seen);
+	return Bad || Left || Compactor.Stats.Errors ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file EnergySim.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host battery life projection. Runs the node's energy policy hour by
+ * 			hour against the consumption model until the battery is empty,
+ * 			next to a node that ignores the policy.
+ *
+ * 			gcc -O2 -Iinclude scripts/EnergySim.c components/power/EnergyManager.c -lm -o energysim
+ * 			./energysim -c 7000 -t 365 -r 600 -s 60
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/EnergyManager.h"
+
+// #defines
+/******************************************************************************/
+#define HOURS_PER_DAY 24
+#define MAX_DAYS (10 * 365)
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -c mAh   battery capacity (%d)\n"
+		"  -t days  target lifetime, 0 = curve only (%d)\n"
+		"  -r s     report period (600)\n"
+		"  -s s     shortest sampling interval (60)\n"
+		"  -z uA    sleep current (%d)\n"
+		"  -w mAs   charge per sample wake (%d)\n"
+		"  -x mAs   charge per full report (%d)\n"
+		"  -l mA    listening current (%d)\n"
+		"  -p days  print every n days (30)\n",
+		Name, ENERGY_CAPACITY_MAH, ENERGY_TARGET_DAYS, ENERGY_SLEEP_UA,
+		ENERGY_SAMPLE_MAS, ENERGY_REPORT_MAS, ENERGY_LISTEN_MA);
+}
+
+// Hours until the battery is empty. With Managed false the node stays at the
+// curve's full battery settings throughout.
+static uint32_t Project(const Energy_Model_t *Model, float Capacity, uint32_t Target_Days, bool Managed, uint32_t Print_Days)
+{
+	static const Energy_Input_t Full = {.Remaining_mAh = 1, .Capacity_mAh = 1};
+	Energy_Input_t Input = {.Remaining_mAh = Capacity, .Capacity_mAh = Capacity};
+	Energy_Policy_t Policy;
+	uint32_t Hour = 0, Target_S = Target_Days * 86400;
+	float Current;
+
+	if (Print_Days) {
+		printf("%6s %6s %8s %6s %6s %5s %9s\n", "day", "SoC %", "period", "batch", "dBm", "RX %", "mA");
+	}
+
+	while (Input.Remaining_mAh > 0 && Hour < MAX_DAYS * HOURS_PER_DAY) {
+		Input.Remaining_S = Hour * 3600 < Target_S ? Target_S - Hour * 3600 : 0;
+		Energy_Policy(Managed ? &Input : &Full, Model, &Policy);
+		Current = Energy_AverageCurrent(Model, &Policy);
+
+		if (Print_Days && Hour % (Print_Days * HOURS_PER_DAY) == 0) {
+			printf("%6u %6.1f %7.2fx %5u%% %6d %4u%% %9.3f\n", Hour / HOURS_PER_DAY,
+				100 * Input.Remaining_mAh / Capacity, Policy.Period_Scale / 100.0f,
+				Policy.Batch_Percent, Policy.Tx_Power, Policy.Rx_Duty, Current);
+		}
+
+		Input.Remaining_mAh -= Current;
+		Hour++;
+	}
+
+	return Hour;
+}
+
+int main(int argc, char **argv)
+{
+	Energy_Model_t Model;
+	float Capacity = ENERGY_CAPACITY_MAH;
+	uint32_t Target_Days = ENERGY_TARGET_DAYS, Print_Days = 30;
+	uint32_t Report_S = 600, Sample_S = 60;
+	uint32_t Managed, Unmanaged;
+	int Opt;
+
+	Energy_DefaultModel(&Model, Sample_S, Report_S);
+	while ((Opt = getopt(argc, argv, "c:t:r:s:z:w:x:l:p:h")) != -1) {
+		switch (Opt) {
+		case 'c': Capacity = atof(optarg); break;
+		case 't': Target_Days = atoi(optarg); break;
+		case 'r': Report_S = atoi(optarg); break;
+		case 's': Sample_S = atoi(optarg); break;
+		case 'z': Model.Sleep_uA = atof(optarg); break;
+		case 'w': Model.Sample_mAs = atof(optarg); break;
+		case 'x': Model.Report_mAs = atof(optarg); break;
+		case 'l': Model.Listen_mA = atof(optarg); break;
+		case 'p': Print_Days = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	Model.Report_Period_S = Report_S;
+	Model.Sample_Interval_S = Sample_S;
+
+	Managed = Project(&Model, Capacity, Target_Days, true, Print_Days);
+	Unmanaged = Project(&Model, Capacity, Target_Days, false, 0);
+
+	printf("\nmanaged:   %.1f days\n", Managed / (float)HOURS_PER_DAY);
+	printf("unmanaged: %.1f days\n", Unmanaged / (float)HOURS_PER_DAY);
+	if (Target_Days) {
+		printf("target:    %u days, %s\n", Target_Days, Managed >= Target_Days * HOURS_PER_DAY ? "met" : "missed");
+	}
+
+	return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file FixedPointTest.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host test of the integer sensor conversions that feed
+ * 			RAW_SENSOR_DATA. Golden raw codes for the SHT3x, the seesaw
+ * 			soil sensor, the anemometer and the wind vane are converted
+ * 			with FixedPoint.h and encoded with the payload helpers, and
+ * 			both the value and the wire bytes must match what was worked
+ * 			out by hand (exact fractions, round half up). Every SHT3x code
+ * 			is also checked against a double precision reference, and the
+ * 			int16/uint16 encoders are checked at their saturation edges.
+ *
+ * 			gcc -O2 -Iinclude scripts/FixedPointTest.c -o fixedpointtest -lm
+ * 			./fixedpointtest -v
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/FixedPoint.h"
+#include "../include/SensorRegistry.h"
+
+// #defines
+/******************************************************************************/
+#define WIRE_INT16 0
+#define WIRE_UINT16 1
+
+// Variables
+/******************************************************************************/
+// One conversion: the raw input, the value in wire units and the two bytes
+// it goes on the air as
+typedef struct {
+	int64_t Raw;
+	int32_t Value;
+	uint8_t Wire[2];
+} Golden_t;
+
+// SHT3x temperature, int16 centi degrees C
+static const Golden_t SHT3X_Temperature[] = {
+	{0x0000, -4500, {0xEE, 0x6C}},		// bottom of the range, -45 C
+	{0x0001, -4500, {0xEE, 0x6C}},
+	{0x3F2C, -182, {0xFF, 0x4A}},		// just below freezing
+	{0x5E7E, 1960, {0x07, 0xA8}},
+	{0x6666, 2500, {0x09, 0xC4}},		// exactly 25 C
+	{0x8000, 4250, {0x10, 0x9A}},
+	{0xB798, 8051, {0x1F, 0x73}},
+	{0xFFFE, 13000, {0x32, 0xC8}},
+	{0xFFFF, 13000, {0x32, 0xC8}},		// top of the range, 130 C
+};
+
+// SHT3x humidity, uint16 centi percent RH
+static const Golden_t SHT3X_Humidity[] = {
+	{0x0000, 0, {0x00, 0x00}},
+	{0x0001, 0, {0x00, 0x00}},
+	{0x3F2C, 2468, {0x09, 0xA4}},
+	{0x5E7E, 3691, {0x0E, 0x6B}},
+	{0x6666, 4000, {0x0F, 0xA0}},
+	{0x8000, 5000, {0x13, 0x88}},
+	{0xB798, 7172, {0x1C, 0x04}},
+	{0xFFFF, 10000, {0x27, 0x10}},
+};
+
+// Seesaw temperature, signed 16.16 to int16 centi degrees C
+static const Golden_t Seesaw_Temperature[] = {
+	{0, 0, {0x00, 0x00}},
+	{-1, 0, {0x00, 0x00}},					// rounds to zero, not -1
+	{0x7FFF, 50, {0x00, 0x32}},
+	{0x8000, 50, {0x00, 0x32}},
+	{25 << 16, 2500, {0x09, 0xC4}},
+	{0x194000, 2525, {0x09, 0xDD}},			// 25.25 C
+	{(25 << 16) + 0x8000, 2550, {0x09, 0xF6}},
+	{-(10 << 16), -1000, {0xFC, 0x18}},
+	{400 << 16, 40000, {0x7F, 0xFF}},		// saturates
+	{-(400 << 16), -40000, {0x80, 0x00}},
+	{INT32_MAX, 3276800, {0x7F, 0xFF}},
+	{INT32_MIN, -3276800, {0x80, 0x00}},
+};
+
+// Seesaw moisture, raw capacitance passed through as uint16
+static const Golden_t Seesaw_Moisture[] = {
+	{0x0000, 0, {0x00, 0x00}},
+	{0x0140, 320, {0x01, 0x40}},			// dry
+	{0x03F6, 1014, {0x03, 0xF6}},			// wet
+	{0xFFFF, 65535, {0xFF, 0xFF}},
+};
+
+// Anemometer, pulses in a 1 s window to uint16 centi km/h
+static const Golden_t Wind_Speed[] = {
+	{0, 0, {0x00, 0x00}},
+	{1, 240, {0x00, 0xF0}},
+	{3, 720, {0x02, 0xD0}},
+	{273, 65520, {0xFF, 0xF0}},				// last speed that fits
+	{274, 65760, {0xFF, 0xFF}},				// saturates
+	{17896, 4295040, {0xFF, 0xFF}},			// past 2^32 in the product
+	{65535, 15728400, {0xFF, 0xFF}},
+};
+
+// Wind vane, bearing in hundredths of a degree to uint16 tenths of a degree
+static const Golden_t Wind_Direction[] = {
+	{0, 0, {0x00, 0x00}},
+	{6, 1, {0x00, 0x01}},
+	{2250, 225, {0x00, 0xE1}},				// sector 1
+	{18000, 1800, {0x07, 0x08}},
+	{33750, 3375, {0x0D, 0x2F}},			// sector 15
+	{35994, 3599, {0x0E, 0x0F}},
+	{35996, 0, {0x00, 0x00}},				// rounds up to 360, wraps to north
+	{35999, 0, {0x00, 0x00}},
+};
+
+// Saturation edges of the payload helpers
+static const Golden_t Int16_Edges[] = {
+	{0, 0, {0x00, 0x00}},
+	{-1, -1, {0xFF, 0xFF}},
+	{32767, 32767, {0x7F, 0xFF}},
+	{32768, 32767, {0x7F, 0xFF}},
+	{-32768, -32768, {0x80, 0x00}},
+	{-32769, -32768, {0x80, 0x00}},
+	{INT32_MAX, 32767, {0x7F, 0xFF}},
+	{INT32_MIN, -32768, {0x80, 0x00}},
+};
+
+static const Golden_t Uint16_Edges[] = {
+	{0, 0, {0x00, 0x00}},
+	{-1, 0, {0x00, 0x00}},
+	{255, 255, {0x00, 0xFF}},
+	{256, 256, {0x01, 0x00}},
+	{65535, 65535, {0xFF, 0xFF}},
+	{65536, 65535, {0xFF, 0xFF}},
+	{INT32_MAX, 65535, {0xFF, 0xFF}},
+	{INT32_MIN, 0, {0x00, 0x00}},
+};
+
+static uint32_t Failures, Checked;
+static bool Verbose;
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -v       print every golden value\n",
+		Name);
+}
+
+// Value is what the conversion returned, it and its wire bytes must match
+static void Check(const char *What, const Golden_t *Golden, int32_t Value, int Wire)
+{
+	uint8_t Buffer[2];
+	uint8_t Length;
+
+	Length = Wire == WIRE_INT16 ? Sensor_PutInt16(Buffer, Value) : Sensor_PutUint16(Buffer, Value);
+
+	if (Length != 2 || Value != Golden->Value || Buffer[0] != Golden->Wire[0] || Buffer[1] != Golden->Wire[1]) {
+		if (Failures++ < 20) {
+			printf("FAIL %s: raw %lld gave %d (%02X %02X), expected %d (%02X %02X)\n", What, (long long)Golden->Raw,
+				Value, Buffer[0], Buffer[1], Golden->Value, Golden->Wire[0], Golden->Wire[1]);
+		}
+	} else if (Verbose) {
+		printf("%-20s %11lld -> %8d -> %02X %02X\n", What, (long long)Golden->Raw, Value, Buffer[0], Buffer[1]);
+	}
+	Checked++;
+}
+
+// Saturation edge tables hold what the wire decodes back to as their Value
+static void Check_Edge(const char *What, const Golden_t *Golden, int Wire)
+{
+	uint8_t Buffer[2];
+	uint8_t Length;
+	int32_t Decoded;
+
+	if (Wire == WIRE_INT16) {
+		Length = Sensor_PutInt16(Buffer, Golden->Raw);
+		Decoded = (int16_t)((Buffer[0] << 8) | Buffer[1]);
+	} else {
+		Length = Sensor_PutUint16(Buffer, Golden->Raw);
+		Decoded = (Buffer[0] << 8) | Buffer[1];
+	}
+
+	if (Length != 2 || Decoded != Golden->Value || Buffer[0] != Golden->Wire[0] || Buffer[1] != Golden->Wire[1]) {
+		if (Failures++ < 20) {
+			printf("FAIL %s: raw %lld decodes to %d (%02X %02X), expected %d (%02X %02X)\n", What, (long long)Golden->Raw,
+				Decoded, Buffer[0], Buffer[1], Golden->Value, Golden->Wire[0], Golden->Wire[1]);
+		}
+	} else if (Verbose) {
+		printf("%-20s %11lld -> %8d -> %02X %02X\n", What, (long long)Golden->Raw, Decoded, Buffer[0], Buffer[1]);
+	}
+	Checked++;
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t Data[2];
+	uint32_t i, Raw;
+	int32_t Value;
+	int Opt;
+
+	while ((Opt = getopt(argc, argv, "vh")) != -1) {
+		switch (Opt) {
+		case 'v': Verbose = true; break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(SHT3X_Temperature) / sizeof(SHT3X_Temperature[0]); i++) {
+		Check("SHT3x temperature", &SHT3X_Temperature[i], Fixed_SHT3X_Temperature(SHT3X_Temperature[i].Raw), WIRE_INT16);
+	}
+	for (i = 0; i < sizeof(SHT3X_Humidity) / sizeof(SHT3X_Humidity[0]); i++) {
+		Check("SHT3x humidity", &SHT3X_Humidity[i], Fixed_SHT3X_Humidity(SHT3X_Humidity[i].Raw), WIRE_UINT16);
+	}
+	for (i = 0; i < sizeof(Seesaw_Temperature) / sizeof(Seesaw_Temperature[0]); i++) {
+		Check("seesaw temperature", &Seesaw_Temperature[i], Fixed_Seesaw_Temperature(Seesaw_Temperature[i].Raw), WIRE_INT16);
+	}
+	for (i = 0; i < sizeof(Seesaw_Moisture) / sizeof(Seesaw_Moisture[0]); i++) {
+		Data[0] = Seesaw_Moisture[i].Raw >> 8;
+		Data[1] = Seesaw_Moisture[i].Raw & 0xFF;
+		Check("seesaw moisture", &Seesaw_Moisture[i], Fixed_Seesaw_Moisture(Data), WIRE_UINT16);
+	}
+	for (i = 0; i < sizeof(Wind_Speed) / sizeof(Wind_Speed[0]); i++) {
+		Check("wind speed", &Wind_Speed[i], Fixed_WindSpeed(Wind_Speed[i].Raw, 1000), WIRE_UINT16);
+	}
+	for (i = 0; i < sizeof(Wind_Direction) / sizeof(Wind_Direction[0]); i++) {
+		Check("wind direction", &Wind_Direction[i], Fixed_Direction(Wind_Direction[i].Raw / 100.0f), WIRE_UINT16);
+	}
+	for (i = 0; i < sizeof(Int16_Edges) / sizeof(Int16_Edges[0]); i++) {
+		Check_Edge("Sensor_PutInt16", &Int16_Edges[i], WIRE_INT16);
+	}
+	for (i = 0; i < sizeof(Uint16_Edges) / sizeof(Uint16_Edges[0]); i++) {
+		Check_Edge("Sensor_PutUint16", &Uint16_Edges[i], WIRE_UINT16);
+	}
+
+	// Windows other than 1 s keep the rate: 1 pulse in 7 ms is 34285.71
+	if (Fixed_WindSpeed(1, 7) != 34286 || Fixed_WindSpeed(3, 3000) != 240) {
+		printf("FAIL wind speed window: %d %d\n", Fixed_WindSpeed(1, 7), Fixed_WindSpeed(3, 3000));
+		Failures++;
+	}
+
+	// Every SHT3x code against the datasheet formula in double precision. No
+	// code lands on a half, so there is nothing to disagree about.
+	for (Raw = 0; Raw <= 0xFFFF; Raw++) {
+		Value = (int32_t)floor((-45 + 175.0 * Raw / 65535) * FIXED_TEMPERATURE_SCALE + 0.5);
+		if (Fixed_SHT3X_Temperature(Raw) != Value) {
+			if (Failures++ < 20) {
+				printf("FAIL SHT3x temperature %u: %d, reference %d\n", Raw, Fixed_SHT3X_Temperature(Raw), Value);
+			}
+		}
+		Value = (int32_t)floor(100.0 * Raw / 65535 * FIXED_HUMIDITY_SCALE + 0.5);
+		if (Fixed_SHT3X_Humidity(Raw) != Value) {
+			if (Failures++ < 20) {
+				printf("FAIL SHT3x humidity %u: %d, reference %d\n", Raw, Fixed_SHT3X_Humidity(Raw), Value);
+			}
+		}
+		Checked += 2;
+	}
+
+	if (Failures) {
+		printf("%u failures\n", Failures);
+		return 1;
+	}
+
+	printf("%u conversions match their golden values and wire bytes\n", Checked);
+	return 0;
+}
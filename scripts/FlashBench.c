@@ -0,0 +1,253 @@
+/**
+ * @file FlashBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host flash ring benchmark and power cut test, against a partition
+ * 			image file. Fills the ring several times over with numbered
+ * 			records, erasing ahead as an idle storage task would, and
+ * 			reports write amplification, erase counts and wear; then cuts
+ * 			the power at random points, a random part of the last program
+ * 			included, and checks that every remount keeps all synced records,
+ * 			in order and without gaps, and carries on writing.
+ *
+ * 			gcc -O2 -Iinclude scripts/FlashBench.c components/storage/FlashLog.c components/storage/RecordLog.c -o flashbench
+ * 			./flashbench -s 1024 -n 200000 -c 500
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/FlashLog.h"
+
+// #defines
+/******************************************************************************/
+#define MIN_DATA 8
+#define MAX_DATA 200
+
+// Variables
+/******************************************************************************/
+static FlashLog_t Ring;
+static uint8_t Page[FLASH_LOG_PAGE_SIZE];
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -i file  image, created (/tmp/flashbench.img)\n"
+		"  -s KiB   partition size (1024)\n"
+		"  -n n     records for the fill run (200000)\n"
+		"  -e n     records between idle polls (16)\n"
+		"  -c n     power cuts (500)\n",
+		Name);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Record i: its number, then bytes derived from it
+static uint16_t Make_Record(uint32_t i, uint8_t *Data)
+{
+	uint16_t Length = MIN_DATA + i * 37 % (MAX_DATA - MIN_DATA), j;
+
+	memcpy(Data, &i, sizeof(i));
+	for (j = 4; j < Length; j++) {
+		Data[j] = i * 13 + j;
+	}
+	return Length;
+}
+
+// Read the ring back: records must be whole and numbered without gaps.
+// Returns the count, sets the first and last number.
+static long Check(uint32_t *First, uint32_t *Last)
+{
+	uint8_t Data[MAX_DATA];
+	FlashLog_Cursor_t Cursor;
+	RecordLog_Frame_t Frame;
+	uint32_t i;
+	long Count = 0;
+
+	FlashLog_ReadBegin(&Ring, &Cursor, Page);
+	while (FlashLog_ReadNext(&Ring, &Cursor, &Frame) == ESP_OK) {
+		memcpy(&i, Frame.Payload, sizeof(i));
+		if (Count == 0) {
+			*First = i;
+		} else if (i != *Last + 1) {
+			printf("record %u follows %u\n", i, *Last);
+			return -1;
+		}
+		if (Frame.Length != Make_Record(i, Data) || memcmp(Frame.Payload, Data, Frame.Length) != 0) {
+			printf("record %u is wrong\n", i);
+			return -1;
+		}
+		*Last = i;
+		Count++;
+	}
+	return Count;
+}
+
+static esp_err_t Create(const char *Image, uint32_t Size)
+{
+	int Fd = open(Image, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	uint8_t *Erased = malloc(Size);
+	bool Ok;
+
+	memset(Erased, 0xFF, Size);
+	Ok = Fd >= 0 && write(Fd, Erased, Size) == (ssize_t)Size;
+	free(Erased);
+	if (Fd >= 0) {
+		close(Fd);
+	}
+	return Ok ? ESP_OK : ESP_FAIL;
+}
+
+// Power lost: what was buffered is gone, and the program in flight got a
+// random part of its bytes onto the flash
+static void Cut(void)
+{
+	uint32_t Address = Ring.Head * FLASH_LOG_PAGE_SIZE + Ring.Written, Length = Ring.Used - Ring.Written, i;
+	uint8_t Cells[FLASH_LOG_PAGE_SIZE];
+
+	if (Length && rand() % 2) {
+		Length = rand() % Length;
+		pread(Ring.Fd, Cells, Length, Address);
+		for (i = 0; i < Length; i++) {
+			Cells[i] &= Ring.Buffer[Ring.Written + i];
+		}
+		pwrite(Ring.Fd, Cells, Length, Address);
+	}
+	close(Ring.Fd);
+	free(Ring.Buffer);
+	Ring.Buffer = NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const char *Image = "/tmp/flashbench.img";
+	uint32_t Size_KiB = 1024, Records = 200000, Idle = 16, Cuts = 500;
+	uint32_t i, Next = 0, Synced = 0, First = 0, Last = 0, c, Burst, Torn = 0;
+	uint8_t Data[MAX_DATA];
+	RecordLog_Config_t Config;
+	double Start, Elapsed, Mount_Time = 0, Mount_Max = 0;
+	long Count;
+	int Opt;
+
+	while ((Opt = getopt(argc, argv, "i:s:n:e:c:h")) != -1) {
+		switch (Opt) {
+		case 'i': Image = optarg; break;
+		case 's': Size_KiB = atoi(optarg); break;
+		case 'n': Records = atoi(optarg); break;
+		case 'e': Idle = atoi(optarg); break;
+		case 'c': Cuts = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Records == 0 || Idle == 0 || Size_KiB < 4 * (FLASH_LOG_ERASE_AHEAD + 2)) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	RecordLog_DefaultConfig(&Config);
+	Config.Sync_MS = 0;
+	if (Create(Image, Size_KiB * 1024) != ESP_OK || FlashLog_Open(&Ring, Image, &Config) != ESP_OK) {
+		perror(Image);
+		return 1;
+	}
+
+	// Fill run: the ring wraps many times, the storage task erases between
+	// bursts of packets
+	Start = Seconds();
+	for (i = 0; i < Records; i++) {
+		if (FlashLog_Append(&Ring, Data, Make_Record(Next++, Data)) != ESP_OK) {
+			fprintf(stderr, "append %u failed\n", i);
+			return 1;
+		}
+		if (i % Idle == Idle - 1) {
+			FlashLog_Poll(&Ring);
+			FlashLog_EraseAhead(&Ring);
+		}
+	}
+	FlashLog_Sync(&Ring);
+	Elapsed = Seconds() - Start;
+	Count = Check(&First, &Last);
+	if (Count <= 0 || Last != Next - 1) {
+		printf("fill run: read back %ld records, last %u of %u\n", Count, Last, Next - 1);
+		return 1;
+	}
+
+	printf("%u KiB ring, %u pages, %u erased ahead\n", Size_KiB, Ring.Pages, FLASH_LOG_ERASE_AHEAD);
+	printf("fill: %u records in %.2f s, %.2f MB programmed, program amplification %.3f\n", Records, Elapsed,
+		Ring.Stats.Log.Device_Bytes / 1e6, (double)Ring.Stats.Log.Device_Bytes / Ring.Stats.Log.Payload_Bytes);
+	printf("      %u erases (%u waited for by an append), %.1f per page, %u pages of old records dropped\n",
+		Ring.Stats.Erases, Ring.Stats.Foreground_Erases, (double)Ring.Stats.Erases / Ring.Pages, Ring.Stats.Pages_Dropped);
+	printf("      %ld newest records kept, %u..%u\n", Count, First, Last);
+
+	// Power cuts: bursts with random syncs, then the cut, then a remount
+	Synced = Next - 1;
+	srand(1);
+	for (c = 0; c < Cuts; c++) {
+		for (Burst = rand() % 400; Burst; Burst--) {
+			if (FlashLog_Append(&Ring, Data, Make_Record(Next++, Data)) != ESP_OK) {
+				fprintf(stderr, "cut %u: append failed\n", c);
+				return 1;
+			}
+			if (rand() % 20 == 0) {
+				FlashLog_Sync(&Ring);
+			}
+			if (rand() % Idle == 0) {
+				FlashLog_EraseAhead(&Ring);
+			}
+			if (Ring.Pending == 0) {
+				Synced = Next - 1;
+			}
+		}
+		Cut();
+
+		Start = Seconds();
+		if (FlashLog_Open(&Ring, Image, &Config) != ESP_OK) {
+			fprintf(stderr, "cut %u: mount failed\n", c);
+			return 1;
+		}
+		Elapsed = Seconds() - Start;
+		Mount_Time += Elapsed;
+		if (Elapsed > Mount_Max) {
+			Mount_Max = Elapsed;
+		}
+		Torn += Ring.Stats.Torn_Pages;
+
+		Count = Check(&First, &Last);
+		if (Count <= 0 || Last < Synced || Last >= Next) {
+			printf("cut %u: %ld records back, last %u; synced up to %u, appended up to %u\n", c, Count, Last,
+				Synced, Next - 1);
+			return 1;
+		}
+		// Whatever was lost is written again under the same numbers
+		Next = Last + 1;
+		Synced = Last;
+	}
+
+	printf("%u power cuts passed: every synced record kept, in order; %u torn pages closed\n", Cuts, Torn);
+	printf("mount: %.1f us mean, %.1f us max (host)\n", Mount_Time / (Cuts ? Cuts : 1) * 1e6, Mount_Max * 1e6);
+
+	FlashLog_Close(&Ring);
+	unlink(Image);
+	return 0;
+}
@@ -0,0 +1,599 @@
+/**
+ * @file I2CBusBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host benchmark of the I2C bus manager against mock FreeRTOS and
+ * 			i2c_master layers (scripts/mock, on pthreads). Reports
+ * 			transactions per second for direct driver calls, blocking
+ * 			register reads from one and from several tasks, and a prebuilt
+ * 			transfer resubmitted asynchronously with a completion callback.
+ * 			With -f the mock bus takes as long as the bits would on the
+ * 			wire at that clock, without it only the manager's own cost is
+ * 			left. Every read is checked against the data the mock device
+ * 			returns. Then tasks probe the port while it is closed and
+ * 			reopened under them, with every queue send stretched to widen
+ * 			the window, which must neither hang nor touch a deleted queue
+ * 			(run a -fsanitize=address build to be sure).
+ *
+ * 			gcc -O2 -Iscripts/mock -Iinclude scripts/I2CBusBench.c components/i2cbus/I2CBus.c -o i2cbusbench -lpthread
+ * 			./i2cbusbench -n 200000 -t 4 -f 400000
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c_master.h"
+#include "../include/I2CBus.h"
+
+// #defines
+/******************************************************************************/
+#define PORT 0
+#define SDA 41
+#define SCL 42
+#define ADDRESS 0x44
+#define MISSING_ADDRESS 0x50
+#define REGISTER 0xE0
+#define READ_LENGTH 6
+#define MAX_THREADS 16
+#define QUEUE_MAGIC 0x51554555
+
+// Variables
+/******************************************************************************/
+struct Mock_Task {
+	pthread_t Thread;
+	TaskFunction_t Function;
+	void *Arg;
+};
+
+struct Mock_Queue {
+	uint32_t Magic;
+	pthread_mutex_t Mutex;
+	pthread_cond_t Not_Empty;
+	pthread_cond_t Not_Full;
+	uint32_t Length;
+	uint32_t Item_Size;
+	uint32_t Head;
+	uint32_t Count;
+	uint8_t Items[];
+};
+
+struct Mock_I2C_Bus {
+	int Port;
+};
+
+struct Mock_I2C_Device {
+	struct Mock_I2C_Bus *Bus;
+	uint16_t Address;
+	uint32_t Speed_Hz;
+};
+
+static __thread struct Mock_Task *Current_Task;
+
+// Mock bus clock, 0 = transfers take no time
+static uint32_t Wire_Hz;
+
+// Blocking and asynchronous runs
+static I2CBus_Device_t Device;
+static uint32_t Per_Thread;
+static atomic_uint Bad_Reads;
+
+static uint8_t Async_Data[READ_LENGTH];
+static atomic_uint Async_Done;
+static StaticSemaphore_t Async_Finished_Buffer;
+static SemaphoreHandle_t Async_Finished;
+static uint32_t Async_Total;
+
+// Close race
+static atomic_bool Race_Jitter, Race_Stop;
+static atomic_uint Race_OK, Race_Closed, Race_Other;
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n n     transactions per run (200000)\n"
+		"  -t n     tasks for the concurrent blocking run, at most %d (4)\n"
+		"  -f hz    mock bus clock, 0 = instant transfers (0)\n"
+		"  -r n     close/reopen cycles in the race run (500)\n",
+		Name, MAX_THREADS);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mock FreeRTOS
+/******************************************************************************/
+static void *Task_Main(void *Arg)
+{
+	Current_Task = Arg;
+	Current_Task->Function(Current_Task->Arg);
+	return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t Function, const char *Name, uint32_t Stack, void *Arg, UBaseType_t Priority, TaskHandle_t *Handle)
+{
+	struct Mock_Task *Task = calloc(1, sizeof(*Task));
+
+	if (Task == NULL) {
+		return pdFALSE;
+	}
+	Task->Function = Function;
+	Task->Arg = Arg;
+	if (Handle) {
+		*Handle = Task;
+	}
+	if (pthread_create(&Task->Thread, NULL, Task_Main, Task) != 0) {
+		free(Task);
+		return pdFALSE;
+	}
+	pthread_detach(Task->Thread);
+
+	return pdPASS;
+}
+
+// Only a task deleting itself is supported
+void vTaskDelete(TaskHandle_t Task)
+{
+	if (Task != NULL && Task != Current_Task) {
+		fprintf(stderr, "vTaskDelete of another task is not mocked\n");
+		abort();
+	}
+	free(Current_Task);
+	Current_Task = NULL;
+	pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t Ticks)
+{
+	usleep(Ticks * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return Current_Task;
+}
+
+static void Check_Queue(QueueHandle_t Queue)
+{
+	if (Queue == NULL || Queue->Magic != QUEUE_MAGIC) {
+		fprintf(stderr, "queue used after vQueueDelete()\n");
+		abort();
+	}
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t Length, UBaseType_t Item_Size)
+{
+	struct Mock_Queue *Queue = calloc(1, sizeof(*Queue) + Length * Item_Size);
+
+	if (Queue == NULL) {
+		return NULL;
+	}
+	Queue->Magic = QUEUE_MAGIC;
+	Queue->Length = Length;
+	Queue->Item_Size = Item_Size;
+	pthread_mutex_init(&Queue->Mutex, NULL);
+	pthread_cond_init(&Queue->Not_Empty, NULL);
+	pthread_cond_init(&Queue->Not_Full, NULL);
+
+	return Queue;
+}
+
+void vQueueDelete(QueueHandle_t Queue)
+{
+	Check_Queue(Queue);
+	Queue->Magic = 0;
+	pthread_mutex_destroy(&Queue->Mutex);
+	pthread_cond_destroy(&Queue->Not_Empty);
+	pthread_cond_destroy(&Queue->Not_Full);
+	free(Queue);
+}
+
+// Waits are forever or not at all, the bus manager uses nothing else
+BaseType_t xQueueSend(QueueHandle_t Queue, const void *Item, TickType_t Wait)
+{
+	// Stretch the gap between the caller finding the port and sending to it
+	if (atomic_load(&Race_Jitter)) {
+		usleep(rand() % 50);
+	}
+	Check_Queue(Queue);
+	pthread_mutex_lock(&Queue->Mutex);
+	while (Queue->Count == Queue->Length) {
+		if (Wait == 0) {
+			pthread_mutex_unlock(&Queue->Mutex);
+			return pdFALSE;
+		}
+		pthread_cond_wait(&Queue->Not_Full, &Queue->Mutex);
+	}
+	memcpy(Queue->Items + (Queue->Head + Queue->Count) % Queue->Length * Queue->Item_Size, Item, Queue->Item_Size);
+	Queue->Count++;
+	pthread_cond_signal(&Queue->Not_Empty);
+	pthread_mutex_unlock(&Queue->Mutex);
+
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t Queue, void *Item, TickType_t Wait)
+{
+	Check_Queue(Queue);
+	pthread_mutex_lock(&Queue->Mutex);
+	while (Queue->Count == 0) {
+		if (Wait == 0) {
+			pthread_mutex_unlock(&Queue->Mutex);
+			return pdFALSE;
+		}
+		pthread_cond_wait(&Queue->Not_Empty, &Queue->Mutex);
+	}
+	memcpy(Item, Queue->Items + Queue->Head * Queue->Item_Size, Queue->Item_Size);
+	Queue->Head = (Queue->Head + 1) % Queue->Length;
+	Queue->Count--;
+	pthread_cond_signal(&Queue->Not_Full);
+	pthread_mutex_unlock(&Queue->Mutex);
+
+	return pdPASS;
+}
+
+static SemaphoreHandle_t Semaphore_Init(StaticSemaphore_t *Buffer, int Count)
+{
+	pthread_mutex_init(&Buffer->Mutex, NULL);
+	pthread_cond_init(&Buffer->Cond, NULL);
+	Buffer->Count = Count;
+
+	return Buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *Buffer)
+{
+	return Semaphore_Init(Buffer, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *Buffer)
+{
+	return Semaphore_Init(Buffer, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Semaphore, TickType_t Wait)
+{
+	pthread_mutex_lock(&Semaphore->Mutex);
+	while (Semaphore->Count == 0) {
+		if (Wait == 0) {
+			pthread_mutex_unlock(&Semaphore->Mutex);
+			return pdFALSE;
+		}
+		pthread_cond_wait(&Semaphore->Cond, &Semaphore->Mutex);
+	}
+	Semaphore->Count--;
+	pthread_mutex_unlock(&Semaphore->Mutex);
+
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Semaphore)
+{
+	pthread_mutex_lock(&Semaphore->Mutex);
+	Semaphore->Count = 1;
+	pthread_cond_signal(&Semaphore->Cond);
+	pthread_mutex_unlock(&Semaphore->Mutex);
+
+	return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t Semaphore)
+{
+	pthread_mutex_destroy(&Semaphore->Mutex);
+	pthread_cond_destroy(&Semaphore->Cond);
+}
+
+// Mock i2c_master
+/******************************************************************************/
+// A start, the address byte and each data byte with its ACK, and a stop
+static void Wire_Time(size_t Write_Size, size_t Read_Size)
+{
+	uint32_t Bits = 2 + 9 * (1 + Write_Size) + (Read_Size ? 1 + 9 * (1 + Read_Size) : 0);
+	double Until;
+
+	if (Wire_Hz == 0) {
+		return;
+	}
+	Until = Seconds() + (double)Bits / Wire_Hz;
+	while (Seconds() < Until) {
+	}
+}
+
+// Device registers read back as a pattern of address, register and offset
+static void Fill(const struct Mock_I2C_Device *Mock, uint8_t Reg, uint8_t *Read, size_t Read_Size)
+{
+	size_t i;
+
+	for (i = 0; i < Read_Size; i++) {
+		Read[i] = Mock->Address ^ Reg ^ (i * 37);
+	}
+}
+
+static bool Read_OK(uint8_t Reg, const uint8_t *Read, size_t Read_Size)
+{
+	size_t i;
+
+	for (i = 0; i < Read_Size; i++) {
+		if (Read[i] != (uint8_t)(ADDRESS ^ Reg ^ (i * 37))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *Config, i2c_master_bus_handle_t *Bus)
+{
+	*Bus = calloc(1, sizeof(**Bus));
+	if (*Bus == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	(*Bus)->Port = Config->i2c_port;
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t Bus)
+{
+	free(Bus);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t Bus, const i2c_device_config_t *Config, i2c_master_dev_handle_t *Mock)
+{
+	*Mock = calloc(1, sizeof(**Mock));
+	if (*Mock == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	(*Mock)->Bus = Bus;
+	(*Mock)->Address = Config->device_address;
+	(*Mock)->Speed_Hz = Config->scl_speed_hz;
+
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t Mock)
+{
+	free(Mock);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t Mock, const uint8_t *Write, size_t Write_Size, int Timeout_MS)
+{
+	if (Mock == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	Wire_Time(Write_Size, 0);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t Mock, uint8_t *Read, size_t Read_Size, int Timeout_MS)
+{
+	if (Mock == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	Wire_Time(0, Read_Size);
+	Fill(Mock, 0, Read, Read_Size);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t Mock, const uint8_t *Write, size_t Write_Size, uint8_t *Read, size_t Read_Size, int Timeout_MS)
+{
+	if (Mock == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	Wire_Time(Write_Size, Read_Size);
+	Fill(Mock, Write_Size ? Write[0] : 0, Read, Read_Size);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t Bus, uint16_t Address, int Timeout_MS)
+{
+	Wire_Time(0, 0);
+	return Address == ADDRESS ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Runs
+/******************************************************************************/
+static void Report(const char *What, uint32_t Transactions, double Elapsed)
+{
+	printf("%-28s %8u tx in %6.3f s  %10.0f tx/s  %6.2f us/tx\n", What, Transactions, Elapsed,
+		Transactions / Elapsed, Elapsed / Transactions * 1e6);
+}
+
+static void *Blocking_Reader(void *Arg)
+{
+	const uint8_t Reg = REGISTER;
+	uint8_t Data[READ_LENGTH];
+	uint32_t i;
+
+	for (i = 0; i < Per_Thread; i++) {
+		if (I2CBus_WriteRead(Device, &Reg, 1, Data, sizeof(Data)) != ESP_OK || !Read_OK(REGISTER, Data, sizeof(Data))) {
+			atomic_fetch_add(&Bad_Reads, 1);
+		}
+	}
+	return NULL;
+}
+
+static double Blocking_Run(uint32_t Threads)
+{
+	pthread_t Thread[MAX_THREADS];
+	double Start;
+	uint32_t i;
+
+	Start = Seconds();
+	for (i = 0; i < Threads; i++) {
+		pthread_create(&Thread[i], NULL, Blocking_Reader, NULL);
+	}
+	for (i = 0; i < Threads; i++) {
+		pthread_join(Thread[i], NULL);
+	}
+	return Seconds() - Start;
+}
+
+// Runs on the bus worker right after each transfer
+static void Async_Callback(esp_err_t Result, void *Arg)
+{
+	if (Result != ESP_OK || !Read_OK(REGISTER, Async_Data, sizeof(Async_Data))) {
+		atomic_fetch_add(&Bad_Reads, 1);
+	}
+	memset(Async_Data, 0, sizeof(Async_Data));
+	if (atomic_fetch_add(&Async_Done, 1) + 1 == Async_Total) {
+		xSemaphoreGive(Async_Finished);
+	}
+}
+
+static void *Race_Prober(void *Arg)
+{
+	esp_err_t err;
+
+	while (!atomic_load(&Race_Stop)) {
+		err = I2CBus_Probe(PORT, atomic_load(&Race_OK) % 2 ? ADDRESS : MISSING_ADDRESS);
+		if (err == ESP_OK || err == ESP_ERR_NOT_FOUND) {
+			atomic_fetch_add(&Race_OK, 1);
+		} else if (err == ESP_ERR_INVALID_STATE) {
+			atomic_fetch_add(&Race_Closed, 1);
+			usleep(10);
+		} else {
+			atomic_fetch_add(&Race_Other, 1);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	i2c_device_config_t Direct_Cfg = {
+		.dev_addr_length = I2C_ADDR_BIT_LEN_7,
+		.device_address = ADDRESS,
+		.scl_speed_hz = 400000,
+	};
+	i2c_master_bus_config_t Bus_Cfg = {
+		.i2c_port = PORT,
+	};
+	const uint8_t Reg = REGISTER;
+	uint32_t Transactions = 200000, Threads = 4, Cycles = 500, i;
+	i2c_master_bus_handle_t Direct_Bus;
+	i2c_master_dev_handle_t Direct_Device;
+	I2CBus_Transfer_t Transfer;
+	pthread_t Thread[MAX_THREADS];
+	uint8_t Data[READ_LENGTH];
+	char Label[32];
+	uint32_t Failed = 0;
+	double Start, Elapsed;
+	int Opt;
+
+	while ((Opt = getopt(argc, argv, "n:t:f:r:h")) != -1) {
+		switch (Opt) {
+		case 'n': Transactions = atoi(optarg); break;
+		case 't': Threads = atoi(optarg); break;
+		case 'f': Wire_Hz = atoi(optarg); break;
+		case 'r': Cycles = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Transactions == 0 || Threads == 0 || Threads > MAX_THREADS) {
+		Usage(argv[0]);
+		return 1;
+	}
+	printf("mock bus %s, %d byte register reads\n", Wire_Hz ? "timed" : "instant", READ_LENGTH);
+	if (Wire_Hz) {
+		printf("  %u Hz: %.1f us on the wire per read\n", Wire_Hz, (2 + 9 * 2 + 1 + 9 * (1 + READ_LENGTH)) * 1e6 / Wire_Hz);
+	}
+
+	// Lower bound, the driver called straight from one task
+	i2c_new_master_bus(&Bus_Cfg, &Direct_Bus);
+	i2c_master_bus_add_device(Direct_Bus, &Direct_Cfg, &Direct_Device);
+	Start = Seconds();
+	for (i = 0; i < Transactions; i++) {
+		i2c_master_transmit_receive(Direct_Device, &Reg, 1, Data, sizeof(Data), 1000);
+	}
+	Report("direct driver", Transactions, Seconds() - Start);
+	i2c_master_bus_rm_device(Direct_Device);
+	i2c_del_master_bus(Direct_Bus);
+
+	if (I2CBus_Open(PORT, SDA, SCL) != ESP_OK || I2CBus_AddDevice(PORT, ADDRESS, 400000, &Device) != ESP_OK) {
+		printf("could not open the bus\n");
+		return 1;
+	}
+
+	// Blocking reads through the queue, one task, then several sharing it
+	Per_Thread = Transactions;
+	Report("I2CBus_WriteRead, 1 task", Transactions, Blocking_Run(1));
+	Per_Thread = Transactions / Threads;
+	Elapsed = Blocking_Run(Threads);
+	snprintf(Label, sizeof(Label), "I2CBus_WriteRead, %u tasks", Threads);
+	Report(Label, Per_Thread * Threads, Elapsed);
+
+	// One prebuilt register read resubmitted, completions on the worker
+	Async_Finished = xSemaphoreCreateBinaryStatic(&Async_Finished_Buffer);
+	Async_Total = Transactions;
+	I2CBus_PrepareRead(&Transfer, Device, REGISTER, Async_Data, sizeof(Async_Data));
+	Start = Seconds();
+	for (i = 0; i < Transactions; i++) {
+		if (I2CBus_Submit(&Transfer, Async_Callback, NULL) != ESP_OK) {
+			Failed++;
+		}
+	}
+	if (Failed == 0) {
+		xSemaphoreTake(Async_Finished, portMAX_DELAY);
+	}
+	Report("I2CBus_Submit + callback", Transactions, Seconds() - Start);
+	vSemaphoreDelete(Async_Finished);
+
+	I2CBus_RemoveDevice(Device);
+	if (I2CBus_Close(PORT) != ESP_OK) {
+		Failed++;
+	}
+
+	// Probes keep coming while the port is torn down and brought back
+	atomic_store(&Race_Jitter, true);
+	Start = Seconds();
+	for (i = 0; i < Threads; i++) {
+		pthread_create(&Thread[i], NULL, Race_Prober, NULL);
+	}
+	for (i = 0; i < Cycles; i++) {
+		if (I2CBus_Open(PORT, SDA, SCL) != ESP_OK) {
+			Failed++;
+			continue;
+		}
+		usleep(100);
+		if (I2CBus_Close(PORT) != ESP_OK) {
+			Failed++;
+		}
+	}
+	atomic_store(&Race_Stop, true);
+	for (i = 0; i < Threads; i++) {
+		pthread_join(Thread[i], NULL);
+	}
+	printf("%u close/reopen cycles under %u probing tasks in %.2f s: %u probes ran, %u found the port closed\n",
+		Cycles, Threads, Seconds() - Start, atomic_load(&Race_OK), atomic_load(&Race_Closed));
+
+	if (Failed || atomic_load(&Bad_Reads) || atomic_load(&Race_Other)) {
+		printf("FAILED: %u bad reads, %u bus calls failed, %u probes returned something else\n",
+			atomic_load(&Bad_Reads), Failed, atomic_load(&Race_Other));
+		return 1;
+	}
+	printf("every read returned the device's data\n");
+	return 0;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file LogBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host record log benchmark. Appends synthetic records through the
+ * 			record log, or through fopen/fputs/fclose per record the way
+ * 			sd_card_append_file() does, and reports records per second and
+ * 			write amplification. Point it at a loop mounted FAT image to get
+ * 			close to the card, or at tmpfs for the CPU side alone.
+ *
+ * 			gcc -O2 -Iinclude scripts/LogBench.c components/storage/RecordLog.c -o logbench
+ * 			./logbench -f /mnt/fat/bench.log -n 100000 -s 32 -g 64
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/RecordLog.h"
+
+// #defines
+/******************************************************************************/
+#define READ_CHUNK 65536
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -f path  log file (/tmp/logbench.log)\n"
+		"  -n n     records (100000)\n"
+		"  -s n     payload bytes per record (32)\n"
+		"  -b n     write buffer bytes (%d)\n"
+		"  -g n     fsync every n records, 0 = only at the end (%d)\n"
+		"  -a       per record fopen/fputs/fclose instead, like sd_card_append_file()\n",
+		Name, RECORD_LOG_BUFFER_SIZE, RECORD_LOG_SYNC_RECORDS);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Bytes this process caused to be sent to the block layer, -1 if unknown
+// (not Linux, or tmpfs, which never writes)
+static long long Block_Bytes(void)
+{
+	char Line[128];
+	long long Bytes = -1;
+	FILE *f = fopen("/proc/self/io", "r");
+
+	if (f == NULL) {
+		return -1;
+	}
+	while (fgets(Line, sizeof(Line), f)) {
+		if (sscanf(Line, "write_bytes: %lld", &Bytes) == 1) {
+			break;
+		}
+	}
+	fclose(f);
+	return Bytes;
+}
+
+// Record i: a counter and a repeating pattern, printable so the fputs path
+// can carry it too
+static void Fill(char *Record, uint32_t Size, uint32_t i)
+{
+	uint32_t j;
+
+	for (j = 0; j < Size; j++) {
+		Record[j] = 'a' + (i + j) % 26;
+	}
+	Record[Size] = '\0';
+}
+
+// Read the log back and count the frames that decode
+static uint64_t Verify(const char *Path)
+{
+	static uint8_t Buffer[READ_CHUNK + RECORD_LOG_HEADER_LEN + RECORD_LOG_MAX_PAYLOAD];
+	RecordLog_Frame_t Frame;
+	uint64_t Count = 0;
+	size_t Have = 0, Got;
+	int Length;
+	FILE *f = fopen(Path, "rb");
+
+	if (f == NULL) {
+		return 0;
+	}
+	while ((Got = fread(Buffer + Have, 1, READ_CHUNK, f)) > 0 || Have) {
+		size_t At = 0;
+
+		Have += Got;
+		while ((Length = RecordLog_Decode(Buffer + At, Have - At, &Frame)) > 0) {
+			Count++;
+			At += Length;
+		}
+		if (Length < 0 || (Got == 0 && At < Have)) {
+			break;
+		}
+		memmove(Buffer, Buffer + At, Have - At);
+		Have -= At;
+	}
+	fclose(f);
+	return Count;
+}
+
+int main(int argc, char **argv)
+{
+	RecordLog_Config_t Config;
+	RecordLog_t Log;
+	const char *Path = "/tmp/logbench.log";
+	uint32_t Records = 100000, Size = 32, i;
+	bool Append_Mode = false;
+	long long Block_Start, Block_End;
+	double Start, Elapsed;
+	uint64_t Device = 0;
+	uint32_t Syncs = 0;
+	char *Record;
+	int Opt;
+
+	RecordLog_DefaultConfig(&Config);
+	Config.Sync_MS = 0;
+	while ((Opt = getopt(argc, argv, "f:n:s:b:g:ah")) != -1) {
+		switch (Opt) {
+		case 'f': Path = optarg; break;
+		case 'n': Records = atoi(optarg); break;
+		case 's': Size = atoi(optarg); break;
+		case 'b': Config.Buffer_Size = atoi(optarg); break;
+		case 'g': Config.Sync_Records = atoi(optarg); break;
+		case 'a': Append_Mode = true; break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Size == 0 || Size > RECORD_LOG_MAX_PAYLOAD) {
+		fprintf(stderr, "payload must be 1..%d bytes\n", RECORD_LOG_MAX_PAYLOAD);
+		return 1;
+	}
+
+	Record = malloc(Size + 1);
+	unlink(Path);
+	sync();
+	Block_Start = Block_Bytes();
+	Start = Seconds();
+
+	if (Append_Mode) {
+		for (i = 0; i < Records; i++) {
+			FILE *f = fopen(Path, "a");
+
+			if (f == NULL) {
+				perror(Path);
+				return 1;
+			}
+			Fill(Record, Size, i);
+			fputs(Record, f);
+			fclose(f);
+			Device += Size;
+		}
+	} else {
+		if (RecordLog_Open(&Log, Path, &Config) != ESP_OK) {
+			perror(Path);
+			return 1;
+		}
+		for (i = 0; i < Records; i++) {
+			Fill(Record, Size, i);
+			if (RecordLog_Append(&Log, Record, Size) != ESP_OK) {
+				fprintf(stderr, "append %u failed\n", i);
+				return 1;
+			}
+		}
+		RecordLog_Close(&Log);
+		Device = Log.Stats.Device_Bytes;
+		Syncs = Log.Stats.Syncs;
+	}
+
+	Elapsed = Seconds() - Start;
+	Block_End = Block_Bytes();
+
+	printf("mode:          %s\n", Append_Mode ? "fopen/fputs/fclose per record" : "record log");
+	printf("records:       %u x %u B\n", Records, Size);
+	printf("time:          %.3f s\n", Elapsed);
+	printf("records/s:     %.0f\n", Records / Elapsed);
+	printf("payload MB/s:  %.2f\n", (double)Records * Size / Elapsed / 1e6);
+	printf("fsyncs:        %u\n", Syncs);
+	printf("write() amp:   %.3f\n", (double)Device / ((double)Records * Size));
+	if (Block_Start >= 0 && Block_End > Block_Start) {
+		printf("block amp:     %.3f\n", (double)(Block_End - Block_Start) / ((double)Records * Size));
+	} else {
+		printf("block amp:     n/a (tmpfs or no /proc/self/io)\n");
+	}
+	if (!Append_Mode) {
+		printf("read back:     %llu valid frames\n", (unsigned long long)Verify(Path));
+	}
+
+	free(Record);
+	return 0;
+}
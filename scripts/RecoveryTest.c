@@ -0,0 +1,268 @@
+/**
+ * @file RecoveryTest.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host fault injection test for segment recovery. Writes one
+ * 			unsealed segment with commit markers and checkpoints, then for
+ * 			every byte offset cuts the file there (a power loss mid write),
+ * 			reopens the store, appends, seals and reads everything back.
+ * 			Every record whose frame was whole before the cut must come
+ * 			back, nothing else may, and the recovery scan must stay within
+ * 			the last checkpoint instead of reading the whole segment.
+ *
+ * 			gcc -O2 -Iinclude scripts/RecoveryTest.c components/storage/Segment.c components/storage/RecordLog.c -o recoverytest
+ * 			./recoverytest -n 2000 -c 4096
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/Segment.h"
+
+// #defines
+/******************************************************************************/
+#define T_ORIGIN 1790035200U			// start of a day bucket
+#define NODE 7
+#define MAX_DATA 60
+#define MARKER 0xFFFFFFFF				// payload of the record appended after recovery
+
+// Variables
+/******************************************************************************/
+static SegmentStore_t Store;
+static Segment_Query_t Query;
+static uint8_t Query_Buffer[SEGMENT_MIN_QUERY_BUFFER];
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -r dir   scratch directory, emptied first (/tmp/recoverytest)\n"
+		"  -n n     records (2000)\n"
+		"  -c n     checkpoint interval, bytes (4096)\n"
+		"  -s n     test every n-th offset (1)\n",
+		Name);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t Get_32(const uint8_t *Buffer)
+{
+	return Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((uint32_t)Buffer[3] << 24);
+}
+
+// Record i: its index, then bytes derived from it
+static uint16_t Make_Record(uint32_t i, uint8_t *Data)
+{
+	uint16_t Length = 4 + i * 7 % (MAX_DATA - 3), j;
+
+	memcpy(Data, &i, sizeof(i));
+	for (j = 4; j < Length; j++) {
+		Data[j] = i * 31 + j;
+	}
+	return Length;
+}
+
+// Cut the log here without sealing, as a power loss would
+static void Abandon(SegmentStore_t *Store)
+{
+	int i;
+
+	for (i = 0; i < SEGMENT_MAX_OPEN; i++) {
+		if (Store->Owners[i] != NULL) {
+			RecordLog_Close(&Store->Logs[i]);
+			Store->Owners[i] = NULL;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *Root = "/tmp/recoverytest";
+	uint32_t Records = 2000, Checkpoint_Bytes = 4096, Step = 1;
+	uint32_t i, Got, Want, Committed, Tested = 0, Full_Scans = 0;
+	uint32_t *Record_End, *Commit_Ends, *Commit_Checkpoints, Commits = 0, c = 0;
+	uint64_t X, Scanned, Scanned_Max = 0, Scanned_Total = 0, Commit_End, Commit_Checkpoint;
+	char Path[SEGMENT_PATH_LEN], Command[SEGMENT_PATH_LEN + 16];
+	uint8_t Data[MAX_DATA], *Image;
+	RecordLog_Frame_t Frame;
+	Segment_Record_t Record;
+	double Start, Recover_Time = 0, Recover_Max = 0, Elapsed;
+	off_t Size;
+	int Fd, Opt, Length;
+
+	while ((Opt = getopt(argc, argv, "r:n:c:s:h")) != -1) {
+		switch (Opt) {
+		case 'r': Root = optarg; break;
+		case 'n': Records = atoi(optarg); break;
+		case 'c': Checkpoint_Bytes = atoi(optarg); break;
+		case 's': Step = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Records == 0 || Step == 0) {
+		Usage(argv[0]);
+		return 1;
+	}
+	snprintf(Command, sizeof(Command), "rm -rf %s", Root);
+
+	// The segment as the card holds it at the moment of the cut, with a sync
+	// every few records on top of the group commit
+	if (system(Command) != 0 || SegmentStore_Open(&Store, Root, 0) != ESP_OK) {
+		perror(Root);
+		return 1;
+	}
+	Store.Checkpoint_Bytes = Checkpoint_Bytes;
+	Record_End = malloc(Records * sizeof(uint32_t));
+	srand(1);
+	for (i = 0; i < Records; i++) {
+		Length = Make_Record(i, Data);
+		if (SegmentStore_Append(&Store, NODE, T_ORIGIN + i, Data, Length) != ESP_OK) {
+			fprintf(stderr, "append %u failed\n", i);
+			return 1;
+		}
+		if (rand() % 12 == 0) {
+			SegmentStore_Sync(&Store);
+		}
+	}
+	SegmentStore_Sync(&Store);
+	Abandon(&Store);
+
+	snprintf(Path, sizeof(Path), "%s/N%03u/%08X.SEG", Root, NODE, T_ORIGIN);
+	Fd = open(Path, O_RDONLY);
+	Size = Fd < 0 ? -1 : lseek(Fd, 0, SEEK_END);
+	Image = malloc(Size > 0 ? Size : 1);
+	if (Size <= 0 || pread(Fd, Image, Size, 0) != Size) {
+		perror(Path);
+		return 1;
+	}
+	close(Fd);
+
+	// Where each record's frame ends and the commit markers, from the image
+	Commit_Ends = malloc((Size / RECORD_LOG_COMMIT_FRAME + 1) * sizeof(uint32_t));
+	Commit_Checkpoints = malloc((Size / RECORD_LOG_COMMIT_FRAME + 1) * sizeof(uint32_t));
+	for (X = 0, i = 0; X < (uint64_t)Size; X += Length) {
+		Length = RecordLog_Decode(Image + X, Size - X, &Frame);
+		if (Length <= 0) {
+			fprintf(stderr, "bad frame at %llu in the written image\n", (unsigned long long)X);
+			return 1;
+		}
+		if (Frame.Type == RECORD_LOG_RECORD) {
+			Record_End[i++] = X + Length;
+		} else if (Frame.Type == RECORD_LOG_COMMIT) {
+			Commit_Ends[Commits] = X + Length;
+			Commit_Checkpoints[Commits++] = Get_32(Frame.Payload + 4);
+		}
+	}
+	printf("segment: %u records, %lld bytes, checkpoint every %u bytes\n", Records, (long long)Size, Checkpoint_Bytes);
+
+	Start = Seconds();
+	for (X = 0; X <= (uint64_t)Size; X += Step) {
+		// The image cut at X
+		Fd = open(Path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (Fd < 0 || write(Fd, Image, X) != (ssize_t)X || close(Fd) != 0) {
+			perror(Path);
+			return 1;
+		}
+
+		// What was whole before the cut, and what the last marker committed
+		for (Want = 0; Want < Records && Record_End[Want] <= X; Want++) {
+		}
+		while (c < Commits && Commit_Ends[c] <= X) {
+			c++;
+		}
+		Commit_End = c ? Commit_Ends[c - 1] : 0;
+		Commit_Checkpoint = c ? Commit_Checkpoints[c - 1] : RECORD_LOG_NO_CHECKPOINT;
+		Committed = 0;
+		while (Committed < Records && Record_End[Committed] <= Commit_End) {
+			Committed++;
+		}
+
+		// Recovery happens when the segment is reopened for an append
+		SegmentStore_Open(&Store, Root, 0);
+		Store.Checkpoint_Bytes = Checkpoint_Bytes;
+		Elapsed = Seconds();
+		i = MARKER;
+		if (SegmentStore_Append(&Store, NODE, T_ORIGIN + Records, &i, sizeof(i)) != ESP_OK) {
+			fprintf(stderr, "cut at %llu: append after recovery failed\n", (unsigned long long)X);
+			return 1;
+		}
+		Elapsed = Seconds() - Elapsed;
+		SegmentStore_Close(&Store);
+
+		Recover_Time += Elapsed;
+		if (Elapsed > Recover_Max) {
+			Recover_Max = Elapsed;
+		}
+		Scanned = Store.Recovery.Bytes_Scanned;
+		Scanned_Total += Scanned;
+		if (Scanned > Scanned_Max) {
+			Scanned_Max = Scanned;
+		}
+		Full_Scans += Store.Recovery.Full_Scans;
+
+		// Only what follows the last committed checkpoint may be scanned
+		if (Commit_End && Commit_Checkpoint != RECORD_LOG_NO_CHECKPOINT && Scanned > X - Commit_Checkpoint) {
+			printf("cut at %llu: scanned %llu bytes, the checkpoint is %llu bytes back\n",
+				(unsigned long long)X, (unsigned long long)Scanned, (unsigned long long)(X - Commit_Checkpoint));
+			return 1;
+		}
+
+		// Every whole record, in order, then the marker
+		Got = 0;
+		Segment_QueryBegin(&Query, Root, 0, NODE, 0, UINT32_MAX, Query_Buffer, sizeof(Query_Buffer));
+		while (Segment_QueryNext(&Query, &Record) == ESP_OK) {
+			if (Got == Want) {
+				memcpy(&i, Record.Data, sizeof(i));
+				if (Record.Length != sizeof(i) || i != MARKER) {
+					printf("cut at %llu: record after the last whole one\n", (unsigned long long)X);
+					return 1;
+				}
+			} else if (Got > Want || Record.Length != Make_Record(Got, Data) || memcmp(Record.Data, Data, Record.Length) != 0
+				|| Record.Timestamp != T_ORIGIN + Got) {
+				printf("cut at %llu: record %u is wrong\n", (unsigned long long)X, Got);
+				return 1;
+			}
+			Got++;
+		}
+		Segment_QueryEnd(&Query);
+		if (Got != Want + 1 || Want < Committed) {
+			printf("cut at %llu: %u records back, %u were whole, %u committed\n", (unsigned long long)X,
+				Got ? Got - 1 : 0, Want, Committed);
+			return 1;
+		}
+		Tested++;
+	}
+	Elapsed = Seconds() - Start;
+
+	printf("%u cuts passed in %.1f s: every whole record recovered, nothing more\n", Tested, Elapsed);
+	printf("recovery: %.1f us mean, %.1f us max; scanned %.0f bytes mean, %llu max of %lld; %u full scans\n",
+		Recover_Time / Tested * 1e6, Recover_Max * 1e6, (double)Scanned_Total / Tested,
+		(unsigned long long)Scanned_Max, (long long)Size, Full_Scans);
+
+	system(Command);
+	free(Image);
+	free(Record_End);
+	free(Commit_Ends);
+	free(Commit_Checkpoints);
+	return 0;
+}
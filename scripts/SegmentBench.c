@@ -0,0 +1,337 @@
+/**
+ * @file SegmentBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host segment store benchmark. Writes millions of synthetic records
+ * 			from many nodes (slightly out of order, like late packets) in
+ * 			storage writer sized batches, then
+ * 			runs random hour and day range queries, checks every result
+ * 			count against the generator, and reports query latency next to
+ * 			a full scan of the node. Last, every node is replayed through
+ * 			the batch callback with a large buffer, stopped halfway and
+ * 			resumed from its saved position.
+ *
+ * 			gcc -O2 -Iinclude scripts/SegmentBench.c components/storage/Segment.c components/storage/RecordLog.c -o segbench
+ * 			./segbench -r /tmp/segbench -n 2000000 -k 16 -d 60
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/Segment.h"
+
+// #defines
+/******************************************************************************/
+#define T_ORIGIN 1790000000U			// some time in 2026
+#define HOUR_S 3600
+#define DAY_S 86400
+#define RECORD_LEN 24					// a typical stored packet
+#define LATE_PERCENT 2					// records that arrive out of order
+#define LATE_MAX_S 900
+// The storage writer's buffer, entry header included; it hands the store
+// one node at a time per buffer
+#define WRITER_BUFFER 4096
+#define WRITER_ENTRY (7 + RECORD_LEN)
+#define BATCH (WRITER_BUFFER / WRITER_ENTRY)
+
+#define REPLAY_BUFFER (32 * 1024)
+
+// Variables
+/******************************************************************************/
+static Segment_Query_t Query;
+static uint8_t Query_Buffer[SEGMENT_MIN_QUERY_BUFFER];
+static uint8_t Replay_Buffer[REPLAY_BUFFER];
+
+// Every node's timestamps, sorted, to count the expected results
+static uint32_t **Times;
+static uint32_t *Time_Count;
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -r dir   store directory, emptied first (/tmp/segbench)\n"
+		"  -n n     records (2000000)\n"
+		"  -k n     nodes (16)\n"
+		"  -d days  time span (60)\n"
+		"  -b s     segment length (%d)\n"
+		"  -q n     queries per kind (200)\n",
+		Name, SEGMENT_BUCKET_S);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int Time_Compare(const void *A, const void *B)
+{
+	uint32_t First = *(const uint32_t *)A, Second = *(const uint32_t *)B;
+
+	return (First > Second) - (First < Second);
+}
+
+// First index with Times[i] >= T
+static uint32_t Lower_Bound(const uint32_t *List, uint32_t Count, uint32_t T)
+{
+	uint32_t Low = 0, High = Count, Mid;
+
+	while (Low < High) {
+		Mid = Low + (High - Low) / 2;
+		if (List[Mid] < T) {
+			Low = Mid + 1;
+		} else {
+			High = Mid;
+		}
+	}
+	return Low;
+}
+
+static uint32_t Expected(uint8_t Node, uint32_t T_Start, uint32_t T_End)
+{
+	return Lower_Bound(Times[Node], Time_Count[Node], T_End + 1) - Lower_Bound(Times[Node], Time_Count[Node], T_Start);
+}
+
+// Run one query, returns the records it produced, or -1 on a bad record
+static long Run(const char *Root, uint32_t Bucket_S, uint8_t Node, uint32_t T_Start, uint32_t T_End, double *Elapsed)
+{
+	Segment_Record_t Record;
+	double Start = Seconds();
+	long Count = 0;
+
+	Segment_QueryBegin(&Query, Root, Bucket_S, Node, T_Start, T_End, Query_Buffer, sizeof(Query_Buffer));
+	while (Segment_QueryNext(&Query, &Record) == ESP_OK) {
+		if (Record.Length != RECORD_LEN || Record.Data[0] != Node) {
+			Count = -1;
+			break;
+		}
+		Count++;
+	}
+	Segment_QueryEnd(&Query);
+	*Elapsed = Seconds() - Start;
+
+	return Count;
+}
+
+static int Compare_Double(const void *A, const void *B)
+{
+	double First = *(const double *)A, Second = *(const double *)B;
+
+	return (First > Second) - (First < Second);
+}
+
+// Random queries of one window length, returns false on a wrong count
+static bool Bench_Queries(const char *Root, uint32_t Bucket_S, const char *Name, uint32_t Window,
+	uint32_t Nodes, uint32_t Span, uint32_t Queries)
+{
+	double *Latency = malloc(Queries * sizeof(double)), Total = 0;
+	uint64_t Records = 0, Frames = 0, Bytes = 0;
+	uint32_t i, T_Start, Want;
+	uint8_t Node;
+	long Got;
+
+	for (i = 0; i < Queries; i++) {
+		Node = rand() % Nodes;
+		T_Start = T_ORIGIN + (Window < Span ? rand() % (Span - Window) : 0);
+		Got = Run(Root, Bucket_S, Node, T_Start, T_Start + Window - 1, &Latency[i]);
+		Want = Expected(Node, T_Start, T_Start + Window - 1);
+		if (Got != (long)Want) {
+			printf("%s query node %u at %u: %ld records, expected %u\n", Name, Node, T_Start, Got, Want);
+			free(Latency);
+			return false;
+		}
+		Total += Latency[i];
+		Records += Got;
+		Frames += Query.Stats.Frames;
+		Bytes += Query.Stats.Bytes_Read;
+	}
+
+	qsort(Latency, Queries, sizeof(double), Compare_Double);
+	printf("%-10s %8.3f ms mean %8.3f ms p99 %9.0f records %9.0f frames %8.1f KiB read\n", Name,
+		Total / Queries * 1e3, Latency[Queries * 99 / 100] * 1e3, (double)Records / Queries,
+		(double)Frames / Queries, Bytes / 1024.0 / Queries);
+
+	free(Latency);
+	return true;
+}
+
+typedef struct {
+	uint8_t Node;
+	uint32_t Records;
+	uint32_t Stop_At;			// stop the run once this many came
+	bool Bad;
+} Replay_t;
+
+static bool Replay_Batch(const Segment_Record_t *Records, uint32_t Count, void *Context)
+{
+	Replay_t *Replay = Context;
+	uint32_t i;
+
+	for (i = 0; i < Count; i++) {
+		if (Records[i].Length != RECORD_LEN || Records[i].Data[0] != Replay->Node) {
+			Replay->Bad = true;
+		}
+	}
+	Replay->Records += Count;
+	return Replay->Records < Replay->Stop_At;
+}
+
+// Every node in two runs, the second resumed from where the first stopped
+static bool Bench_Replay(const char *Root, uint32_t Bucket_S, uint32_t Nodes)
+{
+	Segment_Position_t Position;
+	uint64_t Bytes = 0;
+	uint32_t Batches = 0, Records = 0, n;
+	Replay_t Replay;
+	double Start = Seconds();
+
+	for (n = 0; n < Nodes; n++) {
+		memset(&Replay, 0, sizeof(Replay));
+		Replay.Node = n;
+		Replay.Stop_At = Time_Count[n] / 2;
+
+		Segment_QueryBegin(&Query, Root, Bucket_S, n, 0, UINT32_MAX, Replay_Buffer, sizeof(Replay_Buffer));
+		if (Segment_QueryRun(&Query, Replay_Batch, &Replay) == ESP_ERR_NOT_FINISHED) {
+			Segment_QueryTell(&Query, &Position);
+			Bytes += Query.Stats.Bytes_Read;
+			Batches += Query.Stats.Batches;
+			Segment_QueryEnd(&Query);
+
+			Replay.Stop_At = UINT32_MAX;
+			Segment_QueryBegin(&Query, Root, Bucket_S, n, 0, UINT32_MAX, Replay_Buffer, sizeof(Replay_Buffer));
+			Segment_QuerySeek(&Query, &Position);
+			Segment_QueryRun(&Query, Replay_Batch, &Replay);
+		}
+		Bytes += Query.Stats.Bytes_Read;
+		Batches += Query.Stats.Batches;
+		Segment_QueryEnd(&Query);
+
+		if (Replay.Bad || Replay.Records != Time_Count[n]) {
+			printf("replay node %u: %u records, expected %u%s\n", n, Replay.Records, Time_Count[n],
+				Replay.Bad ? ", some wrong" : "");
+			return false;
+		}
+		Records += Replay.Records;
+	}
+
+	Start = Seconds() - Start;
+	printf("%-10s %8.1f MB/s %9.0f records/s %7u batches of %.1f, %u KiB buffer, resumed halfway\n", "replay",
+		Bytes / Start / 1e6, Records / Start, Batches, (double)Records / Batches, REPLAY_BUFFER / 1024);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	static SegmentStore_t Store;
+	uint8_t Record[RECORD_LEN];
+	const char *Root = "/tmp/segbench";
+	uint32_t Records = 2000000, Nodes = 16, Days = 60, Queries = 200, Bucket_S = SEGMENT_BUCKET_S;
+	uint32_t Span, i, n, Step, Total, First, Last;
+	uint32_t Batch[BATCH];
+	RecordLog_Stats_t Stats;
+	char Command[SEGMENT_PATH_LEN + 16];
+	double Start, Elapsed;
+	long Got;
+	int Opt;
+
+	while ((Opt = getopt(argc, argv, "r:n:k:d:b:q:h")) != -1) {
+		switch (Opt) {
+		case 'r': Root = optarg; break;
+		case 'n': Records = atoi(optarg); break;
+		case 'k': Nodes = atoi(optarg); break;
+		case 'd': Days = atoi(optarg); break;
+		case 'b': Bucket_S = atoi(optarg); break;
+		case 'q': Queries = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Nodes == 0 || Nodes > 256 || Records < Nodes || Queries == 0) {
+		Usage(argv[0]);
+		return 1;
+	}
+	Span = Days * DAY_S;
+	Step = Span / (Records / Nodes);
+
+	snprintf(Command, sizeof(Command), "rm -rf %s", Root);
+	if (system(Command) != 0 || SegmentStore_Open(&Store, Root, Bucket_S) != ESP_OK) {
+		perror(Root);
+		return 1;
+	}
+
+	Times = calloc(Nodes, sizeof(uint32_t *));
+	Time_Count = calloc(Nodes, sizeof(uint32_t));
+	for (n = 0; n < Nodes; n++) {
+		Times[n] = malloc((Records / Nodes + 1) * sizeof(uint32_t));
+	}
+
+	// Nodes report in turn, each on a regular period; a few packets are
+	// stored late with an older timestamp
+	srand(1);
+	Start = Seconds();
+	Total = Records / Nodes * Nodes;
+	for (First = 0; First < Total; First += BATCH) {
+		Last = First + BATCH < Total ? First + BATCH : Total;
+		for (i = First; i < Last; i++) {
+			Batch[i - First] = T_ORIGIN + (i / Nodes) * Step + i % Nodes;
+			if (rand() % 100 < LATE_PERCENT && Batch[i - First] > T_ORIGIN + LATE_MAX_S) {
+				Batch[i - First] -= rand() % LATE_MAX_S;
+			}
+		}
+		for (n = 0; n < Nodes; n++) {
+			for (i = First + (n + Nodes - First % Nodes) % Nodes; i < Last; i += Nodes) {
+				memset(Record, n, sizeof(Record));
+				memcpy(Record + 1, &i, sizeof(i));
+				if (SegmentStore_Append(&Store, n, Batch[i - First], Record, sizeof(Record)) != ESP_OK) {
+					fprintf(stderr, "append %u failed\n", i);
+					return 1;
+				}
+				Times[n][Time_Count[n]++] = Batch[i - First];
+			}
+		}
+	}
+	SegmentStore_Close(&Store);
+	Elapsed = Seconds() - Start;
+	SegmentStore_GetStats(&Store, &Stats);
+
+	for (n = 0; n < Nodes; n++) {
+		qsort(Times[n], Time_Count[n], sizeof(uint32_t), Time_Compare);
+	}
+
+	printf("wrote %u records, %u nodes, %u days in %.2f s (%.0f records/s)\n", Total, Nodes, Days,
+		Elapsed, Total / Elapsed);
+	printf("%u segments sealed, %.1f MiB written, write() amplification %.3f\n\n", Store.Sealed,
+		Stats.Device_Bytes / 1048576.0, (double)Stats.Device_Bytes / Stats.Payload_Bytes);
+
+	if (!Bench_Queries(Root, Bucket_S, "1 hour", HOUR_S, Nodes, Span, Queries)
+		|| !Bench_Queries(Root, Bucket_S, "1 day", DAY_S, Nodes, Span, Queries)
+		|| !Bench_Queries(Root, Bucket_S, "7 days", 7 * DAY_S, Nodes, Span, Queries)) {
+		return 1;
+	}
+
+	// Reference: every record of one node, what a flat log would need to
+	// read for any of the queries above
+	Got = Run(Root, Bucket_S, 0, 0, UINT32_MAX, &Elapsed);
+	printf("%-10s %8.3f ms      %9ld records %9u frames %8.1f KiB read\n", "full scan", Elapsed * 1e3,
+		Got, Query.Stats.Frames, Query.Stats.Bytes_Read / 1024.0);
+
+	if (Got != (long)Time_Count[0] || !Bench_Replay(Root, Bucket_S, Nodes)) {
+		return 1;
+	}
+	return 0;
+}
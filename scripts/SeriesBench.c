@@ -0,0 +1,214 @@
+/**
+ * @file SeriesBench.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host series codec benchmark. Synthesizes sensor series (slow soil
+ * 			and air readings with a daily cycle, gusty wind, a jittered
+ * 			report period), compresses them in blocks, checks that every
+ * 			sample decodes back bit for bit, and reports the compression
+ * 			ratio against the uncompressed records and encode/decode MB/s.
+ * 			Integer columns are RAW_SENSOR_DATA wire units; the float run
+ * 			stores the same readings as physical floats.
+ *
+ * 			gcc -O2 -Iinclude scripts/SeriesBench.c components/storage/SeriesCodec.c -lm -o seriesbench
+ * 			./seriesbench -n 1000000 -b 512
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/SeriesCodec.h"
+
+// #defines
+/******************************************************************************/
+#define T_ORIGIN 1790000000U
+#define COLUMNS 6					// soil moisture, soil temp, air temp, humidity, wind, direction
+#define DAY_S 86400.0
+#define JITTER_PERCENT 5			// reports a second or two off the period
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n n     samples (1000000)\n"
+		"  -b n     block bytes (512, at most %d)\n"
+		"  -p s     report period (60)\n",
+		Name, SERIES_MAX_BLOCK);
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double Noise(double Amplitude)
+{
+	return Amplitude * ((double)rand() / RAND_MAX * 2 - 1);
+}
+
+// Readings in wire units (FixedPoint.h), as a cluster head receives them
+static void Synthesize(uint32_t Count, uint32_t Period, uint32_t *Times, int32_t *Ints)
+{
+	double Moisture = 600, Direction = 1800, Day, Wind = 0;
+	uint32_t i, T = T_ORIGIN;
+	int32_t *Row;
+
+	for (i = 0; i < Count; i++) {
+		Row = &Ints[i * COLUMNS];
+		T += Period;
+		Times[i] = T + (rand() % 100 < JITTER_PERCENT ? rand() % 5 - 2 : 0);
+		Day = sin(2 * M_PI * (T - T_ORIGIN) / DAY_S);
+
+		Moisture += Noise(0.6);
+		Direction += Noise(40);
+		Direction = fmod(Direction + 3600, 3600);
+		Wind = Wind * 0.8 + (rand() % 4 == 0 ? rand() % 1500 : 0);
+
+		Row[0] = (int32_t)Moisture;
+		Row[1] = (int32_t)(1500 + 200 * Day + Noise(2));
+		Row[2] = (int32_t)(1800 + 600 * Day + Noise(4));
+		Row[3] = (int32_t)(6000 - 1500 * Day + Noise(10));
+		Row[4] = (int32_t)Wind;
+		Row[5] = (int32_t)Direction;
+	}
+}
+
+typedef struct {
+	uint64_t Raw_Bytes;
+	uint64_t Block_Bytes;
+	uint32_t Blocks;
+	double Encode_S;
+	double Decode_S;
+} Result_t;
+
+static bool Run(const char *Name, uint32_t Count, uint16_t Block_Size, bool Floats, const uint32_t *Times,
+	const int32_t *Ints, Result_t *Result)
+{
+	static const float Scale[COLUMNS] = {1, 100, 100, 100, 100, 10};
+	Series_Value_t (*Values)[COLUMNS] = malloc(Count * sizeof(*Values));
+	Series_Value_t Out[COLUMNS];
+	// Worst case, one sample per block
+	uint8_t *Blocks = malloc((size_t)Count * (SERIES_HEADER_LEN + 4 + 6 * COLUMNS) + Block_Size), *At;
+	uint16_t *Lengths = malloc((Count + 1) * sizeof(uint16_t)), Length;
+	uint16_t Float_Mask = Floats ? (1U << COLUMNS) - 1 : 0;
+	Series_Encoder_t Encoder;
+	Series_Decoder_t Decoder;
+	uint32_t i, b, Got = 0, Timestamp;
+	double Start;
+	int c;
+
+	for (i = 0; i < Count; i++) {
+		for (c = 0; c < COLUMNS; c++) {
+			if (Floats) {
+				Values[i][c].Float = Ints[i * COLUMNS + c] / Scale[c];
+			} else {
+				Values[i][c].Int = Ints[i * COLUMNS + c];
+			}
+		}
+	}
+	memset(Result, 0, sizeof(*Result));
+	// What the store holds without the codec: timestamp and 16 bit values,
+	// or 32 bit floats
+	Result->Raw_Bytes = (uint64_t)Count * (4 + (Floats ? 4 : 2) * COLUMNS);
+
+	// Blocks packed back to back
+	Start = Seconds();
+	At = Blocks;
+	Series_EncodeBegin(&Encoder, At, Block_Size, COLUMNS, Float_Mask);
+	for (i = 0; i < Count; i++) {
+		if (Series_Append(&Encoder, Times[i], Values[i]) != ESP_OK) {
+			Length = Series_EncodeEnd(&Encoder);
+			Lengths[Result->Blocks++] = Length;
+			At += Length;
+			Series_EncodeBegin(&Encoder, At, Block_Size, COLUMNS, Float_Mask);
+			Series_Append(&Encoder, Times[i], Values[i]);
+		}
+	}
+	Length = Series_EncodeEnd(&Encoder);
+	Lengths[Result->Blocks++] = Length;
+	At += Length;
+	Result->Encode_S = Seconds() - Start;
+	Result->Block_Bytes = At - Blocks;
+
+	Start = Seconds();
+	for (b = 0, At = Blocks; b < Result->Blocks; At += Lengths[b++]) {
+		if (Series_DecodeBegin(&Decoder, At, Lengths[b]) != ESP_OK) {
+			break;
+		}
+		while (Series_Next(&Decoder, &Timestamp, Out) == ESP_OK) {
+			if (Timestamp != Times[Got] || memcmp(Out, Values[Got], sizeof(Out)) != 0) {
+				printf("%s: sample %u decodes differently\n", Name, Got);
+				return false;
+			}
+			Got++;
+		}
+	}
+	Result->Decode_S = Seconds() - Start;
+
+	free(Values);
+	free(Blocks);
+	free(Lengths);
+	if (Got != Count) {
+		printf("%s: %u of %u samples decoded\n", Name, Got, Count);
+		return false;
+	}
+
+	printf("%-6s %6.2fx  %5.1f bits/sample  %7u blocks  encode %7.1f MB/s  decode %7.1f MB/s\n", Name,
+		(double)Result->Raw_Bytes / Result->Block_Bytes, Result->Block_Bytes * 8.0 / Count, Result->Blocks,
+		Result->Raw_Bytes / Result->Encode_S / 1e6, Result->Raw_Bytes / Result->Decode_S / 1e6);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t Count = 1000000, Period = 60, Block_Size = 512;
+	uint32_t *Times;
+	int32_t *Ints;
+	Result_t Ints_Result, Floats_Result;
+	int Opt;
+
+	while ((Opt = getopt(argc, argv, "n:b:p:h")) != -1) {
+		switch (Opt) {
+		case 'n': Count = atoi(optarg); break;
+		case 'b': Block_Size = atoi(optarg); break;
+		case 'p': Period = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (Count == 0 || Block_Size <= SERIES_HEADER_LEN || Block_Size > SERIES_MAX_BLOCK) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	Times = malloc(Count * sizeof(uint32_t));
+	Ints = malloc((size_t)Count * COLUMNS * sizeof(int32_t));
+	srand(1);
+	Synthesize(Count, Period, Times, Ints);
+
+	printf("%u samples, %u columns, %u s period, %u byte blocks\n", Count, COLUMNS, Period, Block_Size);
+	if (!Run("int", Count, Block_Size, false, Times, Ints, &Ints_Result)
+		|| !Run("float", Count, Block_Size, true, Times, Ints, &Floats_Result)) {
+		return 1;
+	}
+
+	free(Times);
+	free(Ints);
+	return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file WindvaneTest.c
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host test of the wind vane conversion. Every 12 bit ADC code is
+ * 			mapped with the binary search over the threshold table and
+ * 			with a linear nearest voltage scan (the old conversion), and
+ * 			both must agree. The code on each side of every sector
+ * 			boundary and both ends of the range are checked on their
+ * 			own, then the vector average is checked around north, where
+ * 			it has to wrap at 360 instead of landing near 180.
+ *
+ * 			gcc -O2 -Iinclude scripts/WindvaneTest.c components/sensors/Windvane.c -o windvanetest -lm
+ * 			./windvanetest -v
+ *
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/Windvane.h"
+
+// #defines
+/******************************************************************************/
+#define CODES 4096
+#define TOLERANCE_DEG 0.01f
+
+// Variables
+/******************************************************************************/
+// Divider output of each sector as the vane datasheet gives it, kept apart
+// from the copy in Windvane.c so a typo there shows up here
+static const double Golden_Voltage[NUMBER_OF_KEYS] = {
+	2.53, 1.31, 1.49, 0.27, 0.30, 0.21, 0.60, 0.41,
+	0.93, 0.79, 2.03, 1.93, 3.05, 2.67, 2.86, 2.26
+};
+
+static uint32_t Failures;
+
+// Functions
+/******************************************************************************/
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -v       print the sector boundaries\n",
+		Name);
+}
+
+static void Fail(const char *What, unsigned int A, double B, double C)
+{
+	if (Failures++ < 20) {
+		printf("FAIL %s: %u %.4f %.4f\n", What, A, B, C);
+	}
+}
+
+// The conversion the table replaced: closest sector voltage, a tie goes to
+// the higher one like the rounded up threshold does
+static uint8_t Linear_Sector(uint16_t Raw)
+{
+	double Voltage = Raw * MAX_ADC_VOLTAGE / CODES, Best = 1e9, Distance;
+	uint8_t Sector = 0;
+	int i;
+
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Distance = fabs(Golden_Voltage[i] - Voltage);
+		if (Distance < Best || (Distance == Best && Golden_Voltage[i] > Golden_Voltage[Sector])) {
+			Best = Distance;
+			Sector = i;
+		}
+	}
+
+	return Sector;
+}
+
+static float Angle_Error(float A, float B)
+{
+	float Error = fabsf(A - B);
+
+	return Error > 180 ? 360 - Error : Error;
+}
+
+// Direction or Resultant below 0 are not checked, only the range is
+static void Check_Average(const char *What, const uint32_t Count[NUMBER_OF_KEYS], float Direction, float Resultant)
+{
+	Windvane_Snapshot_t Snapshot;
+	uint32_t Samples = 0;
+	int i;
+
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Samples += Count[i];
+	}
+	Windvane_Average(Count, Samples, &Snapshot);
+
+	if (Snapshot.Samples != Samples) {
+		Fail(What, Snapshot.Samples, Samples, 0);
+	}
+	if (!(Snapshot.Direction >= 0 && Snapshot.Direction < 360)) {
+		Fail(What, 0, Snapshot.Direction, Direction);
+	}
+	if (Direction >= 0 && Angle_Error(Snapshot.Direction, Direction) > TOLERANCE_DEG) {
+		Fail(What, 1, Snapshot.Direction, Direction);
+	}
+	if (Resultant >= 0 && fabsf(Snapshot.Resultant - Resultant) > 1e-4f) {
+		Fail(What, 2, Snapshot.Resultant, Resultant);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t Count[NUMBER_OF_KEYS];
+	uint8_t Order[NUMBER_OF_KEYS], Key, Sector, Previous;
+	uint32_t Boundary, Changes = 0, Seen = 0, Codes_Checked = 0;
+	double Midpoint, Expected;
+	bool Verbose = false;
+	int Opt, i, j;
+
+	while ((Opt = getopt(argc, argv, "vh")) != -1) {
+		switch (Opt) {
+		case 'v': Verbose = true; break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	Windvane_BuildTables();
+
+	// Every code, table against the linear scan
+	Previous = Windvane_Sector(0);
+	for (i = 0; i < CODES; i++) {
+		Sector = Windvane_Sector(i);
+		if (Sector >= NUMBER_OF_KEYS || Sector != Linear_Sector(i)) {
+			Fail("code", i, Sector, Linear_Sector(i));
+		}
+		if (Sector != Previous) {
+			Changes++;
+		}
+		Seen |= 1U << Sector;
+		Previous = Sector;
+		Codes_Checked++;
+	}
+	if (Changes != NUMBER_OF_KEYS - 1 || Seen != (1U << NUMBER_OF_KEYS) - 1) {
+		Fail("monotonic", Changes, Seen, 0);
+	}
+
+	// Each boundary on its own: last code of the lower sector, first of the upper
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Order[i] = i;
+	}
+	for (i = 1; i < NUMBER_OF_KEYS; i++) {
+		Key = Order[i];
+		for (j = i - 1; j >= 0 && Golden_Voltage[Order[j]] > Golden_Voltage[Key]; j--) {
+			Order[j + 1] = Order[j];
+		}
+		Order[j + 1] = Key;
+	}
+	if (Windvane_Sector(0) != Order[0] || Windvane_Sector(CODES - 1) != Order[NUMBER_OF_KEYS - 1]) {
+		Fail("range end", 0, Windvane_Sector(0), Windvane_Sector(CODES - 1));
+	}
+	for (i = 0; i < NUMBER_OF_KEYS - 1; i++) {
+		Midpoint = (Golden_Voltage[Order[i]] + Golden_Voltage[Order[i + 1]]) / 2;
+		Boundary = (uint32_t)ceil(Midpoint / MAX_ADC_VOLTAGE * CODES);
+		if (Windvane_Sector(Boundary - 1) != Order[i] || Windvane_Sector(Boundary) != Order[i + 1]) {
+			Fail("boundary", Boundary, Windvane_Sector(Boundary - 1), Windvane_Sector(Boundary));
+		}
+		if (Verbose) {
+			printf("sector %2u (%.2f V) | %4u | sector %2u (%.2f V)\n", Order[i], Golden_Voltage[Order[i]],
+				Boundary, Order[i + 1], Golden_Voltage[Order[i + 1]]);
+		}
+	}
+
+	// A single sector is its own bearing, north is 0 and never 360
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		memset(Count, 0, sizeof(Count));
+		Count[i] = 1000;
+		Check_Average("single", Count, i * KEY_TO_DEG, 1);
+	}
+
+	// Neighbours average to the bearing between them, 15 and 0 across north
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		memset(Count, 0, sizeof(Count));
+		Count[i] = 500;
+		Count[(i + 1) % NUMBER_OF_KEYS] = 500;
+		Expected = fmod(i * KEY_TO_DEG + KEY_TO_DEG / 2, 360);
+		Check_Average("pair", Count, Expected, cos(KEY_TO_DEG / 2 * M_PI / 180));
+	}
+
+	// Symmetric about north within 90 degrees lands on north, an arithmetic
+	// mean of the bearings would give 180
+	for (i = 1; i < NUMBER_OF_KEYS / 4; i++) {
+		memset(Count, 0, sizeof(Count));
+		Count[i] = 300;
+		Count[NUMBER_OF_KEYS - i] = 300;
+		Check_Average("about north", Count, 0, cos(i * KEY_TO_DEG * M_PI / 180));
+	}
+
+	// A hair west of north comes out just under 360, not at or over it
+	memset(Count, 0, sizeof(Count));
+	Count[NUMBER_OF_KEYS - 1] = 1000;
+	Count[1] = 999;
+	Expected = atan2(-sin(KEY_TO_DEG * M_PI / 180), 1999 * cos(KEY_TO_DEG * M_PI / 180)) * 180 / M_PI + 360;
+	Check_Average("just west of north", Count, Expected, -1);
+
+	// No direction at all, and an empty window
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		Count[i] = 10;
+	}
+	Check_Average("uniform", Count, -1, 0);
+	memset(Count, 0, sizeof(Count));
+	Check_Average("empty", Count, -1, 0);
+
+	if (Failures) {
+		printf("%u failures\n", Failures);
+		return 1;
+	}
+
+	printf("%u codes match the linear scan, %d boundaries and the wrap at north hold\n", Codes_Checked, NUMBER_OF_KEYS - 1);
+	return 0;
+}
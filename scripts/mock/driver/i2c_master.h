@@ -0,0 +1,58 @@
+/**
+ * @file i2c_master.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host stand in for the i2c_master driver calls the I2C bus manager
+ * 			makes. Transfers take the time their bits would on the wire.
+ * 			Implemented in scripts/I2CBusBench.c.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef MOCK_I2C_MASTER_H
+#define MOCK_I2C_MASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef int i2c_port_num_t;
+
+typedef enum {
+	I2C_CLK_SRC_DEFAULT,
+} i2c_clock_source_t;
+
+typedef enum {
+	I2C_ADDR_BIT_LEN_7,
+} i2c_addr_bit_len_t;
+
+typedef struct {
+	i2c_port_num_t i2c_port;
+	int sda_io_num;
+	int scl_io_num;
+	i2c_clock_source_t clk_source;
+	uint8_t glitch_ignore_cnt;
+} i2c_master_bus_config_t;
+
+typedef struct {
+	i2c_addr_bit_len_t dev_addr_length;
+	uint16_t device_address;
+	uint32_t scl_speed_hz;
+} i2c_device_config_t;
+
+typedef struct Mock_I2C_Bus *i2c_master_bus_handle_t;
+typedef struct Mock_I2C_Device *i2c_master_dev_handle_t;
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *Config, i2c_master_bus_handle_t *Bus);
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t Bus);
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t Bus, const i2c_device_config_t *Config, i2c_master_dev_handle_t *Device);
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t Device);
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t Device, const uint8_t *Write, size_t Write_Size, int Timeout_MS);
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t Device, uint8_t *Read, size_t Read_Size, int Timeout_MS);
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t Device, const uint8_t *Write, size_t Write_Size, uint8_t *Read, size_t Read_Size, int Timeout_MS);
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t Bus, uint16_t Address, int Timeout_MS);
+
+#endif // MOCK_I2C_MASTER_H
@@ -0,0 +1,25 @@
+// Host stand in for the ESP error codes the I2C bus manager uses
+#ifndef MOCK_ESP_ERR_H
+#define MOCK_ESP_ERR_H
+
+#include <stdio.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) ({ \
+	esp_err_t err_rc_ = (x); \
+	if (err_rc_ != ESP_OK) { \
+		fprintf(stderr, "%s:%d: %s = 0x%x\n", __FILE__, __LINE__, #x, err_rc_); \
+	} \
+	err_rc_; \
+})
+
+#endif // MOCK_ESP_ERR_H
@@ -0,0 +1,6 @@
+// Host stand in, logs go to stderr
+#include <stdio.h>
+
+#define ESP_LOGE(Tag, Format, ...) fprintf(stderr, "E %s: " Format "\n", Tag, ##__VA_ARGS__)
+#define ESP_LOGW(Tag, Format, ...) fprintf(stderr, "W %s: " Format "\n", Tag, ##__VA_ARGS__)
+#define ESP_LOGI(Tag, Format, ...) fprintf(stderr, "I %s: " Format "\n", Tag, ##__VA_ARGS__)
@@ -0,0 +1,66 @@
+/**
+ * @file FreeRTOS.h
+ * @author Jacob Dennon (jdennon@ucsc.edu)
+ * @brief Host stand in for the few FreeRTOS calls the I2C bus manager makes,
+ * 			on pthreads. Implemented in scripts/I2CBusBench.c.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef MOCK_FREERTOS_H
+#define MOCK_FREERTOS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+
+// Critical sections are a plain mutex on the host
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define taskENTER_CRITICAL(Mux) pthread_mutex_lock(Mux)
+#define taskEXIT_CRITICAL(Mux) pthread_mutex_unlock(Mux)
+
+typedef struct Mock_Task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct Mock_Queue *QueueHandle_t;
+
+// Mutexes and binary semaphores are both a count behind a condition variable
+typedef struct {
+	pthread_mutex_t Mutex;
+	pthread_cond_t Cond;
+	int Count;
+} StaticSemaphore_t;
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t Function, const char *Name, uint32_t Stack, void *Arg, UBaseType_t Priority, TaskHandle_t *Handle);
+void vTaskDelete(TaskHandle_t Task);
+void vTaskDelay(TickType_t Ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+QueueHandle_t xQueueCreate(UBaseType_t Length, UBaseType_t Item_Size);
+void vQueueDelete(QueueHandle_t Queue);
+BaseType_t xQueueSend(QueueHandle_t Queue, const void *Item, TickType_t Wait);
+BaseType_t xQueueReceive(QueueHandle_t Queue, void *Item, TickType_t Wait);
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *Buffer);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *Buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t Semaphore, TickType_t Wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t Semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t Semaphore);
+
+#endif // MOCK_FREERTOS_H
@@ -0,0 +1,2 @@
+// Host stand in, see FreeRTOS.h
+#include "FreeRTOS.h"
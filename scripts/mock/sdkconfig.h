@@ -0,0 +1,5 @@
+// Host stand in, the menuconfig values the I2C bus manager reads
+#define CONFIG_I2C_MASTER_SCL 42
+#define CONFIG_I2C_MASTER_SDA 41
+#define CONFIG_I2C_MASTER_FREQ 100000
+#define CONFIG_I2C_MASTER_TIMEOUT 1000